@@ -45,6 +45,7 @@
 #include "nnfusion/core/operators/op_define/ceiling.hpp"
 #include "nnfusion/core/operators/op_define/concat.hpp"
 #include "nnfusion/core/operators/op_define/constant.hpp"
+#include "nnfusion/core/operators/op_define/control_flow.hpp"
 #include "nnfusion/core/operators/op_define/convert.hpp"
 #include "nnfusion/core/operators/op_define/convolution.hpp"
 #include "nnfusion/core/operators/op_define/cos.hpp"
@@ -186,6 +186,9 @@ namespace nnfusion
 
     void* aligned_alloc(size_t alignment, size_t size);
     void aligned_free(void*);
+
+    // Hex SHA-1 digest of data, the same on every build and platform, unlike std::hash.
+    std::string sha1_digest(const std::string& data);
     //     size_t round_up(size_t size, size_t alignment);
     //     template <typename T>
     //     T apply_permutation(T input, nnfusion::AxisVector order);
@@ -11,6 +11,7 @@
 #include "nnfusion/core/graph/gnode.hpp"
 #include "nnfusion/core/graph/graph.hpp"
 
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
 #include "nnfusion/core/operators/op_define/fused.hpp"
 
 using namespace std;
@@ -382,7 +383,7 @@ const nnfusion::element::Type& GNodeIndex::get_element_type() const
 }
 
 void FusedGNode::build_fused_node(std::unordered_set<std::shared_ptr<GNode>> nodes,
-    std::shared_ptr<Graph> graph)
+    std::shared_ptr<Graph> graph, bool clean_graph)
 {
     // Reorder input nodes to satisfy the reverse-DFS traversal
     NNFUSION_CHECK(!m_order_nodes.size());
@@ -391,6 +392,7 @@ void FusedGNode::build_fused_node(std::unordered_set<std::shared_ptr<GNode>> nod
         if (nodes.find(node) == nodes.end())
             continue;
         m_order_nodes.push_back(node);
+        m_op_contexts.push_back(std::make_shared<OpContext>(node));
     }
 
     NNFUSION_CHECK(m_order_nodes.size());
@@ -482,10 +484,28 @@ void FusedGNode::build_fused_node(std::unordered_set<std::shared_ptr<GNode>> nod
         useless_edges.pop();
     }
 
+    // The IR of the fused op is derived from the edges between the fused nodes, which are
+    // only removed afterwards.
     derive_op_def();
+
+    if (clean_graph)
+    {
+        for (auto& node : m_order_nodes)
+            graph->remove_node(node);
+        for (auto& proxy : m_proxy_inputs)
+            graph->remove_node(proxy);
+    }
 }
 
 void FusedGNode::derive_op_def()
 {
+    // Ops without an Antares expression, like a Max reduction, leave the fusion to its kernel
+    // emitter.
+    for (const auto& m_node : m_order_nodes)
+    {
+        auto it = nnfusion::op::get_op_configs().find(m_node->get_op_type());
+        if (it == nnfusion::op::get_op_configs().end() || !it->second.f_translate_v2)
+            return;
+    }
     static_pointer_cast<nnfusion::op::Fused>(m_op_ptr)->register_ir2(shared_from_this());
 }
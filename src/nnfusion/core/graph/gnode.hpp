@@ -227,8 +227,11 @@ namespace nnfusion
                 construct_from_op_ptr(op_ptr);
             };
 
+            // With clean_graph, the fused nodes and the proxy inputs are removed from graph,
+            // otherwise the caller removes them.
             void build_fused_node(std::unordered_set<std::shared_ptr<GNode>> nodes,
-                                  std::shared_ptr<Graph> graph);
+                                  std::shared_ptr<Graph> graph,
+                                  bool clean_graph = false);
 
             const std::vector<std::shared_ptr<GNode>> get_mediates_nodes() const {
                 return m_order_nodes;
@@ -242,12 +245,19 @@ namespace nnfusion
                 return m_proxy_outputs;
             }
 
+            // Ops and tensors of the mediate nodes, kept after they are removed from the graph.
+            const std::vector<std::shared_ptr<OpContext>>& get_op_contexts() const
+            {
+                return m_op_contexts;
+            }
+
         protected:
             void derive_op_def();
 
             std::vector<std::shared_ptr<GNode>> m_order_nodes;
             std::vector<std::shared_ptr<GNode>> m_proxy_inputs;
             std::vector<std::shared_ptr<Output>> m_proxy_outputs;
+            std::vector<std::shared_ptr<OpContext>> m_op_contexts;
         };
     } // namespace graph
 } // namespace nnfusion
@@ -127,6 +127,8 @@ void Graph::remove_node(std::shared_ptr<GNode> node)
     {
         remove_edge(*node->get_out_edges().begin());
     }
+    if (get_order_position(node) >= 0)
+        invalidate_ordered_ops();
     m_nodes[node->get_id()] = nullptr;
     node->Clear();
     m_free_nodes.push_back(node);
@@ -185,15 +187,40 @@ GNodeVector Graph::get_nodes()
 
 GNodeVector Graph::get_ordered_ops()
 {
-    // todo: stored ops instead of calculate each time
-    GNodeVector nodes;
-    ReverseDFS(this,
-               get_outputs(),
-               nullptr,
-               [&](std::shared_ptr<GNode> node) { nodes.push_back(node); },
-               nullptr);
+    if (!m_ordered_ops_is_valid)
+    {
+        m_ordered_ops.clear();
+        ReverseDFS(this,
+                   get_outputs(),
+                   nullptr,
+                   [&](std::shared_ptr<GNode> node) { m_ordered_ops.push_back(node); },
+                   nullptr);
+        m_order_position.assign(m_nodes.size(), -1);
+        for (size_t i = 0; i < m_ordered_ops.size(); i++)
+            m_order_position[m_ordered_ops[i]->get_id()] = i;
+        m_ordered_ops_is_valid = true;
+        ++m_ordered_ops_rebuilds;
+    }
+    return m_ordered_ops;
+}
+
+void Graph::invalidate_ordered_ops()
+{
+    m_ordered_ops_is_valid = false;
+    m_bfs_ordered_ops_is_valid = false;
+}
 
-    return nodes;
+int Graph::get_order_position(const std::shared_ptr<GNode>& node) const
+{
+    size_t id = node->get_id();
+    if (!m_ordered_ops_is_valid || id >= m_order_position.size())
+        return -1;
+    return m_order_position[id];
+}
+
+bool Graph::is_output(const std::shared_ptr<GNode>& node) const
+{
+    return std::find(m_output_nodes.begin(), m_output_nodes.end(), node) != m_output_nodes.end();
 }
 
 GNodeVector Graph::get_bfs_ordered_ops()
@@ -282,6 +309,16 @@ const std::shared_ptr<nnfusion::graph::Edge>
         edge = m_free_edges.back();
         m_free_edges.pop_back();
     }
+    // An edge into an unreachable node changes nothing, an edge between two ordered nodes keeps
+    // the order when it points forward. Anything else may make new nodes reachable.
+    if (m_ordered_ops_is_valid)
+    {
+        int dest_position = get_order_position(dest);
+        int source_position = get_order_position(source);
+        if (dest_position >= 0 && (source_position < 0 || source_position > dest_position))
+            invalidate_ordered_ops();
+    }
+
     edge->m_id = m_edges.size();
     edge->m_src = source;
     edge->m_dst = dest;
@@ -335,8 +372,18 @@ void Graph::remove_edge(std::shared_ptr<Edge> edge)
     {
         // todo remove ^src from dst's node_def's input
     }
-    edge->get_src()->remove_out_edge(edge);
+    auto source = edge->get_src();
+    source->remove_out_edge(edge);
     edge->get_dst()->remove_in_edge(edge);
+    // The source stays reachable through an output or another consumer which is reachable.
+    if (get_order_position(source) >= 0 && !is_output(source))
+    {
+        bool reachable = false;
+        for (auto& out_edge : source->get_out_edges())
+            reachable |= get_order_position(out_edge->get_dst()) >= 0;
+        if (!reachable)
+            invalidate_ordered_ops();
+    }
     NNFUSION_CHECK(edge == m_edges[edge->m_id]);
     //CHECK_GT(m_num_edges, 0);
 
@@ -353,6 +400,7 @@ void Graph::remove_edge(std::shared_ptr<Edge> edge)
 
 void Graph::set_default_outputs()
 {
+    invalidate_ordered_ops();
     m_output_nodes.clear();
     for (auto node : m_nodes)
     {
@@ -364,6 +412,7 @@ void Graph::set_default_outputs()
 }
 void Graph::set_outputs(const GNodeVector& outputs)
 {
+    invalidate_ordered_ops();
     m_output_nodes = outputs;
 }
 
@@ -72,7 +72,11 @@ namespace nnfusion
             // REQUIRES: 0 <= id < get_max_node_id().
 
             GNodeVector get_nodes();
+            // Topological order of the nodes reachable from the outputs. The order is cached
+            // and kept across edits which leave it valid, see invalidate_ordered_ops().
             GNodeVector get_ordered_ops();
+            // How many times the topological order has been computed from scratch.
+            size_t get_ordered_ops_rebuilds() const { return m_ordered_ops_rebuilds; }
             GNodeVector get_bfs_ordered_ops();
 
             GNodeVector get_const_nodes();
@@ -133,6 +137,17 @@ namespace nnfusion
             // the node with that id was removed from the graph.
             GNodeVector m_nodes;
 
+            void invalidate_ordered_ops();
+            // Position of a node in m_ordered_ops, -1 if it is not reachable from the outputs.
+            int get_order_position(const std::shared_ptr<GNode>& node) const;
+            bool is_output(const std::shared_ptr<GNode>& node) const;
+
+            // cached result of get_ordered_ops, indexed by m_order_position
+            GNodeVector m_ordered_ops;
+            std::vector<int> m_order_position;
+            bool m_ordered_ops_is_valid = false;
+            size_t m_ordered_ops_rebuilds = 0;
+
             //ordered ops from bfs
             GNodeVector m_bfs_ordered_ops;
             bool m_bfs_ordered_ops_is_valid = false;
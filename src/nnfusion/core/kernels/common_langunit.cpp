@@ -26,6 +26,7 @@ LU_DEFINE(header::iostream, "#include <iostream>\n");
 LU_DEFINE(header::windows, "#include <windows.h>\n");
 LU_DEFINE(header::unordered_map, "#include <unordered_map>\n");
 LU_DEFINE(header::torch_extension, "#include <torch/extension.h>\n");
+LU_DEFINE(header::mman, "#include <fcntl.h>\n#include <sys/mman.h>\n#include <unistd.h>\n");
 
 // Macro
 LU_DEFINE(macro::NNFUSION_DEBUG, "#define NNFUSION_DEBUG\n");
@@ -37,3 +38,4 @@ LU_DEFINE(declaration::typedef_int,
           "int32_t;\ntypedef signed long int int64_t;\ntypedef unsigned char uint8_t;\ntypedef "
           "unsigned short uint16_t;\ntypedef unsigned int uint32_t;\ntypedef unsigned long int "
           "uint64_t;\n");
+LU_DEFINE(declaration::nnfusion_weights, "extern char* nnfusion_weights;\n");
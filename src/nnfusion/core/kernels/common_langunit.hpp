@@ -40,6 +40,7 @@ namespace nnfusion
             LU_DECLARE(windows);
             LU_DECLARE(unordered_map);
             LU_DECLARE(torch_extension);
+            LU_DECLARE(mman);
         }
 
         namespace macro
@@ -51,6 +52,7 @@ namespace nnfusion
         namespace declaration
         {
             LU_DECLARE(typedef_int);
+            LU_DECLARE(nnfusion_weights);
         }
     } // namespace kernels
 } // namespace nnfusion
\ No newline at end of file
@@ -0,0 +1,1120 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "antares_lowering.hpp"
+#include <functional>
+#include <regex>
+#include "../cpu_helper.hpp"
+#include "../cpu_langunit.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::kernels;
+
+struct cpu::AntaresLowering::Expr
+{
+    enum Kind
+    {
+        Number,
+        Axis,
+        // a tensor named without indices, only read by dtype()
+        TensorRef,
+        Access,
+        Unary,
+        Binary,
+        // args are the value, the default and the conditions
+        When,
+        // text is the dtype, or args[1] the dtype() of another expression
+        Cast,
+        Call,
+        TypeOf
+    };
+
+    Kind kind;
+    std::string text;
+    std::vector<ExprPtr> args;
+    // cache of infer_type
+    std::string dtype;
+};
+
+namespace
+{
+    using Expr = cpu::AntaresLowering::Expr;
+    using ExprPtr = cpu::AntaresLowering::ExprPtr;
+
+    // Loops over the last axis are split into chunks of at most this many elements when a
+    // statement has too few rows to keep the thread pool busy.
+    const int64_t kMaxChunk = 1024;
+
+    ExprPtr make_expr(Expr::Kind kind,
+                      const std::string& text,
+                      const std::vector<ExprPtr>& args = std::vector<ExprPtr>())
+    {
+        auto expr = std::make_shared<Expr>();
+        expr->kind = kind;
+        expr->text = text;
+        expr->args = args;
+        return expr;
+    }
+
+    void walk(const ExprPtr& expr, const std::function<void(const ExprPtr&)>& visit)
+    {
+        visit(expr);
+        for (auto& arg : expr->args)
+            walk(arg, visit);
+    }
+
+    struct Token
+    {
+        enum Kind
+        {
+            Ident,
+            Number,
+            // `quoted` names of functions and dtypes
+            Text,
+            Symbol,
+            End
+        };
+        Kind kind;
+        std::string text;
+    };
+
+    std::vector<Token> tokenize(const std::string& code)
+    {
+        // longest first
+        static const std::vector<std::string> symbols = {
+            "+=!", "*=!", ">=!", "<=!", "=.", "==", "!=", "<=", ">=", "//", "=", "<", ">", "+", "-",
+            "*",   "/",   "%",   "&",   "|",  "~",  "!",  "(",  ")",  "[",  "]", ",", ".", ";"};
+        std::vector<Token> tokens;
+        size_t i = 0;
+        while (i < code.size())
+        {
+            char c = code[i];
+            if (isspace(c))
+            {
+                ++i;
+            }
+            else if (isalpha(c) || c == '_')
+            {
+                size_t j = i;
+                while (j < code.size() && (isalnum(code[j]) || code[j] == '_'))
+                    ++j;
+                tokens.push_back({Token::Ident, code.substr(i, j - i)});
+                i = j;
+            }
+            else if (isdigit(c) || (c == '.' && i + 1 < code.size() && isdigit(code[i + 1])))
+            {
+                size_t j = i;
+                while (j < code.size() && (isdigit(code[j]) || code[j] == '.'))
+                    ++j;
+                if (j < code.size() && (code[j] == 'e' || code[j] == 'E'))
+                {
+                    ++j;
+                    if (j < code.size() && (code[j] == '+' || code[j] == '-'))
+                        ++j;
+                    while (j < code.size() && isdigit(code[j]))
+                        ++j;
+                }
+                tokens.push_back({Token::Number, code.substr(i, j - i)});
+                i = j;
+            }
+            else if (c == '`')
+            {
+                size_t j = code.find('`', i + 1);
+                if (j == std::string::npos)
+                    throw std::invalid_argument("unterminated `");
+                tokens.push_back({Token::Text, code.substr(i + 1, j - i - 1)});
+                i = j + 1;
+            }
+            else
+            {
+                size_t length = 0;
+                for (auto& symbol : symbols)
+                {
+                    if (code.compare(i, symbol.size(), symbol) == 0)
+                    {
+                        tokens.push_back({Token::Symbol, symbol});
+                        length = symbol.size();
+                        break;
+                    }
+                }
+                if (length == 0)
+                    throw std::invalid_argument("unexpected character '" + std::string(1, c) +
+                                                "'");
+                i += length;
+            }
+        }
+        tokens.push_back({Token::End, ""});
+        return tokens;
+    }
+
+    struct ParsedStatement
+    {
+        std::string tensor;
+        std::vector<std::string> axes;
+        std::string op;
+        ExprPtr value;
+        std::unordered_map<std::string, int64_t> extents;
+    };
+
+    // Recursive descent over the einstein_v2 expression, with the operator precedence of Python.
+    class Parser
+    {
+    public:
+        Parser(const std::string& code)
+            : m_tokens(tokenize(code))
+        {
+        }
+
+        std::vector<ParsedStatement> parse()
+        {
+            std::vector<ParsedStatement> statements;
+            while (!at_end())
+            {
+                if (accept(";"))
+                    continue;
+                statements.push_back(parse_statement());
+                if (!at_end())
+                    expect(";");
+            }
+            return statements;
+        }
+
+    private:
+        const Token& peek() const { return m_tokens[m_pos]; }
+        bool at_end() const { return peek().kind == Token::End; }
+        bool is(const std::string& text) const
+        {
+            return (peek().kind == Token::Symbol || peek().kind == Token::Ident) &&
+                   peek().text == text;
+        }
+
+        bool accept(const std::string& text)
+        {
+            if (!is(text))
+                return false;
+            ++m_pos;
+            return true;
+        }
+
+        void expect(const std::string& text)
+        {
+            if (!accept(text))
+                fail("expected '" + text + "'");
+        }
+
+        std::string expect(Token::Kind kind, const std::string& what)
+        {
+            if (peek().kind != kind)
+                fail("expected " + what);
+            return m_tokens[m_pos++].text;
+        }
+
+        void fail(const std::string& message) const
+        {
+            throw std::invalid_argument(message + " at '" + peek().text + "'");
+        }
+
+        ParsedStatement parse_statement()
+        {
+            ParsedStatement statement;
+            statement.tensor = expect(Token::Ident, "a tensor");
+            expect("[");
+            while (!accept("]"))
+            {
+                if (!statement.axes.empty())
+                    expect(",");
+                statement.axes.push_back(expect(Token::Ident, "an axis"));
+            }
+            static const std::unordered_map<std::string, std::string> ops = {
+                {"=", "="}, {"+=!", "+"}, {"*=!", "*"}, {">=!", ">"}, {"<=!", "<"}};
+            auto op = ops.find(peek().text);
+            if (peek().kind != Token::Symbol || op == ops.end())
+                fail("unsupported assignment");
+            ++m_pos;
+            statement.op = op->second;
+            statement.value = parse_expr();
+            if (accept("where"))
+            {
+                do
+                {
+                    auto axis = expect(Token::Ident, "an axis");
+                    expect("in");
+                    statement.extents[axis] = std::stoll(expect(Token::Number, "an extent"));
+                } while (accept(","));
+            }
+            return statement;
+        }
+
+        ExprPtr parse_expr()
+        {
+            auto lhs = parse_or();
+            for (auto op : {"==", "!=", "<=", ">=", "<", ">"})
+            {
+                if (accept(op))
+                    return make_expr(Expr::Binary, op, {lhs, parse_or()});
+            }
+            return lhs;
+        }
+
+        ExprPtr parse_or()
+        {
+            auto lhs = parse_and();
+            while (accept("|"))
+                lhs = make_expr(Expr::Binary, "|", {lhs, parse_and()});
+            return lhs;
+        }
+
+        ExprPtr parse_and()
+        {
+            auto lhs = parse_additive();
+            while (accept("&"))
+                lhs = make_expr(Expr::Binary, "&", {lhs, parse_additive()});
+            return lhs;
+        }
+
+        ExprPtr parse_additive()
+        {
+            auto lhs = parse_multiplicative();
+            while (is("+") || is("-"))
+            {
+                auto op = m_tokens[m_pos++].text;
+                lhs = make_expr(Expr::Binary, op, {lhs, parse_multiplicative()});
+            }
+            return lhs;
+        }
+
+        ExprPtr parse_multiplicative()
+        {
+            auto lhs = parse_unary();
+            while (is("*") || is("/") || is("//") || is("%"))
+            {
+                auto op = m_tokens[m_pos++].text;
+                lhs = make_expr(Expr::Binary, op, {lhs, parse_unary()});
+            }
+            return lhs;
+        }
+
+        ExprPtr parse_unary()
+        {
+            if (accept("+"))
+                return parse_unary();
+            if (is("-") || is("~") || is("!"))
+            {
+                auto op = m_tokens[m_pos++].text;
+                return make_expr(Expr::Unary, op, {parse_unary()});
+            }
+            return parse_postfix();
+        }
+
+        std::vector<ExprPtr> parse_list()
+        {
+            std::vector<ExprPtr> items;
+            expect("[");
+            while (!accept("]"))
+            {
+                if (!items.empty())
+                    expect(",");
+                items.push_back(parse_expr());
+            }
+            return items;
+        }
+
+        ExprPtr parse_postfix()
+        {
+            auto expr = parse_primary();
+            while (accept("."))
+            {
+                auto method = expect(Token::Ident, "a method");
+                expect("(");
+                if (method == "when")
+                {
+                    auto conds = is("[") ? parse_list() : std::vector<ExprPtr>{parse_expr()};
+                    expect(",");
+                    std::vector<ExprPtr> args = {expr, parse_expr()};
+                    args.insert(args.end(), conds.begin(), conds.end());
+                    expr = make_expr(Expr::When, "", args);
+                }
+                else if (method == "cast")
+                {
+                    if (peek().kind == Token::Text)
+                        expr = make_expr(Expr::Cast, m_tokens[m_pos++].text, {expr});
+                    else
+                        expr = make_expr(Expr::Cast, "", {expr, parse_expr()});
+                }
+                else if (method == "call")
+                {
+                    auto func = expect(Token::Text, "a function");
+                    std::vector<ExprPtr> args = {expr};
+                    if (accept(","))
+                    {
+                        auto extra = parse_list();
+                        args.insert(args.end(), extra.begin(), extra.end());
+                    }
+                    expr = make_expr(Expr::Call, func, args);
+                }
+                else if (method == "dtype")
+                {
+                    expr = make_expr(Expr::TypeOf, "", {expr});
+                }
+                else
+                {
+                    fail("unsupported method " + method);
+                }
+                expect(")");
+            }
+            return expr;
+        }
+
+        ExprPtr parse_primary()
+        {
+            if (peek().kind == Token::Number)
+                return make_expr(Expr::Number, m_tokens[m_pos++].text);
+            if (accept("("))
+            {
+                auto expr = parse_expr();
+                expect(")");
+                return expr;
+            }
+            auto name = expect(Token::Ident, "an expression");
+            if (name == "const" && accept("("))
+            {
+                auto expr = parse_expr();
+                expect(")");
+                return expr;
+            }
+            if (!is("["))
+                return make_expr(Expr::Axis, name);
+            return make_expr(Expr::Access, name, parse_list());
+        }
+
+        std::vector<Token> m_tokens;
+        size_t m_pos = 0;
+    };
+
+    bool is_float(const std::string& dtype) { return dtype.compare(0, 5, "float") == 0; }
+    bool is_bool(const std::string& dtype) { return dtype == "bool" || dtype == "int8"; }
+    int type_rank(const std::string& dtype)
+    {
+        static const std::vector<std::string> order = {
+            "bool", "int8", "int16", "int32", "int64", "float16", "float32", "float64"};
+        return std::find(order.begin(), order.end(), dtype) - order.begin();
+    }
+
+    // The dtype of arithmetic on a and b, at least int32 as in C++.
+    std::string promote(const std::string& a, const std::string& b)
+    {
+        auto dtype = type_rank(a) >= type_rank(b) ? a : b;
+        return type_rank(dtype) < type_rank("int32") ? "int32" : dtype;
+    }
+
+    std::string c_type(const std::string& dtype)
+    {
+        static const std::unordered_map<std::string, std::string> types = {{"bool", "bool"},
+                                                                           {"int8", "char"},
+                                                                           {"int16", "int16_t"},
+                                                                           {"int32", "int32_t"},
+                                                                           {"int64", "int64_t"},
+                                                                           {"float32", "float"},
+                                                                           {"float64", "double"}};
+        auto it = types.find(dtype);
+        if (it == types.end())
+            throw std::invalid_argument("unsupported dtype " + dtype);
+        return it->second;
+    }
+
+    // C type of the memory of a tensor
+    std::string storage_type(const std::string& dtype)
+    {
+        return dtype == "bool" ? "char" : c_type(dtype);
+    }
+
+    std::string cast_dtype(std::string dtype)
+    {
+        static const std::unordered_map<std::string, std::string> aliases = {
+            {"float", "float32"}, {"double", "float64"}, {"int", "int32"}, {"half", "float16"}};
+        auto it = aliases.find(dtype);
+        if (it != aliases.end())
+            dtype = it->second;
+        c_type(dtype);
+        return dtype;
+    }
+
+    const std::unordered_set<std::string>& unary_functions()
+    {
+        static const std::unordered_set<std::string> functions = {
+            "exp", "log", "sqrt", "ceil", "floor", "abs",  "sin",  "cos", "tan",   "sinh",
+            "cosh", "tanh", "asin", "acos", "atan", "erf", "round", "log1p", "expm1"};
+        return functions;
+    }
+
+    bool is_simple(const std::string& code)
+    {
+        return std::all_of(
+            code.begin(), code.end(), [](char c) { return isalnum(c) || c == '_' || c == '.'; });
+    }
+
+    std::string wrap(const std::string& code) { return is_simple(code) ? code : "(" + code + ")"; }
+} // namespace
+
+std::string cpu::get_antares_dtype(const element::Type& type)
+{
+    if (type == element::f32)
+        return "float32";
+    if (type == element::f64)
+        return "float64";
+    if (type == element::i32)
+        return "int32";
+    if (type == element::i64)
+        return "int64";
+    if (type == element::boolean)
+        return "int8";
+    return "";
+}
+
+bool cpu::AntaresCpuSchedule::is_default() const
+{
+    return to_string() == AntaresCpuSchedule().to_string();
+}
+
+std::string cpu::AntaresCpuSchedule::to_string() const
+{
+    std::stringstream ss;
+    ss << "t" << tile << "_o" << (reduce_outside < 0 ? "a" : std::to_string(reduce_outside))
+       << "_v" << vector_width << "_s" << shards_per_thread;
+    return ss.str();
+}
+
+nlohmann::json cpu::AntaresCpuSchedule::to_json() const
+{
+    nlohmann::json json;
+    json["tile"] = tile;
+    json["reduce_outside"] = reduce_outside;
+    json["vector_width"] = vector_width;
+    json["shards_per_thread"] = shards_per_thread;
+    return json;
+}
+
+cpu::AntaresCpuSchedule cpu::AntaresCpuSchedule::from_json(const nlohmann::json& json)
+{
+    AntaresCpuSchedule schedule;
+    schedule.tile = json.value("tile", schedule.tile);
+    schedule.reduce_outside = json.value("reduce_outside", schedule.reduce_outside);
+    schedule.vector_width = json.value("vector_width", schedule.vector_width);
+    schedule.shards_per_thread = json.value("shards_per_thread", schedule.shards_per_thread);
+    return schedule;
+}
+
+cpu::AntaresLowering::AntaresLowering(const std::string& ir,
+                                      const std::vector<AntaresTensor>& outputs)
+{
+    const std::string begin = "einstein_v2(\"";
+    const std::string end = "\", input_dict=";
+    auto begin_pos = ir.find(begin);
+    auto end_pos = ir.find(end);
+    if (begin_pos == std::string::npos || end_pos == std::string::npos || end_pos < begin_pos)
+    {
+        m_error = "not an einstein_v2 IR";
+        return;
+    }
+    try
+    {
+        parse_input_dict(ir.substr(end_pos));
+        for (size_t i = 0; i < outputs.size(); ++i)
+        {
+            auto name = "output" + std::to_string(i);
+            m_tensors[name] = Tensor{outputs[i].dtype, outputs[i].shape, name, -1};
+        }
+        begin_pos += begin.size();
+        parse(ir.substr(begin_pos, end_pos - begin_pos));
+        for (size_t i = 0; i < outputs.size(); ++i)
+        {
+            if (m_tensors["output" + std::to_string(i)].statement < 0)
+                throw std::invalid_argument("output" + std::to_string(i) + " is not written");
+        }
+    }
+    catch (const std::exception& e)
+    {
+        m_error = e.what();
+        m_statements.clear();
+    }
+}
+
+void cpu::AntaresLowering::parse_input_dict(const std::string& ir)
+{
+    // "input0" : { "dtype" : "float32", "shape" : [2, 3]}, or ("input0", {...}) past 10 inputs
+    std::regex input(
+        "\"(\\w+)\"\\s*[:,]\\s*\\{\\s*\"dtype\"\\s*:\\s*\"(\\w+)\"\\s*,\\s*\"shape\"\\s*:\\s*\\["
+        "([^\\]]*)\\]");
+    for (std::sregex_iterator it(ir.begin(), ir.end(), input), end; it != end; ++it)
+    {
+        auto name = (*it)[1].str();
+        Tensor tensor{(*it)[2].str(), Shape(), name, -1};
+        c_type(tensor.dtype);
+        std::stringstream dims((*it)[3].str());
+        std::string dim;
+        while (std::getline(dims, dim, ','))
+        {
+            if (dim.find_first_not_of(" ") != std::string::npos)
+                tensor.shape.push_back(std::stoull(dim));
+        }
+        m_tensors[name] = tensor;
+    }
+}
+
+void cpu::AntaresLowering::parse(const std::string& expr)
+{
+    for (auto& parsed : Parser(expr).parse())
+    {
+        Statement statement;
+        statement.tensor = parsed.tensor;
+        statement.axes = parsed.axes;
+        statement.op = parsed.op;
+        statement.value = parsed.value;
+        statement.extents = parsed.extents;
+        analyze(statement);
+        m_statements.push_back(statement);
+    }
+    if (m_statements.empty())
+        throw std::invalid_argument("no statement");
+}
+
+void cpu::AntaresLowering::analyze(Statement& statement)
+{
+    auto target = m_tensors.find(statement.tensor);
+    bool is_output = target != m_tensors.end() && target->second.storage == statement.tensor &&
+                     statement.tensor.compare(0, 6, "output") == 0;
+    if (target != m_tensors.end() && !is_output)
+        throw std::invalid_argument(statement.tensor + " is written twice or is an input");
+    if (is_output && target->second.statement >= 0)
+        throw std::invalid_argument(statement.tensor + " is written twice");
+
+    // An axis which indexes dims of different sizes has no extent, unless the where clause
+    // bounds it within all of them.
+    auto explicit_extents = statement.extents;
+    auto set_extent = [&](const std::string& axis, int64_t extent) {
+        auto bound = explicit_extents.find(axis);
+        if (bound != explicit_extents.end())
+        {
+            if (bound->second > extent)
+                throw std::invalid_argument("axis " + axis + " in " +
+                                            std::to_string(bound->second) +
+                                            " exceeds a dim of size " + std::to_string(extent));
+            return;
+        }
+        auto it = statement.extents.find(axis);
+        if (it == statement.extents.end())
+            statement.extents[axis] = extent;
+        else if (it->second != extent)
+            throw std::invalid_argument("axis " + axis + " indexes dims of sizes " +
+                                        std::to_string(it->second) + " and " +
+                                        std::to_string(extent));
+    };
+
+    // the extents of axes which index a dim, in the order of the reads
+    std::vector<std::string> value_axes;
+    walk(statement.value, [&](const ExprPtr& expr) {
+        if (expr->kind == Expr::Axis)
+        {
+            if (m_tensors.count(expr->text))
+                expr->kind = Expr::TensorRef;
+            else if (std::find(value_axes.begin(), value_axes.end(), expr->text) ==
+                     value_axes.end())
+                value_axes.push_back(expr->text);
+        }
+        if (expr->kind != Expr::Access)
+            return;
+        auto it = m_tensors.find(expr->text);
+        if (it == m_tensors.end() || (it->second.statement < 0 && it->second.storage.compare(
+                                                                      0, 6, "output") == 0))
+            throw std::invalid_argument("unknown tensor " + expr->text);
+        auto& shape = it->second.shape;
+        if (expr->args.empty() && shape_size(shape) == 1)
+            return;
+        if (expr->args.size() != shape.size())
+            throw std::invalid_argument(expr->text + " is read with " +
+                                        std::to_string(expr->args.size()) + " indices");
+        for (size_t d = 0; d < shape.size(); ++d)
+        {
+            if (expr->args[d]->kind == Expr::Axis)
+                set_extent(expr->args[d]->text, shape[d]);
+        }
+    });
+    if (is_output && target->second.shape.size() == statement.axes.size())
+    {
+        for (size_t d = 0; d < statement.axes.size(); ++d)
+            set_extent(statement.axes[d], target->second.shape[d]);
+    }
+
+    Shape shape;
+    for (auto& axis : statement.axes)
+    {
+        if (std::count(statement.axes.begin(), statement.axes.end(), axis) > 1)
+            throw std::invalid_argument("axis " + axis + " is repeated on the left side");
+        if (!statement.extents.count(axis))
+            throw std::invalid_argument("cannot infer the extent of axis " + axis);
+        shape.push_back(statement.extents[axis]);
+    }
+    for (auto& axis : value_axes)
+    {
+        if (!statement.extents.count(axis))
+            throw std::invalid_argument("cannot infer the extent of axis " + axis);
+        if (std::find(statement.axes.begin(), statement.axes.end(), axis) == statement.axes.end())
+            statement.reduce_axes.push_back(axis);
+    }
+    if (statement.op == "=" && !statement.reduce_axes.empty())
+        throw std::invalid_argument("axis " + statement.reduce_axes[0] +
+                                    " of an injective statement is not on its left side");
+
+    auto dtype = infer_type(statement.value);
+    if (is_output)
+    {
+        // e.g. [N] where N in 1 for a scalar
+        auto squeeze = [](const Shape& s) {
+            Shape squeezed;
+            for (auto dim : s)
+            {
+                if (dim != 1)
+                    squeezed.push_back(dim);
+            }
+            return squeezed;
+        };
+        if (squeeze(shape) != squeeze(target->second.shape))
+            throw std::invalid_argument(statement.tensor + " is written with shape " +
+                                        join(shape) + " instead of " +
+                                        join(target->second.shape));
+        target->second.shape = shape;
+        target->second.statement = m_statements.size();
+    }
+    else
+    {
+        storage_type(dtype);
+        auto storage = statement.op == "=" ? "" : "t_" + statement.tensor;
+        m_tensors[statement.tensor] = Tensor{dtype, shape, storage, int(m_statements.size())};
+    }
+
+    if (!statement.reduce_axes.empty() && !statement.axes.empty())
+    {
+        // Weigh the reads whose fastest dim follows the last axis of the target against the
+        // ones where it follows a reduced axis, by the size of the tensors read.
+        auto& last = statement.axes.back();
+        size_t vector_reads = 0, reduce_reads = 0;
+        walk(statement.value, [&](const ExprPtr& expr) {
+            if (expr->kind != Expr::Access || expr->args.empty())
+                return;
+            bool follows_last = false, follows_reduce = false;
+            walk(expr->args.back(), [&](const ExprPtr& index) {
+                if (index->kind != Expr::Axis)
+                    return;
+                follows_last |= index->text == last;
+                follows_reduce |= std::count(statement.reduce_axes.begin(),
+                                             statement.reduce_axes.end(),
+                                             index->text) > 0;
+            });
+            auto size = shape_size(m_tensors.at(expr->text).shape);
+            if (follows_last)
+                vector_reads += size;
+            else if (follows_reduce)
+                reduce_reads += size;
+        });
+        statement.vector_reduce = vector_reads > reduce_reads;
+    }
+}
+
+const std::string& cpu::AntaresLowering::infer_type(const ExprPtr& expr) const
+{
+    if (!expr->dtype.empty())
+        return expr->dtype;
+    auto& dtype = expr->dtype;
+    switch (expr->kind)
+    {
+    case Expr::Number:
+        if (expr->text.find_first_of(".eE") != std::string::npos)
+            dtype = "float32";
+        else
+            dtype = std::stoll(expr->text) > std::numeric_limits<int32_t>::max() ? "int64"
+                                                                                 : "int32";
+        break;
+    case Expr::Axis: dtype = "int32"; break;
+    case Expr::TensorRef:
+    case Expr::Access: dtype = m_tensors.at(expr->text).dtype; break;
+    case Expr::Unary:
+    {
+        auto& operand = infer_type(expr->args[0]);
+        dtype = expr->text != "-" && is_bool(operand) ? "bool" : operand;
+        break;
+    }
+    case Expr::Binary:
+    {
+        auto& a = infer_type(expr->args[0]);
+        auto& b = infer_type(expr->args[1]);
+        if (expr->text == "&" || expr->text == "|")
+            dtype = is_bool(a) && is_bool(b) ? "bool" : promote(a, b);
+        else if (expr->text.find_first_of("=<>") != std::string::npos)
+            dtype = "bool";
+        else
+            dtype = promote(a, b);
+        break;
+    }
+    case Expr::When:
+        for (size_t i = 1; i < expr->args.size(); ++i)
+            infer_type(expr->args[i]);
+        dtype = infer_type(expr->args[0]);
+        break;
+    case Expr::Cast:
+        infer_type(expr->args[0]);
+        dtype = expr->text.empty() ? infer_type(expr->args[1]) : cast_dtype(expr->text);
+        break;
+    case Expr::TypeOf: dtype = infer_type(expr->args[0]); break;
+    case Expr::Call:
+    {
+        dtype = infer_type(expr->args[0]);
+        for (size_t i = 1; i < expr->args.size(); ++i)
+            dtype = promote(dtype, infer_type(expr->args[i]));
+        if (expr->text == "max" || expr->text == "min" || expr->text == "pow")
+        {
+            if (expr->args.size() != 2)
+                throw std::invalid_argument(expr->text + " takes two arguments");
+        }
+        else if (!unary_functions().count(expr->text) && expr->text != "rsqrt" &&
+                 expr->text != "normcdf" && expr->text != "remainder")
+        {
+            throw std::invalid_argument("unsupported function " + expr->text);
+        }
+        else if (expr->args.size() != 1)
+        {
+            throw std::invalid_argument(expr->text + " takes one argument");
+        }
+        else if (!is_float(dtype))
+        {
+            dtype = "float32";
+        }
+        break;
+    }
+    }
+    c_type(dtype);
+    return dtype;
+}
+
+std::string
+    cpu::AntaresLowering::emit_expr(const ExprPtr& expr,
+                                    const std::unordered_map<std::string, std::string>& axes) const
+{
+    std::vector<std::string> args;
+    if (expr->kind != Expr::Access)
+    {
+        for (auto& arg : expr->args)
+            args.push_back(arg->kind == Expr::TypeOf ? "" : emit_expr(arg, axes));
+    }
+    auto& dtype = infer_type(expr);
+    auto type = c_type(dtype);
+
+    switch (expr->kind)
+    {
+    case Expr::Number:
+        if (dtype == "float32")
+            return expr->text + "f";
+        return dtype == "int64" ? expr->text + "LL" : expr->text;
+    case Expr::Axis: return axes.at(expr->text);
+    case Expr::TensorRef:
+        throw std::invalid_argument(expr->text + " is read without indices");
+    case Expr::TypeOf: throw std::invalid_argument("dtype() outside of cast");
+    case Expr::Access:
+    {
+        auto& tensor = m_tensors.at(expr->text);
+        std::vector<std::string> indices;
+        for (auto& arg : expr->args)
+            indices.push_back(emit_expr(arg, axes));
+        if (!tensor.storage.empty())
+            return tensor.storage + "[" + emit_offset(tensor, indices) + "]";
+        // an inlined mediate, with its axes bound to the indices
+        auto& statement = m_statements[tensor.statement];
+        std::unordered_map<std::string, std::string> bound;
+        for (size_t d = 0; d < statement.axes.size(); ++d)
+            bound[statement.axes[d]] = indices.empty() ? "0" : wrap(indices[d]);
+        return emit_expr(statement.value, bound);
+    }
+    case Expr::Unary:
+        if (expr->text == "-")
+            return "(-" + args[0] + ")";
+        return (dtype == "bool" ? "(!" : "(~") + args[0] + ")";
+    case Expr::Binary:
+    {
+        auto& op = expr->text;
+        if (op == "//" || op == "%")
+        {
+            m_uses_floor_div = true;
+            auto helper = op == "//" ? "nnfusion_floor_div" : "nnfusion_floor_mod";
+            return std::string(helper) + "<" + (is_float(dtype) ? type : "int64_t") + ">(" +
+                   args[0] + ", " + args[1] + ")";
+        }
+        if ((op == "&" || op == "|") && dtype == "bool")
+            return "(" + args[0] + (op == "&" ? " && " : " || ") + args[1] + ")";
+        return "(" + args[0] + " " + op + " " + args[1] + ")";
+    }
+    case Expr::When:
+    {
+        std::vector<std::string> conds(args.begin() + 2, args.end());
+        auto otherwise = args[1];
+        if (infer_type(expr->args[1]) != dtype)
+            otherwise = "static_cast<" + type + ">(" + otherwise + ")";
+        return "(" + join(conds, " && ") + " ? " + args[0] + " : " + otherwise + ")";
+    }
+    case Expr::Cast: return "static_cast<" + type + ">(" + args[0] + ")";
+    case Expr::Call:
+    {
+        auto& func = expr->text;
+        if (func == "max" || func == "min")
+            return "std::" + func + "<" + type + ">(" + args[0] + ", " + args[1] + ")";
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            if (infer_type(expr->args[i]) != dtype)
+                args[i] = "static_cast<" + type + ">(" + args[i] + ")";
+        }
+        if (func == "pow")
+            return "std::pow(" + args[0] + ", " + args[1] + ")";
+        if (unary_functions().count(func))
+            return "std::" + func + "(" + args[0] + ")";
+        if (func == "rsqrt")
+            return "(static_cast<" + type + ">(1) / std::sqrt(" + args[0] + "))";
+        if (func == "normcdf")
+            return "(static_cast<" + type + ">(0.5) * std::erfc(-" + wrap(args[0]) +
+                   " * static_cast<" + type + ">(0.70710678118654752440)))";
+        if (func == "remainder")
+            return "(" + args[0] + " - std::floor(" + args[0] + "))";
+        throw std::invalid_argument("unsupported function " + func);
+    }
+    }
+    return "";
+}
+
+std::string cpu::AntaresLowering::emit_offset(const Tensor& tensor,
+                                              const std::vector<std::string>& indices) const
+{
+    std::vector<std::string> terms;
+    size_t stride = 1;
+    for (size_t d = indices.size(); d-- > 0;)
+    {
+        if (indices[d] != "0")
+            terms.insert(terms.begin(),
+                         stride == 1 ? indices[d]
+                                     : wrap(indices[d]) + " * " + std::to_string(stride));
+        stride *= tensor.shape[d];
+    }
+    return terms.empty() ? "0" : join(terms, " + ");
+}
+
+void cpu::AntaresLowering::emit_statement(const Statement& statement,
+                                          const AntaresCpuSchedule& schedule,
+                                          LanguageUnit& lu) const
+{
+    auto& tensor = m_tensors.at(statement.tensor);
+    auto type = storage_type(tensor.dtype);
+    std::unordered_map<std::string, std::string> axes;
+    for (auto& axis : statement.axes)
+        axes[axis] = "ax_" + axis;
+    for (auto& axis : statement.reduce_axes)
+        axes[axis] = "ax_" + axis;
+
+    auto value = emit_expr(statement.value, axes);
+    if (infer_type(statement.value) != tensor.dtype)
+        value = "static_cast<" + type + ">(" + value + ")";
+    std::string init;
+    std::function<std::string(const std::string&)> reduce;
+    if (statement.op == "+" || statement.op == "*")
+    {
+        init = statement.op == "+" ? "0" : "1";
+        reduce = [&](const std::string& acc) { return acc + " " + statement.op + " " + value; };
+    }
+    else if (statement.op != "=")
+    {
+        auto func = statement.op == ">" ? "max" : "min";
+        init = std::string("std::numeric_limits<") + type + ">::" +
+               (statement.op == ">" ? "lowest()" : "max()");
+        reduce = [&, func](const std::string& acc) {
+            return std::string("std::") + func + "<" + type + ">(" + acc + ", " + value + ")";
+        };
+    }
+    int64_t reduce_size = 1;
+    for (auto& axis : statement.reduce_axes)
+        reduce_size *= statement.extents.at(axis);
+
+    // split the row index r over the axes
+    auto emit_axes = [&](LanguageUnit& body, const std::string& row, size_t count) {
+        int64_t stride = 1;
+        for (size_t d = count; d-- > 0;)
+        {
+            auto& axis = statement.axes[d];
+            body << "const int64_t ax_" << axis << " = " << row;
+            if (stride > 1)
+                body << " / " << stride;
+            if (d > 0)
+                body << " % " << statement.extents.at(axis);
+            body << ";\n";
+            stride *= statement.extents.at(axis);
+        }
+    };
+    auto emit_reduce_loops = [&](LanguageUnit& body) {
+        for (auto& axis : statement.reduce_axes)
+        {
+            body << "for (int64_t ax_" << axis << " = 0; ax_" << axis << " < "
+                 << statement.extents.at(axis) << "; ++ax_" << axis << ")\n";
+            body.block_begin();
+        }
+    };
+
+    LanguageUnit body("row");
+    int64_t rows = 1, cost = reduce_size;
+    bool vector = statement.reduce_axes.empty() ? !statement.axes.empty() : statement.vector_reduce;
+    if (!statement.reduce_axes.empty() && !statement.axes.empty() && schedule.reduce_outside >= 0)
+        vector = schedule.reduce_outside == 1;
+    if (vector)
+    {
+        auto& last = statement.axes.back();
+        int64_t cols = statement.extents.at(last);
+        for (size_t d = 0; d + 1 < statement.axes.size(); ++d)
+            rows *= statement.extents.at(statement.axes[d]);
+        // too few rows for the thread pool: split the last axis
+        int64_t chunks = rows >= 64 ? 1 : (cols + kMaxChunk - 1) / kMaxChunk;
+        if (schedule.tile > 0)
+            chunks = (cols + schedule.tile - 1) / schedule.tile;
+        int64_t chunk = (cols + chunks - 1) / chunks;
+        rows *= chunks;
+        cost *= chunk;
+
+        if (chunks > 1)
+        {
+            body << "const int64_t row = r / " << chunks << ";\n";
+            body << "const int64_t v_begin = r % " << chunks << " * " << chunk << ";\n";
+            body << "const int64_t v_end = std::min(v_begin + " << chunk
+                 << ", static_cast<int64_t>(" << cols << "));\n";
+        }
+        else
+        {
+            body << "const int64_t row = r;\n";
+            body << "const int64_t v_begin = 0, v_end = " << cols << ";\n";
+        }
+        emit_axes(body, "row", statement.axes.size() - 1);
+        body << type << "* out = " << tensor.storage << " + row * " << cols << ";\n";
+        auto loop = "for (int64_t ax_" + last + " = v_begin; ax_" + last + " < v_end; ++ax_" +
+                    last + ")\n";
+        // the loop computing the row, in steps of vector_width elements and a tail
+        auto emit_row_loop = [&](const std::string& code) {
+            auto width = schedule.vector_width;
+            if (width <= 1 || width > chunk)
+            {
+                body << loop;
+                body.block_begin();
+                body << code;
+                body.block_end();
+                return;
+            }
+            auto step = "ax_" + last + "_step";
+            body.block_begin();
+            body << "int64_t " << step << " = v_begin;\n";
+            body << "for (; " << step << " + " << width << " <= v_end; " << step
+                 << " += " << width << ")\n";
+            body.block_begin();
+            body << "for (int64_t ax_" << last << " = " << step << "; ax_" << last << " < "
+                 << step << " + " << width << "; ++ax_" << last << ")\n";
+            body.block_begin();
+            body << code;
+            body.block_end();
+            body.block_end();
+            body << "for (int64_t ax_" << last << " = " << step << "; ax_" << last
+                 << " < v_end; ++ax_" << last << ")\n";
+            body.block_begin();
+            body << code;
+            body.block_end();
+            body.block_end();
+        };
+        if (statement.op == "=")
+        {
+            emit_row_loop("out[ax_" + last + "] = " + value + ";\n");
+        }
+        else
+        {
+            body << loop;
+            body.block_begin();
+            body << "out[ax_" << last << "] = " << init << ";\n";
+            body.block_end();
+            emit_reduce_loops(body);
+            emit_row_loop("out[ax_" + last + "] = " + reduce("out[ax_" + last + "]") + ";\n");
+            for (size_t i = 0; i < statement.reduce_axes.size(); ++i)
+                body.block_end();
+        }
+    }
+    else
+    {
+        for (auto& axis : statement.axes)
+            rows *= statement.extents.at(axis);
+        emit_axes(body, "r", statement.axes.size());
+        if (statement.op == "=")
+        {
+            body << tensor.storage << "[r] = " << value << ";\n";
+        }
+        else
+        {
+            body << type << " acc = " << init << ";\n";
+            emit_reduce_loops(body);
+            body << "acc = " << reduce("acc") << ";\n";
+            for (size_t i = 0; i < statement.reduce_axes.size(); ++i)
+                body.block_end();
+            body << tensor.storage << "[r] = acc;\n";
+        }
+    }
+
+    lu.block_begin();
+    emit_row_parallel_for(lu, rows, cost, body.get_code(), schedule.shards_per_thread);
+    lu.block_end();
+}
+
+int64_t cpu::AntaresLowering::get_max_row_length() const
+{
+    int64_t length = 1;
+    for (auto& statement : m_statements)
+    {
+        if (!m_tensors.at(statement.tensor).storage.empty() && !statement.axes.empty())
+            length = std::max(length, statement.extents.at(statement.axes.back()));
+    }
+    return length;
+}
+
+bool cpu::AntaresLowering::has_reduction_order() const
+{
+    for (auto& statement : m_statements)
+    {
+        if (!m_tensors.at(statement.tensor).storage.empty() && !statement.axes.empty() &&
+            !statement.reduce_axes.empty())
+            return true;
+    }
+    return false;
+}
+
+void cpu::AntaresLowering::emit(LanguageUnit& lu, const AntaresCpuSchedule& schedule) const
+{
+    NNFUSION_CHECK(is_valid()) << m_error;
+    m_uses_floor_div = false;
+    for (auto& statement : m_statements)
+    {
+        auto& tensor = m_tensors.at(statement.tensor);
+        if (!tensor.storage.empty() && tensor.storage != statement.tensor)
+        {
+            auto type = storage_type(tensor.dtype);
+            lu << "std::vector<" << type << "> " << tensor.storage << "_buffer("
+               << shape_size(tensor.shape) << ");\n";
+            lu << type << "* " << tensor.storage << " = " << tensor.storage << "_buffer.data();\n";
+        }
+    }
+    for (auto& statement : m_statements)
+    {
+        if (!m_tensors.at(statement.tensor).storage.empty())
+            emit_statement(statement, schedule, lu);
+    }
+
+    lu.require(header::algorithm);
+    lu.require(header::cmath);
+    lu.require(header::limits);
+    lu.require(header::vector);
+    if (m_uses_floor_div)
+        lu.require(declaration::antares_floor_div);
+}
@@ -0,0 +1,134 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "nnfusion/common/common.hpp"
+#include "nnfusion/common/languageunit.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        namespace cpu
+        {
+            // A tensor of an Antares IR, dtype is the name Antares gives it, e.g. float32.
+            struct AntaresTensor
+            {
+                std::string dtype;
+                nnfusion::Shape shape;
+            };
+
+            // Antares dtype of an element type, empty if the IR has none for it.
+            std::string get_antares_dtype(const nnfusion::element::Type& type);
+
+            // Schedule of the loops of AntaresLowering, which the local CPU tuning of
+            // KernelTuning searches over; the defaults are those of an untuned kernel.
+            struct AntaresCpuSchedule
+            {
+                AntaresCpuSchedule()
+                    : tile(0)
+                    , reduce_outside(-1)
+                    , vector_width(1)
+                    , shards_per_thread(0)
+                {
+                }
+
+                // elements of the last axis per task, 0 to split the last axis only when
+                // there are too few rows for the thread pool
+                int64_t tile;
+                // 1 runs reductions outside of the loop over the last axis, 0 with a scalar
+                // accumulator per element, -1 picks by the reads of each statement
+                int reduce_outside;
+                // elements per step of the loop over the last axis, whose body is then a loop
+                // of this fixed count for the vectorizer
+                int64_t vector_width;
+                // tasks per thread of ParallelFor, 0 for the cost-based count
+                int64_t shards_per_thread;
+
+                bool is_default() const;
+                // e.g. t256_o1_v8_s2, for kernel names and logs
+                std::string to_string() const;
+                nlohmann::json to_json() const;
+                static AntaresCpuSchedule from_json(const nlohmann::json& json);
+            };
+
+            /// \brief Lowers the einstein_v2 expression of an Antares IR, see
+            /// op::get_translation, to C++ loops over the thread pool of a CPU kernel, so that
+            /// ops without a CPU kernel of their own get compiled code without the Antares
+            /// codegen server.
+            ///
+            /// Every statement `lhs[axes] op value where axis in n` runs as a parallel loop over
+            /// the rows of lhs, i.e. all its axes but the last one. Injective statements (=)
+            /// which write mediates are inlined into their readers, reductions (+=!, *=!, >=!,
+            /// <=!) and the outputs are written to memory. A reduction runs over the reduced
+            /// axes inside the loop over the last axis of lhs when the last index of some read
+            /// follows that axis, so that the innermost loop stays contiguous for the
+            /// vectorizer, and with a scalar accumulator per element otherwise.
+            class AntaresLowering
+            {
+            public:
+                // outputs are the tensors of the kernel, whose shapes the IR leaves to inference
+                AntaresLowering(const std::string& ir, const std::vector<AntaresTensor>& outputs);
+
+                bool is_valid() const { return m_error.empty(); }
+                // what of the IR is not supported, empty if valid
+                const std::string& get_error() const { return m_error; }
+                size_t get_statement_count() const { return m_statements.size(); }
+                // the longest last axis of the statements written to memory
+                int64_t get_max_row_length() const;
+                // whether the reduce_outside of a schedule changes some statement
+                bool has_reduction_order() const;
+                // Emit the loops for a kernel with inputs input0... and outputs output0..., and a
+                // concurrency::ThreadPool* thread_pool.
+                void emit(LanguageUnit& lu,
+                          const AntaresCpuSchedule& schedule = AntaresCpuSchedule()) const;
+
+                struct Expr;
+                using ExprPtr = std::shared_ptr<Expr>;
+
+            private:
+                struct Tensor
+                {
+                    std::string dtype;
+                    nnfusion::Shape shape;
+                    // the name of its memory in the kernel, empty for inlined mediates
+                    std::string storage;
+                    // the statement writing it, -1 for inputs
+                    int statement;
+                };
+
+                struct Statement
+                {
+                    std::string tensor;
+                    std::vector<std::string> axes;
+                    // =, +, *, > or <
+                    std::string op;
+                    ExprPtr value;
+                    std::vector<std::string> reduce_axes;
+                    std::unordered_map<std::string, int64_t> extents;
+                    // whether the reduction runs inside the loop over the last axis
+                    bool vector_reduce = false;
+                };
+
+                void parse_input_dict(const std::string& ir);
+                void parse(const std::string& expr);
+                void analyze(Statement& statement);
+                const std::string& infer_type(const ExprPtr& expr) const;
+                std::string emit_expr(const ExprPtr& expr,
+                                      const std::unordered_map<std::string, std::string>& axes)
+                    const;
+                std::string emit_offset(const Tensor& tensor,
+                                        const std::vector<std::string>& indices) const;
+                void emit_statement(const Statement& statement,
+                                    const AntaresCpuSchedule& schedule,
+                                    LanguageUnit& lu) const;
+
+                std::string m_error;
+                std::vector<Statement> m_statements;
+                std::unordered_map<std::string, Tensor> m_tensors;
+                mutable bool m_uses_floor_div = false;
+            };
+        } // namespace cpu
+    }     // namespace kernels
+} // namespace nnfusion
@@ -4,6 +4,10 @@
 #include "cpu_helper.hpp"
 #include "nnfusion/core/operators/generic_op/generic_op.hpp"
 
+DEFINE_string(fcpu_simd_isa,
+              "auto",
+              "Vector ISA of the CPU SIMD kernels: avx2, avx512, or auto to follow the host.");
+
 using namespace nnfusion::kernels;
 
 LanguageUnit_p cpu::get_eigen_math_kernel(const std::string& name,
@@ -75,7 +79,8 @@ LanguageUnit_p cpu::get_eigen_math_kernel(const std::string& name,
 LanguageUnit_p cpu::get_simd_math_kernel(const std::string& name,
                                          const std::string& math_kernel,
                                          size_t data_size,
-                                         const std::vector<std::string>& data_types)
+                                         const std::vector<std::string>& data_types,
+                                         const std::string& vec_type)
 {
     NNFUSION_CHECK(std::count(name.begin(), name.end(), '-') == 0);
     std::string mangled_name = "declaration::function_def_inline_" + name;
@@ -90,12 +95,12 @@ LanguageUnit_p cpu::get_simd_math_kernel(const std::string& name,
     if (math_kernel.size())
     {
         auto num_inputs = data_types.size() - 1;
-        writer << "inline __m256 " << name << "(";
+        writer << "inline " << vec_type << " " << name << "(";
         for (size_t i = 0; i < num_inputs - 1; ++i)
         {
-            writer << "__m256 in" << i << ", ";
+            writer << vec_type << " in" << i << ", ";
         }
-        writer << "__m256 in" << num_inputs - 1;
+        writer << vec_type << " in" << num_inputs - 1;
         writer << ")\n";
         writer << "{\n";
         writer.indent++;
@@ -107,3 +112,326 @@ LanguageUnit_p cpu::get_simd_math_kernel(const std::string& name,
     }
     return cw;
 }
+
+const cpu::SimdIsa cpu::avx2_isa{"avx2", "__m256", "_mm256", 8};
+const cpu::SimdIsa cpu::avx512_isa{"avx512", "__m512", "_mm512", 16};
+
+const cpu::SimdIsa& cpu::get_simd_isa()
+{
+    if (FLAGS_fcpu_simd_isa == "avx512")
+        return avx512_isa;
+    if (FLAGS_fcpu_simd_isa == "auto")
+    {
+        // The generated runtime is built with -march=native on the codegen host.
+        static bool has_avx512 = __builtin_cpu_supports("avx512f");
+        return has_avx512 ? avx512_isa : avx2_isa;
+    }
+    NNFUSION_CHECK(FLAGS_fcpu_simd_isa == "avx2") << "Unknown -fcpu_simd_isa: "
+                                                  << FLAGS_fcpu_simd_isa;
+    return avx2_isa;
+}
+
+namespace
+{
+    void replace_all(std::string& str, const std::string& from, const std::string& to)
+    {
+        size_t pos = 0;
+        while ((pos = str.find(from, pos)) != std::string::npos)
+        {
+            str.replace(pos, from.size(), to);
+            pos += to.size();
+        }
+    }
+
+    // AVX2 intrinsics without an AVX512F counterpart of the same name.
+    const std::vector<std::pair<std::string, std::string>> avx512_renames = {
+        {"_mm256_cmp_ps", "nnfusion_mm512_cmp_ps"},
+        {"_mm256_and_ps", "nnfusion_mm512_and_ps"},
+        {"_mm256_or_ps", "nnfusion_mm512_or_ps"},
+        {"_mm256_xor_ps", "nnfusion_mm512_xor_ps"},
+        {"_mm256_ceil_ps", "nnfusion_mm512_ceil_ps"},
+        {"_mm256_floor_ps", "nnfusion_mm512_floor_ps"},
+        {"_mm256_rsqrt_ps", "_mm512_rsqrt14_ps"}};
+
+    std::string avx2_tail_mask(uint32_t tail)
+    {
+        std::vector<std::string> lanes;
+        for (uint32_t i = 0; i < 8; i++)
+            lanes.push_back(i < tail ? "-1" : "0");
+        return "_mm256_setr_epi32(" + join(lanes, ", ") + ")";
+    }
+
+    std::string avx512_tail_mask(uint32_t tail)
+    {
+        std::stringstream ss;
+        ss << "(__mmask16)0x" << std::hex << ((1u << tail) - 1);
+        return ss.str();
+    }
+
+    bool is_16bit_float(const std::string& type) { return type == "half" || type == "bfloat16"; }
+}
+
+std::string cpu::translate_simd_op(const std::string& op, bool is_math_kernel, const SimdIsa& isa)
+{
+    if (isa.name == avx2_isa.name)
+        return op;
+    // Functions generated from simd_math_kernel must not clash with real intrinsics.
+    if (is_math_kernel)
+        return "nnfusion" + translate_simd_math_kernel(op, isa);
+    return translate_simd_math_kernel(op, isa);
+}
+
+std::string cpu::translate_simd_math_kernel(const std::string& math_kernel, const SimdIsa& isa)
+{
+    if (isa.name == avx2_isa.name)
+        return math_kernel;
+    std::string translated = math_kernel;
+    for (auto& rename : avx512_renames)
+        replace_all(translated, rename.first, rename.second);
+    replace_all(translated, "_mm256_", "_mm512_");
+    replace_all(translated, "__m256", "__m512");
+    return translated;
+}
+
+LanguageUnit_p cpu::get_simd_helpers(const SimdIsa& isa)
+{
+    if (isa.name != avx512_isa.name)
+        return nullptr;
+    static LanguageUnit_p helpers(new LanguageUnit("declaration::simd_avx512_helpers", R"(
+#define nnfusion_mm512_cmp_ps(a, b, imm)                                                         \
+    _mm512_castsi512_ps(_mm512_maskz_mov_epi32(_mm512_cmp_ps_mask(a, b, imm), _mm512_set1_epi32(-1)))
+
+inline __m512 nnfusion_mm512_and_ps(__m512 a, __m512 b)
+{
+    return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_castps_si512(b)));
+}
+
+inline __m512 nnfusion_mm512_or_ps(__m512 a, __m512 b)
+{
+    return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(a), _mm512_castps_si512(b)));
+}
+
+inline __m512 nnfusion_mm512_xor_ps(__m512 a, __m512 b)
+{
+    return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_castps_si512(b)));
+}
+
+inline __m512 nnfusion_mm512_ceil_ps(__m512 a)
+{
+    return _mm512_roundscale_ps(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+}
+
+inline __m512 nnfusion_mm512_floor_ps(__m512 a)
+{
+    return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+)"));
+    return helpers;
+}
+
+std::string cpu::emit_simd_load(const SimdIsa& isa,
+                                const std::string& type,
+                                const std::string& ptr,
+                                const std::string& var,
+                                uint32_t tail)
+{
+    bool avx512 = isa.name == avx512_isa.name;
+    std::stringstream ss;
+    if (tail > 0 && (type == "float" || type == "int32_t"))
+    {
+        ss << isa.vec << " " << var << " = ";
+        if (type == "float")
+        {
+            if (avx512)
+                ss << "_mm512_maskz_loadu_ps(" << avx512_tail_mask(tail) << ", " << ptr << ");\n";
+            else
+                ss << "_mm256_maskload_ps(" << ptr << ", " << avx2_tail_mask(tail) << ");\n";
+        }
+        else
+        {
+            if (avx512)
+                ss << "_mm512_cvtepi32_ps(_mm512_maskz_loadu_epi32(" << avx512_tail_mask(tail)
+                   << ", " << ptr << "));\n";
+            else
+                ss << "_mm256_cvtepi32_ps(_mm256_maskload_epi32((const int*)(" << ptr << "), "
+                   << avx2_tail_mask(tail) << "));\n";
+        }
+        return ss.str();
+    }
+    if (tail > 0 && is_16bit_float(type))
+    {
+        // No masked 16-bit loads in AVX2 and AVX512F, go through a zero-padded copy.
+        ss << "uint16_t " << var << "_buf[" << isa.width << "] = {0};\n";
+        ss << "memcpy(" << var << "_buf, " << ptr << ", " << tail * 2 << ");\n";
+        return ss.str() + emit_simd_load(isa, type, var + "_buf", var);
+    }
+
+    if (type == "float")
+    {
+        ss << isa.vec << " " << var << " = " << isa.prefix << "_loadu_ps(" << ptr << ");\n";
+    }
+    else if (type == "int32_t")
+    {
+        if (avx512)
+            ss << "__m512 " << var << " = _mm512_cvtepi32_ps(_mm512_loadu_si512((const void*)("
+               << ptr << ")));\n";
+        else
+            ss << "__m256 " << var
+               << " = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(" << ptr << ")));\n";
+    }
+    else if (type == "half")
+    {
+        if (avx512)
+            ss << "__m512 " << var << " = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)("
+               << ptr << ")));\n";
+        else
+            ss << "__m256 " << var << " = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)("
+               << ptr << ")));\n";
+    }
+    else if (type == "bfloat16")
+    {
+        // bfloat16 is the upper half of a float
+        if (avx512)
+            ss << "__m512 " << var
+               << " = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32("
+               << "_mm256_loadu_si256((const __m256i*)(" << ptr << "))), 16));\n";
+        else
+            ss << "__m256 " << var
+               << " = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32("
+               << "_mm_loadu_si128((const __m128i*)(" << ptr << "))), 16));\n";
+    }
+    else
+    {
+        uint32_t count = tail > 0 ? tail : isa.width;
+        ss << "float " << var << "_buf[" << isa.width << "] = {0};\n";
+        ss << "for (int j = 0; j < " << count << "; ++j)\n{\n";
+        ss << var << "_buf[j] = (float)(" << ptr << ")[j];\n}\n";
+        ss << isa.vec << " " << var << " = " << isa.prefix << "_loadu_ps(" << var << "_buf);\n";
+    }
+    return ss.str();
+}
+
+std::string cpu::emit_simd_store(const SimdIsa& isa,
+                                 const std::string& type,
+                                 const std::string& ptr,
+                                 const std::string& value,
+                                 uint32_t tail)
+{
+    bool avx512 = isa.name == avx512_isa.name;
+    std::stringstream ss;
+    if (tail > 0 && (type == "float" || type == "int32_t"))
+    {
+        if (type == "float")
+        {
+            if (avx512)
+                ss << "_mm512_mask_storeu_ps(" << ptr << ", " << avx512_tail_mask(tail) << ", "
+                   << value << ");\n";
+            else
+                ss << "_mm256_maskstore_ps(" << ptr << ", " << avx2_tail_mask(tail) << ", "
+                   << value << ");\n";
+        }
+        else
+        {
+            if (avx512)
+                ss << "_mm512_mask_storeu_epi32(" << ptr << ", " << avx512_tail_mask(tail)
+                   << ", _mm512_cvttps_epi32(" << value << "));\n";
+            else
+                ss << "_mm256_maskstore_epi32((int*)(" << ptr << "), " << avx2_tail_mask(tail)
+                   << ", _mm256_cvttps_epi32(" << value << "));\n";
+        }
+        return ss.str();
+    }
+    if (tail > 0 && is_16bit_float(type))
+    {
+        ss << "{\n";
+        ss << "uint16_t store_buf[" << isa.width << "];\n";
+        ss << emit_simd_store(isa, type, "store_buf", value);
+        ss << "memcpy(" << ptr << ", store_buf, " << tail * 2 << ");\n";
+        ss << "}\n";
+        return ss.str();
+    }
+
+    if (type == "float")
+    {
+        ss << isa.prefix << "_storeu_ps(" << ptr << ", " << value << ");\n";
+    }
+    else if (type == "int32_t")
+    {
+        if (avx512)
+            ss << "_mm512_storeu_si512((void*)(" << ptr << "), _mm512_cvttps_epi32(" << value
+               << "));\n";
+        else
+            ss << "_mm256_storeu_si256((__m256i*)(" << ptr << "), _mm256_cvttps_epi32(" << value
+               << "));\n";
+    }
+    else if (type == "half")
+    {
+        if (avx512)
+            ss << "_mm256_storeu_si256((__m256i*)(" << ptr << "), _mm512_cvtps_ph(" << value
+               << ", _MM_FROUND_TO_NEAREST_INT));\n";
+        else
+            ss << "_mm_storeu_si128((__m128i*)(" << ptr << "), _mm256_cvtps_ph(" << value
+               << ", _MM_FROUND_TO_NEAREST_INT));\n";
+    }
+    else if (type == "bfloat16")
+    {
+        // round to nearest even, then keep the upper half
+        std::string p = isa.prefix;
+        std::string si = avx512 ? "si512" : "si256";
+        ss << "{\n";
+        ss << (avx512 ? "__m512i" : "__m256i") << " bits = " << p << "_castps_" << si << "("
+           << value << ");\n";
+        ss << "bits = " << p << "_srli_epi32(" << p << "_add_epi32(bits, " << p << "_add_epi32("
+           << p << "_and_" << si << "(" << p << "_srli_epi32(bits, 16), " << p
+           << "_set1_epi32(1)), " << p << "_set1_epi32(0x7fff))), 16);\n";
+        if (avx512)
+            ss << "_mm256_storeu_si256((__m256i*)(" << ptr << "), _mm512_cvtepi32_epi16(bits));\n";
+        else
+            ss << "_mm_storeu_si128((__m128i*)(" << ptr << "), _mm_packus_epi32("
+               << "_mm256_castsi256_si128(bits), _mm256_extracti128_si256(bits, 1)));\n";
+        ss << "}\n";
+    }
+    else
+    {
+        uint32_t count = tail > 0 ? tail : isa.width;
+        ss << "{\n";
+        ss << "float store_buf[" << isa.width << "];\n";
+        ss << isa.prefix << "_storeu_ps(store_buf, " << value << ");\n";
+        ss << "for (int j = 0; j < " << count << "; ++j)\n{\n";
+        ss << "(" << ptr << ")[j] = (" << type << ")store_buf[j];\n}\n";
+        ss << "}\n";
+    }
+    return ss.str();
+}
+
+void cpu::emit_row_parallel_for(LanguageUnit& lu,
+                                size_t rows,
+                                size_t cols,
+                                const std::string& body,
+                                size_t shards_per_thread)
+{
+    lu << "const int64_t rows = " << rows << ";\n";
+    if (shards_per_thread > 0)
+    {
+        lu << "int num_shards = std::max(std::min(static_cast<int64_t>(thread_pool->NumThreads()) "
+           << "* " << shards_per_thread << ", rows), static_cast<int64_t>(1));\n";
+    }
+    else
+    {
+        lu << "const int64_t min_cost_per_shard = 10000;\n";
+        lu << "int num_shards = std::max(std::min(static_cast<int64_t>(thread_pool->NumThreads()), "
+           << "rows * " << cols << " / min_cost_per_shard), static_cast<int64_t>(1));\n";
+    }
+    lu << "const int64_t block_size = (rows + num_shards - 1) / num_shards;\n";
+    lu << "num_shards = (rows + block_size - 1) / block_size;\n";
+    lu << "auto func = [&](int __rank__)\n";
+    lu << "{\n";
+    lu << "int64_t start = block_size * __rank__;\n";
+    lu << "int64_t end = std::min(block_size * (__rank__ + 1), rows);\n";
+    lu << "for (int64_t r = start; r < end; ++r)\n";
+    lu.block_begin();
+    lu << body;
+    lu.block_end();
+    lu << "};\n";
+    lu << "thread_pool->ParallelFor(num_shards, func);\n";
+}
@@ -9,6 +9,8 @@
 
 #include "cpu_kernelops.hpp"
 
+DECLARE_string(fcpu_simd_isa);
+
 namespace nnfusion
 {
     namespace kernels
@@ -25,7 +27,58 @@ namespace nnfusion
                 get_simd_math_kernel(const std::string& name,
                                      const std::string& math_kernel,
                                      size_t data_size,
-                                     const std::vector<std::string>& data_types);
+                                     const std::vector<std::string>& data_types,
+                                     const std::string& vec_type = "__m256");
+
+            /// \brief Vector instruction set targeted by the SIMD kernels, CpuOpMap describes the
+            /// kernels with AVX2 intrinsics which are rewritten for wider ISAs.
+            struct SimdIsa
+            {
+                std::string name;
+                // float vector type
+                std::string vec;
+                // intrinsic prefix
+                std::string prefix;
+                // floats per vector
+                uint32_t width;
+            };
+
+            extern const SimdIsa avx2_isa;
+            extern const SimdIsa avx512_isa;
+            // The ISA picked by -fcpu_simd_isa, auto checks the codegen host.
+            const SimdIsa& get_simd_isa();
+
+            // Rewrite an AVX2 simd_op or simd_math_kernel of CpuOpMap for isa, is_math_kernel
+            // tells whether op names the function generated from a simd_math_kernel.
+            std::string
+                translate_simd_op(const std::string& op, bool is_math_kernel, const SimdIsa& isa);
+            std::string translate_simd_math_kernel(const std::string& math_kernel,
+                                                   const SimdIsa& isa);
+            // Helpers the rewritten AVX-512 kernels need, nullptr for AVX2.
+            shared_ptr<LanguageUnit> get_simd_helpers(const SimdIsa& isa);
+
+            // Declare a float vector var holding the elements of type at ptr, converted with
+            // vector instructions for float, int32, half and bfloat16. A tail in (0, width)
+            // only touches the first tail elements, with masked loads where the ISA has them.
+            std::string emit_simd_load(const SimdIsa& isa,
+                                       const std::string& type,
+                                       const std::string& ptr,
+                                       const std::string& var,
+                                       uint32_t tail = 0);
+            // Store the float vector value to the elements of type at ptr.
+            std::string emit_simd_store(const SimdIsa& isa,
+                                        const std::string& type,
+                                        const std::string& ptr,
+                                        const std::string& value,
+                                        uint32_t tail = 0);
+
+            // Split rows of cols elements into contiguous blocks over the thread pool, body sees
+            // the row index r. Blocks are sized by cost unless shards_per_thread is given.
+            void emit_row_parallel_for(LanguageUnit& lu,
+                                       size_t rows,
+                                       size_t cols,
+                                       const std::string& body,
+                                       size_t shards_per_thread = 0);
         }
     }
 }
@@ -4,6 +4,7 @@
 #include "cpu_kernel_emitter.hpp"
 #include <cstring>
 #include <sstream>
+#include "antares/antares_lowering.hpp"
 #include "nnfusion/core/operators/generic_op/generic_op.hpp"
 #include "nnfusion/util/logging.hpp"
 
@@ -145,7 +146,7 @@ LanguageUnit_p cpu::AntaresCpuKernelEmitter::emit_function_body()
     auto& ctx = m_context;
 
     if (antares_code.empty())
-        return nullptr;
+        return FLAGS_fantares_cpu_builtin ? emit_builtin_function_body() : nullptr;
 
     LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
     auto& lu = *_lu;
@@ -196,6 +197,61 @@ thread_pool->ParallelFor(rank, func);
     return _lu;
 }
 
+std::shared_ptr<cpu::AntaresLowering> cpu::AntaresCpuKernelEmitter::get_builtin_lowering()
+{
+    std::vector<AntaresTensor> outputs;
+    for (auto& output : m_context->outputs)
+    {
+        auto dtype = get_antares_dtype(output->get_element_type());
+        if (dtype.empty())
+            return nullptr;
+        outputs.push_back(AntaresTensor{dtype, output->get_shape()});
+    }
+
+    std::string ir;
+    try
+    {
+        ir = nnfusion::op::get_translation(m_context->gnode);
+    }
+    catch (const std::exception&)
+    {
+        return nullptr;
+    }
+    if (ir.empty())
+        return nullptr;
+
+    auto lowering = std::make_shared<AntaresLowering>(ir, outputs);
+    if (!lowering->is_valid())
+    {
+        NNFUSION_LOG(INFO) << "No built-in Antares kernel for " << m_context->gnode->get_name()
+                           << ": " << lowering->get_error();
+        return nullptr;
+    }
+    return lowering;
+}
+
+LanguageUnit_p cpu::AntaresCpuKernelEmitter::emit_builtin_function_body()
+{
+    auto lowering = get_builtin_lowering();
+    if (lowering == nullptr)
+        return nullptr;
+
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    lu.block_begin();
+    lowering->emit(lu, m_schedule);
+    lu.block_end();
+    return _lu;
+}
+
+LanguageUnit_p cpu::AntaresCpuKernelEmitter::emit_function_name()
+{
+    auto _lu = CpuKernelEmitter::emit_function_name();
+    if (antares_code.empty() && !m_schedule.is_default())
+        *_lu << "_" << m_schedule.to_string();
+    return _lu;
+}
+
 LanguageUnit_p cpu::AntaresCpuKernelEmitter::emit_dependency()
 {
     LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
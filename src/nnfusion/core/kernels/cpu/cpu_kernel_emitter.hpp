@@ -5,12 +5,14 @@
 #include "nnfusion/common/descriptor/layout/tensor_layout.hpp"
 #include "nnfusion/common/descriptor/tensor.hpp"
 #include "nnfusion/core/kernels/antares_ke_imp.hpp"
+#include "nnfusion/core/kernels/cpu/antares/antares_lowering.hpp"
 #include "nnfusion/core/kernels/cpu/cpu_langunit.hpp"
 #include "nnfusion/core/kernels/kernel_emitter.hpp"
 #include "nnfusion/core/kernels/kernel_registration.hpp"
 #include "nnfusion/core/operators/generic_op/generic_op.hpp"
 
 DECLARE_bool(fantares_mode);
+DECLARE_bool(fantares_cpu_builtin);
 
 namespace nnfusion
 {
@@ -63,6 +65,14 @@ namespace nnfusion
                 {
                     m_intra_op_parallelism = true;
                 }
+
+                // Code for cpu_init that packs the constant inputs of this kernel once, for a
+                // body that looks them up and falls back to the unpacked tensors, and the code
+                // for cpu_free that releases them. Both nullptr if nothing is packed.
+                virtual std::pair<LanguageUnit_p, LanguageUnit_p> emit_prepack()
+                {
+                    return std::make_pair(nullptr, nullptr);
+                }
             };
 
             class AntaresCpuKernelEmitter : public CpuKernelEmitter
@@ -90,15 +100,29 @@ namespace nnfusion
                             }
                         }
                     }
+                    // tuned by the local CPU tuning of KernelTuning
+                    if ((*ctx->gnode)["AntaresCpuSchedule"].is_valid())
+                        m_schedule = (*ctx->gnode)["AntaresCpuSchedule"].as<AntaresCpuSchedule>();
                 }
 
                 bool is_eliminative() override;
                 virtual LanguageUnit_p emit_function_body() override;
                 virtual LanguageUnit_p emit_dependency() override;
+                // Loops lowered from the IR in nnfusion by AntaresLowering, for the ops which
+                // the codegen server or the kernel cache have no code for.
+                LanguageUnit_p emit_builtin_function_body();
+                // the lowering behind emit_builtin_function_body, nullptr if the op has no IR or
+                // the IR is not supported
+                std::shared_ptr<AntaresLowering> get_builtin_lowering();
+                // names of the built-in kernels tell their schedule, so that the candidates of
+                // one op can be compiled together
+                LanguageUnit_p emit_function_name() override;
 
                 AntaresKEImp::Pointer m_antares_ke_imp;
                 std::string antares_code;
                 bool is_memcpy = false;
+                // loops of the built-in kernel
+                AntaresCpuSchedule m_schedule;
             };
 
             class CustomCPUKernelEmitter : public CpuKernelEmitter
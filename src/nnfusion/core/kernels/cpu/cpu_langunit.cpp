@@ -7,6 +7,10 @@ using namespace nnfusion::kernels;
 
 // Header
 LU_DEFINE(header::thread, "#include <thread>\n");
+LU_DEFINE(header::mutex, "#include <mutex>\n");
+LU_DEFINE(header::random, "#include <random>\n");
+LU_DEFINE(header::algorithm, "#include <algorithm>\n");
+LU_DEFINE(header::resource, "#include <sys/resource.h>\n");
 LU_DEFINE(header::eigen_tensor,
           "#define EIGEN_USE_THREADS\n#include <unsupported/Eigen/CXX11/Tensor>\n");
 LU_DEFINE(header::eigen_utils, "#include \"eigen_utils.hpp\"\n");
@@ -15,6 +19,8 @@ LU_DEFINE(header::cblas, "#include \"mkl_cblas.h\"\n#define CBLAS_ENUM_DEFINED_H
 LU_DEFINE(header::mlas, "#include \"mlas.h\"\n");
 LU_DEFINE(header::threadpool, "#include \"numa_aware_threadpool.h\"\n");
 LU_DEFINE(header::barrier, "#include \"barrier.h\"\n");
+LU_DEFINE(header::task_graph, "#include \"task_graph.h\"\n");
+LU_DEFINE(header::kernel_trace, "#include \"kernel_trace.h\"\n");
 LU_DEFINE(header::simd, "#include <immintrin.h>\n");
 
 // Macro
@@ -28,4 +34,56 @@ LU_DEFINE(declaration::worker_thread_pool,
 LU_DEFINE(declaration::schedule_thread_pool,
           "concurrency::NumaAwareThreadPool *schedule_thread_pool;\n")
 LU_DEFINE(declaration::superscaler_schedule_thread,
-          "concurrency::NumaAwareThreadPool *superscaler_schedule_thread;\n")
\ No newline at end of file
+          "concurrency::NumaAwareThreadPool *superscaler_schedule_thread;\n")
+LU_DEFINE(declaration::mlas_packed_b,
+          R"(// Constant weights packed once by cpu_init, by the address of the weight.
+inline std::unordered_map<const float*, void*>& nnfusion_mlas_packed_b(bool trans_b)
+{
+    static std::unordered_map<const float*, void*> packed[2];
+    return packed[trans_b];
+}
+
+inline std::unordered_map<const float*, void*>& nnfusion_mlas_packed_filter()
+{
+    static std::unordered_map<const float*, void*> packed;
+    return packed;
+}
+
+inline void nnfusion_mlas_release_packed(std::unordered_map<const float*, void*>& packed,
+                                         const float* weight)
+{
+    auto it = packed.find(weight);
+    if (it == packed.end())
+        return;
+    free(it->second);
+    packed.erase(it);
+}
+)");
+
+LU_DEFINE(declaration::antares_floor_div,
+          R"(// Floor division and modulo of Antares, which round towards negative infinity.
+template <typename T>
+inline T nnfusion_floor_div(T a, T b)
+{
+    T q = a / b;
+    return (q * b != a && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+template <>
+inline float nnfusion_floor_div<float>(float a, float b)
+{
+    return std::floor(a / b);
+}
+
+template <>
+inline double nnfusion_floor_div<double>(double a, double b)
+{
+    return std::floor(a / b);
+}
+
+template <typename T>
+inline T nnfusion_floor_mod(T a, T b)
+{
+    return a - nnfusion_floor_div<T>(a, b) * b;
+}
+)");
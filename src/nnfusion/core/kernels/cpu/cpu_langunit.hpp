@@ -11,6 +11,10 @@ namespace nnfusion
         namespace header
         {
             LU_DECLARE(thread);
+            LU_DECLARE(mutex);
+            LU_DECLARE(random);
+            LU_DECLARE(algorithm);
+            LU_DECLARE(resource);
             LU_DECLARE(eigen_tensor);
             LU_DECLARE(eigen_utils);
             LU_DECLARE(eigen_spatial_convolution);
@@ -18,6 +22,8 @@ namespace nnfusion
             LU_DECLARE(mlas);
             LU_DECLARE(threadpool);
             LU_DECLARE(barrier);
+            LU_DECLARE(task_graph);
+            LU_DECLARE(kernel_trace);
             LU_DECLARE(simd);
         }
 
@@ -32,6 +38,8 @@ namespace nnfusion
             LU_DECLARE(worker_thread_pool);
             LU_DECLARE(schedule_thread_pool);
             LU_DECLARE(superscaler_schedule_thread);
+            LU_DECLARE(mlas_packed_b);
+            LU_DECLARE(antares_floor_div);
         }
     } // namespace kernels
 } // namespace nnfusion
@@ -0,0 +1,513 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "control_flow.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::kernels;
+
+namespace
+{
+    const size_t kWorkspaceAlignment = 64;
+
+    size_t align(size_t size)
+    {
+        return (size + kWorkspaceAlignment - 1) / kWorkspaceAlignment * kWorkspaceAlignment;
+    }
+
+    std::shared_ptr<descriptor::Tensor> get_output_source(const op::ControlFlowBody& body,
+                                                          size_t i)
+    {
+        return body.outputs.at(i)->get_input_tensor_ptr(0);
+    }
+}
+
+cpu::ControlFlowKernelEmitter::ControlFlowKernelEmitter(shared_ptr<KernelContext> ctx)
+    : CpuKernelEmitter(ctx)
+    , m_compiled(true)
+{
+}
+
+bool cpu::ControlFlowKernelEmitter::collect_kernels(op::ControlFlowBody& body, BodyPlan& plan)
+{
+    for (auto node : body.graph->get_ordered_ops())
+    {
+        if (node->is_parameter() || node->get_op_ptr()->is_output())
+            continue;
+        if (!(*node)["Kernel_Selection_Result"].is_valid())
+            return false;
+        auto kernel = (*node)["Kernel_Selection_Result"]
+                          .as<pair<NNFusion_DeviceType, KernelEmitter::Pointer>>()
+                          .second;
+        if (!kernel || node->is_constant() || !kernel->get_or_emit_source())
+            return false;
+        if (kernel->is_parallelism())
+            m_intra_op_parallelism = true;
+        plan.kernels.push_back(kernel);
+    }
+    return true;
+}
+
+void cpu::ControlFlowKernelEmitter::route_captures(const op::ControlFlowBody& body,
+                                                   BodyPlan& plan)
+{
+    for (auto& capture : body.captures)
+        plan.routes[capture.first->get_output_tensor_ptr(0).get()] =
+            "input" + to_string(capture.second);
+}
+
+void cpu::ControlFlowKernelEmitter::route_output(const op::ControlFlowBody& body,
+                                                 size_t i,
+                                                 const std::string& dst,
+                                                 BodyPlan& plan,
+                                                 std::vector<BodyCopy>& copies)
+{
+    auto src = get_output_source(body, i);
+    if (!body.outputs[i]->get_in_edge(0)->get_src()->is_parameter() &&
+        plan.routes.count(src.get()) == 0)
+        plan.routes[src.get()] = dst;
+    else
+        copies.push_back(BodyCopy{dst, src});
+}
+
+void cpu::ControlFlowKernelEmitter::plan_workspace(
+    BodyPlan& plan, const std::vector<std::shared_ptr<descriptor::Tensor>>& pinned)
+{
+    // first and last kernel using each value
+    std::vector<std::shared_ptr<descriptor::Tensor>> values;
+    std::unordered_map<const descriptor::Tensor*, std::pair<size_t, size_t>> live;
+    for (size_t i = 0; i < plan.kernels.size(); i++)
+    {
+        auto& ctx = plan.kernels[i]->m_context;
+        for (auto tensors : {&ctx->inputs, &ctx->outputs, &ctx->tensors})
+        {
+            for (auto& tensor : *tensors)
+            {
+                if (plan.routes.count(tensor.get()))
+                    continue;
+                NNFUSION_CHECK(!tensor->is_persistent())
+                    << "Persistent tensor " << tensor->get_name() << " in a body of "
+                    << m_context->gnode->get_name();
+                auto it = live.find(tensor.get());
+                if (it == live.end())
+                {
+                    live[tensor.get()] = std::make_pair(i, i);
+                    values.push_back(tensor);
+                }
+                else
+                {
+                    it->second.second = i;
+                }
+            }
+        }
+    }
+    for (auto& tensor : pinned)
+    {
+        auto it = live.find(tensor.get());
+        if (it != live.end())
+            it->second.second = plan.kernels.size();
+    }
+
+    // first fit, among the values still alive when the value is produced
+    struct Block
+    {
+        size_t offset, size, last;
+    };
+    std::vector<Block> blocks;
+    for (auto& value : values)
+    {
+        auto& range = live[value.get()];
+        blocks.erase(std::remove_if(blocks.begin(),
+                                    blocks.end(),
+                                    [&range](const Block& b) { return b.last < range.first; }),
+                     blocks.end());
+        std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+            return a.offset < b.offset;
+        });
+        size_t size = align(value->size());
+        size_t offset = 0;
+        for (auto& block : blocks)
+        {
+            if (offset + size <= block.offset)
+                break;
+            offset = std::max(offset, block.offset + block.size);
+        }
+        blocks.push_back(Block{offset, size, range.second});
+        plan.offsets[value.get()] = offset;
+        plan.workspace_size = std::max(plan.workspace_size, offset + size);
+    }
+}
+
+size_t cpu::ControlFlowKernelEmitter::reserve_staging(BodyPlan& plan, size_t size)
+{
+    size_t offset = align(plan.workspace_size);
+    plan.workspace_size = offset + size;
+    return offset;
+}
+
+void cpu::ControlFlowKernelEmitter::allocate_workspace()
+{
+    size_t size = 0;
+    for (auto& plan : m_plans)
+        size = std::max(size, plan.workspace_size);
+    if (size > 0)
+        m_workspace = allocate_tensor(Shape{size}, element::character);
+}
+
+std::string cpu::ControlFlowKernelEmitter::get_workspace_expr(size_t offset,
+                                                              const std::string& type)
+{
+    NNFUSION_CHECK_NOT_NULLPTR(m_workspace);
+    return "reinterpret_cast<" + type + "*>(" + m_workspace->get_name() + " + " +
+           to_string(offset) + ")";
+}
+
+std::string
+    cpu::ControlFlowKernelEmitter::get_expr(const BodyPlan& plan,
+                                            const std::shared_ptr<descriptor::Tensor>& tensor)
+{
+    auto route = plan.routes.find(tensor.get());
+    if (route != plan.routes.end())
+        return route->second;
+    auto offset = plan.offsets.find(tensor.get());
+    NNFUSION_CHECK(offset != plan.offsets.end())
+        << "Value " << tensor->get_name() << " of a body of " << m_context->gnode->get_name()
+        << " has no memory.";
+    return get_workspace_expr(offset->second, tensor->get_element_type().c_type_string());
+}
+
+void cpu::ControlFlowKernelEmitter::emit_calls(LanguageUnit& lu, const BodyPlan& plan)
+{
+    for (auto& kernel : plan.kernels)
+    {
+        auto& ctx = kernel->m_context;
+        std::vector<std::string> args;
+        if (kernel->is_parallelism())
+            args.push_back("thread_pool");
+        for (auto tensors : {&ctx->inputs, &ctx->outputs, &ctx->tensors})
+            for (auto& tensor : *tensors)
+                args.push_back(get_expr(plan, tensor));
+        lu << kernel->get_function_name() << "(" << join(args, ", ") << ");\n";
+    }
+}
+
+void cpu::ControlFlowKernelEmitter::emit_copies(LanguageUnit& lu,
+                                                const BodyPlan& plan,
+                                                const std::vector<BodyCopy>& copies)
+{
+    for (auto& copy : copies)
+    {
+        auto src = get_expr(plan, copy.src);
+        if (src != copy.dst)
+            lu << "memcpy(" << copy.dst << ", " << src << ", " << copy.src->size() << ");\n";
+    }
+}
+
+void cpu::ControlFlowKernelEmitter::emit_state_copies(LanguageUnit& lu,
+                                                      const BodyPlan& plan,
+                                                      const std::vector<BodyCopy>& copies,
+                                                      size_t staging)
+{
+    std::unordered_set<std::string> states;
+    for (auto& copy : copies)
+        states.insert(copy.dst);
+    std::vector<BodyCopy> staged;
+    for (auto& copy : copies)
+    {
+        auto src = get_expr(plan, copy.src);
+        if (src == copy.dst || states.count(src) == 0)
+            continue;
+        auto stage = get_workspace_expr(staging, "char");
+        lu << "memcpy(" << stage << ", " << src << ", " << copy.src->size() << ");\n";
+        staged.push_back(BodyCopy{stage, copy.src});
+        staging += align(copy.src->size());
+    }
+    size_t next = 0;
+    for (auto& copy : copies)
+    {
+        auto src = get_expr(plan, copy.src);
+        if (src == copy.dst)
+            continue;
+        if (states.count(src))
+            src = staged[next++].dst;
+        lu << "memcpy(" << copy.dst << ", " << src << ", " << copy.src->size() << ");\n";
+    }
+}
+
+std::string cpu::ControlFlowKernelEmitter::get_slice_expr(const std::string& base,
+                                                          const Shape& slice_shape,
+                                                          size_t length,
+                                                          bool reverse)
+{
+    std::string index = reverse ? "(" + to_string(length - 1) + " - i)" : "i";
+    return base + " + " + index + " * " + to_string(shape_size(slice_shape));
+}
+
+std::vector<KernelEmitter::Pointer> cpu::ControlFlowKernelEmitter::get_body_kernels()
+{
+    std::vector<KernelEmitter::Pointer> kernels;
+    for (auto& plan : m_plans)
+    {
+        for (auto& kernel : plan.kernels)
+        {
+            if (auto nested = std::dynamic_pointer_cast<ControlFlowKernelEmitter>(kernel))
+            {
+                auto nested_kernels = nested->get_body_kernels();
+                kernels.insert(kernels.end(), nested_kernels.begin(), nested_kernels.end());
+            }
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
+
+LanguageUnit_p cpu::ControlFlowKernelEmitter::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::cstring);
+    if (is_parallelism())
+        _lu->require(header::threadpool);
+
+    // the body kernels are defined in other units, or files with -fkernels_as_files
+    LanguageUnit_p decl(new LanguageUnit("declaration::" + get_function_name() + "_bodies"));
+    std::unordered_set<std::string> declared;
+    for (auto& plan : m_plans)
+    {
+        for (auto& kernel : plan.kernels)
+        {
+            if (declared.insert(kernel->get_function_name()).second)
+                *decl << "extern " << kernel->get_or_emit_source()->get_specialized_signature()
+                      << ";\n";
+        }
+    }
+    _lu->require(decl);
+    return _lu;
+}
+
+cpu::If::If(shared_ptr<KernelContext> ctx)
+    : ControlFlowKernelEmitter(ctx)
+{
+    auto op = static_pointer_cast<nnfusion::op::If>(ctx->gnode->get_op_ptr());
+    for (auto& body : op->get_bodies())
+    {
+        m_plans.emplace_back();
+        m_copies.emplace_back();
+        auto& plan = m_plans.back();
+        if (!collect_kernels(body, plan))
+        {
+            m_compiled = false;
+            return;
+        }
+        route_captures(body, plan);
+        for (size_t i = 0; i < body.outputs.size(); i++)
+            route_output(body, i, "output" + to_string(i), plan, m_copies.back());
+        plan_workspace(plan, {});
+    }
+    allocate_workspace();
+}
+
+LanguageUnit_p cpu::If::emit_function_body()
+{
+    if (!m_compiled)
+        return nullptr;
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+
+    for (size_t b = 0; b < m_plans.size(); b++)
+    {
+        lu << (b == 0 ? "if (input0[0])\n" : "else\n");
+        lu.block_begin();
+        emit_calls(lu, m_plans[b]);
+        emit_copies(lu, m_plans[b], m_copies[b]);
+        lu.block_end();
+    }
+    return _lu;
+}
+
+cpu::Loop::Loop(shared_ptr<KernelContext> ctx)
+    : ControlFlowKernelEmitter(ctx)
+    , m_loop(static_pointer_cast<nnfusion::op::Loop>(ctx->gnode->get_op_ptr()))
+    , m_staging(0)
+{
+    auto& body = m_loop->get_body();
+    m_plans.emplace_back();
+    auto& plan = m_plans.back();
+    if (!collect_kernels(body, plan))
+    {
+        m_compiled = false;
+        return;
+    }
+    route_captures(body, plan);
+    plan.routes[body.inputs[0]->get_output_tensor_ptr(0).get()] = "iteration";
+    plan.routes[body.inputs[1]->get_output_tensor_ptr(0).get()] = "condition";
+    size_t carried = m_loop->get_carried_size();
+    for (size_t i = 0; i < carried; i++)
+        plan.routes[body.inputs[2 + i]->get_output_tensor_ptr(0).get()] = "output" + to_string(i);
+
+    size_t length = std::max<int64_t>(m_loop->get_max_trip_count(), 0);
+    for (size_t i = 0; i < m_loop->get_scan_output_size(); i++)
+    {
+        auto slice = get_slice_expr("output" + to_string(carried + i),
+                                    get_output_source(body, 1 + carried + i)->get_shape(),
+                                    length,
+                                    false);
+        route_output(body, 1 + carried + i, slice, plan, m_scan_copies);
+    }
+
+    std::vector<std::shared_ptr<descriptor::Tensor>> pinned;
+    m_condition = get_output_source(body, 0);
+    pinned.push_back(m_condition);
+    size_t staging = 0;
+    for (size_t i = 0; i < carried; i++)
+    {
+        auto src = get_output_source(body, 1 + i);
+        m_state_copies.push_back(BodyCopy{"output" + to_string(i), src});
+        pinned.push_back(src);
+        staging += align(src->size());
+    }
+    plan_workspace(plan, pinned);
+    m_staging = reserve_staging(plan, staging);
+    allocate_workspace();
+}
+
+LanguageUnit_p cpu::Loop::emit_function_body()
+{
+    if (!m_compiled)
+        return nullptr;
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    auto& plan = m_plans[0];
+
+    size_t input = 0;
+    std::vector<std::string> conditions;
+    if (m_loop->has_trip_count())
+        conditions.push_back("i < input" + to_string(input++) + "[0]");
+    lu << "int64_t iteration[1] = {0};\n";
+    if (m_loop->has_condition())
+    {
+        lu << "char condition[1] = {input" << input++ << "[0]};\n";
+        conditions.push_back("condition[0]");
+    }
+    else
+    {
+        lu << "char condition[1] = {1};\n";
+    }
+    size_t carried = m_loop->get_carried_size();
+    for (size_t i = 0; i < carried; i++)
+        lu << "memcpy(output" << i << ", input" << input + i << ", "
+           << m_context->outputs[i]->size() << ");\n";
+    // the scan outputs hold max_trip_count slices, whatever the trip count input says
+    size_t scan_outputs = m_loop->get_scan_output_size();
+    if (scan_outputs > 0)
+        conditions.push_back("i < " + to_string(m_loop->get_max_trip_count()));
+
+    lu << "int64_t i = 0;\n";
+    lu << "for (; " << join(conditions, " && ") << "; ++i)\n";
+    lu.block_begin();
+    lu << "iteration[0] = i;\n";
+    emit_calls(lu, plan);
+    auto condition = get_expr(plan, m_condition);
+    if (m_loop->has_condition() && condition != "condition")
+        lu << "condition[0] = " << condition << "[0];\n";
+    emit_copies(lu, plan, m_scan_copies);
+    emit_state_copies(lu, plan, m_state_copies, m_staging);
+    lu.block_end();
+
+    if (m_loop->has_condition() && m_loop->get_max_trip_count() > 0)
+    {
+        // the slices of the iterations skipped by an early exit are zero
+        for (size_t k = 0; k < scan_outputs; k++)
+        {
+            auto& output = m_context->outputs[carried + k];
+            size_t slice_size = output->size() / m_loop->get_max_trip_count();
+            lu << "memset((char*)output" << carried + k << " + i * " << slice_size << ", 0, ("
+               << m_loop->get_max_trip_count() << " - i) * " << slice_size << ");\n";
+        }
+    }
+    return _lu;
+}
+
+cpu::Scan::Scan(shared_ptr<KernelContext> ctx)
+    : ControlFlowKernelEmitter(ctx)
+    , m_scan(static_pointer_cast<nnfusion::op::Scan>(ctx->gnode->get_op_ptr()))
+    , m_staging(0)
+{
+    auto& body = m_scan->get_body();
+    m_plans.emplace_back();
+    auto& plan = m_plans.back();
+    if (!collect_kernels(body, plan))
+    {
+        m_compiled = false;
+        return;
+    }
+    route_captures(body, plan);
+    size_t states = m_scan->get_state_size();
+    size_t length = m_scan->get_sequence_length();
+    for (size_t i = 0; i < states; i++)
+        plan.routes[body.inputs[i]->get_output_tensor_ptr(0).get()] = "output" + to_string(i);
+    for (size_t i = 0; i < m_scan->get_scan_input_size(); i++)
+    {
+        auto& param = body.inputs[states + i];
+        plan.routes[param->get_output_tensor_ptr(0).get()] =
+            get_slice_expr("input" + to_string(states + i),
+                           param->get_output_shape(0),
+                           length,
+                           m_scan->is_reverse_input(i));
+    }
+    for (size_t i = 0; i < m_scan->get_scan_output_size(); i++)
+    {
+        auto slice = get_slice_expr("output" + to_string(states + i),
+                                    get_output_source(body, states + i)->get_shape(),
+                                    length,
+                                    m_scan->is_reverse_output(i));
+        route_output(body, states + i, slice, plan, m_scan_copies);
+    }
+
+    std::vector<std::shared_ptr<descriptor::Tensor>> pinned;
+    size_t staging = 0;
+    for (size_t i = 0; i < states; i++)
+    {
+        auto src = get_output_source(body, i);
+        m_state_copies.push_back(BodyCopy{"output" + to_string(i), src});
+        pinned.push_back(src);
+        staging += align(src->size());
+    }
+    plan_workspace(plan, pinned);
+    m_staging = reserve_staging(plan, staging);
+    allocate_workspace();
+}
+
+LanguageUnit_p cpu::Scan::emit_function_body()
+{
+    if (!m_compiled)
+        return nullptr;
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    auto& plan = m_plans[0];
+
+    for (size_t i = 0; i < m_scan->get_state_size(); i++)
+        lu << "memcpy(output" << i << ", input" << i << ", " << m_context->outputs[i]->size()
+           << ");\n";
+    lu << "for (int64_t i = 0; i < " << m_scan->get_sequence_length() << "; ++i)\n";
+    lu.block_begin();
+    emit_calls(lu, plan);
+    emit_copies(lu, plan, m_scan_copies);
+    emit_state_copies(lu, plan, m_state_copies, m_staging);
+    lu.block_end();
+    return _lu;
+}
+
+REGISTER_KERNEL_EMITTER(
+    "If",                                                                    //op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("cpu").Priority(2), //attrs
+    cpu::If)                                                                 //constructor
+
+REGISTER_KERNEL_EMITTER(
+    "Loop",                                                                  //op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("cpu").Priority(2), //attrs
+    cpu::Loop)                                                               //constructor
+
+REGISTER_KERNEL_EMITTER(
+    "Scan",                                                                  //op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("cpu").Priority(2), //attrs
+    cpu::Scan)                                                               //constructor
@@ -0,0 +1,134 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "../cpu_kernel_emitter.hpp"
+#include "../cpu_langunit.hpp"
+#include "nnfusion/core/operators/op_define/control_flow.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        namespace cpu
+        {
+            /// \brief Kernel of If, Loop and Scan, a host loop or branch calling the kernels
+            /// which ControlFlowPass selected for the nodes of the bodies.
+            ///
+            /// Body values are not allocated per run: captured values are read from the inputs,
+            /// loop-carried values and states live in the outputs of the op, slices of scan
+            /// inputs and outputs are read and written in place, and the other values share one
+            /// workspace tensor in the memory pool, planned by their liveness in the body.
+            class ControlFlowKernelEmitter : public CpuKernelEmitter
+            {
+            public:
+                LanguageUnit_p emit_dependency() override;
+
+                // The kernels of the bodies, nested ones included, whose definitions the
+                // codegen emits along with this kernel.
+                std::vector<KernelEmitter::Pointer> get_body_kernels();
+
+            protected:
+                ControlFlowKernelEmitter(shared_ptr<KernelContext> ctx);
+
+                // A value of a body the kernel copies at the end of a run.
+                struct BodyCopy
+                {
+                    std::string dst;
+                    std::shared_ptr<nnfusion::descriptor::Tensor> src;
+                };
+
+                struct BodyPlan
+                {
+                    std::vector<KernelEmitter::Pointer> kernels;
+                    // C expressions of the values which are not in the workspace
+                    std::unordered_map<const nnfusion::descriptor::Tensor*, std::string> routes;
+                    std::unordered_map<const nnfusion::descriptor::Tensor*, size_t> offsets;
+                    size_t workspace_size = 0;
+                };
+
+                // Collect the kernels of a body, false if some node has none.
+                bool collect_kernels(nnfusion::op::ControlFlowBody& body, BodyPlan& plan);
+                void route_captures(const nnfusion::op::ControlFlowBody& body, BodyPlan& plan);
+                // Route the body output i to dst if a kernel of the body produces it and it is
+                // not routed yet, so that the kernel writes it in place; add a copy otherwise.
+                void route_output(const nnfusion::op::ControlFlowBody& body,
+                                  size_t i,
+                                  const std::string& dst,
+                                  BodyPlan& plan,
+                                  std::vector<BodyCopy>& copies);
+                // Place the values which are not routed in the workspace, those in pinned stay
+                // alive until the end of a run.
+                void plan_workspace(
+                    BodyPlan& plan,
+                    const std::vector<std::shared_ptr<nnfusion::descriptor::Tensor>>& pinned);
+                // Reserve size bytes of workspace after the plan for emit_state_copies, return
+                // their offset.
+                size_t reserve_staging(BodyPlan& plan, size_t size);
+                // Allocate the workspace for the largest plan.
+                void allocate_workspace();
+
+                std::string get_expr(const BodyPlan& plan,
+                                     const std::shared_ptr<nnfusion::descriptor::Tensor>& tensor);
+                std::string get_workspace_expr(size_t offset, const std::string& type);
+                void emit_calls(LanguageUnit& lu, const BodyPlan& plan);
+                void emit_copies(LanguageUnit& lu,
+                                 const BodyPlan& plan,
+                                 const std::vector<BodyCopy>& copies);
+                // Copy the loop-carried values or states to the outputs of the op, staging the
+                // values read from other states first.
+                void emit_state_copies(LanguageUnit& lu,
+                                       const BodyPlan& plan,
+                                       const std::vector<BodyCopy>& copies,
+                                       size_t staging);
+                // The slice at iteration i of a scan input or output of length slices.
+                static std::string get_slice_expr(const std::string& base,
+                                                  const nnfusion::Shape& slice_shape,
+                                                  size_t length,
+                                                  bool reverse);
+
+                std::vector<BodyPlan> m_plans;
+                bool m_compiled;
+                std::shared_ptr<nnfusion::descriptor::Tensor> m_workspace;
+            };
+
+            class If : public ControlFlowKernelEmitter
+            {
+            public:
+                If(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+
+            private:
+                std::vector<std::vector<BodyCopy>> m_copies;
+            };
+
+            class Loop : public ControlFlowKernelEmitter
+            {
+            public:
+                Loop(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+
+            private:
+                std::shared_ptr<nnfusion::op::Loop> m_loop;
+                std::vector<BodyCopy> m_scan_copies, m_state_copies;
+                std::shared_ptr<nnfusion::descriptor::Tensor> m_condition;
+                size_t m_staging;
+            };
+
+            class Scan : public ControlFlowKernelEmitter
+            {
+            public:
+                Scan(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+
+            private:
+                std::shared_ptr<nnfusion::op::Scan> m_scan;
+                std::vector<BodyCopy> m_scan_copies, m_state_copies;
+                size_t m_staging;
+            };
+        } // namespace cpu
+    }     // namespace kernels
+} // namespace nnfusion
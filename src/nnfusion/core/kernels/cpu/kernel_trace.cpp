@@ -0,0 +1,211 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "kernel_trace.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        LanguageUnit_p kernel_trace_header = LanguageUnit_p(new LanguageUnit("kernel_trace.h",
+                                                                             R"(
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#endif
+
+namespace nnfusion
+{
+    namespace cpu
+    {
+        // KernelTracer keeps the timestamps of the last capacity kernel calls in a ring buffer
+        // and the total time and call count of every node over all runs. Timestamps are TSC
+        // ticks where available, converted to microseconds against the steady clock.
+        class KernelTracer
+        {
+        public:
+            KernelTracer(int num_nodes,
+                         const char* const* names,
+                         const char* const* op_types,
+                         size_t capacity)
+                : num_nodes_(num_nodes)
+                , names_(names)
+                , op_types_(op_types)
+                , capacity_(capacity > 0 ? capacity : 1)
+                , events_(new Event[capacity > 0 ? capacity : 1])
+                , head_(0)
+                , total_ticks_(new std::atomic<uint64_t>[num_nodes > 0 ? num_nodes : 1])
+                , calls_(new std::atomic<uint64_t>[num_nodes > 0 ? num_nodes : 1])
+                , start_ticks_(Now())
+                , start_time_(std::chrono::steady_clock::now())
+            {
+                for (int i = 0; i < num_nodes_; i++)
+                {
+                    total_ticks_[i].store(0, std::memory_order_relaxed);
+                    calls_[i].store(0, std::memory_order_relaxed);
+                }
+            }
+
+            static uint64_t Now()
+            {
+#if defined(__x86_64__) || defined(_M_X64)
+                return __rdtsc();
+#else
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+#endif
+            }
+
+            void Record(int node, uint64_t begin)
+            {
+                uint64_t end = Now();
+                size_t slot = head_.fetch_add(1, std::memory_order_relaxed) % capacity_;
+                events_[slot] = Event{node, ThreadId(), begin, end};
+                total_ticks_[node].fetch_add(end - begin, std::memory_order_relaxed);
+                calls_[node].fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Write the events in the ring buffer as a Chrome trace and print the time spent in
+            // every node and op type.
+            void Dump(const char* trace_path)
+            {
+                double us_per_tick = MicrosecondsPerTick();
+                size_t head = head_.load(std::memory_order_acquire);
+                size_t count = std::min(head, capacity_);
+
+                uint64_t origin = UINT64_MAX;
+                for (size_t i = head - count; i < head; i++)
+                    origin = std::min(origin, events_[i % capacity_].begin);
+
+                std::ofstream trace(trace_path);
+                trace << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+                for (size_t i = head - count; i < head; i++)
+                {
+                    const Event& e = events_[i % capacity_];
+                    trace << (i + count == head ? "" : ",\n") << "{\"name\": \""
+                          << Escape(names_[e.node]) << "\", \"cat\": \""
+                          << Escape(op_types_[e.node]) << "\", \"ph\": \"X\", \"pid\": 0, "
+                          << "\"tid\": " << e.thread << ", \"ts\": "
+                          << (e.begin - origin) * us_per_tick
+                          << ", \"dur\": " << (e.end - e.begin) * us_per_tick << "}";
+                }
+                trace << "\n]}\n";
+                trace.close();
+
+                uint64_t total = 0;
+                std::map<std::string, std::pair<uint64_t, uint64_t>> by_op_type;
+                std::vector<int> nodes;
+                for (int i = 0; i < num_nodes_; i++)
+                {
+                    uint64_t ticks = total_ticks_[i].load(std::memory_order_relaxed);
+                    total += ticks;
+                    by_op_type[op_types_[i]].first += ticks;
+                    by_op_type[op_types_[i]].second += calls_[i].load(std::memory_order_relaxed);
+                    nodes.push_back(i);
+                }
+                std::sort(nodes.begin(), nodes.end(), [&](int a, int b) {
+                    return total_ticks_[a].load() > total_ticks_[b].load();
+                });
+                double total_ms = total * us_per_tick / 1000.0;
+
+                printf("kernel trace: %zu of %zu calls written to %s, %f ms in kernels\n",
+                       count, head, trace_path, total_ms);
+                printf("%-48s %-24s %10s %12s %12s %8s\n", "node", "op", "calls", "total ms",
+                       "avg us", "%");
+                for (int i : nodes)
+                {
+                    uint64_t calls = calls_[i].load(std::memory_order_relaxed);
+                    if (calls == 0)
+                        continue;
+                    double ms = total_ticks_[i].load(std::memory_order_relaxed) * us_per_tick /
+                                1000.0;
+                    printf("%-48s %-24s %10llu %12.3f %12.3f %8.2f\n", names_[i], op_types_[i],
+                           (unsigned long long)calls, ms, ms * 1000.0 / calls,
+                           total_ms > 0 ? ms * 100.0 / total_ms : 0.0);
+                }
+                std::vector<std::pair<double, std::string>> op_types;
+                for (auto& it : by_op_type)
+                    op_types.push_back(
+                        std::make_pair(it.second.first * us_per_tick / 1000.0, it.first));
+                std::sort(op_types.rbegin(), op_types.rend());
+                printf("%-48s %10s %12s %8s\n", "op", "calls", "total ms", "%");
+                for (auto& it : op_types)
+                    printf("%-48s %10llu %12.3f %8.2f\n", it.second.c_str(),
+                           (unsigned long long)by_op_type[it.second].second, it.first,
+                           total_ms > 0 ? it.first * 100.0 / total_ms : 0.0);
+            }
+
+        private:
+            struct Event
+            {
+                int node;
+                int thread;
+                uint64_t begin;
+                uint64_t end;
+            };
+
+            static int ThreadId()
+            {
+                static std::atomic<int> next_id(0);
+                thread_local int id = next_id.fetch_add(1);
+                return id;
+            }
+
+            double MicrosecondsPerTick() const
+            {
+                uint64_t ticks = Now() - start_ticks_;
+                double us = std::chrono::duration<double, std::micro>(
+                                std::chrono::steady_clock::now() - start_time_)
+                                .count();
+                return ticks > 0 ? us / ticks : 0.0;
+            }
+
+            static std::string Escape(const char* s)
+            {
+                std::string out;
+                for (; *s; ++s)
+                {
+                    unsigned char c = *s;
+                    if (c < 0x20)
+                    {
+                        char code[8];
+                        snprintf(code, sizeof(code), "\\u%04x", c);
+                        out += code;
+                        continue;
+                    }
+                    if (c == '"' || c == '\\')
+                        out += '\\';
+                    out += *s;
+                }
+                return out;
+            }
+
+            int num_nodes_;
+            const char* const* names_;
+            const char* const* op_types_;
+            size_t capacity_;
+            std::unique_ptr<Event[]> events_;
+            std::atomic<size_t> head_;
+            std::unique_ptr<std::atomic<uint64_t>[]> total_ticks_;
+            std::unique_ptr<std::atomic<uint64_t>[]> calls_;
+            uint64_t start_ticks_;
+            std::chrono::steady_clock::time_point start_time_;
+        };
+    }
+}
+)"));
+    }
+}
@@ -11,17 +11,32 @@ using namespace nnfusion::kernels;
 cpu::ConvolutionMlas::ConvolutionMlas(shared_ptr<KernelContext> ctx)
     : MlasKernelEmitter(ctx)
 {
-    auto conv = static_pointer_cast<op::Convolution>(ctx->gnode->get_op_ptr());
-
     input_shape = ctx->inputs[0]->get_shape();
     filter_shape = ctx->inputs[1]->get_shape();
     output_shape = ctx->outputs[0]->get_shape();
-    window_dilation_strides = conv->get_window_dilation_strides();
-    window_movement_strides = conv->get_window_movement_strides();
-    data_dilation_strides = conv->get_data_dilation_strides();
-    padding_below_diff = conv->get_padding_below();
-    padding_above_diff = conv->get_padding_above();
-    data_format = conv->get_data_format();
+    if (auto fused = std::dynamic_pointer_cast<op::GenericOp>(ctx->gnode->get_op_ptr()))
+    {
+        auto& cfg = fused->localOpConfig.getRoot();
+        window_dilation_strides = Strides(cfg["dilations"].get<std::vector<size_t>>());
+        window_movement_strides = Strides(cfg["strides"].get<std::vector<size_t>>());
+        data_dilation_strides = Strides(window_movement_strides.size(), 1);
+        padding_below_diff = CoordinateDiff(cfg["padding_below"].get<std::vector<int64_t>>());
+        padding_above_diff = CoordinateDiff(cfg["padding_above"].get<std::vector<int64_t>>());
+        data_format = cfg["data_format"];
+        activation = cfg["activation"];
+        has_bias = cfg["has_bias"];
+        has_residual = cfg["has_residual"];
+    }
+    else
+    {
+        auto conv = static_pointer_cast<op::Convolution>(ctx->gnode->get_op_ptr());
+        window_dilation_strides = conv->get_window_dilation_strides();
+        window_movement_strides = conv->get_window_movement_strides();
+        data_dilation_strides = conv->get_data_dilation_strides();
+        padding_below_diff = conv->get_padding_below();
+        padding_above_diff = conv->get_padding_above();
+        data_format = conv->get_data_format();
+    }
     dtype = ctx->outputs[0]->get_element_type().c_type_string();
 
     std::stringstream tag;
@@ -29,6 +44,12 @@ cpu::ConvolutionMlas::ConvolutionMlas(shared_ptr<KernelContext> ctx)
         << join(filter_shape, "_") << "_o" << join(output_shape, "_") << "_ws"
         << join(window_movement_strides, "_") << "_wd" << join(window_dilation_strides, "_")
         << "_pb" << join(padding_below_diff, "_") << "_pa" << join(padding_above_diff, "_");
+    if (!activation.empty())
+        tag << "_" << activation;
+    if (has_bias)
+        tag << "_bias";
+    if (has_residual)
+        tag << "_residual";
     custom_tag = tag.str();
 }
 
@@ -89,6 +110,25 @@ LanguageUnit_p cpu::ConvolutionMlas::emit_function_body()
     size_t output_height = output_shape[2];
     size_t output_width = output_shape[3];
 
+    std::string activation_kind = "MlasIdentityActivation";
+    if (activation == "relu")
+        activation_kind = "MlasReluActivation";
+    else if (activation == "sigmoid")
+        activation_kind = "MlasLogisticActivation";
+    else if (activation == "tanh")
+        activation_kind = "MlasTanhActivation";
+    else
+        NNFUSION_CHECK(activation.empty()) << "Unsupported activation of FusedConv: " << activation;
+    // The residual is copied to the output, which the convolution is then accumulated to.
+    std::string residual;
+    if (has_residual)
+    {
+        std::string input = "input" + std::to_string(has_bias ? 3 : 2);
+        residual = "if (output0 != " + input + ")\n    memcpy(output0, " + input + ", " +
+                   std::to_string(shape_size(output_shape) * sizeof(float)) +
+                   ");\nparameters.Beta = 1.0f;\n";
+    }
+
     auto code = op::create_code_from_template(
         R"(
 int64_t batch_count = @batch_count@;
@@ -118,7 +158,7 @@ int64_t stride_shape[] = { stride_height, stride_width };
 int64_t output_shape[] = { output_height, output_width };
 
 MLAS_ACTIVATION activation;
-activation.ActivationKind = MlasIdentityActivation;
+activation.ActivationKind = @activation_kind@;
 
 MLAS_CONV_PARAMETERS parameters;
 size_t working_buffer_size = 0;
@@ -140,11 +180,11 @@ MlasConvPrepare(&parameters,
                 thread_pool);
 
 float* working_buffer = new float[working_buffer_size];
-
+@residual@
 MlasConv(&parameters,
          input0,
          input1,
-         nullptr,
+         @bias@,
          working_buffer,
          output0,
          thread_pool);
@@ -168,7 +208,10 @@ delete[] working_buffer;
          {"stride_height", stride_height},
          {"stride_width", stride_width},
          {"output_height", output_height},
-         {"output_width", output_width}});
+         {"output_width", output_width},
+         {"activation_kind", activation_kind},
+         {"bias", has_bias ? "input2" : "nullptr"},
+         {"residual", residual}});
 
     lu << code;
 
@@ -179,6 +222,8 @@ LanguageUnit_p cpu::ConvolutionMlas::emit_dependency()
 {
     LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
     _lu->require(header::mlas);
+    if (has_residual)
+        _lu->require(header::cstring);
 
     return _lu;
 }
@@ -187,3 +232,8 @@ REGISTER_KERNEL_EMITTER(
     "Convolution",                                                            // op_name
     Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
     cpu::ConvolutionMlas)                                                     // constructor
+
+REGISTER_KERNEL_EMITTER(
+    "FusedConv",                                                              // op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
+    cpu::ConvolutionMlas)                                                     // constructor
@@ -10,6 +10,8 @@ namespace nnfusion
     {
         namespace cpu
         {
+            // A Convolution, or a FusedConv whose bias, activation and residual MLAS applies to
+            // each block of the output right after computing it.
             class ConvolutionMlas : public MlasKernelEmitter
             {
             public:
@@ -24,6 +26,9 @@ namespace nnfusion
                     data_dilation_strides;
                 nnfusion::CoordinateDiff padding_below_diff, padding_above_diff;
                 string dtype, data_format;
+                // the epilogue of a FusedConv
+                string activation;
+                bool has_bias = false, has_residual = false;
             };
         } // namespace cpu
     }     // namespace kernels
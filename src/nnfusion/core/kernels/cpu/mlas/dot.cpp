@@ -2,6 +2,8 @@
 // Licensed under the MIT License.
 
 #include "dot.hpp"
+#include "../simd/gelu.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
 
 using namespace nnfusion;
 using namespace nnfusion::kernels;
@@ -9,16 +11,36 @@ using namespace nnfusion::kernels;
 cpu::DotMlas::DotMlas(shared_ptr<KernelContext> ctx)
     : MlasKernelEmitter(ctx)
 {
-    auto dot_op = static_pointer_cast<op::Dot>(ctx->gnode->get_op_ptr());
-
-    reduction_axes = dot_op->get_reduction_axes_count();
+    if (auto generic_op = std::dynamic_pointer_cast<op::GenericOp>(ctx->gnode->get_op_ptr()))
+    {
+        auto& cfg = generic_op->localOpConfig.getRoot();
+        reduction_axes = 1;
+        trans_A = cfg["trans_A"];
+        trans_B = cfg["trans_B"];
+        fused = true;
+        has_bias = cfg["has_bias"];
+        has_residual = cfg["has_residual"];
+        activation = cfg["activation"];
+    }
+    else
+    {
+        auto dot_op = static_pointer_cast<op::Dot>(ctx->gnode->get_op_ptr());
+        reduction_axes = dot_op->get_reduction_axes_count();
+        trans_A = dot_op->get_transpose_A();
+        trans_B = dot_op->get_transpose_B();
+    }
     arg0_shape = nnfusion::Shape(ctx->inputs[0]->get_shape());
     arg1_shape = nnfusion::Shape(ctx->inputs[1]->get_shape());
+    auto b_edge = ctx->gnode ? ctx->gnode->get_in_edge(1) : nullptr;
+    constant_b = b_edge && b_edge->get_src()->is_constant();
 
     std::stringstream tag;
     tag << "Mlas"
         << "_r_" << reduction_axes << "_i_" << join(arg0_shape, "_") << "_i_"
         << join(arg1_shape, "_");
+    if (fused)
+        tag << "_t" << trans_A << trans_B << "_" << (activation.empty() ? "identity" : activation)
+            << "_b" << has_bias << "_r" << has_residual;
     custom_tag = tag.str();
 }
 
@@ -27,10 +49,6 @@ LanguageUnit_p cpu::DotMlas::emit_function_body()
     LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
     auto& lu = *_lu;
 
-    auto gemm = static_pointer_cast<nnfusion::op::Dot>(m_context->gnode->get_op_ptr());
-    auto trans_A = gemm->get_transpose_A();
-    auto trans_B = gemm->get_transpose_B();
-
     std::string trans_A_str = (trans_A) ? "CblasTrans" : "CblasNoTrans";
     std::string trans_B_str = (trans_B) ? "CblasTrans" : "CblasNoTrans";
 
@@ -90,6 +108,29 @@ LanguageUnit_p cpu::DotMlas::emit_function_body()
     size_t ldb = (trans_B) ? K : N;
     size_t ldc = N;
 
+    bool matrix = reduction_axes == 1 && arg0_shape.size() == 2 && arg1_shape.size() == 2;
+    if (constant_b && matrix)
+        build_prepack(N, K, ldb);
+    if (fused)
+    {
+        NNFUSION_CHECK(matrix) << "FusedDot only support Matrix";
+        emit_fused_gemm(lu, M, N, K, lda);
+        return _lu;
+    }
+
+    if (constant_b && matrix)
+    {
+        // The weight packed by cpu_init saves MlasGemm from packing B on every call.
+        lu << "auto& packed_b = nnfusion_mlas_packed_b(" << (trans_B ? "true" : "false") << ");\n";
+        lu << "auto packed = packed_b.find(input1);\n";
+        lu << "if (packed != packed_b.end())\n";
+        lu.block_begin();
+        lu << "MlasGemm(" << trans_A_str << ", " << M << ", " << N << ", " << K << ", 1.0, input0, "
+           << lda << ", packed->second, 0.0, output0, " << ldc << ", thread_pool);\n";
+        lu << "return;\n";
+        lu.block_end();
+    }
+
     lu << "MlasGemm(" << ((trans_A) ? "CblasTrans, " : "CblasNoTrans, ")
        << ((trans_B) ? "CblasTrans, " : "CblasNoTrans, ") << M << ", " << N << ", " << K << ", "
        << "1.0, "
@@ -102,10 +143,169 @@ LanguageUnit_p cpu::DotMlas::emit_function_body()
     return _lu;
 }
 
+void cpu::DotMlas::build_prepack(size_t N, size_t K, size_t ldb)
+{
+    std::string trans_B_str = (trans_B) ? "CblasTrans" : "CblasNoTrans";
+    prepack = std::make_shared<LanguageUnit>(get_function_name() + "_prepack");
+    auto& pack = *prepack;
+    std::string weight = m_context->input_names[1];
+    pack << "if (nnfusion_mlas_packed_b(" << (trans_B ? "true" : "false") << ").count("
+         << weight << ") == 0)\n";
+    pack.block_begin();
+    pack << "size_t packed_size = (MlasGemmPackBSize(" << N << ", " << K
+         << ") + 63) / 64 * 64;\n";
+    pack << "void* packed = aligned_alloc(64, packed_size);\n";
+    pack << "MlasGemmPackB(" << trans_B_str << ", " << N << ", " << K << ", " << weight << ", "
+         << ldb << ", packed);\n";
+    pack << "nnfusion_mlas_packed_b(" << (trans_B ? "true" : "false") << ")[" << weight
+         << "] = packed;\n";
+    pack.block_end();
+    prepack->require(header::mlas);
+    prepack->require(header::stdlib);
+    prepack->require(header::unordered_map);
+    prepack->require(declaration::mlas_packed_b);
+
+    prepack_release = std::make_shared<LanguageUnit>(get_function_name() + "_prepack_release");
+    *prepack_release << "nnfusion_mlas_release_packed(nnfusion_mlas_packed_b("
+                     << (trans_B ? "true" : "false") << "), " << weight << ");\n";
+    prepack_release->require(declaration::mlas_packed_b);
+}
+
+void cpu::DotMlas::emit_fused_gemm(LanguageUnit& lu, size_t M, size_t N, size_t K, size_t lda)
+{
+    std::string activation_kind = "MlasIdentityActivation";
+    if (activation == "relu")
+        activation_kind = "MlasReluActivation";
+    else if (activation == "sigmoid")
+        activation_kind = "MlasLogisticActivation";
+    else if (activation == "tanh")
+        activation_kind = "MlasTanhActivation";
+    else
+        NNFUSION_CHECK(activation.empty() || activation == "gelu")
+            << "Unsupported activation of FusedDot: " << activation;
+
+    // Each block of rows starts as residual + bias, the GEMM accumulates to it and the
+    // activation runs on the block before the next one evicts it from cache.
+    std::string init;
+    if (has_bias || has_residual)
+    {
+        std::string residual = "input" + std::to_string(has_bias ? 3 : 2);
+        init = "for (int64_t r = 0; r < rows; ++r)\n{\nfloat* row = c + r * N;\n";
+        if (has_residual)
+            init += "const float* residual = " + residual + " + (m + r) * N;\n";
+        init += "for (int64_t n = 0; n < N; ++n)\n    row[n] = ";
+        init += has_residual ? (has_bias ? "residual[n] + input2[n];\n" : "residual[n];\n")
+                             : "input2[n];\n";
+        init += "}\n";
+    }
+    std::string epilogue;
+    if (activation_kind != "MlasIdentityActivation")
+    {
+        epilogue = "MlasActivation(&activation, c, nullptr, rows, N, N);\n";
+    }
+    else if (activation == "gelu")
+    {
+        auto& isa = get_simd_isa();
+        lu.require(get_gelu_kernel(isa));
+        std::string gelu = "nnfusion_gelu_" + isa.name + "(x)";
+        size_t tail = N % isa.width;
+        epilogue = "for (int64_t r = 0; r < rows; ++r)\n{\nfloat* row = c + r * N;\n";
+        epilogue += "for (int64_t n = 0; n < " + std::to_string(N - tail) + "; n += " +
+                    std::to_string(isa.width) + ")\n{\n";
+        epilogue += emit_simd_load(isa, "float", "row + n", "x");
+        epilogue += emit_simd_store(isa, "float", "row + n", gelu);
+        epilogue += "}\n";
+        if (tail > 0)
+        {
+            std::string offset = "row + " + std::to_string(N - tail);
+            epilogue += "{\n" + emit_simd_load(isa, "float", offset, "x", tail);
+            epilogue += emit_simd_store(isa, "float", offset, gelu, tail) + "}\n";
+        }
+        epilogue += "}\n";
+    }
+
+    std::string gemm;
+    std::string a = trans_A ? "input0 + m" : "input0 + m * " + std::to_string(lda);
+    std::string beta = init.empty() ? "0.0f" : "1.0f";
+    std::string trans_A_str = (trans_A) ? "CblasTrans" : "CblasNoTrans";
+    std::string trans_B_str = (trans_B) ? "CblasTrans" : "CblasNoTrans";
+    std::string ldb = std::to_string(trans_B ? K : N);
+    if (constant_b)
+    {
+        gemm = "if (packed_b != nullptr)\n    MlasGemm(" + trans_A_str +
+               ", rows, N, K, 1.0f, a, lda, packed_b, " + beta + ", c, N, pool);\nelse\n    ";
+    }
+    gemm += "MlasGemm(" + trans_A_str + ", " + trans_B_str +
+            ", rows, N, K, 1.0f, a, lda, input1, " + ldb + ", " + beta + ", c, N, pool);\n";
+
+    if (constant_b)
+    {
+        lu << "auto& packed_map = nnfusion_mlas_packed_b(" << (trans_B ? "true" : "false")
+           << ");\n";
+        lu << "auto packed = packed_map.find(input1);\n";
+        lu << "const void* packed_b = packed != packed_map.end() ? packed->second : nullptr;\n";
+    }
+    // Blocks of a packed B are cut to stay in cache, otherwise a block is a whole shard, as
+    // MlasGemm packs B again on every call.
+    size_t chunk_rows = constant_b ? std::max<size_t>(16, 16384 / std::max<size_t>(N, 1)) : M;
+    auto code = op::create_code_from_template(
+        R"(
+MLAS_ACTIVATION activation;
+activation.ActivationKind = @activation_kind@;
+const int64_t M = @M@, N = @N@, K = @K@, lda = @lda@;
+auto gemm_block = [&](int64_t m, int64_t rows, MLAS_THREADPOOL* pool)
+{
+    const float* a = @a@;
+    float* c = output0 + m * N;
+@init@@gemm@@epilogue@};
+
+const int64_t min_rows_per_shard = 16;
+int num_shards = std::max(std::min(static_cast<int64_t>(thread_pool->NumThreads()),
+                                   M / min_rows_per_shard), static_cast<int64_t>(1));
+if (num_shards == 1)
+{
+    gemm_block(0, M, thread_pool);
+    return;
+}
+const int64_t block_size = (M + num_shards - 1) / num_shards;
+num_shards = (M + block_size - 1) / block_size;
+auto func = [&](int __rank__)
+{
+    int64_t end = std::min(block_size * (__rank__ + 1), M);
+    for (int64_t m = block_size * __rank__; m < end; m += @chunk_rows@)
+        gemm_block(m, std::min<int64_t>(@chunk_rows@, end - m), nullptr);
+};
+thread_pool->ParallelFor(num_shards, func);
+)",
+        {{"activation_kind", activation_kind},
+         {"M", M},
+         {"N", N},
+         {"K", K},
+         {"lda", lda},
+         {"a", a},
+         {"init", init},
+         {"gemm", gemm},
+         {"epilogue", epilogue},
+         {"chunk_rows", chunk_rows}});
+    lu << code;
+}
+
+std::pair<LanguageUnit_p, LanguageUnit_p> cpu::DotMlas::emit_prepack()
+{
+    get_or_emit_source();
+    return std::make_pair(prepack, prepack_release);
+}
+
 LanguageUnit_p cpu::DotMlas::emit_dependency()
 {
     LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
     _lu->require(header::mlas);
+    if (constant_b)
+    {
+        _lu->require(header::stdlib);
+        _lu->require(header::unordered_map);
+        _lu->require(declaration::mlas_packed_b);
+    }
 
     return _lu;
 }
@@ -114,3 +314,8 @@ REGISTER_KERNEL_EMITTER(
     "Dot",                                                                    // op_name
     Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
     cpu::DotMlas)
+
+REGISTER_KERNEL_EMITTER(
+    "FusedDot",                                                               // op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
+    cpu::DotMlas)
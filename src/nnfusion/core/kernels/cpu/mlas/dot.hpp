@@ -10,6 +10,8 @@ namespace nnfusion
     {
         namespace cpu
         {
+            // A Dot, or a 2D FusedDot whose bias, residual and activation are applied to blocks
+            // of rows right after their GEMM, while they are still in cache.
             class DotMlas : public MlasKernelEmitter
             {
             public:
@@ -17,10 +19,21 @@ namespace nnfusion
 
                 LanguageUnit_p emit_function_body() override;
                 LanguageUnit_p emit_dependency() override;
+                std::pair<LanguageUnit_p, LanguageUnit_p> emit_prepack() override;
 
             private:
+                void build_prepack(size_t N, size_t K, size_t ldb);
+                void emit_fused_gemm(LanguageUnit& lu, size_t M, size_t N, size_t K, size_t lda);
+
                 size_t reduction_axes;
+                bool trans_A, trans_B;
                 nnfusion::Shape arg0_shape, arg1_shape;
+                // B is a Constant, whose packed copy is looked up at run time.
+                bool constant_b;
+                LanguageUnit_p prepack, prepack_release;
+                // the epilogue of a FusedDot
+                bool fused = false, has_bias = false, has_residual = false;
+                std::string activation;
             };
         } // namespace cpu
     }     // namespace kernels
@@ -0,0 +1,253 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nchwc.hpp"
+#include "nnfusion/core/kernels/cpu/cpu_langunit.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::kernels;
+
+cpu::NchwcReorderMlas::NchwcReorderMlas(shared_ptr<KernelContext> ctx)
+    : MlasKernelEmitter(ctx)
+{
+    input_shape = ctx->inputs[0]->get_shape();
+    to_nchwc = ctx->gnode->get_op_type() == "NchwcReorderInput";
+
+    std::stringstream tag;
+    tag << "mlas_nchwc_reorder_" << (to_nchwc ? "input" : "output") << "_i"
+        << join(input_shape, "_");
+    custom_tag = tag.str();
+}
+
+LanguageUnit_p cpu::NchwcReorderMlas::emit_function_body()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+
+    lu << "int64_t shape[] = {" << join(input_shape, ", ") << "};\n";
+    lu << (to_nchwc ? "MlasReorderInput" : "MlasReorderOutput") << "(shape, input0, output0);\n";
+
+    return _lu;
+}
+
+LanguageUnit_p cpu::NchwcReorderMlas::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::mlas);
+
+    return _lu;
+}
+
+cpu::NchwcConvMlas::NchwcConvMlas(shared_ptr<KernelContext> ctx)
+    : MlasKernelEmitter(ctx)
+{
+    auto generic_op = static_pointer_cast<nnfusion::op::GenericOp>(ctx->gnode->get_op_ptr());
+    auto& cfg = generic_op->localOpConfig.getRoot();
+
+    input_shape = ctx->inputs[0]->get_shape();
+    filter_shape = ctx->inputs[1]->get_shape();
+    output_shape = ctx->outputs[0]->get_shape();
+    strides = cfg["strides"].get<std::vector<int64_t>>();
+    dilations = cfg["dilations"].get<std::vector<int64_t>>();
+    pads = cfg["pads"].get<std::vector<int64_t>>();
+    activation = cfg["activation"];
+    nchw_input = cfg["nchw_input"];
+    auto filter_edge = ctx->gnode->get_in_edge(1);
+    constant_filter = filter_edge && filter_edge->get_src()->is_constant();
+
+    std::stringstream tag;
+    tag << "mlas_nchwc_conv_i" << join(input_shape, "_") << "_w" << join(filter_shape, "_")
+        << "_o" << join(output_shape, "_") << "_s" << join(strides, "_") << "_d"
+        << join(dilations, "_") << "_p" << join(pads, "_") << "_b" << ctx->inputs.size()
+        << (nchw_input ? "_nchw" : "") << (activation.empty() ? "" : "_" + activation);
+    custom_tag = tag.str();
+}
+
+LanguageUnit_p cpu::NchwcConvMlas::emit_function_body()
+{
+    if (!activation.empty() && activation != "relu")
+        return nullptr;
+
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+
+    // An input with less channels than a NCHWc block is read as NCHW, with the filter in OIHWBo
+    // format, see MlasNchwcConv.
+    std::string reorder_filter =
+        nchw_input ? "MlasReorderFilterOIHWBo" : "MlasReorderFilterOIHWBiBo";
+    size_t filter_bytes = (shape_size(filter_shape) * sizeof(float) + 63) / 64 * 64;
+
+    // The filter reordered by cpu_init is looked up, profiling runs reorder it on the fly.
+    auto code = op::create_code_from_template(
+        R"(
+int64_t input_shape[] = {@input_shape@};
+int64_t filter_shape[] = {@filter_shape@};
+int64_t output_shape[] = {@output_shape@};
+int64_t kernel_shape[] = {@kernel_shape@};
+int64_t dilation_shape[] = {@dilations@};
+int64_t padding[] = {@pads@};
+int64_t stride_shape[] = {@strides@};
+
+const float* filter = input1;
+float* reordered_filter = nullptr;
+auto packed = nnfusion_mlas_packed_filter().find(input1);
+if (packed != nnfusion_mlas_packed_filter().end())
+{
+    filter = static_cast<const float*>(packed->second);
+}
+else
+{
+    reordered_filter = static_cast<float*>(aligned_alloc(64, @filter_bytes@));
+    @reorder_filter@(filter_shape, input1, reordered_filter);
+    filter = reordered_filter;
+}
+
+MLAS_ACTIVATION activation;
+activation.ActivationKind = @activation@;
+
+MlasNchwcConv(2, input_shape, kernel_shape, dilation_shape, padding, stride_shape, output_shape,
+              1, input0, filter, @bias@, output0, &activation, true, thread_pool);
+free(reordered_filter);
+)",
+        {{"input_shape", join(input_shape, ", ")},
+         {"filter_shape", join(filter_shape, ", ")},
+         {"output_shape", join(output_shape, ", ")},
+         {"kernel_shape", join(Shape(filter_shape.begin() + 2, filter_shape.end()), ", ")},
+         {"dilations", join(dilations, ", ")},
+         {"pads", join(pads, ", ")},
+         {"strides", join(strides, ", ")},
+         {"filter_bytes", filter_bytes},
+         {"reorder_filter", reorder_filter},
+         {"activation", activation == "relu" ? "MlasReluActivation" : "MlasIdentityActivation"},
+         {"bias", m_context->inputs.size() == 3 ? "input2" : "nullptr"}});
+    lu << code;
+
+    if (constant_filter)
+    {
+        std::string weight = m_context->input_names[1];
+        prepack = std::make_shared<LanguageUnit>(get_function_name() + "_prepack");
+        auto& pack = *prepack;
+        pack << "if (nnfusion_mlas_packed_filter().count(" << weight << ") == 0)\n";
+        pack.block_begin();
+        pack << "int64_t filter_shape[] = {" << join(filter_shape, ", ") << "};\n";
+        pack << "float* packed = static_cast<float*>(aligned_alloc(64, " << filter_bytes
+             << "));\n";
+        pack << reorder_filter << "(filter_shape, " << weight << ", packed);\n";
+        pack << "nnfusion_mlas_packed_filter()[" << weight << "] = packed;\n";
+        pack.block_end();
+        prepack->require(header::mlas);
+        prepack->require(header::stdlib);
+        prepack->require(header::unordered_map);
+        prepack->require(declaration::mlas_packed_b);
+
+        prepack_release = std::make_shared<LanguageUnit>(get_function_name() + "_prepack_release");
+        *prepack_release << "nnfusion_mlas_release_packed(nnfusion_mlas_packed_filter(), "
+                         << weight << ");\n";
+        prepack_release->require(declaration::mlas_packed_b);
+    }
+
+    return _lu;
+}
+
+LanguageUnit_p cpu::NchwcConvMlas::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::mlas);
+    _lu->require(header::stdlib);
+    _lu->require(header::unordered_map);
+    _lu->require(declaration::mlas_packed_b);
+
+    return _lu;
+}
+
+std::pair<LanguageUnit_p, LanguageUnit_p> cpu::NchwcConvMlas::emit_prepack()
+{
+    get_or_emit_source();
+    return std::make_pair(prepack, prepack_release);
+}
+
+cpu::NchwcPoolMlas::NchwcPoolMlas(shared_ptr<KernelContext> ctx)
+    : MlasKernelEmitter(ctx)
+{
+    auto generic_op = static_pointer_cast<nnfusion::op::GenericOp>(ctx->gnode->get_op_ptr());
+    auto& cfg = generic_op->localOpConfig.getRoot();
+
+    input_shape = ctx->inputs[0]->get_shape();
+    output_shape = ctx->outputs[0]->get_shape();
+    window = cfg["window"].get<std::vector<int64_t>>();
+    strides = cfg["strides"].get<std::vector<int64_t>>();
+    pads = cfg["pads"].get<std::vector<int64_t>>();
+    kind = cfg["kind"];
+
+    std::stringstream tag;
+    tag << "mlas_nchwc_pool_" << kind << "_i" << join(input_shape, "_") << "_w"
+        << join(window, "_") << "_o" << join(output_shape, "_") << "_s" << join(strides, "_")
+        << "_p" << join(pads, "_");
+    custom_tag = tag.str();
+}
+
+LanguageUnit_p cpu::NchwcPoolMlas::emit_function_body()
+{
+    std::string pooling_kind;
+    if (kind == "max")
+        pooling_kind = "MlasMaximumPooling";
+    else if (kind == "avg_include_pad")
+        pooling_kind = "MlasAveragePoolingIncludePad";
+    else if (kind == "avg_exclude_pad")
+        pooling_kind = "MlasAveragePoolingExcludePad";
+    else
+        return nullptr;
+
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+
+    auto code = op::create_code_from_template(
+        R"(
+int64_t input_shape[] = {@input_shape@};
+int64_t output_shape[] = {@output_shape@};
+int64_t kernel_shape[] = {@window@};
+int64_t padding[] = {@pads@};
+int64_t stride_shape[] = {@strides@};
+
+MlasNchwcPool(@kind@, 2, input_shape, kernel_shape, nullptr, padding, stride_shape, output_shape,
+              input0, output0, thread_pool);
+)",
+        {{"input_shape", join(input_shape, ", ")},
+         {"output_shape", join(output_shape, ", ")},
+         {"window", join(window, ", ")},
+         {"pads", join(pads, ", ")},
+         {"strides", join(strides, ", ")},
+         {"kind", pooling_kind}});
+    lu << code;
+
+    return _lu;
+}
+
+LanguageUnit_p cpu::NchwcPoolMlas::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::mlas);
+
+    return _lu;
+}
+
+REGISTER_KERNEL_EMITTER(
+    "NchwcReorderInput",                                                      // op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
+    cpu::NchwcReorderMlas)                                                    // constructor
+
+REGISTER_KERNEL_EMITTER(
+    "NchwcReorderOutput",                                                     // op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
+    cpu::NchwcReorderMlas)                                                    // constructor
+
+REGISTER_KERNEL_EMITTER(
+    "NchwcConv",                                                              // op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
+    cpu::NchwcConvMlas)                                                       // constructor
+
+REGISTER_KERNEL_EMITTER(
+    "NchwcPool",                                                              // op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
+    cpu::NchwcPoolMlas)                                                       // constructor
@@ -0,0 +1,59 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "../cpu_kernel_emitter.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        namespace cpu
+        {
+            // NchwcReorderInput and NchwcReorderOutput
+            class NchwcReorderMlas : public MlasKernelEmitter
+            {
+            public:
+                NchwcReorderMlas(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+
+            private:
+                nnfusion::Shape input_shape;
+                bool to_nchwc;
+            };
+
+            class NchwcConvMlas : public MlasKernelEmitter
+            {
+            public:
+                NchwcConvMlas(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+                std::pair<LanguageUnit_p, LanguageUnit_p> emit_prepack() override;
+
+            private:
+                nnfusion::Shape input_shape, filter_shape, output_shape;
+                std::vector<int64_t> strides, dilations, pads;
+                std::string activation;
+                bool nchw_input, constant_filter;
+                LanguageUnit_p prepack, prepack_release;
+            };
+
+            class NchwcPoolMlas : public MlasKernelEmitter
+            {
+            public:
+                NchwcPoolMlas(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+
+            private:
+                nnfusion::Shape input_shape, output_shape;
+                std::vector<int64_t> window, strides, pads;
+                std::string kind;
+            };
+        } // namespace cpu
+    }     // namespace kernels
+} // namespace nnfusion
@@ -0,0 +1,103 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <iomanip>
+
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+#include "quantized_matmul.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::kernels;
+
+cpu::QuantizedMatMulMlas::QuantizedMatMulMlas(shared_ptr<KernelContext> ctx)
+    : MlasKernelEmitter(ctx)
+{
+    arg0_shape = nnfusion::Shape(ctx->inputs[0]->get_shape());
+    arg1_shape = nnfusion::Shape(ctx->inputs[1]->get_shape());
+
+    auto generic_op = static_pointer_cast<nnfusion::op::GenericOp>(ctx->gnode->get_op_ptr());
+    a_zero_point = generic_op->localOpConfig.getRoot()["a_zero_point"];
+    b_zero_point = generic_op->localOpConfig.getRoot()["b_zero_point"];
+    scale = generic_op->localOpConfig.getRoot()["scale"];
+    accumulator = allocate_tensor(m_context->outputs[0]->get_shape(), element::i32);
+
+    std::stringstream tag;
+    tag << "Mlas_quantized_matmul"
+        << "_i_" << join(arg0_shape, "_") << "_i_" << join(arg1_shape, "_") << "_z_"
+        << a_zero_point << "_" << b_zero_point << "_s_" << scale;
+    custom_tag = tag.str();
+}
+
+LanguageUnit_p cpu::QuantizedMatMulMlas::emit_function_body()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+
+    // B is either one [K, N] matrix shared by all rows of A, which then form a single GEMM, or a
+    // batch of matrices matching the leading dimensions of A.
+    bool broadcast_b = arg1_shape.size() == 2;
+    size_t rank = arg0_shape.size();
+    size_t k = arg0_shape[rank - 1];
+    size_t n = arg1_shape.back();
+    size_t m = broadcast_b ? shape_size(arg0_shape) / k : arg0_shape[rank - 2];
+    size_t batch = broadcast_b ? 1 : shape_size(arg0_shape) / (m * k);
+    std::string b_type = m_context->inputs[1]->get_element_type().c_type_string();
+
+    std::stringstream scale_literal;
+    scale_literal << std::scientific << std::setprecision(9) << scale << "f";
+
+    // MlasGemm accumulates in the int32 temp tensor, which is then scaled into the output.
+    auto code = op::create_code_from_template(
+        R"(
+int32_t* accumulator = @accumulator@;
+for (int64_t b = 0; b < @batch@; ++b)
+{
+    MlasGemm(@m@, @n@, @k@, input0 + b * @stride_a@, @k@, static_cast<uint8_t>(@a_zero_point@),
+             input1 + b * @stride_b@, @n@, static_cast<@b_type@>(@b_zero_point@),
+             accumulator + b * @stride_c@, @n@, thread_pool);
+}
+
+int num_shards = static_cast<int64_t>(thread_pool->NumThreads());
+const int64_t total = @total@;
+const int64_t block_size = (total + num_shards - 1) / num_shards;
+auto func = [&](int __rank__)
+{
+    int64_t start = block_size * __rank__;
+    int64_t end = std::min(start + block_size, total);
+    for (int64_t i = start; i < end; ++i)
+        output0[i] = @scale@ * static_cast<float>(accumulator[i]);
+};
+thread_pool->ParallelFor(num_shards, func);
+)",
+        {{"m", m},
+         {"n", n},
+         {"k", k},
+         {"batch", batch},
+         {"stride_a", m * k},
+         {"stride_b", broadcast_b ? 0 : k * n},
+         {"stride_c", m * n},
+         {"total", batch * m * n},
+         {"a_zero_point", a_zero_point},
+         {"b_zero_point", b_zero_point},
+         {"b_type", b_type},
+         {"scale", scale_literal.str()},
+         {"accumulator", accumulator->get_name()}});
+
+    lu << code;
+
+    return _lu;
+}
+
+LanguageUnit_p cpu::QuantizedMatMulMlas::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::mlas);
+    _lu->require(header::algorithm);
+
+    return _lu;
+}
+
+REGISTER_KERNEL_EMITTER(
+    "QuantizedMatMul",                                                        // op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("mlas").Priority(6), // attrs
+    cpu::QuantizedMatMulMlas)
@@ -0,0 +1,29 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "../cpu_kernel_emitter.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        namespace cpu
+        {
+            class QuantizedMatMulMlas : public MlasKernelEmitter
+            {
+            public:
+                QuantizedMatMulMlas(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+
+            private:
+                nnfusion::Shape arg0_shape, arg1_shape;
+                int a_zero_point, b_zero_point;
+                float scale;
+                std::shared_ptr<nnfusion::descriptor::Tensor> accumulator;
+            };
+        } // namespace cpu
+    }     // namespace kernels
+} // namespace nnfusion
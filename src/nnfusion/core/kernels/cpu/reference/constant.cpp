@@ -5,8 +5,10 @@
 #include <stdio.h>
 
 #include "nnfusion/common/languageunit.hpp"
+#include "nnfusion/core/kernels/common_langunit.hpp"
 #include "nnfusion/core/kernels/kernel_emitter.hpp"
 #include "nnfusion/core/kernels/kernel_registration.hpp"
+#include "nnfusion/core/kernels/weight_pack.hpp"
 #include "nnfusion/core/operators/generic_op/generic_op.hpp"
 
 namespace nnfusion
@@ -33,8 +35,22 @@ namespace nnfusion
 
                 LanguageUnit_p emit_function_body() override
                 {
-                    nnfusion::codegen::create_folder(folder);
                     const_name = m_context->outputs[0]->get_name();
+                    if (FLAGS_fpack_constants)
+                    {
+                        // The runtime normally points output0 into the mapped weight file,
+                        // copy only when the tensor lives elsewhere (e.g. inplace concat).
+                        size_t offset =
+                            WeightPack::Global()->add(const_name, op->get_storage());
+                        LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+                        auto& writer = *_lu;
+                        writer << "if ((char*)output0 != nnfusion_weights + " << offset << ")\n"
+                               << "    memcpy(output0, nnfusion_weights + " << offset << ", "
+                               << op->get_data_size() << ");\n";
+                        return _lu;
+                    }
+
+                    nnfusion::codegen::create_folder(folder);
                     ofstream bin_file(folder + const_name + ".bin", ios::out | ios::binary);
                     bin_file.write((const char*)op->get_data_ptr(), op->get_data_size());
                     bin_file.close();
@@ -52,6 +68,11 @@ namespace nnfusion
 
                 {
                     LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+                    if (FLAGS_fpack_constants)
+                    {
+                        _lu->require(header::cstring);
+                        _lu->require(declaration::nnfusion_weights);
+                    }
                     return _lu;
                 }
 
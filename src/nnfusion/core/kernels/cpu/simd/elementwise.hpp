@@ -37,26 +37,47 @@ namespace nnfusion
                         return nullptr;
                     }
 
-                    size_t remainder_count = m_data_size % m_simd_block_size;
+                    auto& isa = get_simd_isa();
+                    size_t remainder_count = m_data_size % isa.width;
                     size_t loop_count = m_data_size - remainder_count;
-                    size_t shard_data_count = m_data_size / m_simd_block_size;
+                    size_t shard_data_count = m_data_size / isa.width;
 
-                    auto op = CpuOpMap<T>::simd_op;
+                    bool has_math_kernel = CpuOpMap<T>::simd_math_kernel != nullptr;
+                    auto op = translate_simd_op(CpuOpMap<T>::simd_op, has_math_kernel, isa);
 
                     LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
                     auto& lu = *_lu;
 
-                    if (CpuOpMap<T>::simd_math_kernel != nullptr)
+                    auto helpers = get_simd_helpers(isa);
+                    if (helpers != nullptr)
+                    {
+                        lu.require(helpers);
+                    }
+                    if (has_math_kernel)
                     {
                         auto math_kernel = get_simd_math_kernel(
-                            op, CpuOpMap<T>::simd_math_kernel, m_data_size, m_data_types);
+                            op,
+                            translate_simd_math_kernel(CpuOpMap<T>::simd_math_kernel, isa),
+                            m_data_size,
+                            m_data_types,
+                            isa.vec);
                         NNFUSION_CHECK_NOT_NULLPTR(math_kernel);
+                        if (helpers != nullptr)
+                        {
+                            math_kernel->require(helpers);
+                        }
                         lu.require(math_kernel);
                     }
                     auto num_inputs = m_data_types.size() - 1;
                     NNFUSION_CHECK(num_inputs > 0)
                         << "At least one input and one output tensor for elementwise-op.";
 
+                    std::vector<std::string> in_args;
+                    for (size_t i = 0; i < num_inputs; ++i)
+                    {
+                        in_args.push_back("in" + std::to_string(i));
+                    }
+
                     if (loop_count > 0)
                     {
                         lu << "const int64_t min_cost_per_shard = 10000;\n";
@@ -73,54 +94,22 @@ namespace nnfusion
 
                         lu << "auto func = [&](int __rank__)\n";
                         lu << "{\n";
-                        lu << "int64_t start = block_size * __rank__ * " << m_simd_block_size
-                           << ";\n";
+                        lu << "int64_t start = block_size * __rank__ * " << isa.width << ";\n";
                         lu << "int64_t end = std::min(block_size * (__rank__ + 1), "
                               "static_cast<int64_t>("
-                           << shard_data_count << ")) * " << m_simd_block_size << ";\n";
-
-                        for (size_t i = 0; i < num_inputs + 1; i++)
-                        {
-                            if (m_data_types[i] != "float")
-                            {
-                                lu << "float tmp_buffer[" << m_simd_block_size << "];\n";
-                                break;
-                            }
-                        }
+                           << shard_data_count << ")) * " << isa.width << ";\n";
 
-                        lu << "for (size_t i = start; i < end; i+=" << m_simd_block_size << ")\n";
+                        lu << "for (size_t i = start; i < end; i+=" << isa.width << ")\n";
                         lu.block_begin();
                         for (size_t i = 0; i < num_inputs; ++i)
                         {
-                            if (m_data_types[i] != "float")
-                            {
-                                lu << "for (int j = 0; j < " << m_simd_block_size << "; ++j)\n{\n";
-                                lu << "tmp_buffer[j] = (float)input" << i << "[i + j];\n}\n";
-                                lu << "__m256 in" << i << " = _mm256_loadu_ps(tmp_buffer);\n";
-                            }
-                            else
-                            {
-                                lu << "__m256 in" << i << " = _mm256_loadu_ps(input" << i
-                                   << " + i);\n";
-                            }
-                        }
-                        lu << "__m256 out = " << op << "(";
-                        for (size_t i = 0; i < num_inputs - 1; ++i)
-                        {
-                            lu << "in" << i << ", ";
-                        }
-                        lu << "in" << num_inputs - 1 << ");\n";
-                        if (m_data_types[num_inputs] != "float")
-                        {
-                            lu << "_mm256_storeu_ps(tmp_buffer, out);\n";
-                            lu << "for (int j = 0; j < " << m_simd_block_size << "; ++j)\n{\n";
-                            lu << "output0[i + j] = (" << m_data_types[num_inputs]
-                               << ")tmp_buffer[j];\n}\n";
-                        }
-                        else
-                        {
-                            lu << "_mm256_storeu_ps(output0 + i, out);\n";
+                            lu << emit_simd_load(isa,
+                                                 m_data_types[i],
+                                                 "input" + std::to_string(i) + " + i",
+                                                 in_args[i]);
                         }
+                        lu << isa.vec << " out = " << op << "(" << join(in_args, ", ") << ");\n";
+                        lu << emit_simd_store(isa, m_data_types[num_inputs], "output0 + i", "out");
                         lu.block_end();
                         lu << "};\n";
                         lu << "thread_pool->ParallelFor(num_shards, func);\n";
@@ -128,23 +117,24 @@ namespace nnfusion
 
                     if (remainder_count > 0)
                     {
-                        lu << "for (size_t i = " << loop_count << "; i < " << m_data_size
-                           << "; ++i)\n";
-                        lu << "{\n";
+                        // one masked vector for the tail
+                        lu.block_begin();
                         for (size_t i = 0; i < num_inputs; ++i)
                         {
-                            lu << "__m256 in" << i
-                               << " = _mm256_insertf128_ps(_mm256_setzero_ps(), _mm_set_ss(input"
-                               << i << "[i]), 0);\n";
-                        }
-                        lu << "__m256 out = " << op << "(";
-                        for (size_t i = 0; i < num_inputs - 1; ++i)
-                        {
-                            lu << "in" << i << ", ";
+                            lu << emit_simd_load(isa,
+                                                 m_data_types[i],
+                                                 "input" + std::to_string(i) + " + " +
+                                                     std::to_string(loop_count),
+                                                 in_args[i],
+                                                 remainder_count);
                         }
-                        lu << "in" << num_inputs - 1 << ");\n";
-                        lu << "output0[i] = _mm_cvtss_f32(_mm256_extractf128_ps(out, 0));\n";
-                        lu << "}\n";
+                        lu << isa.vec << " out = " << op << "(" << join(in_args, ", ") << ");\n";
+                        lu << emit_simd_store(isa,
+                                              m_data_types[num_inputs],
+                                              "output0 + " + std::to_string(loop_count),
+                                              "out",
+                                              remainder_count);
+                        lu.block_end();
                     }
 
                     return _lu;
@@ -154,10 +144,17 @@ namespace nnfusion
                 {
                     LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
                     _lu->require(header::simd);
+                    for (auto& type : m_data_types)
+                    {
+                        // tails of 16-bit floats are copied through a buffer
+                        if (type == "half" || type == "bfloat16")
+                            _lu->require(header::cstring);
+                    }
 
                     return _lu;
                 }
 
+                // Always AVX2, ElementwiseFused composes these into __m256 code.
                 virtual std::pair<std::string, shared_ptr<LanguageUnit>> get_op_kernel() override
                 {
                     std::string op = CpuOpMap<T>::simd_op;
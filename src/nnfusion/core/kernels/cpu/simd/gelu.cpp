@@ -0,0 +1,103 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "gelu.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::kernels;
+
+LanguageUnit_p cpu::get_gelu_kernel(const SimdIsa& isa)
+{
+    static std::unordered_map<std::string, LanguageUnit_p> kernels;
+    auto it = kernels.find(isa.name);
+    if (it != kernels.end())
+        return it->second;
+
+    // The erf coefficients are those of Eigen's generic_fast_erf_float, inputs are clamped to
+    // [-4, 4] where erf is already +/-1 in single precision.
+    auto code = op::create_code_from_template(
+        R"(
+inline @vec@ nnfusion_gelu_@isa@(@vec@ x)
+{
+    @vec@ z = @p@_mul_ps(x, @p@_set1_ps(0.70710678118654752f));
+    z = @p@_max_ps(@p@_min_ps(z, @p@_set1_ps(4.0f)), @p@_set1_ps(-4.0f));
+    @vec@ z2 = @p@_mul_ps(z, z);
+    @vec@ p = @p@_fmadd_ps(z2, @p@_set1_ps(-2.72614225801306e-10f), @p@_set1_ps(2.77068142495902e-08f));
+    p = @p@_fmadd_ps(z2, p, @p@_set1_ps(-2.10102402082508e-06f));
+    p = @p@_fmadd_ps(z2, p, @p@_set1_ps(-5.69250639462346e-05f));
+    p = @p@_fmadd_ps(z2, p, @p@_set1_ps(-7.34990630326855e-04f));
+    p = @p@_fmadd_ps(z2, p, @p@_set1_ps(-2.95459980854025e-03f));
+    p = @p@_fmadd_ps(z2, p, @p@_set1_ps(-1.60960333262415e-02f));
+    p = @p@_mul_ps(z, p);
+    @vec@ q = @p@_fmadd_ps(z2, @p@_set1_ps(-1.45660718464996e-05f), @p@_set1_ps(-2.13374055278905e-04f));
+    q = @p@_fmadd_ps(z2, q, @p@_set1_ps(-1.68282697438203e-03f));
+    q = @p@_fmadd_ps(z2, q, @p@_set1_ps(-7.37332916720468e-03f));
+    q = @p@_fmadd_ps(z2, q, @p@_set1_ps(-1.42647390514189e-02f));
+    @vec@ erf = @p@_div_ps(p, q);
+    return @p@_mul_ps(@p@_mul_ps(x, @p@_set1_ps(0.5f)), @p@_add_ps(erf, @p@_set1_ps(1.0f)));
+}
+)",
+        {{"isa", isa.name}, {"vec", isa.vec}, {"p", isa.prefix}});
+
+    LanguageUnit_p lu(new LanguageUnit("declaration::nnfusion_gelu_" + isa.name, code));
+    lu->require(header::simd);
+    kernels[isa.name] = lu;
+    return lu;
+}
+
+cpu::GeluSimd::GeluSimd(shared_ptr<KernelContext> ctx)
+    : SimdKernelEmitter(ctx)
+{
+    m_data_size = ctx->inputs[0]->size(false);
+}
+
+LanguageUnit_p cpu::GeluSimd::emit_function_body()
+{
+    auto& isa = get_simd_isa();
+    size_t remainder_count = m_data_size % isa.width;
+    size_t loop_count = m_data_size - remainder_count;
+
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    lu.require(get_gelu_kernel(isa));
+
+    if (loop_count > 0)
+    {
+        // each row is one full vector
+        std::string offset = "r * " + std::to_string(isa.width);
+        std::string body = emit_simd_load(isa, "float", "input0 + " + offset, "in0") +
+                           emit_simd_store(isa,
+                                           "float",
+                                           "output0 + " + offset,
+                                           "nnfusion_gelu_" + isa.name + "(in0)");
+        emit_row_parallel_for(lu, loop_count / isa.width, isa.width, body);
+    }
+
+    if (remainder_count > 0)
+    {
+        // one masked vector for the tail
+        std::string offset = std::to_string(loop_count);
+        lu.block_begin();
+        lu << emit_simd_load(isa, "float", "input0 + " + offset, "in0", remainder_count);
+        lu << emit_simd_store(isa,
+                              "float",
+                              "output0 + " + offset,
+                              "nnfusion_gelu_" + isa.name + "(in0)",
+                              remainder_count);
+        lu.block_end();
+    }
+
+    return _lu;
+}
+
+LanguageUnit_p cpu::GeluSimd::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::simd);
+    return _lu;
+}
+
+REGISTER_KERNEL_EMITTER("Gelu",
+                        Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("simd").Priority(5),
+                        cpu::GeluSimd)
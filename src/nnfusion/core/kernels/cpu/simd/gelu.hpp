@@ -0,0 +1,31 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "../cpu_helper.hpp"
+#include "../cpu_kernel_emitter.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        namespace cpu
+        {
+            // Vector gelu(x) = 0.5 * x * (1 + erf(x / sqrt(2))), erf is evaluated with a rational
+            // approximation accurate to a few ulps.
+            LanguageUnit_p get_gelu_kernel(const SimdIsa& isa);
+
+            class GeluSimd : public SimdKernelEmitter
+            {
+            public:
+                GeluSimd(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+
+            private:
+                size_t m_data_size;
+            };
+        } // namespace cpu
+    }     // namespace kernels
+} // namespace nnfusion
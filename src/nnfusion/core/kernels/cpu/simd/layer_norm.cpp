@@ -0,0 +1,265 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "layer_norm.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::kernels;
+
+LanguageUnit_p cpu::get_row_norm_kernels(const SimdIsa& isa)
+{
+    static std::unordered_map<std::string, LanguageUnit_p> kernels;
+    auto it = kernels.find(isa.name);
+    if (it != kernels.end())
+        return it->second;
+
+    // Each lane keeps its own Welford state over every width-th element, the lanes are merged
+    // with Chan's formula and the remaining elements are folded in one by one.
+    auto code = op::create_code_from_template(
+        R"(
+template <int K>
+inline void nnfusion_row_moments_@isa@(
+    const float* const* x, float* sum, int64_t n, float& mean, float& var)
+{
+    @vec@ v_mean = @p@_setzero_ps();
+    @vec@ v_m2 = @p@_setzero_ps();
+    int64_t i = 0, lane_count = 0;
+    for (; i + @w@ <= n; i += @w@)
+    {
+        @vec@ v = @p@_loadu_ps(x[0] + i);
+        for (int k = 1; k < K; ++k)
+            v = @p@_add_ps(v, @p@_loadu_ps(x[k] + i));
+        if (K > 1)
+            @p@_storeu_ps(sum + i, v);
+        ++lane_count;
+        @vec@ delta = @p@_sub_ps(v, v_mean);
+        v_mean = @p@_fmadd_ps(delta, @p@_set1_ps(1.0f / lane_count), v_mean);
+        v_m2 = @p@_fmadd_ps(delta, @p@_sub_ps(v, v_mean), v_m2);
+    }
+    float m = 0.0f, m2 = 0.0f, count = 0.0f;
+    if (lane_count > 0)
+    {
+        alignas(64) float lane_mean[@w@], lane_m2[@w@];
+        @p@_store_ps(lane_mean, v_mean);
+        @p@_store_ps(lane_m2, v_m2);
+        for (int l = 0; l < @w@; ++l)
+        {
+            float total = count + lane_count;
+            float delta = lane_mean[l] - m;
+            m += delta * lane_count / total;
+            m2 += lane_m2[l] + delta * delta * count * lane_count / total;
+            count = total;
+        }
+    }
+    for (; i < n; ++i)
+    {
+        float v = x[0][i];
+        for (int k = 1; k < K; ++k)
+            v += x[k][i];
+        if (K > 1)
+            sum[i] = v;
+        count += 1.0f;
+        float delta = v - m;
+        m += delta / count;
+        m2 += delta * (v - m);
+    }
+    mean = m;
+    var = m2 / n;
+}
+
+inline void nnfusion_row_normalize_@isa@(const float* x,
+                                         const float* gamma,
+                                         const float* beta,
+                                         float* y,
+                                         int64_t n,
+                                         float mean,
+                                         float inv_std)
+{
+    @vec@ v_mean = @p@_set1_ps(mean);
+    @vec@ v_inv_std = @p@_set1_ps(inv_std);
+    int64_t i = 0;
+    for (; i + @w@ <= n; i += @w@)
+    {
+        @vec@ v = @p@_mul_ps(@p@_sub_ps(@p@_loadu_ps(x + i), v_mean), v_inv_std);
+        @p@_storeu_ps(y + i, @p@_fmadd_ps(v, @p@_loadu_ps(gamma + i), @p@_loadu_ps(beta + i)));
+    }
+    for (; i < n; ++i)
+        y[i] = (x[i] - mean) * inv_std * gamma[i] + beta[i];
+}
+)",
+        {{"isa", isa.name}, {"vec", isa.vec}, {"p", isa.prefix}, {"w", isa.width}});
+
+    LanguageUnit_p lu(new LanguageUnit("declaration::nnfusion_row_norm_" + isa.name, code));
+    lu->require(header::simd);
+    kernels[isa.name] = lu;
+    return lu;
+}
+
+cpu::LayerNormSimd::LayerNormSimd(shared_ptr<KernelContext> ctx)
+    : SimdKernelEmitter(ctx)
+{
+    auto generic_op = static_pointer_cast<op::GenericOp>(ctx->gnode->get_op_ptr());
+    auto& cfg = generic_op->localOpConfig.getRoot();
+    const nnfusion::Shape& input_shape = ctx->inputs[0]->get_shape();
+    epsilon = cfg["epsilon"];
+    int axis = cfg["axis"];
+    axis += axis < 0 ? input_shape.size() : 0;
+
+    rows = 1;
+    cols = 1;
+    for (int i = 0; i < axis; i++)
+        rows *= input_shape[i];
+    for (size_t i = axis; i < input_shape.size(); i++)
+        cols *= input_shape[i];
+}
+
+LanguageUnit_p cpu::LayerNormSimd::emit_function_body()
+{
+    auto& isa = get_simd_isa();
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    lu.require(get_row_norm_kernels(isa));
+
+    // output1 and output2 keep the mean and 1 / sqrt(var + epsilon) of each row.
+    auto body = op::create_code_from_template(
+        R"(const float* x = input0 + r * @cols@;
+float mean, var;
+nnfusion_row_moments_@isa@<1>(&x, nullptr, @cols@, mean, var);
+float inv_std = 1.0f / std::sqrt(var + @epsilon@);
+nnfusion_row_normalize_@isa@(x, input1, input2, output0 + r * @cols@, @cols@, mean, inv_std);
+output1[r] = mean;
+output2[r] = inv_std;
+)",
+        {{"isa", isa.name}, {"cols", cols}, {"epsilon", epsilon}});
+    emit_row_parallel_for(lu, rows, cols, body);
+    return _lu;
+}
+
+LanguageUnit_p cpu::LayerNormSimd::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::simd);
+    _lu->require(header::cmath);
+    return _lu;
+}
+
+cpu::SkipLayerNormSimd::SkipLayerNormSimd(shared_ptr<KernelContext> ctx)
+    : SimdKernelEmitter(ctx)
+{
+    auto generic_op = static_pointer_cast<op::GenericOp>(ctx->gnode->get_op_ptr());
+    epsilon = generic_op->localOpConfig.getRoot()["epsilon"];
+    const nnfusion::Shape& input_shape = ctx->inputs[0]->get_shape();
+    rows = input_shape[0] * input_shape[1];
+    cols = input_shape[2];
+    has_bias = ctx->inputs.size() == 5;
+}
+
+LanguageUnit_p cpu::SkipLayerNormSimd::emit_function_body()
+{
+    auto& isa = get_simd_isa();
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    lu.require(get_row_norm_kernels(isa));
+
+    // input + skip (+ bias) is written to the output while its moments are accumulated, then
+    // normalized in place.
+    auto body = op::create_code_from_template(
+        R"(float* y = output0 + r * @cols@;
+const float* x[] = {input0 + r * @cols@, input1 + r * @cols@@bias@};
+float mean, var;
+nnfusion_row_moments_@isa@<@k@>(x, y, @cols@, mean, var);
+float inv_std = 1.0f / std::sqrt(var + @epsilon@);
+nnfusion_row_normalize_@isa@(y, input2, input3, y, @cols@, mean, inv_std);
+)",
+        {{"isa", isa.name},
+         {"cols", cols},
+         {"epsilon", epsilon},
+         {"bias", has_bias ? ", input4" : ""},
+         {"k", has_bias ? 3 : 2}});
+    emit_row_parallel_for(lu, rows, cols, body);
+    return _lu;
+}
+
+LanguageUnit_p cpu::SkipLayerNormSimd::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::simd);
+    _lu->require(header::cmath);
+    return _lu;
+}
+
+cpu::EmbedLayerNormSimd::EmbedLayerNormSimd(shared_ptr<KernelContext> ctx)
+    : SimdKernelEmitter(ctx)
+{
+    auto generic_op = static_pointer_cast<op::GenericOp>(ctx->gnode->get_op_ptr());
+    epsilon = generic_op->localOpConfig.getRoot()["epsilon"];
+    const nnfusion::Shape& input_ids_shape = ctx->inputs[0]->get_shape();
+    batch_size = input_ids_shape[0];
+    sequence_length = input_ids_shape[1];
+    hidden_size = ctx->inputs[2]->get_shape()[1];
+    has_mask = ctx->inputs.size() == 8;
+}
+
+LanguageUnit_p cpu::EmbedLayerNormSimd::emit_function_body()
+{
+    auto& isa = get_simd_isa();
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    lu.require(get_row_norm_kernels(isa));
+
+    auto body = op::create_code_from_template(
+        R"(float* y = output0 + r * @hidden@;
+const float* x[] = {input2 + static_cast<int64_t>(input0[r]) * @hidden@,
+                    input3 + (r % @seq@) * @hidden@,
+                    input4 + static_cast<int64_t>(input1[r]) * @hidden@};
+float mean, var;
+nnfusion_row_moments_@isa@<3>(x, y, @hidden@, mean, var);
+float inv_std = 1.0f / std::sqrt(var + @epsilon@);
+nnfusion_row_normalize_@isa@(y, input5, input6, y, @hidden@, mean, inv_std);
+)",
+        {{"isa", isa.name},
+         {"hidden", hidden_size},
+         {"seq", sequence_length},
+         {"epsilon", epsilon}});
+    emit_row_parallel_for(lu, batch_size * sequence_length, hidden_size, body);
+
+    // mask_index is the first masked position of each sequence, or the sequence length when
+    // nothing is masked (or there is no mask at all).
+    lu << "for (int64_t b = 0; b < " << batch_size << "; ++b)\n";
+    lu.block_begin();
+    lu << "int64_t index = " << sequence_length << ";\n";
+    if (has_mask)
+    {
+        lu << "for (int64_t s = 0; s < " << sequence_length << "; ++s)\n";
+        lu.block_begin();
+        lu << "if (input7[b * " << sequence_length << " + s] == 0)\n";
+        lu.block_begin();
+        lu << "index = s;\n";
+        lu << "break;\n";
+        lu.block_end();
+        lu.block_end();
+    }
+    lu << "output1[b] = index;\n";
+    lu.block_end();
+    return _lu;
+}
+
+LanguageUnit_p cpu::EmbedLayerNormSimd::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::simd);
+    _lu->require(header::cmath);
+    return _lu;
+}
+
+REGISTER_KERNEL_EMITTER("LayerNorm",
+                        Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("simd").Priority(5),
+                        cpu::LayerNormSimd)
+
+REGISTER_KERNEL_EMITTER("SkipLayerNorm",
+                        Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("simd").Priority(5),
+                        cpu::SkipLayerNormSimd)
+
+REGISTER_KERNEL_EMITTER("EmbedLayerNorm",
+                        Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("simd").Priority(5),
+                        cpu::EmbedLayerNormSimd)
@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "../cpu_helper.hpp"
+#include "../cpu_kernel_emitter.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        namespace cpu
+        {
+            // Inline row kernels shared by the normalization emitters: a single pass Welford
+            // mean/variance over the sum of K rows (the sum is stored when K > 1), and the
+            // affine normalization of one row.
+            LanguageUnit_p get_row_norm_kernels(const SimdIsa& isa);
+
+            class LayerNormSimd : public SimdKernelEmitter
+            {
+            public:
+                LayerNormSimd(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+
+            private:
+                size_t rows, cols;
+                float epsilon;
+            };
+
+            class SkipLayerNormSimd : public SimdKernelEmitter
+            {
+            public:
+                SkipLayerNormSimd(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+
+            private:
+                size_t rows, cols;
+                float epsilon;
+                bool has_bias;
+            };
+
+            class EmbedLayerNormSimd : public SimdKernelEmitter
+            {
+            public:
+                EmbedLayerNormSimd(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+
+            private:
+                size_t batch_size, sequence_length, hidden_size;
+                float epsilon;
+                bool has_mask;
+            };
+        } // namespace cpu
+    }     // namespace kernels
+} // namespace nnfusion
@@ -0,0 +1,494 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "loop_fused.hpp"
+#include "../cpu_kernelops.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::kernels;
+
+namespace
+{
+    struct LoopOp
+    {
+        const char* simd_op;
+        const char* simd_math_kernel;
+    };
+
+#define LOOP_OP(OP_NAME)                                                                           \
+    {                                                                                              \
+        #OP_NAME,                                                                                  \
+        {                                                                                          \
+            cpu::CpuOpMap<op::OP_NAME>::simd_op, cpu::CpuOpMap<op::OP_NAME>::simd_math_kernel      \
+        }                                                                                          \
+    }
+
+    // The elementwise ops of LoopFusionPass, Exp comes from the loop helpers.
+    const std::unordered_map<std::string, LoopOp>& loop_ops()
+    {
+        static const std::unordered_map<std::string, LoopOp> ops = {
+            LOOP_OP(Abs),
+            LOOP_OP(Add),
+            LOOP_OP(Divide),
+            LOOP_OP(Maximum),
+            LOOP_OP(Minimum),
+            LOOP_OP(Multiply),
+            LOOP_OP(Negative),
+            LOOP_OP(Relu),
+            LOOP_OP(Rsqrt),
+            LOOP_OP(Sqrt),
+            LOOP_OP(Square),
+            LOOP_OP(Subtract),
+            {"Exp", {"nnfusion_mm256_exp_ps", nullptr}}};
+        return ops;
+    }
+#undef LOOP_OP
+
+    // Vector instruction and identity of the reductions.
+    const std::unordered_map<std::string, std::pair<std::string, std::string>>& reductions()
+    {
+        static const std::unordered_map<std::string, std::pair<std::string, std::string>> ops = {
+            {"Sum", {"add", "0.0f"}},
+            {"Max", {"max", "-std::numeric_limits<float>::infinity()"}},
+            {"Min", {"min", "std::numeric_limits<float>::infinity()"}}};
+        return ops;
+    }
+
+    // Horizontal reductions of a vector and the Cephes expf polynomial, with |error| below 2
+    // ulp on the range where the result is a normal float.
+    LanguageUnit_p get_loop_helpers(const cpu::SimdIsa& isa)
+    {
+        static std::unordered_map<std::string, LanguageUnit_p> helpers;
+        auto it = helpers.find(isa.name);
+        if (it != helpers.end())
+            return it->second;
+
+        bool avx512 = isa.name == cpu::avx512_isa.name;
+        std::string code;
+        for (auto& reduction : {"add", "max", "min"})
+        {
+            std::string op = reduction;
+            std::string body = avx512 ? R"(
+    return _mm512_reduce_@op@_ps(x);)"
+                                      : R"(
+    __m128 v = _mm_@op@_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+    v = _mm_@op@_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_@op@_ss(v, _mm_movehdup_ps(v)));)";
+            code += op::create_code_from_template(
+                "\ninline float nnfusion@p@_reduce_@op@_ps(@vec@ x)\n{" + body + "\n}\n",
+                {{"p", isa.prefix}, {"vec", isa.vec}, {"op", op}});
+        }
+        code += op::create_code_from_template(
+            R"(
+inline @vec@ nnfusion@p@_exp_ps(@vec@ x)
+{
+    // exp(x) = 2^n * exp(g), n = round(x / ln(2)), ln(2) is split in two for an exact g
+    x = @p@_min_ps(@p@_max_ps(x, @p@_set1_ps(-87.3365447f)), @p@_set1_ps(88.0f));
+    @vec@ n = @p@_add_ps(@p@_mul_ps(x, @p@_set1_ps(1.44269504f)), @p@_set1_ps(0.5f));
+    n = @floor@;
+    @vec@ g = @p@_sub_ps(x, @p@_mul_ps(n, @p@_set1_ps(0.693359375f)));
+    g = @p@_add_ps(g, @p@_mul_ps(n, @p@_set1_ps(2.12194440e-4f)));
+    @vec@ y = @p@_set1_ps(1.9875691500e-4f);
+    y = @p@_add_ps(@p@_mul_ps(y, g), @p@_set1_ps(1.3981999507e-3f));
+    y = @p@_add_ps(@p@_mul_ps(y, g), @p@_set1_ps(8.3334519073e-3f));
+    y = @p@_add_ps(@p@_mul_ps(y, g), @p@_set1_ps(4.1665795894e-2f));
+    y = @p@_add_ps(@p@_mul_ps(y, g), @p@_set1_ps(1.6666665459e-1f));
+    y = @p@_add_ps(@p@_mul_ps(y, g), @p@_set1_ps(5.0000001201e-1f));
+    y = @p@_add_ps(@p@_mul_ps(y, @p@_mul_ps(g, g)), @p@_add_ps(g, @p@_set1_ps(1.0f)));
+    @vec@i e = @p@_slli_epi32(@p@_add_epi32(@p@_cvtps_epi32(n), @p@_set1_epi32(127)), 23);
+    return @p@_mul_ps(y, @p@_castsi@bits@_ps(e));
+}
+)",
+            {{"p", isa.prefix},
+             {"vec", isa.vec},
+             {"bits", avx512 ? "512" : "256"},
+             {"floor",
+              avx512 ? "_mm512_roundscale_ps(n, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)"
+                     : "_mm256_floor_ps(n)"}});
+
+        LanguageUnit_p lu(new LanguageUnit("declaration::nnfusion_loop_helpers_" + isa.name, code));
+        lu->require(header::simd);
+        helpers[isa.name] = lu;
+        return lu;
+    }
+}
+
+cpu::LoopFused::LoopFused(shared_ptr<KernelContext> ctx)
+    : SimdKernelEmitter(ctx)
+    , m_rows(0)
+    , m_cols(0)
+    , m_sweeps(0)
+{
+    analyze();
+}
+
+void cpu::LoopFused::analyze()
+{
+    auto fused_node = static_pointer_cast<graph::FusedGNode>(m_context->gnode);
+    auto& op_contexts = fused_node->get_op_contexts();
+    for (auto& ctx : op_contexts)
+    {
+        if (reductions().count(ctx->op->get_op_type()))
+        {
+            m_rows = shape_size(ctx->outputs[0]->get_shape());
+            m_cols = shape_size(ctx->inputs[0]->get_shape()) / m_rows;
+            break;
+        }
+    }
+    NNFUSION_CHECK(m_cols > 0) << "LoopFused needs a reduction: " << m_context->gnode->get_name();
+
+    auto& isa = get_simd_isa();
+    for (size_t i = 0; i < m_context->inputs.size(); ++i)
+    {
+        auto& tensor = m_context->inputs[i];
+        std::string input = "input" + std::to_string(i);
+        Value value;
+        size_t size = shape_size(tensor->get_shape());
+        if (size == m_rows * m_cols)
+        {
+            value.vec = isa.prefix + "_loadu_ps(" + input + " + r * " + std::to_string(m_cols) +
+                        " + c)";
+            value.tail =
+                isa.prefix + "_set1_ps(" + input + "[r * " + std::to_string(m_cols) + " + c])";
+        }
+        else
+        {
+            // Other sizes are only read by broadcasts.
+            value.row = true;
+            value.scalar = input + "[r]";
+        }
+        m_values[tensor->get_name()] = value;
+        m_inputs[tensor->get_name()] = input;
+    }
+
+    for (auto& ctx : op_contexts)
+    {
+        auto op_type = ctx->op->get_op_type();
+        auto& output = ctx->outputs[0];
+        if (op_type == "Reshape")
+        {
+            m_values[output->get_name()] = value_of(ctx->inputs[0]->get_name());
+            continue;
+        }
+
+        Step step;
+        step.ctx = ctx;
+        step.var = "t" + std::to_string(m_steps.size());
+        Value value;
+        if (op_type == "Broadcast")
+        {
+            value = broadcast_value(step);
+        }
+        else if (reductions().count(op_type))
+        {
+            auto& input = value_of(ctx->inputs[0]->get_name());
+            NNFUSION_CHECK(!input.row && shape_size(output->get_shape()) == m_rows);
+            value.row = true;
+            value.sweep = input.sweep + 1;
+            value.scalar = step.var;
+            m_sweeps = std::max(m_sweeps, value.sweep);
+        }
+        else
+        {
+            auto it = loop_ops().find(op_type);
+            NNFUSION_CHECK(it != loop_ops().end()) << "LoopFused does not support " << op_type;
+            bool has_math_kernel = it->second.simd_math_kernel != nullptr;
+            step.func = translate_simd_op(it->second.simd_op, has_math_kernel, isa);
+            if (has_math_kernel)
+            {
+                std::vector<std::string> data_types(ctx->inputs.size() + 1, "float");
+                auto math_kernel = get_simd_math_kernel(
+                    step.func,
+                    translate_simd_math_kernel(it->second.simd_math_kernel, isa),
+                    shape_size(output->get_shape()),
+                    data_types,
+                    isa.vec);
+                NNFUSION_CHECK_NOT_NULLPTR(math_kernel);
+                m_math_kernels.push_back(math_kernel);
+            }
+
+            value.row = shape_size(output->get_shape()) != m_rows * m_cols;
+            for (auto& input : ctx->inputs)
+            {
+                auto& in_value = value_of(input->get_name());
+                NNFUSION_CHECK(in_value.row == value.row);
+                value.sweep = std::max(value.sweep, in_value.sweep);
+            }
+            if (value.row)
+                value.scalar = step.var;
+            else
+                value.vec = value.tail = step.var;
+        }
+        m_values[output->get_name()] = value;
+        m_producers[output->get_name()] = m_steps.size();
+        m_steps.push_back(step);
+    }
+
+    // A full output is written by the sweep which can compute it.
+    for (auto& output : m_context->outputs)
+    {
+        auto& value = value_of(output->get_name());
+        if (!value.row)
+            m_sweeps = std::max(m_sweeps, value.sweep + 1);
+    }
+}
+
+const cpu::LoopFused::Value& cpu::LoopFused::value_of(const std::string& tensor) const
+{
+    auto it = m_values.find(tensor);
+    NNFUSION_CHECK(it != m_values.end()) << "LoopFused has no value of " << tensor;
+    return it->second;
+}
+
+cpu::LoopFused::Value cpu::LoopFused::broadcast_value(const Step& step) const
+{
+    auto& isa = get_simd_isa();
+    auto broadcast = static_pointer_cast<op::Broadcast>(step.ctx->op);
+    auto& in_tensor = step.ctx->inputs[0];
+    auto& out_shape = step.ctx->outputs[0]->get_shape();
+    size_t in_size = shape_size(in_tensor->get_shape());
+    auto input = m_inputs.find(in_tensor->get_name());
+    bool external = input != m_inputs.end();
+
+    Value value;
+    if (in_size == 1 && external)
+    {
+        if (shape_size(out_shape) == m_rows)
+        {
+            value.row = true;
+            value.scalar = input->second + "[0]";
+        }
+        else
+        {
+            value.vec = value.tail = isa.prefix + "_set1_ps(" + input->second + "[0])";
+        }
+        return value;
+    }
+
+    NNFUSION_CHECK(shape_size(out_shape) == m_rows * m_cols);
+    if (*broadcast->get_broadcast_axes().rbegin() + 1 == out_shape.size())
+    {
+        // a value per row
+        auto& in_value = value_of(in_tensor->get_name());
+        NNFUSION_CHECK(in_value.row && in_size == m_rows);
+        value.sweep = in_value.sweep;
+        value.vec = value.tail = isa.prefix + "_set1_ps(" + in_value.scalar + ")";
+    }
+    else
+    {
+        // a tensor repeated over the leading axes
+        NNFUSION_CHECK(external && in_size % m_cols == 0);
+        std::string offset = "(r % " + std::to_string(in_size / m_cols) + ") * " +
+                             std::to_string(m_cols) + " + c";
+        value.vec = isa.prefix + "_loadu_ps(" + input->second + " + " + offset + ")";
+        value.tail = isa.prefix + "_set1_ps(" + input->second + "[" + offset + "])";
+    }
+    return value;
+}
+
+void cpu::LoopFused::mark_needed(const std::string& tensor, std::vector<bool>& needed) const
+{
+    auto it = m_producers.find(tensor);
+    if (it == m_producers.end() || needed[it->second] || value_of(tensor).row)
+        return;
+    auto& step = m_steps[it->second];
+    needed[it->second] = true;
+    for (auto& input : step.ctx->inputs)
+        mark_needed(input->get_name(), needed);
+}
+
+std::string cpu::LoopFused::emit_sweep(int sweep, bool tail) const
+{
+    auto& isa = get_simd_isa();
+    std::vector<bool> needed(m_steps.size(), false);
+    for (auto& step : m_steps)
+    {
+        auto& input = step.ctx->inputs[0]->get_name();
+        if (reductions().count(step.ctx->op->get_op_type()) && value_of(input).sweep == sweep)
+            mark_needed(input, needed);
+    }
+    for (auto& output : m_context->outputs)
+    {
+        auto& value = value_of(output->get_name());
+        if (!value.row && value.sweep == sweep)
+            mark_needed(output->get_name(), needed);
+    }
+
+    std::stringstream ss;
+    for (size_t i = 0; i < m_steps.size(); ++i)
+    {
+        auto& step = m_steps[i];
+        auto op_type = step.ctx->op->get_op_type();
+        auto reduction = reductions().find(op_type);
+        if (reduction != reductions().end())
+        {
+            auto& input = value_of(step.ctx->inputs[0]->get_name());
+            if (input.sweep != sweep)
+                continue;
+            if (!tail)
+            {
+                ss << "acc_" << step.var << " = " << isa.prefix << "_" << reduction->second.first
+                   << "_ps(acc_" << step.var << ", " << input.vec << ");\n";
+            }
+            else
+            {
+                std::string lane = isa.prefix + "_cvtss_f32(" + input.tail + ")";
+                if (op_type == "Sum")
+                    ss << step.var << " += " << lane << ";\n";
+                else
+                    ss << step.var << " = std::" << reduction->second.first << "(" << step.var
+                       << ", " << lane << ");\n";
+            }
+        }
+        else if (needed[i] && !step.func.empty())
+        {
+            std::vector<std::string> args;
+            for (auto& input : step.ctx->inputs)
+            {
+                auto& value = value_of(input->get_name());
+                args.push_back(tail ? value.tail : value.vec);
+            }
+            ss << isa.vec << " " << step.var << " = " << step.func << "(" << join(args, ", ")
+               << ");\n";
+        }
+    }
+
+    for (size_t i = 0; i < m_context->outputs.size(); ++i)
+    {
+        auto& value = value_of(m_context->outputs[i]->get_name());
+        if (value.row || value.sweep != sweep)
+            continue;
+        std::string output = "output" + std::to_string(i) + " + r * " + std::to_string(m_cols);
+        if (!tail)
+            ss << isa.prefix << "_storeu_ps(" << output << " + c, " << value.vec << ");\n";
+        else
+            ss << "*(" << output << " + c) = " << isa.prefix << "_cvtss_f32(" << value.tail
+               << ");\n";
+    }
+    return ss.str();
+}
+
+LanguageUnit_p cpu::LoopFused::emit_function_body()
+{
+    auto& isa = get_simd_isa();
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    lu.require(get_loop_helpers(isa));
+    for (auto& math_kernel : m_math_kernels)
+    {
+        auto helpers = get_simd_helpers(isa);
+        if (helpers != nullptr)
+            math_kernel->require(helpers);
+        lu.require(math_kernel);
+    }
+
+    size_t vec_cols = m_cols - m_cols % isa.width;
+    LanguageUnit body("row");
+    for (int sweep = 0; sweep <= m_sweeps; ++sweep)
+    {
+        // the values per row which this sweep reads
+        for (auto& step : m_steps)
+        {
+            auto& value = value_of(step.ctx->outputs[0]->get_name());
+            if (!value.row || value.sweep != sweep || step.func.empty())
+                continue;
+            std::vector<std::string> args;
+            for (auto& input : step.ctx->inputs)
+                args.push_back(isa.prefix + "_set1_ps(" + value_of(input->get_name()).scalar +
+                               ")");
+            body << "float " << step.var << " = " << isa.prefix << "_cvtss_f32(" << step.func
+                 << "(" << join(args, ", ") << "));\n";
+        }
+        for (size_t i = 0; i < m_context->outputs.size(); ++i)
+        {
+            auto& value = value_of(m_context->outputs[i]->get_name());
+            if (value.row && value.sweep == sweep)
+                body << "output" << i << "[r] = " << value.scalar << ";\n";
+        }
+        if (sweep == m_sweeps)
+            break;
+
+        std::vector<const Step*> sweep_reductions;
+        for (auto& step : m_steps)
+        {
+            auto reduction = reductions().find(step.ctx->op->get_op_type());
+            if (reduction == reductions().end() ||
+                value_of(step.ctx->inputs[0]->get_name()).sweep != sweep)
+                continue;
+            sweep_reductions.push_back(&step);
+            body << isa.vec << " acc_" << step.var << " = " << isa.prefix << "_set1_ps("
+                 << reduction->second.second << ");\n";
+        }
+        if (vec_cols > 0)
+        {
+            body << "for (int64_t c = 0; c < " << vec_cols << "; c += " << isa.width << ")\n";
+            body.block_begin();
+            body << emit_sweep(sweep, false);
+            body.block_end();
+        }
+        for (auto step : sweep_reductions)
+        {
+            body << "float " << step->var << " = nnfusion" << isa.prefix << "_reduce_"
+                 << reductions().at(step->ctx->op->get_op_type()).first << "_ps(acc_"
+                 << step->var << ");\n";
+        }
+        if (vec_cols < m_cols)
+        {
+            body << "for (int64_t c = " << vec_cols << "; c < " << m_cols << "; ++c)\n";
+            body.block_begin();
+            body << emit_sweep(sweep, true);
+            body.block_end();
+        }
+    }
+    emit_row_parallel_for(lu, m_rows, m_cols * m_sweeps, body.get_code());
+
+    return _lu;
+}
+
+LanguageUnit_p cpu::LoopFused::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::simd);
+    _lu->require(header::limits);
+    _lu->require(header::algorithm);
+
+    return _lu;
+}
+
+LanguageUnit_p cpu::LoopFused::emit_comments()
+{
+    LanguageUnit_p _lu(new LanguageUnit(this->m_kernel_name + "_comments"));
+    auto& lu = *_lu;
+    lu << "// Node name:\t" << m_context->gnode->get_name() << "\n";
+    lu << "// Loop fusion of " << m_rows << " rows of " << m_cols << " columns, " << m_sweeps
+       << " sweeps per row\n";
+    lu << "// Input:\n";
+    for (auto in : m_context->inputs)
+    {
+        lu << "//\t- name: " << in->get_name();
+        lu << "\ttype: " << in->get_element_type().c_type_string();
+        lu << "\tshape: " << in->get_shape();
+        lu << "\n";
+    }
+    lu << "// Output:\n";
+    for (auto out : m_context->outputs)
+    {
+        lu << "//\t- name: " << out->get_name();
+        lu << "\ttype: " << out->get_element_type().c_type_string();
+        lu << "\tshape: " << out->get_shape();
+        lu << "\n";
+    }
+    lu << "// Fused ops:\n";
+    for (auto& step : m_steps)
+    {
+        lu << "//\t- " << step.var << " = " << step.ctx->op->get_op_type() << "\n";
+    }
+
+    return _lu;
+}
+
+REGISTER_KERNEL_EMITTER(
+    "LoopFused",                                                              // op_name
+    Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("simd").Priority(5), // attrs
+    cpu::LoopFused)                                                           // constructor
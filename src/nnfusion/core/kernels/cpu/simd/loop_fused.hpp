@@ -0,0 +1,64 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "../cpu_helper.hpp"
+#include "../cpu_kernel_emitter.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        namespace cpu
+        {
+            // A group of LoopFusionPass: reductions over the last cols elements of rows, with the
+            // elementwise ops, broadcasts and reshapes around them. Each thread takes a block of
+            // rows, and every row is swept once per reduction; the ops a sweep needs are
+            // recomputed instead of written out, so that a row is only read from memory once as
+            // long as it stays in cache.
+            class LoopFused : public SimdKernelEmitter
+            {
+            public:
+                LoopFused(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+                LanguageUnit_p emit_comments() override;
+
+            private:
+                // A tensor of the group, either a full tensor which is a vector expression in the
+                // loop over the columns of a row, or a float per row. sweep is the first sweep of
+                // a row where it can be computed, or for values per row, read.
+                struct Value
+                {
+                    bool row = false;
+                    int sweep = 0;
+                    std::string vec, tail, scalar;
+                };
+
+                struct Step
+                {
+                    std::shared_ptr<graph::OpContext> ctx;
+                    // the vector function of an elementwise op, empty for reductions
+                    std::string func;
+                    std::string var;
+                };
+
+                void analyze();
+                const Value& value_of(const std::string& tensor) const;
+                Value broadcast_value(const Step& step) const;
+                void mark_needed(const std::string& tensor, std::vector<bool>& needed) const;
+                std::string emit_sweep(int sweep, bool tail) const;
+
+                size_t m_rows, m_cols;
+                int m_sweeps;
+                std::vector<Step> m_steps;
+                std::unordered_map<std::string, Value> m_values;
+                std::unordered_map<std::string, size_t> m_producers;
+                // the input arg of each input tensor
+                std::unordered_map<std::string, std::string> m_inputs;
+                std::vector<LanguageUnit_p> m_math_kernels;
+            };
+        } // namespace cpu
+    }     // namespace kernels
+} // namespace nnfusion
@@ -0,0 +1,135 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <iomanip>
+
+#include "quantize_linear.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::kernels;
+
+LanguageUnit_p cpu::get_quantize_u8_kernel(const SimdIsa& isa)
+{
+    static std::unordered_map<std::string, LanguageUnit_p> kernels;
+    auto it = kernels.find(isa.name);
+    if (it != kernels.end())
+        return it->second;
+
+    std::string code;
+    if (isa.name == avx512_isa.name)
+    {
+        code = R"(
+inline void nnfusion_quantize_u8_avx512(__m512 x, uint8_t* y)
+{
+    _mm_storeu_si128((__m128i*)y, _mm512_cvtusepi32_epi8(_mm512_cvtps_epi32(x)));
+}
+)";
+    }
+    else
+    {
+        code = R"(
+inline void nnfusion_quantize_u8_avx2(__m256 x, uint8_t* y)
+{
+    __m256i i32 = _mm256_cvtps_epi32(x);
+    __m128i i16 = _mm_packus_epi32(_mm256_castsi256_si128(i32), _mm256_extracti128_si256(i32, 1));
+    _mm_storel_epi64((__m128i*)y, _mm_packus_epi16(i16, i16));
+}
+)";
+    }
+
+    LanguageUnit_p lu(new LanguageUnit("declaration::nnfusion_quantize_u8_" + isa.name, code));
+    lu->require(header::simd);
+    kernels[isa.name] = lu;
+    return lu;
+}
+
+cpu::QuantizeLinearSimd::QuantizeLinearSimd(shared_ptr<KernelContext> ctx)
+    : SimdKernelEmitter(ctx)
+{
+    auto generic_op = static_pointer_cast<nnfusion::op::GenericOp>(ctx->gnode->get_op_ptr());
+    m_scale = generic_op->localOpConfig.getRoot()["scale"];
+    m_zero_point = generic_op->localOpConfig.getRoot()["zero_point"];
+    m_data_size = ctx->inputs[0]->size(false);
+
+    std::stringstream tag;
+    tag << "Simd_quantize_linear_s_" << m_scale << "_z_" << m_zero_point;
+    custom_tag = tag.str();
+}
+
+LanguageUnit_p cpu::QuantizeLinearSimd::emit_function_body()
+{
+    auto& isa = get_simd_isa();
+    size_t remainder_count = m_data_size % isa.width;
+    size_t loop_count = m_data_size - remainder_count;
+    size_t shard_data_count = m_data_size / isa.width;
+
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+    auto& lu = *_lu;
+    lu.require(get_quantize_u8_kernel(isa));
+
+    // Multiplying by the reciprocal may differ from x / scale in the last bit, which only moves
+    // values within half an ulp of a rounding boundary.
+    std::stringstream constants;
+    constants << std::scientific << std::setprecision(9);
+    constants << "const float inv_scale = " << 1.0f / m_scale << "f;\n";
+    constants << "const float zero_point = " << m_zero_point << ".0f;\n";
+    lu << constants.str();
+    if (loop_count > 0)
+    {
+        lu << "const int64_t min_cost_per_shard = 10000;\n";
+        lu << "int num_shards = "
+           << "std::max(std::min(static_cast<int64_t>("
+           << "thread_pool->NumThreads()), " << loop_count
+           << "/ min_cost_per_shard), static_cast<int64_t>(1));\n";
+        lu << "const int64_t block_size = (" << shard_data_count
+           << " + num_shards - 1) / num_shards;\n";
+        lu << "if (block_size > " << shard_data_count << ")\n";
+        lu.block_begin();
+        lu << "num_shards = 1;\n";
+        lu.block_end();
+
+        lu << "auto func = [&](int __rank__)\n";
+        lu << "{\n";
+        lu << isa.vec << " scale_vec = " << isa.prefix << "_set1_ps(inv_scale);\n";
+        lu << isa.vec << " zero_vec = " << isa.prefix << "_set1_ps(zero_point);\n";
+        lu << isa.vec << " lower = " << isa.prefix << "_setzero_ps();\n";
+        lu << isa.vec << " upper = " << isa.prefix << "_set1_ps(255.0f);\n";
+        lu << "int64_t start = block_size * __rank__ * " << isa.width << ";\n";
+        lu << "int64_t end = std::min(block_size * (__rank__ + 1), "
+              "static_cast<int64_t>("
+           << shard_data_count << ")) * " << isa.width << ";\n";
+        lu << "for (size_t i = start; i < end; i+=" << isa.width << ")\n";
+        lu.block_begin();
+        lu << emit_simd_load(isa, "float", "input0 + i", "in0");
+        lu << isa.vec << " q = " << isa.prefix << "_fmadd_ps(in0, scale_vec, zero_vec);\n";
+        lu << "q = " << isa.prefix << "_min_ps(" << isa.prefix << "_max_ps(q, lower), upper);\n";
+        lu << "nnfusion_quantize_u8_" << isa.name << "(q, output0 + i);\n";
+        lu.block_end();
+        lu << "};\n";
+        lu << "thread_pool->ParallelFor(num_shards, func);\n";
+    }
+
+    if (remainder_count > 0)
+    {
+        lu << "for (size_t i = " << loop_count << "; i < " << m_data_size << "; i++)\n";
+        lu.block_begin();
+        lu << "float q = std::nearbyint(input0[i] * inv_scale + zero_point);\n";
+        lu << "output0[i] = static_cast<uint8_t>(std::min(std::max(q, 0.0f), 255.0f));\n";
+        lu.block_end();
+    }
+
+    return _lu;
+}
+
+LanguageUnit_p cpu::QuantizeLinearSimd::emit_dependency()
+{
+    LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
+    _lu->require(header::simd);
+    _lu->require(header::cmath);
+    return _lu;
+}
+
+REGISTER_KERNEL_EMITTER("QuantizeLinear",
+                        Device(GENERIC_CPU).TypeConstraint(element::f32).Tag("simd").Priority(5),
+                        cpu::QuantizeLinearSimd)
@@ -0,0 +1,33 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "../cpu_helper.hpp"
+#include "../cpu_kernel_emitter.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        namespace cpu
+        {
+            // Round a vector already scaled and clamped to [0, 255] to nearest even and store it
+            // as isa.width uint8 values.
+            LanguageUnit_p get_quantize_u8_kernel(const SimdIsa& isa);
+
+            class QuantizeLinearSimd : public SimdKernelEmitter
+            {
+            public:
+                QuantizeLinearSimd(shared_ptr<KernelContext> ctx);
+
+                LanguageUnit_p emit_function_body() override;
+                LanguageUnit_p emit_dependency() override;
+
+            private:
+                size_t m_data_size;
+                float m_scale;
+                int m_zero_point;
+            };
+        } // namespace cpu
+    }     // namespace kernels
+} // namespace nnfusion
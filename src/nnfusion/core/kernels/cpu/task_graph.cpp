@@ -0,0 +1,248 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "task_graph.hpp"
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        LanguageUnit_p task_graph_header = LanguageUnit_p(new LanguageUnit("task_graph.h",
+                                                                           R"(
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nnfusion
+{
+    namespace cpu
+    {
+        // TaskGraphExecutor runs a static task graph. Task i becomes ready once its
+        // dep_count[i] predecessors have finished, and its successors are
+        // succ[succ_offset[i]] ... succ[succ_offset[i + 1] - 1].
+        // Every worker owns a deque: it pushes the tasks it makes ready to the back and pops
+        // from the back, idle workers steal from the front of the other deques. Workers with
+        // nothing to pop or steal sleep until a task is pushed or the graph completes, so that
+        // they leave the cores to the intra-op thread pools of the running kernels.
+        class TaskGraphExecutor
+        {
+        public:
+            TaskGraphExecutor(int num_tasks,
+                              const int* dep_count,
+                              const int* succ_offset,
+                              const int* succ,
+                              int num_threads = 0)
+                : num_tasks_(num_tasks)
+                , dep_count_(dep_count)
+                , succ_offset_(succ_offset)
+                , succ_(succ)
+                , pending_deps_(new std::atomic<int>[num_tasks > 0 ? num_tasks : 1])
+                , remaining_(0)
+                , queued_(0)
+                , sleeping_(0)
+                , active_(0)
+                , generation_(0)
+                , shutdown_(false)
+                , run_task_(nullptr)
+            {
+                if (num_threads <= 0)
+                    num_threads = std::thread::hardware_concurrency();
+                if (num_threads <= 0)
+                    num_threads = 1;
+                for (int i = 0; i < num_threads; i++)
+                    queues_.emplace_back(new WorkQueue());
+                for (int i = 1; i < num_threads; i++)
+                    threads_.emplace_back(&TaskGraphExecutor::WorkerLoop, this, i);
+            }
+
+            ~TaskGraphExecutor()
+            {
+                {
+                    std::lock_guard<std::mutex> l(mu_);
+                    shutdown_ = true;
+                }
+                cv_.notify_all();
+                for (auto& t : threads_)
+                    t.join();
+            }
+
+            // Run every task once, the calling thread works as worker 0.
+            void Run(const std::function<void(int)>& run_task)
+            {
+                if (num_tasks_ == 0)
+                    return;
+                run_task_ = &run_task;
+                for (int i = 0; i < num_tasks_; i++)
+                    pending_deps_[i].store(dep_count_[i], std::memory_order_relaxed);
+                // Set before any push, a worker waking late from the previous run may already
+                // take part in this one.
+                remaining_.store(num_tasks_);
+                int worker = 0;
+                for (int i = 0; i < num_tasks_; i++)
+                {
+                    if (dep_count_[i] == 0)
+                    {
+                        Push(worker, i);
+                        worker = (worker + 1) % queues_.size();
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> l(mu_);
+                    generation_++;
+                }
+                cv_.notify_all();
+
+                Work(0);
+                // Wait for the workers still leaving Work(), the next run resets the counters.
+                std::unique_lock<std::mutex> l(mu_);
+                idle_cv_.wait(l, [&] { return active_ == 0; });
+            }
+
+        private:
+            struct WorkQueue
+            {
+                std::mutex mu;
+                std::deque<int> tasks;
+            };
+
+            void Push(int worker, int task)
+            {
+                {
+                    std::lock_guard<std::mutex> l(queues_[worker]->mu);
+                    queues_[worker]->tasks.push_back(task);
+                }
+                // queued_ and sleeping_ are sequentially consistent: either a sleeping worker
+                // is seen here, or it sees the task before it waits.
+                queued_.fetch_add(1);
+                if (sleeping_.load() > 0)
+                    Wake(false);
+            }
+
+            bool Pop(int worker, int& task)
+            {
+                std::lock_guard<std::mutex> l(queues_[worker]->mu);
+                if (queues_[worker]->tasks.empty())
+                    return false;
+                task = queues_[worker]->tasks.back();
+                queues_[worker]->tasks.pop_back();
+                queued_.fetch_sub(1);
+                return true;
+            }
+
+            bool Steal(int worker, int& task)
+            {
+                int n = queues_.size();
+                for (int k = 1; k < n; k++)
+                {
+                    auto& victim = queues_[(worker + k) % n];
+                    std::lock_guard<std::mutex> l(victim->mu);
+                    if (!victim->tasks.empty())
+                    {
+                        task = victim->tasks.front();
+                        victim->tasks.pop_front();
+                        queued_.fetch_sub(1);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // Taking the lock orders the notification after the predicate check of a worker
+            // about to wait.
+            void Wake(bool all)
+            {
+                {
+                    std::lock_guard<std::mutex> l(work_mu_);
+                }
+                if (all)
+                    work_cv_.notify_all();
+                else
+                    work_cv_.notify_one();
+            }
+
+            void Work(int worker)
+            {
+                int task;
+                while (true)
+                {
+                    if (Pop(worker, task) || Steal(worker, task))
+                    {
+                        (*run_task_)(task);
+                        for (int s = succ_offset_[task]; s < succ_offset_[task + 1]; s++)
+                        {
+                            int next = succ_[s];
+                            if (pending_deps_[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                                Push(worker, next);
+                        }
+                        if (remaining_.fetch_sub(1) == 1)
+                            Wake(true);
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> l(work_mu_);
+                    sleeping_.fetch_add(1);
+                    work_cv_.wait(l, [&] { return queued_.load() > 0 || remaining_.load() == 0; });
+                    sleeping_.fetch_sub(1);
+                    if (remaining_.load() == 0)
+                        return;
+                }
+            }
+
+            void WorkerLoop(int worker)
+            {
+                unsigned long long seen = 0;
+                while (true)
+                {
+                    {
+                        std::unique_lock<std::mutex> l(mu_);
+                        cv_.wait(l, [&] { return shutdown_ || generation_ != seen; });
+                        if (shutdown_)
+                            return;
+                        seen = generation_;
+                        active_++;
+                    }
+                    Work(worker);
+                    {
+                        std::lock_guard<std::mutex> l(mu_);
+                        active_--;
+                    }
+                    idle_cv_.notify_one();
+                }
+            }
+
+            int num_tasks_;
+            const int* dep_count_;
+            const int* succ_offset_;
+            const int* succ_;
+            std::unique_ptr<std::atomic<int>[]> pending_deps_;
+            std::atomic<int> remaining_;
+            // Tasks in the deques, and workers waiting for one.
+            std::atomic<int> queued_;
+            std::atomic<int> sleeping_;
+            // Workers inside Work(), guarded by mu_.
+            int active_;
+            std::vector<std::unique_ptr<WorkQueue>> queues_;
+            std::vector<std::thread> threads_;
+            // mu_ and cv_ start the workers on a new run, idle_cv_ tells Run() they are done.
+            std::mutex mu_;
+            std::condition_variable cv_;
+            std::condition_variable idle_cv_;
+            // work_mu_ and work_cv_ wake the workers when a task is pushed or the run completes.
+            std::mutex work_mu_;
+            std::condition_variable work_cv_;
+            unsigned long long generation_;
+            bool shutdown_;
+            const std::function<void(int)>* run_task_;
+        };
+    }
+}
+)"));
+    }
+}
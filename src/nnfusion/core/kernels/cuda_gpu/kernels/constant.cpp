@@ -7,6 +7,7 @@
 
 #include "../cuda_emitter.hpp"
 #include "../cuda_langunit.hpp"
+#include "nnfusion/core/kernels/weight_pack.hpp"
 #include "nnfusion/core/operators/generic_op/generic_op.hpp"
 
 namespace nnfusion
@@ -33,8 +34,23 @@ namespace nnfusion
 
                 LanguageUnit_p emit_function_body() override
                 {
-                    nnfusion::codegen::create_folder(folder);
                     const_name = m_context->outputs[0]->get_name();
+                    if (FLAGS_fpack_constants)
+                    {
+                        // nnfusion_weights is the device copy of the packed weight file,
+                        // uploaded by one H2D copy in cuda_init().
+                        size_t offset =
+                            WeightPack::Global()->add(const_name, op->get_storage());
+                        LanguageUnit_p _lu(new LanguageUnit(get_function_name()));
+                        auto& writer = *_lu;
+                        writer << "if ((char*)output0 != nnfusion_weights + " << offset << ")\n"
+                               << "    cudaMemcpyAsync(output0, nnfusion_weights + " << offset
+                               << ", " << op->get_data_size()
+                               << ", cudaMemcpyDeviceToDevice, stream);\n";
+                        return _lu;
+                    }
+
+                    nnfusion::codegen::create_folder(folder);
                     ofstream bin_file(folder + const_name + ".bin", ios::out | ios::binary);
                     bin_file.write((const char*)op->get_data_ptr(), op->get_data_size());
                     bin_file.close();
@@ -66,6 +82,8 @@ namespace nnfusion
                     LanguageUnit_p _lu(new LanguageUnit(get_function_name() + "_dep"));
                     _lu->require(header::cuda);
                     _lu->require(header::fstream);
+                    if (FLAGS_fpack_constants)
+                        _lu->require(declaration::nnfusion_weights);
                     return _lu;
                 }
 
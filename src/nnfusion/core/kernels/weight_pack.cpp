@@ -0,0 +1,108 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <cstring>
+
+#include "weight_pack.hpp"
+
+DEFINE_bool(fpack_constants,
+            false,
+            "Pack all constants into one aligned weight file which is mapped by the runtime.");
+
+using namespace nnfusion::kernels;
+
+const size_t WeightPack::alignment;
+const std::string WeightPack::folder = "./Constant/";
+const std::string WeightPack::blob_name = "weights.bin";
+const std::string WeightPack::index_name = "weights.idx";
+
+size_t WeightPack::add(const std::string& name, const std::shared_ptr<op::ConstantData>& data)
+{
+    size_t size = data->size();
+    std::string key = m_scope + name;
+    auto it = m_index.find(key);
+    if (it != m_index.end())
+    {
+        NNFUSION_CHECK(it->second.size == size) << "Constant " << key
+                                                << " is packed twice with different sizes.";
+        return it->second.offset;
+    }
+
+    if (!m_blob.is_open())
+    {
+        // A blob closed by save() is appended to, e.g. by the next bucket of a multi-shape
+        // runtime.
+        NNFUSION_CHECK(nnfusion::codegen::create_folder(folder));
+        auto mode = std::ios::in | std::ios::out | std::ios::binary;
+        m_blob.open(folder + blob_name, m_size > 0 ? mode : mode | std::ios::trunc);
+        NNFUSION_CHECK(m_blob.good()) << "Failed to open " << folder + blob_name;
+    }
+
+    size_t hash = data->hash();
+    auto range = m_by_hash.equal_range(hash);
+    for (auto same = range.first; same != range.second; ++same)
+    {
+        if (blob_equals(same->second, *data))
+        {
+            m_index[key] = same->second;
+            m_names.push_back(key);
+            return same->second.offset;
+        }
+    }
+
+    size_t offset = m_size;
+    m_blob.seekp(m_size);
+    m_blob.write((const char*)data->data(), size);
+    m_size += size;
+    size_t padding = (alignment - m_size % alignment) % alignment;
+    if (padding > 0)
+    {
+        std::vector<char> zeros(padding, 0);
+        m_blob.write(zeros.data(), padding);
+        m_size += padding;
+    }
+
+    m_index[key] = Entry{offset, size};
+    m_names.push_back(key);
+    m_by_hash.emplace(hash, Entry{offset, size});
+    return offset;
+}
+
+bool WeightPack::blob_equals(const Entry& entry, const op::ConstantData& data)
+{
+    if (entry.size != data.size())
+        return false;
+    std::vector<char> packed(entry.size);
+    m_blob.flush();
+    m_blob.seekg(entry.offset);
+    m_blob.read(packed.data(), entry.size);
+    NNFUSION_CHECK(m_blob.good()) << "Failed to read " << folder + blob_name;
+    return std::memcmp(packed.data(), data.data(), entry.size) == 0;
+}
+
+const WeightPack::Entry& WeightPack::get(const std::string& name) const
+{
+    auto it = m_index.find(m_scope + name);
+    NNFUSION_CHECK(it != m_index.end()) << "Constant " << m_scope + name << " is not packed.";
+    return it->second;
+}
+
+void WeightPack::save()
+{
+    if (empty())
+        return;
+    // Closed before the codegen moves the folder away.
+    if (m_blob.is_open())
+        m_blob.close();
+    NNFUSION_CHECK(!m_blob.fail()) << "Failed to write " << folder + blob_name;
+
+    std::ofstream index_file(folder + index_name, std::ios::out | std::ios::trunc);
+    for (auto& name : m_names)
+    {
+        auto& entry = m_index[name];
+        index_file << name << " " << entry.offset << " " << entry.size << "\n";
+    }
+    index_file.close();
+    NNFUSION_LOG(INFO) << "Packed " << m_names.size() << " constants into " << folder + blob_name
+                       << " (" << m_size << " bytes).";
+}
@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "nnfusion/common/common.hpp"
+#include "nnfusion/core/operators/op_define/constant.hpp"
+
+DECLARE_bool(fpack_constants);
+
+namespace nnfusion
+{
+    namespace kernels
+    {
+        /// \brief WeightPack gathers the data of all Constant kernels into a single aligned
+        /// blob (Constant/weights.bin) plus a text index (Constant/weights.idx, one
+        /// "name offset size" line per tensor). The generated runtime maps the blob once
+        /// instead of opening one file per tensor. Tensors with the same bytes are stored once.
+        class WeightPack
+        {
+        public:
+            struct Entry
+            {
+                size_t offset;
+                size_t size;
+            };
+
+            static WeightPack* Global()
+            {
+                static WeightPack* global_weight_pack = new WeightPack();
+                return global_weight_pack;
+            }
+
+            // Append data to the blob, return its offset. Adding the same name twice is a
+            // no-op and returns the offset of the first add, adding the bytes of a packed
+            // tensor under a new name returns the offset of that tensor. Tensors are matched
+            // by the hash cached on their data and compared with the bytes in the blob.
+            size_t add(const std::string& name, const std::shared_ptr<op::ConstantData>& data);
+            bool contains(const std::string& name) const
+            {
+                return m_index.count(m_scope + name) > 0;
+            }
+            const Entry& get(const std::string& name) const;
+            // Names are looked up within the current scope, so that graphs compiled into one
+            // blob (e.g. shape buckets) can reuse tensor names for different data.
+            void set_scope(const std::string& scope) { m_scope = scope; }
+            const std::string& get_scope() const { return m_scope; }
+            const std::vector<std::string>& get_names() const { return m_names; }
+            size_t size() const { return m_size; }
+            bool empty() const { return m_names.empty(); }
+            // Close the blob and write the index file.
+            void save();
+
+            static const size_t alignment = 64;
+            static const std::string folder;
+            static const std::string blob_name;
+            static const std::string index_name;
+
+        private:
+            WeightPack() {}
+
+            std::fstream m_blob;
+            size_t m_size = 0;
+            std::string m_scope;
+            bool blob_equals(const Entry& entry, const op::ConstantData& data);
+
+            // content hash -> entry of the bytes packed with this hash
+            std::unordered_multimap<size_t, Entry> m_by_hash;
+            std::vector<std::string> m_names;
+            std::unordered_map<std::string, Entry> m_index;
+        };
+    } // namespace kernels
+} // namespace nnfusion
@@ -0,0 +1,47 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+// A NCW or NCHW Convolution of GemmEpilogueFusionPass with the ops after it, which MLAS applies
+// to each block of the output while it is in cache: activation(conv + bias + residual). The
+// inputs are the input, the filter, the bias [O] if has_bias is set and the residual, of the
+// output shape, if has_residual is set. activation is empty, "relu", "sigmoid" or "tanh".
+REGISTER_OP(FusedConv)
+    .attr<std::vector<int64_t>>("strides")
+    .attr<std::vector<int64_t>>("dilations")
+    .attr<std::vector<int64_t>>("padding_below")
+    .attr<std::vector<int64_t>>("padding_above")
+    .attr<std::string>("data_format", "NCHW")
+    .attr<std::string>("activation", "")
+    .attr<bool>("has_bias", false)
+    .attr<bool>("has_residual", false)
+    .infershape([](std::shared_ptr<graph::GNode> gnode) -> void {
+        auto generic_op = std::dynamic_pointer_cast<nnfusion::op::GenericOp>(gnode->get_op_ptr());
+        auto& cfg = generic_op->localOpConfig.getRoot();
+        bool has_bias = cfg["has_bias"];
+        bool has_residual = cfg["has_residual"];
+        NNFUSION_CHECK(gnode->get_input_size() == size_t(2 + has_bias + has_residual));
+        const nnfusion::Shape& input_shape = gnode->get_input_shape(0);
+        const nnfusion::Shape& filter_shape = gnode->get_input_shape(1);
+        size_t spatial = input_shape.size() - 2;
+        NNFUSION_CHECK((spatial == 1 || spatial == 2) && filter_shape.size() == input_shape.size());
+        NNFUSION_CHECK(input_shape[1] == filter_shape[1])
+            << "FusedConv expects " << filter_shape[1] << " input channels, got "
+            << input_shape[1];
+
+        nnfusion::Shape output_shape{input_shape[0], filter_shape[0]};
+        for (size_t i = 0; i < spatial; i++)
+        {
+            int64_t window = (filter_shape[2 + i] - 1) * int64_t(cfg["dilations"][i]) + 1;
+            int64_t padded = input_shape[2 + i] + int64_t(cfg["padding_below"][i]) +
+                             int64_t(cfg["padding_above"][i]);
+            NNFUSION_CHECK(padded >= window);
+            output_shape.push_back((padded - window) / int64_t(cfg["strides"][i]) + 1);
+        }
+        if (has_bias)
+            NNFUSION_CHECK(gnode->get_input_shape(2) == nnfusion::Shape({filter_shape[0]}));
+        if (has_residual)
+            NNFUSION_CHECK(gnode->get_input_shape(2 + has_bias) == output_shape);
+        gnode->set_output_type_and_shape(0, nnfusion::element::f32, output_shape);
+    });
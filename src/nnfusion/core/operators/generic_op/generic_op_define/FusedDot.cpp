@@ -0,0 +1,40 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+// A 2D Dot of GemmEpilogueFusionPass with the ops after it, which the CPU backend applies to
+// the GEMM output while it is in cache: activation(A * B + bias + residual). The inputs are A,
+// B, the bias [N] if has_bias is set and the residual [M, N] if has_residual is set.
+// activation is empty, "relu", "sigmoid", "tanh" or "gelu".
+REGISTER_OP(FusedDot)
+    .attr<bool>("trans_A", false)
+    .attr<bool>("trans_B", false)
+    .attr<std::string>("activation", "")
+    .attr<bool>("has_bias", false)
+    .attr<bool>("has_residual", false)
+    .infershape([](std::shared_ptr<graph::GNode> gnode) -> void {
+        auto generic_op = std::dynamic_pointer_cast<nnfusion::op::GenericOp>(gnode->get_op_ptr());
+        auto& cfg = generic_op->localOpConfig.getRoot();
+        bool has_bias = cfg["has_bias"];
+        bool has_residual = cfg["has_residual"];
+        NNFUSION_CHECK(gnode->get_input_size() == size_t(2 + has_bias + has_residual));
+        auto& A_shape = gnode->get_input_shape(0);
+        auto& B_shape = gnode->get_input_shape(1);
+        NNFUSION_CHECK(A_shape.size() == 2 && B_shape.size() == 2)
+            << "FusedDot only support Matrix";
+
+        bool trans_A = cfg["trans_A"];
+        bool trans_B = cfg["trans_B"];
+        size_t m = trans_A ? A_shape[1] : A_shape[0];
+        size_t k1 = trans_A ? A_shape[0] : A_shape[1];
+        size_t n = trans_B ? B_shape[0] : B_shape[1];
+        size_t k2 = trans_B ? B_shape[1] : B_shape[0];
+        NNFUSION_CHECK(k1 == k2);
+        if (has_bias)
+            NNFUSION_CHECK(gnode->get_input_shape(2) == nnfusion::Shape({n}));
+        if (has_residual)
+            NNFUSION_CHECK(gnode->get_input_shape(2 + has_bias) == nnfusion::Shape({m, n}));
+
+        gnode->set_output_type_and_shape(0, nnfusion::element::f32, nnfusion::Shape({m, n}));
+    });
@@ -0,0 +1,39 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+// 2D convolution of MLAS on NCHWc tensors, with an optional bias [O] and a fused activation.
+// The filter is the plain [O, I, KH, KW] tensor, it is reordered by the kernel. The input is a
+// NCHWc tensor, or a plain NCHW tensor if nchw_input is set, the output is a NCHWc tensor.
+// pads holds the top, left, bottom and right paddings.
+REGISTER_OP(NchwcConv)
+    .attr<std::vector<int64_t>>("strides", {1, 1})
+    .attr<std::vector<int64_t>>("dilations", {1, 1})
+    .attr<std::vector<int64_t>>("pads", {0, 0, 0, 0})
+    .attr<std::string>("activation", "")
+    .attr<bool>("nchw_input", false)
+    .infershape([](std::shared_ptr<graph::GNode> gnode) -> void {
+        NNFUSION_CHECK(gnode->get_input_size() == 2 || gnode->get_input_size() == 3);
+        auto generic_op = std::dynamic_pointer_cast<nnfusion::op::GenericOp>(gnode->get_op_ptr());
+        auto& cfg = generic_op->localOpConfig.getRoot();
+        const nnfusion::Shape& input_shape = gnode->get_input_shape(0);
+        const nnfusion::Shape& filter_shape = gnode->get_input_shape(1);
+        NNFUSION_CHECK(input_shape.size() == 4 && filter_shape.size() == 4);
+        NNFUSION_CHECK(input_shape[1] == filter_shape[1])
+            << "NchwcConv expects " << filter_shape[1] << " input channels, got "
+            << input_shape[1];
+        if (gnode->get_input_size() == 3)
+            NNFUSION_CHECK(gnode->get_input_shape(2) == nnfusion::Shape({filter_shape[0]}));
+
+        nnfusion::Shape output_shape{input_shape[0], filter_shape[0]};
+        for (size_t i = 0; i < 2; i++)
+        {
+            int64_t window = (filter_shape[2 + i] - 1) * int64_t(cfg["dilations"][i]) + 1;
+            int64_t padded =
+                input_shape[2 + i] + int64_t(cfg["pads"][i]) + int64_t(cfg["pads"][i + 2]);
+            NNFUSION_CHECK(padded >= window);
+            output_shape.push_back((padded - window) / int64_t(cfg["strides"][i]) + 1);
+        }
+        gnode->set_output_type_and_shape(0, nnfusion::element::f32, output_shape);
+    });
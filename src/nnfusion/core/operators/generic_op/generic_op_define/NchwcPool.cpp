@@ -0,0 +1,32 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+// 2D pooling of MLAS on NCHWc tensors. kind is "max", "avg_include_pad" or "avg_exclude_pad",
+// pads holds the top, left, bottom and right paddings.
+REGISTER_OP(NchwcPool)
+    .attr<std::string>("kind", "max")
+    .attr<std::vector<int64_t>>("window")
+    .attr<std::vector<int64_t>>("strides", {1, 1})
+    .attr<std::vector<int64_t>>("pads", {0, 0, 0, 0})
+    .infershape([](std::shared_ptr<graph::GNode> gnode) -> void {
+        NNFUSION_CHECK(gnode->get_input_size() == 1);
+        auto generic_op = std::dynamic_pointer_cast<nnfusion::op::GenericOp>(gnode->get_op_ptr());
+        auto& cfg = generic_op->localOpConfig.getRoot();
+        const nnfusion::Shape& input_shape = gnode->get_input_shape(0);
+        NNFUSION_CHECK(input_shape.size() == 4);
+        NNFUSION_CHECK(cfg["window"].size() == 2);
+
+        nnfusion::Shape output_shape{input_shape[0], input_shape[1]};
+        for (size_t i = 0; i < 2; i++)
+        {
+            int64_t padded =
+                input_shape[2 + i] + int64_t(cfg["pads"][i]) + int64_t(cfg["pads"][i + 2]);
+            NNFUSION_CHECK(padded >= int64_t(cfg["window"][i]));
+            output_shape.push_back((padded - int64_t(cfg["window"][i])) /
+                                       int64_t(cfg["strides"][i]) +
+                                   1);
+        }
+        gnode->set_output_type_and_shape(0, nnfusion::element::f32, output_shape);
+    });
@@ -0,0 +1,19 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+// Copy a [N, C, H, W] tensor between the plain NCHW layout and the NCHWc layout of MLAS, which
+// stores blocks of channels innermost. The shape is the same in both layouts.
+static void infer_nchwc_reorder(std::shared_ptr<graph::GNode> gnode)
+{
+    NNFUSION_CHECK(gnode->get_input_size() == 1);
+    const nnfusion::Shape& input_shape_0 = gnode->get_input_shape(0);
+    NNFUSION_CHECK(input_shape_0.size() == 4) << "NCHWc reorders expect a 4D tensor.";
+    NNFUSION_CHECK(gnode->get_input_element_type(0) == nnfusion::element::f32);
+    gnode->set_output_type_and_shape(0, nnfusion::element::f32, input_shape_0);
+}
+
+REGISTER_OP(NchwcReorderInput).infershape(infer_nchwc_reorder);
+
+REGISTER_OP(NchwcReorderOutput).infershape(infer_nchwc_reorder);
@@ -0,0 +1,22 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+// y = saturate(round(x / scale) + zero_point), saturated to uint8
+REGISTER_OP(QuantizeLinear)
+    .attr<float>("scale", 1.0f)
+    .attr<int>("zero_point", 0)
+    .infershape([](std::shared_ptr<graph::GNode> gnode) -> void {
+        NNFUSION_CHECK(gnode->get_input_size() == 1);
+        NNFUSION_CHECK(gnode->get_input_element_type(0) == nnfusion::element::f32)
+            << "QuantizeLinear only supports float inputs.";
+
+        auto generic_op = std::dynamic_pointer_cast<nnfusion::op::GenericOp>(gnode->get_op_ptr());
+        float scale = generic_op->localOpConfig.getRoot()["scale"];
+        int zero_point = generic_op->localOpConfig.getRoot()["zero_point"];
+        NNFUSION_CHECK(scale > 0) << "QuantizeLinear expects a positive scale.";
+        NNFUSION_CHECK(zero_point >= 0 && zero_point <= 255);
+
+        gnode->set_output_type_and_shape(0, nnfusion::element::u8, gnode->get_input_shape(0));
+    });
@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+// output = scale * (A - a_zero_point) x (B - b_zero_point), accumulated in int32.
+// A is uint8 [..., M, K]; B is either a int8/uint8 matrix [K, N] shared by every row of A, or
+// a batch [..., K, N] with the same leading dimensions as A.
+REGISTER_OP(QuantizedMatMul)
+    .attr<int>("a_zero_point", 0)
+    .attr<int>("b_zero_point", 0)
+    .attr<float>("scale", 1.0f)
+    .infershape([](std::shared_ptr<graph::GNode> gnode) -> void {
+        NNFUSION_CHECK(gnode->get_input_size() == 2);
+        const nnfusion::Shape& input_shape_0 = gnode->get_input_shape(0);
+        const nnfusion::Shape& input_shape_1 = gnode->get_input_shape(1);
+        NNFUSION_CHECK(gnode->get_input_element_type(0) == nnfusion::element::u8);
+        NNFUSION_CHECK(gnode->get_input_element_type(1) == nnfusion::element::u8 ||
+                       gnode->get_input_element_type(1) == nnfusion::element::i8);
+        NNFUSION_CHECK(input_shape_0.size() >= 2 && input_shape_1.size() >= 2);
+        NNFUSION_CHECK(input_shape_1.size() == 2 || input_shape_1.size() == input_shape_0.size())
+            << "QuantizedMatMul expects a matrix or a batch of the same rank as A for B.";
+
+        size_t rank = input_shape_0.size();
+        NNFUSION_CHECK(input_shape_0[rank - 1] == input_shape_1[input_shape_1.size() - 2]);
+        if (input_shape_1.size() == rank)
+        {
+            for (size_t i = 0; i + 2 < rank; i++)
+                NNFUSION_CHECK(input_shape_0[i] == input_shape_1[i]);
+        }
+
+        nnfusion::Shape output_shape_0(input_shape_0.begin(), input_shape_0.end() - 1);
+        output_shape_0.push_back(input_shape_1.back());
+        gnode->set_output_type_and_shape(0, nnfusion::element::f32, output_shape_0);
+    });
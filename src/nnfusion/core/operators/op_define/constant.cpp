@@ -55,14 +55,89 @@ string to_cpp_string(T value)
     return rc;
 }
 
-Constant::~Constant()
+ConstantData::ConstantData(size_t size, size_t alignment)
+    : m_data(nnfusion::aligned_alloc(alignment, size))
+    , m_size(size)
 {
-    if (m_data)
+}
+
+ConstantData::ConstantData(std::shared_ptr<const void> data, size_t size)
+    : m_data(const_cast<void*>(data.get()))
+    , m_size(size)
+    , m_owner(std::move(data))
+{
+}
+
+ConstantData::~ConstantData()
+{
+    if (m_data && !m_owner)
     {
         nnfusion::aligned_free(m_data);
     }
 }
 
+size_t ConstantData::hash_bytes(const void* data, size_t size)
+{
+    // FNV-1a over 8-byte words, so that hashing gigabytes of weights stays cheap.
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL ^ size;
+    auto bytes = static_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+    return hash;
+}
+
+size_t ConstantData::hash() const
+{
+    if (!m_hashed.load(std::memory_order_acquire))
+    {
+        m_hash.store(hash_bytes(m_data, m_size), std::memory_order_relaxed);
+        m_hashed.store(true, std::memory_order_release);
+    }
+    return m_hash.load(std::memory_order_relaxed);
+}
+
+bool ConstantData::equals(const ConstantData& other) const
+{
+    if (this == &other || (m_data == other.m_data && m_size == other.m_size))
+        return true;
+    return m_size == other.m_size && hash() == other.hash() &&
+           std::memcmp(m_data, other.m_data, m_size) == 0;
+}
+
+Constant::~Constant()
+{
+}
+
+void* Constant::get_mutable_data_ptr()
+{
+    if (m_storage.use_count() > 1 || !m_storage->owns_data())
+    {
+        auto copy = allocate_data();
+        std::memcpy(copy->data(), m_data, copy->size());
+        m_storage = copy;
+        m_data = m_storage->data();
+    }
+    m_storage->invalidate_hash();
+    return m_data;
+}
+
+bool Constant::data_equals(const Constant& other) const
+{
+    return m_element_type == other.m_element_type && m_shape == other.m_shape &&
+           m_storage->equals(*other.m_storage);
+}
+
 DataBuffer Constant::get_buffer() const
 {
     DataBuffer ret(m_element_type);
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <sstream>
 
@@ -32,6 +33,43 @@ namespace nnfusion
 {
     namespace op
     {
+        /// \brief Reference-counted bytes of Constant data. Constants with the same bytes may
+        ///        share one, the first writer copies it, see Constant::get_mutable_data_ptr. The
+        ///        bytes are either allocated here or owned by another object, like a mapped file,
+        ///        and are hashed once for the passes which compare constants.
+        class ConstantData
+        {
+        public:
+            /// \brief Allocates uninitialized bytes aligned to alignment.
+            ConstantData(size_t size, size_t alignment);
+            /// \brief Uses the bytes at data in place, keeping their owner alive.
+            ConstantData(std::shared_ptr<const void> data, size_t size);
+            ~ConstantData();
+
+            void* data() const { return m_data; }
+            size_t size() const { return m_size; }
+            size_t hash() const;
+            /// \brief Drops the cached hash after the bytes are written.
+            void invalidate_hash() { m_hashed.store(false, std::memory_order_release); }
+            /// \brief Whether the bytes are allocated here rather than owned by another object.
+            bool owns_data() const { return !m_owner; }
+            bool equals(const ConstantData& other) const;
+
+            /// \brief The hash of ConstantData::hash, for bytes outside of a ConstantData.
+            static size_t hash_bytes(const void* data, size_t size);
+
+        private:
+            void* m_data;
+            size_t m_size;
+            std::shared_ptr<const void> m_owner;
+            // Set once the hash is cached. Threads which hash concurrently store the same value.
+            mutable std::atomic<bool> m_hashed{false};
+            mutable std::atomic<size_t> m_hash{0};
+
+            ConstantData(const ConstantData&) = delete;
+            ConstantData& operator=(const ConstantData&) = delete;
+        };
+
         /// \brief Class for constants.
         class Constant : public TensorOp
         {
@@ -47,8 +85,8 @@ namespace nnfusion
                      nnfusion::Shape shape,
                      const std::vector<T>& values)
                 : TensorOp("Constant", element_type, shape)
-                , m_data(nnfusion::aligned_alloc(
-                      m_element_type.size(), nnfusion::shape_size(m_shape) * m_element_type.size()))
+                , m_storage(allocate_data())
+                , m_data(m_storage->data())
             {
                 size_t literal_num = values.size() * sizeof(T) / element_type.size();
 
@@ -90,8 +128,8 @@ namespace nnfusion
                      nnfusion::Shape shape,
                      const DataBuffer& values)
                 : TensorOp("Constant", element_type, shape)
-                , m_data(nnfusion::aligned_alloc(
-                      m_element_type.size(), nnfusion::shape_size(m_shape) * m_element_type.size()))
+                , m_storage(allocate_data())
+                , m_data(m_storage->data())
             {
                 OP_VALIDATION(this, values.size() == nnfusion::shape_size(m_shape))
                     << "Did not get the expected number of literals for a constant of shape "
@@ -112,8 +150,8 @@ namespace nnfusion
                      nnfusion::Shape shape,
                      const std::vector<std::string>& values)
                 : TensorOp("Constant", element_type, shape)
-                , m_data(nnfusion::aligned_alloc(
-                      m_element_type.size(), nnfusion::shape_size(m_shape) * m_element_type.size()))
+                , m_storage(allocate_data())
+                , m_data(m_storage->data())
             {
                 OP_VALIDATION(this,
                               values.size() == 1 || values.size() == nnfusion::shape_size(m_shape))
@@ -139,11 +177,48 @@ namespace nnfusion
                      const nnfusion::Shape& shape,
                      const void* data)
                 : TensorOp("Constant", element_type, shape)
-                , m_data(nullptr)
+                , m_storage(allocate_data())
+                , m_data(m_storage->data())
+            {
+                std::memcpy(m_data, data, m_storage->size());
+            }
+
+            /// \brief Constructs a tensor constant on data owned elsewhere, e.g. a mapped file,
+            ///        without copying it. The constant keeps data alive, its bytes must not
+            ///        be changed by the owner while the constant uses them.
+            ///
+            /// \param element_type The element type of the tensor constant.
+            /// \param shape The shape of the tensor constant.
+            /// \param data The constant data, aligned to the element type size.
+            Constant(const nnfusion::element::Type& element_type,
+                     const nnfusion::Shape& shape,
+                     std::shared_ptr<const void> data)
+                : TensorOp("Constant", element_type, shape)
+                , m_storage(std::make_shared<ConstantData>(
+                      std::move(data), nnfusion::shape_size(m_shape) * m_element_type.size()))
+                , m_data(m_storage->data())
+            {
+                NNFUSION_CHECK(reinterpret_cast<uintptr_t>(m_data) % m_element_type.size() == 0)
+                    << "Constant data is not aligned to its element type " << m_element_type;
+            }
+
+            /// \brief Constructs a tensor constant sharing the data of another one, e.g. a
+            ///        folded constant with the same bytes as an existing one.
+            ///
+            /// \param element_type The element type of the tensor constant.
+            /// \param shape The shape of the tensor constant.
+            /// \param storage The data, of the size of shape.
+            Constant(const nnfusion::element::Type& element_type,
+                     const nnfusion::Shape& shape,
+                     std::shared_ptr<ConstantData> storage)
+                : TensorOp("Constant", element_type, shape)
+                , m_storage(std::move(storage))
+                , m_data(m_storage->data())
             {
-                size_t size = nnfusion::shape_size(m_shape) * m_element_type.size();
-                m_data = nnfusion::aligned_alloc(m_element_type.size(), size);
-                std::memcpy(m_data, data, size);
+                NNFUSION_CHECK(m_storage->size() ==
+                               nnfusion::shape_size(m_shape) * m_element_type.size())
+                    << "Constant data of " << m_storage->size() << " bytes does not match shape "
+                    << m_shape;
             }
 
             virtual ~Constant() override;
@@ -217,6 +292,15 @@ namespace nnfusion
 
             DataBuffer get_buffer() const;
             const void* get_data_ptr() const { return m_data; }
+            /// \brief The data for writing, copied first if other constants share it or it is
+            ///        owned by another object.
+            void* get_mutable_data_ptr();
+            /// \brief The storage of the data, which constants with the same bytes may share.
+            const std::shared_ptr<ConstantData>& get_storage() const { return m_storage; }
+            /// \brief Hash of the data bytes, computed once per storage.
+            size_t get_data_hash() const { return m_storage->hash(); }
+            /// \brief Whether other has the same type, shape and data bytes.
+            bool data_equals(const Constant& other) const;
             size_t get_data_size() const
             {
                 return nnfusion::shape_size(m_shape) * m_element_type.size();
@@ -231,6 +315,11 @@ namespace nnfusion
             bool is_constant() const override { return true; }
             bool& is_weight() { return m_is_weight; }
         protected:
+            std::shared_ptr<ConstantData> allocate_data() const
+            {
+                return std::make_shared<ConstantData>(
+                    nnfusion::shape_size(m_shape) * m_element_type.size(), m_element_type.size());
+            }
             template <typename T>
             void write_values(const std::vector<T>& values)
             {
@@ -239,6 +328,8 @@ namespace nnfusion
                 buf.dump(m_data);
             }
             bool m_is_weight = false;
+            std::shared_ptr<ConstantData> m_storage;
+            // the data of m_storage
             void* m_data{nullptr};
             Constant(const Constant&) = delete;
             Constant(Constant&&) = delete;
@@ -0,0 +1,246 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "control_flow.hpp"
+#include "nnfusion/core/graph/gnode.hpp"
+
+using namespace std;
+using namespace nnfusion::op;
+
+ControlFlowOp::ControlFlowOp(const std::string& op_type,
+                             const std::vector<ControlFlowBody>& bodies,
+                             size_t explicit_input_size)
+    : Op(op_type)
+    , m_bodies(bodies)
+    , m_explicit_input_size(explicit_input_size)
+{
+}
+
+void ControlFlowOp::validate_captures(std::shared_ptr<graph::GNode> gnode)
+{
+    OP_VALIDATION(this, gnode->get_input_size() >= m_explicit_input_size)
+        << "Expected at least " << m_explicit_input_size << " inputs, got "
+        << gnode->get_input_size() << ".";
+    for (auto& body : m_bodies)
+    {
+        OP_VALIDATION(this, body.graph != nullptr) << "Body graph is not set.";
+        for (auto& capture : body.captures)
+        {
+            OP_VALIDATION(this, capture.second < gnode->get_input_size())
+                << "Capture " << capture.first->get_name() << " is bound to input "
+                << capture.second << ", which does not exist.";
+            OP_VALIDATION(this,
+                          gnode->get_input_element_type(capture.second) ==
+                                  capture.first->get_output_element_type(0) &&
+                              gnode->get_input_shape(capture.second) ==
+                                  capture.first->get_output_shape(0))
+                << "Capture " << capture.first->get_name() << " does not match input "
+                << capture.second << ".";
+        }
+    }
+}
+
+void ControlFlowOp::validate_body_input(std::shared_ptr<graph::GNode> gnode,
+                                        const ControlFlowBody& body,
+                                        size_t i,
+                                        const nnfusion::element::Type& type,
+                                        const nnfusion::Shape& shape)
+{
+    OP_VALIDATION(this, i < body.inputs.size()) << "Body has no input " << i << ".";
+    auto& input = body.inputs[i];
+    OP_VALIDATION(this,
+                  input->get_output_element_type(0) == type &&
+                      input->get_output_shape(0) == shape)
+        << "Body input " << i << " (" << input->get_name() << ") is "
+        << input->get_output_element_type(0) << input->get_output_shape(0) << ", expected "
+        << type << shape << ".";
+}
+
+const nnfusion::element::Type&
+    ControlFlowOp::get_output_element_type(const ControlFlowBody& body, size_t i)
+{
+    return body.outputs.at(i)->get_input_element_type(0);
+}
+
+const nnfusion::Shape& ControlFlowOp::get_output_shape(const ControlFlowBody& body, size_t i)
+{
+    return body.outputs.at(i)->get_input_shape(0);
+}
+
+If::If(const ControlFlowBody& then_branch, const ControlFlowBody& else_branch)
+    : ControlFlowOp("If", {then_branch, else_branch}, 1)
+{
+}
+
+void If::validate_and_infer_types(std::shared_ptr<graph::GNode> gnode)
+{
+    validate_captures(gnode);
+    OP_VALIDATION(this,
+                  gnode->get_input_element_type(0) == nnfusion::element::boolean &&
+                      shape_size(gnode->get_input_shape(0)) == 1)
+        << "Condition must be a boolean of one element, got " << gnode->get_input_element_type(0)
+        << gnode->get_input_shape(0) << ".";
+
+    auto& then_branch = m_bodies[0];
+    auto& else_branch = m_bodies[1];
+    OP_VALIDATION(this, then_branch.inputs.empty() && else_branch.inputs.empty())
+        << "Branches take no inputs.";
+    OP_VALIDATION(this, then_branch.outputs.size() == else_branch.outputs.size())
+        << "Branches produce " << then_branch.outputs.size() << " and "
+        << else_branch.outputs.size() << " outputs.";
+
+    gnode->set_output_size(then_branch.outputs.size());
+    for (size_t i = 0; i < then_branch.outputs.size(); i++)
+    {
+        auto& type = get_output_element_type(then_branch, i);
+        auto& shape = get_output_shape(then_branch, i);
+        OP_VALIDATION(this,
+                      type == get_output_element_type(else_branch, i) &&
+                          shape == get_output_shape(else_branch, i))
+            << "Output " << i << " is " << type << shape << " in the then branch and "
+            << get_output_element_type(else_branch, i) << get_output_shape(else_branch, i)
+            << " in the else branch, static shapes need them to be the same.";
+        gnode->set_output_type_and_shape(i, type, shape);
+    }
+}
+
+Loop::Loop(const ControlFlowBody& body,
+           bool has_trip_count,
+           bool has_condition,
+           int64_t max_trip_count)
+    : ControlFlowOp("Loop",
+                    {body},
+                    size_t(has_trip_count) + size_t(has_condition) + body.inputs.size() - 2)
+    , m_has_trip_count(has_trip_count)
+    , m_has_condition(has_condition)
+    , m_max_trip_count(max_trip_count)
+{
+}
+
+void Loop::validate_and_infer_types(std::shared_ptr<graph::GNode> gnode)
+{
+    auto& body = m_bodies[0];
+    OP_VALIDATION(this, body.inputs.size() >= 2 && body.outputs.size() >= body.inputs.size() - 1)
+        << "Body takes the iteration number, the condition and the loop-carried values, and "
+           "produces the condition, the loop-carried values and the scan outputs.";
+    OP_VALIDATION(this, m_has_trip_count || m_has_condition)
+        << "Loop without trip count and condition never ends.";
+    validate_captures(gnode);
+
+    size_t input = 0;
+    if (m_has_trip_count)
+    {
+        OP_VALIDATION(this,
+                      gnode->get_input_element_type(input) == nnfusion::element::i64 &&
+                          shape_size(gnode->get_input_shape(input)) == 1)
+            << "Trip count must be an int64 of one element.";
+        input++;
+    }
+    if (m_has_condition)
+    {
+        OP_VALIDATION(this,
+                      gnode->get_input_element_type(input) == nnfusion::element::boolean &&
+                          shape_size(gnode->get_input_shape(input)) == 1)
+            << "Condition must be a boolean of one element.";
+        input++;
+    }
+    validate_body_input(gnode, body, 0, nnfusion::element::i64, nnfusion::Shape{});
+    validate_body_input(gnode, body, 1, nnfusion::element::boolean, nnfusion::Shape{});
+    OP_VALIDATION(this,
+                  get_output_element_type(body, 0) == nnfusion::element::boolean &&
+                      shape_size(get_output_shape(body, 0)) == 1)
+        << "Body must produce a boolean condition of one element.";
+
+    size_t carried = get_carried_size();
+    size_t scan_outputs = get_scan_output_size();
+    OP_VALIDATION(this, scan_outputs == 0 || m_max_trip_count >= 0)
+        << "Scan outputs need a constant trip count, their shapes are static.";
+
+    gnode->set_output_size(carried + scan_outputs);
+    for (size_t i = 0; i < carried; i++)
+    {
+        auto& type = gnode->get_input_element_type(input + i);
+        auto& shape = gnode->get_input_shape(input + i);
+        validate_body_input(gnode, body, 2 + i, type, shape);
+        OP_VALIDATION(this,
+                      get_output_element_type(body, 1 + i) == type &&
+                          get_output_shape(body, 1 + i) == shape)
+            << "Loop-carried value " << i << " is " << type << shape << " but the body produces "
+            << get_output_element_type(body, 1 + i) << get_output_shape(body, 1 + i) << ".";
+        gnode->set_output_type_and_shape(i, type, shape);
+    }
+    for (size_t i = 0; i < scan_outputs; i++)
+    {
+        nnfusion::Shape shape{static_cast<size_t>(m_max_trip_count)};
+        auto& slice_shape = get_output_shape(body, 1 + carried + i);
+        shape.insert(shape.end(), slice_shape.begin(), slice_shape.end());
+        gnode->set_output_type_and_shape(
+            carried + i, get_output_element_type(body, 1 + carried + i), shape);
+    }
+}
+
+Scan::Scan(const ControlFlowBody& body,
+           size_t scan_input_size,
+           const std::vector<bool>& reverse_inputs,
+           const std::vector<bool>& reverse_outputs)
+    : ControlFlowOp("Scan", {body}, body.inputs.size())
+    , m_scan_input_size(scan_input_size)
+    , m_reverse_inputs(reverse_inputs)
+    , m_reverse_outputs(reverse_outputs)
+    , m_sequence_length(0)
+{
+}
+
+void Scan::validate_and_infer_types(std::shared_ptr<graph::GNode> gnode)
+{
+    auto& body = m_bodies[0];
+    OP_VALIDATION(this, m_scan_input_size > 0 && m_scan_input_size <= body.inputs.size())
+        << "Scan needs at least one scan input.";
+    size_t states = get_state_size();
+    OP_VALIDATION(this, body.outputs.size() >= states)
+        << "Body must produce the " << states << " states.";
+    size_t scan_outputs = get_scan_output_size();
+    OP_VALIDATION(this,
+                  m_reverse_inputs.size() == m_scan_input_size &&
+                      m_reverse_outputs.size() == scan_outputs)
+        << "Expected a direction per scan input and scan output.";
+    validate_captures(gnode);
+
+    m_sequence_length = 0;
+    for (size_t i = 0; i < m_scan_input_size; i++)
+    {
+        auto& shape = gnode->get_input_shape(states + i);
+        OP_VALIDATION(this, !shape.empty()) << "Scan input " << i << " has no axis to scan.";
+        OP_VALIDATION(this, i == 0 || shape[0] == m_sequence_length)
+            << "Scan inputs have different lengths, " << shape[0] << " and "
+            << m_sequence_length << ".";
+        m_sequence_length = shape[0];
+        validate_body_input(gnode,
+                            body,
+                            states + i,
+                            gnode->get_input_element_type(states + i),
+                            nnfusion::Shape(shape.begin() + 1, shape.end()));
+    }
+
+    gnode->set_output_size(states + scan_outputs);
+    for (size_t i = 0; i < states; i++)
+    {
+        auto& type = gnode->get_input_element_type(i);
+        auto& shape = gnode->get_input_shape(i);
+        validate_body_input(gnode, body, i, type, shape);
+        OP_VALIDATION(this,
+                      get_output_element_type(body, i) == type &&
+                          get_output_shape(body, i) == shape)
+            << "State " << i << " is " << type << shape << " but the body produces "
+            << get_output_element_type(body, i) << get_output_shape(body, i) << ".";
+        gnode->set_output_type_and_shape(i, type, shape);
+    }
+    for (size_t i = 0; i < scan_outputs; i++)
+    {
+        nnfusion::Shape shape{m_sequence_length};
+        auto& slice_shape = get_output_shape(body, states + i);
+        shape.insert(shape.end(), slice_shape.begin(), slice_shape.end());
+        gnode->set_output_type_and_shape(
+            states + i, get_output_element_type(body, states + i), shape);
+    }
+}
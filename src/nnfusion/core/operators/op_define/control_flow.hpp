@@ -0,0 +1,137 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "nnfusion/core/graph/graph.hpp"
+#include "nnfusion/core/operators/op.hpp"
+
+namespace nnfusion
+{
+    namespace op
+    {
+        /// \brief A body of a control-flow op, i.e. a graph of its own which the kernel of the op
+        /// runs as a whole, once per iteration or branch taken.
+        struct ControlFlowBody
+        {
+            std::shared_ptr<graph::Graph> graph;
+            // Parameters the op binds per run, e.g. the iteration number and loop-carried values
+            // of a Loop.
+            graph::GNodeVector inputs;
+            // Parameters bound to the input of the op of that index for all runs, i.e. the
+            // values of the enclosing graph which the body reads.
+            std::vector<std::pair<std::shared_ptr<graph::GNode>, size_t>> captures;
+            // Result nodes of the values the body produces.
+            graph::GNodeVector outputs;
+        };
+
+        /// \brief Base of If, Loop and Scan. The inputs of the op come first, then the values
+        /// its bodies capture which are no input already.
+        class ControlFlowOp : public Op
+        {
+        public:
+            std::vector<ControlFlowBody>& get_bodies() { return m_bodies; }
+            // Number of inputs before the captured ones.
+            size_t get_explicit_input_size() const { return m_explicit_input_size; }
+        protected:
+            ControlFlowOp(const std::string& op_type,
+                          const std::vector<ControlFlowBody>& bodies,
+                          size_t explicit_input_size);
+
+            // Check the captures of the bodies against the inputs of gnode.
+            void validate_captures(std::shared_ptr<graph::GNode> gnode);
+            void validate_body_input(std::shared_ptr<graph::GNode> gnode,
+                                     const ControlFlowBody& body,
+                                     size_t i,
+                                     const nnfusion::element::Type& type,
+                                     const nnfusion::Shape& shape);
+            static const nnfusion::element::Type&
+                get_output_element_type(const ControlFlowBody& body, size_t i);
+            static const nnfusion::Shape& get_output_shape(const ControlFlowBody& body, size_t i);
+
+            std::vector<ControlFlowBody> m_bodies;
+            size_t m_explicit_input_size;
+        };
+
+        /// \brief Runs the then or the else branch by a boolean input of one element. Both
+        /// branches produce outputs of the same types and shapes.
+        class If : public ControlFlowOp
+        {
+        public:
+            If(const ControlFlowBody& then_branch, const ControlFlowBody& else_branch);
+
+            void validate_and_infer_types(std::shared_ptr<graph::GNode> gnode) override;
+
+            ControlFlowBody& get_then_branch() { return m_bodies[0]; }
+            ControlFlowBody& get_else_branch() { return m_bodies[1]; }
+        };
+
+        /// \brief Runs its body while the iteration number is below a trip count and a condition
+        /// holds. Inputs are the trip count and the condition, each only if the loop has it,
+        /// then the initial loop-carried values. The body gets the iteration number, the
+        /// condition and the loop-carried values, and produces the condition, the next
+        /// loop-carried values and the slices of the scan outputs. Outputs are the final
+        /// loop-carried values, then the scan outputs, which stack the slices of all
+        /// iterations and thus need a static trip count. Their slices of the iterations an
+        /// early exit skips are zero.
+        class Loop : public ControlFlowOp
+        {
+        public:
+            /// \param max_trip_count The trip count if it is a constant, -1 otherwise.
+            Loop(const ControlFlowBody& body,
+                 bool has_trip_count,
+                 bool has_condition,
+                 int64_t max_trip_count);
+
+            void validate_and_infer_types(std::shared_ptr<graph::GNode> gnode) override;
+
+            ControlFlowBody& get_body() { return m_bodies[0]; }
+            bool has_trip_count() const { return m_has_trip_count; }
+            bool has_condition() const { return m_has_condition; }
+            int64_t get_max_trip_count() const { return m_max_trip_count; }
+            size_t get_carried_size() const { return m_bodies[0].inputs.size() - 2; }
+            size_t get_scan_output_size() const
+            {
+                return m_bodies[0].outputs.size() - 1 - get_carried_size();
+            }
+
+        protected:
+            bool m_has_trip_count;
+            bool m_has_condition;
+            int64_t m_max_trip_count;
+        };
+
+        /// \brief Runs its body once per slice of the scan inputs along their first axis.
+        /// Inputs are the initial states, then the scan inputs. The body gets the states and
+        /// one slice of every scan input, and produces the next states and the slices of the
+        /// scan outputs. Outputs are the final states, then the scan outputs.
+        class Scan : public ControlFlowOp
+        {
+        public:
+            /// \param reverse_inputs Whether each scan input is read from its last slice on.
+            /// \param reverse_outputs Whether each scan output is written from its last slice on.
+            Scan(const ControlFlowBody& body,
+                 size_t scan_input_size,
+                 const std::vector<bool>& reverse_inputs,
+                 const std::vector<bool>& reverse_outputs);
+
+            void validate_and_infer_types(std::shared_ptr<graph::GNode> gnode) override;
+
+            ControlFlowBody& get_body() { return m_bodies[0]; }
+            size_t get_state_size() const { return m_bodies[0].inputs.size() - m_scan_input_size; }
+            size_t get_scan_input_size() const { return m_scan_input_size; }
+            size_t get_scan_output_size() const
+            {
+                return m_bodies[0].outputs.size() - get_state_size();
+            }
+            size_t get_sequence_length() const { return m_sequence_length; }
+            bool is_reverse_input(size_t i) const { return m_reverse_inputs.at(i); }
+            bool is_reverse_output(size_t i) const { return m_reverse_outputs.at(i); }
+        protected:
+            size_t m_scan_input_size;
+            std::vector<bool> m_reverse_inputs;
+            std::vector<bool> m_reverse_outputs;
+            size_t m_sequence_length;
+        };
+    }
+}
@@ -1,9 +1,10 @@
-// Copyright (c) Microsoft Corporation.
-// Licensed under the MIT License.
-
 #include "manager.hpp"
 #include <limits>
+#include <list>
+#include <mutex>
 #include <pwd.h>
+#include <sys/stat.h>
+#include <unordered_map>
 #include "nnfusion/core/graph/graph.hpp"
 #include "nnfusion/core/kernels/cuda_gpu/cuda_common_ops.hpp"
 #include "nnfusion/core/kernels/kernel_emitter.hpp"
@@ -17,40 +18,216 @@ DEFINE_string(fkernel_cache_path, "", "Kernel cache DB path");
 DEFINE_string(fproduct_name,
               "default",
               "Device product name, like 'GeForce GTX 1080 Ti', 'Tesla V100-PCIE-16GB'");
+DEFINE_int32(fkernel_cache_capacity,
+             16384,
+             "Number of kernel identifiers kept in the in-memory kernel cache.");
 
 using namespace nnfusion::cache;
 
-std::unordered_set<std::string> KernelCacheManager::SupportOpList;
+namespace nnfusion
+{
+    namespace cache
+    {
+        ///\brief The process-wide connection to the kernel cache DB and the in-memory cache in
+        // front of it. All the members are guarded by mutex.
+        class KernelCacheDB
+        {
+        public:
+            static KernelCacheDB* open(const std::string& path);
+            ~KernelCacheDB();
+
+            bool lookup(const std::string& key, std::vector<KernelEntry_p>& fetched);
+            void store(const std::string& key, const std::vector<KernelEntry_p>& fetched);
+            void invalidate(const std::string& key) { evict(key); }
+            // Run the fetch statement once bound, return the entries grouped by identifier.
+            std::unordered_map<std::string, std::vector<KernelEntry_p>>
+                query(sqlite3_stmt* stmt);
+            void load_profiles(const std::string& device_type);
+            // The fetch statement of count identifiers of one device type, prepared once per
+            // count.
+            sqlite3_stmt* get_prefetch_stmt(size_t count);
+
+            std::mutex mutex;
+            sqlite3* db = nullptr;
+            sqlite3_stmt* fetch_stmt = nullptr;
+            std::unordered_map<size_t, sqlite3_stmt*> prefetch_stmts;
+            sqlite3_stmt* insert_stmt = nullptr;
+            sqlite3_stmt* replace_stmt = nullptr;
+            sqlite3_stmt* profile_fetch_stmt = nullptr;
+            sqlite3_stmt* profile_insert_stmt = nullptr;
+
+            std::unordered_map<std::string, double> profiles;
+            std::unordered_set<std::string> profiled_devices;
+            CacheStats stats;
+
+        private:
+            void evict(const std::string& key);
+
+            using LRUList = std::list<std::string>;
+            LRUList lru;
+            std::unordered_map<std::string, std::pair<std::vector<KernelEntry_p>, LRUList::iterator>>
+                entries;
+        };
+    }
+}
 
-sqlite3* KernelCacheManager::kernel_cache = nullptr;
-KernelCacheManager::KernelCacheManager()
+namespace
 {
-    m_path = (getpwuid(getuid())->pw_dir + std::string("/.cache/nnfusion/kernel_cache.db"));
-    if (FLAGS_fkernel_cache_path != "")
+    std::unique_ptr<KernelCacheDB> global_kernel_cache;
+    std::mutex global_kernel_cache_mutex;
+
+    std::string entry_key(const std::string& identifier, const std::string& device_type)
     {
-        m_path = FLAGS_fkernel_cache_path;
+        return device_type + "/" + identifier;
     }
+
+    std::string column_string(sqlite3_stmt* stmt, int col)
     {
-        size_t pos = m_path.find_last_of("/");
-        if (pos != std::string::npos && pos != (m_path.size() - 1))
-        {
-            std::string cache_folder = m_path.substr(0, pos);
+        auto text = (const char*)sqlite3_column_text(stmt, col);
+        return text ? std::string(text) : std::string();
+    }
 
-            struct stat s;
-            if (stat(cache_folder.c_str(), &s) != 0)
+    sqlite3_stmt* prepare(sqlite3* db, const char* sql)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        NNFUSION_CHECK(SQLITE_OK == sqlite3_prepare_v2(db, sql, -1, &stmt, 0))
+            << sqlite3_errmsg(db);
+        return stmt;
+    }
+
+    void bind_string(sqlite3_stmt* stmt, int col, const std::string& str)
+    {
+        sqlite3_bind_text(stmt, col, str.data(), str.size(), SQLITE_STATIC);
+    }
+
+    void finish(sqlite3_stmt* stmt)
+    {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+    // Profiling results used to be kept in ~/.cache/nnfusion_cache.db, copy them into the
+    // ProfilingCache table the first time a kernel cache DB is opened.
+    void migrate_legacy_profiles(sqlite3* db, const std::string& path)
+    {
+        int version = 0;
+        auto stmt = prepare(db, "PRAGMA user_version;");
+        if (SQLITE_ROW == sqlite3_step(stmt))
+            version = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+        if (version >= 1)
+            return;
+
+        std::string legacy = getpwuid(getuid())->pw_dir + std::string("/.cache/nnfusion_cache.db");
+        struct stat s;
+        if (legacy != path && stat(legacy.c_str(), &s) == 0)
+        {
+            stmt = prepare(db, "ATTACH DATABASE ? AS legacy;");
+            bind_string(stmt, 1, legacy);
+            bool attached = SQLITE_DONE == sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+            if (attached && SQLITE_OK == sqlite3_exec(db,
+                                                      R"(
+INSERT OR IGNORE INTO ProfilingCache (KeyCode, KeyOp, DeviceType, Cost) SELECT key_code, key_op, device_type, cost FROM legacy.KernelCache;
+)",
+                                                      NULL,
+                                                      0,
+                                                      NULL))
             {
-                std::string cmd_create_folder = "mkdir -p " + cache_folder;
-                system(cmd_create_folder.c_str());
+                NNFUSION_LOG(INFO) << "Migrated " << sqlite3_changes(db)
+                                   << " profiling results from " << legacy;
             }
+            else
+            {
+                NNFUSION_LOG(NNFUSION_WARNING) << "Failed to migrate the profiling results of "
+                                               << legacy << ": " << sqlite3_errmsg(db);
+            }
+            if (attached)
+                sqlite3_exec(db, "DETACH DATABASE legacy;", NULL, 0, NULL);
         }
+        sqlite3_exec(db, "PRAGMA user_version = 1;", NULL, 0, NULL);
     }
 
-    if (!kernel_cache)
+    KernelEntry_p parse_kernel_entry(sqlite3_stmt* pStmt)
     {
-        if (SQLITE_OK == sqlite3_open(m_path.c_str(), &kernel_cache))
+        KernelEntry_p fetched_kernel = std::make_shared<KernelEntry>();
+
+        fetched_kernel->key = column_string(pStmt, 0);
+        fetched_kernel->identifier = column_string(pStmt, 1);
+        fetched_kernel->op_type = column_string(pStmt, 2);
+        fetched_kernel->attributes = nlohmann::json::parse(column_string(pStmt, 3));
+        fetched_kernel->source = column_string(pStmt, 4);
+        fetched_kernel->device_type = column_string(pStmt, 5);
+        fetched_kernel->function = nlohmann::json::parse(column_string(pStmt, 6));
+        fetched_kernel->miscs = nlohmann::json::parse(column_string(pStmt, 8));
+
+        // parse input tags
+        size_t pos = 0;
+        std::string fetched_tags = column_string(pStmt, 7);
+        while ((pos = fetched_tags.find(",")) != std::string::npos)
         {
-            NNFUSION_LOG(INFO) << "Open kernel cache from: " << m_path;
-            const char* table_create = R"(
+            fetched_kernel->tags.insert(fetched_tags.substr(0, pos));
+            fetched_tags.erase(0, pos + 1);
+        }
+        if (fetched_tags != "")
+        {
+            fetched_kernel->tags.insert(fetched_tags);
+        }
+
+        // parse profiling information
+        size_t subpos = 0;
+        auto miscs = fetched_kernel->miscs;
+        if (miscs.find("external_profile") != miscs.end())
+        {
+            std::string fetched_profile = miscs["external_profile"]["time"];
+            while ((pos = fetched_profile.find(";")) != std::string::npos)
+            {
+                subpos = fetched_profile.find(":");
+                fetched_kernel->profile[fetched_profile.substr(0, subpos)] =
+                    stof(fetched_profile.substr(subpos + 1, pos));
+                fetched_profile.erase(0, pos + 1);
+            }
+
+            fetched_kernel->resource = miscs["external_profile"]["resource"];
+        }
+        return fetched_kernel;
+    }
+
+    std::vector<KernelEntry_p> copy_entries(const std::vector<KernelEntry_p>& entries)
+    {
+        std::vector<KernelEntry_p> copied;
+        for (auto& entry : entries)
+            copied.push_back(std::make_shared<KernelEntry>(*entry));
+        return copied;
+    }
+}
+
+KernelCacheDB* KernelCacheDB::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(global_kernel_cache_mutex);
+    if (global_kernel_cache)
+        return global_kernel_cache.get();
+
+    sqlite3* db = nullptr;
+    if (SQLITE_OK != sqlite3_open_v2(path.c_str(),
+                                     &db,
+                                     SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                                         SQLITE_OPEN_FULLMUTEX,
+                                     nullptr))
+    {
+        NNFUSION_LOG(ERROR) << "Invalid path to kernel cache: " << path << ", "
+                            << sqlite3_errmsg(db) << ", kernel cache will be disabled";
+        sqlite3_close(db);
+        return nullptr;
+    }
+    NNFUSION_LOG(INFO) << "Open kernel cache from: " << path;
+
+    // WAL lets other processes read while one writes, wait for their locks instead of failing.
+    sqlite3_busy_timeout(db, 10000);
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, 0, NULL);
+    sqlite3_exec(db, "PRAGMA synchronous=NORMAL;", NULL, 0, NULL);
+
+    const char* table_create = R"(
 CREATE TABLE IF NOT EXISTS KernelCache(
    Key        TEXT NOT NULL,
    Identifier TEXT NOT NULL,
@@ -63,15 +240,143 @@ CREATE TABLE IF NOT EXISTS KernelCache(
    Miscs      TEXT DEFAULT "",
    PRIMARY KEY(Key)
    );
+CREATE INDEX IF NOT EXISTS KernelCacheIdentifier ON KernelCache(Identifier, DeviceType);
+CREATE TABLE IF NOT EXISTS ProfilingCache(
+   KeyCode    TEXT NOT NULL,
+   KeyOp      TEXT NOT NULL,
+   DeviceType TEXT NOT NULL,
+   Cost       REAL,
+   PRIMARY KEY(KeyCode, DeviceType)
+   );
 )";
-            NNFUSION_CHECK(SQLITE_OK == sqlite3_exec(kernel_cache, table_create, NULL, 0, NULL));
-        }
-        else
+    NNFUSION_CHECK(SQLITE_OK == sqlite3_exec(db, table_create, NULL, 0, NULL));
+    migrate_legacy_profiles(db, path);
+
+    auto cache = new KernelCacheDB();
+    cache->db = db;
+    cache->fetch_stmt = prepare(db, R"(
+SELECT Key, Identifier, OpType, Attributes, Source, DeviceType, Function, Tags, Miscs FROM KernelCache WHERE (Identifier = ?) AND (DeviceType = ?);
+    )");
+    cache->insert_stmt = prepare(db, R"(
+INSERT INTO KernelCache (Key,Identifier,OpType,Attributes,Source,DeviceType,Function,Tags,Miscs) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);
+    )");
+    cache->replace_stmt = prepare(db, R"(
+INSERT OR REPLACE INTO KernelCache (Key,Identifier,OpType,Attributes,Source,DeviceType,Function,Tags,Miscs) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);
+    )");
+    cache->profile_fetch_stmt = prepare(db, R"(
+SELECT KeyCode, Cost FROM ProfilingCache WHERE (DeviceType = ?);
+    )");
+    cache->profile_insert_stmt = prepare(db, R"(
+INSERT OR REPLACE INTO ProfilingCache (KeyCode, KeyOp, DeviceType, Cost) VALUES (?, ?, ?, ?);
+    )");
+    global_kernel_cache.reset(cache);
+    return cache;
+}
+
+KernelCacheDB::~KernelCacheDB()
+{
+    for (auto stmt :
+         {fetch_stmt, insert_stmt, replace_stmt, profile_fetch_stmt, profile_insert_stmt})
+        sqlite3_finalize(stmt);
+    for (auto& it : prefetch_stmts)
+        sqlite3_finalize(it.second);
+    sqlite3_close(db);
+}
+
+bool KernelCacheDB::lookup(const std::string& key, std::vector<KernelEntry_p>& fetched)
+{
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return false;
+    lru.splice(lru.begin(), lru, it->second.second);
+    fetched = copy_entries(it->second.first);
+    return true;
+}
+
+void KernelCacheDB::store(const std::string& key, const std::vector<KernelEntry_p>& fetched)
+{
+    evict(key);
+    lru.push_front(key);
+    entries[key] = std::make_pair(fetched, lru.begin());
+    while (entries.size() > static_cast<size_t>(std::max(FLAGS_fkernel_cache_capacity, 1)))
+        evict(lru.back());
+}
+
+void KernelCacheDB::evict(const std::string& key)
+{
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return;
+    lru.erase(it->second.second);
+    entries.erase(it);
+}
+
+std::unordered_map<std::string, std::vector<KernelEntry_p>>
+    KernelCacheDB::query(sqlite3_stmt* stmt)
+{
+    stats.db_queries++;
+    std::unordered_map<std::string, std::vector<KernelEntry_p>> fetched;
+    while (SQLITE_ROW == sqlite3_step(stmt))
+    {
+        auto identifier = column_string(stmt, 1);
+        fetched[identifier].push_back(parse_kernel_entry(stmt));
+    }
+    finish(stmt);
+    return fetched;
+}
+
+sqlite3_stmt* KernelCacheDB::get_prefetch_stmt(size_t count)
+{
+    auto it = prefetch_stmts.find(count);
+    if (it != prefetch_stmts.end())
+        return it->second;
+    std::string sql =
+        "SELECT Key, Identifier, OpType, Attributes, Source, DeviceType, Function, Tags, Miscs "
+        "FROM KernelCache WHERE (DeviceType = ?) AND Identifier IN (?";
+    for (size_t i = 1; i < count; i++)
+        sql += ", ?";
+    sql += ");";
+    auto stmt = prepare(db, sql.c_str());
+    prefetch_stmts[count] = stmt;
+    return stmt;
+}
+
+void KernelCacheDB::load_profiles(const std::string& device_type)
+{
+    if (profiled_devices.count(device_type) > 0)
+        return;
+    stats.db_queries++;
+    bind_string(profile_fetch_stmt, 1, device_type);
+    while (SQLITE_ROW == sqlite3_step(profile_fetch_stmt))
+    {
+        profiles[entry_key(column_string(profile_fetch_stmt, 0), device_type)] =
+            sqlite3_column_double(profile_fetch_stmt, 1);
+    }
+    finish(profile_fetch_stmt);
+    profiled_devices.insert(device_type);
+}
+
+std::unordered_set<std::string> KernelCacheManager::SupportOpList;
+
+KernelCacheManager::KernelCacheManager(const std::unordered_set<std::string>& extra_ops)
+{
+    m_path = (getpwuid(getuid())->pw_dir + std::string("/.cache/nnfusion/kernel_cache.db"));
+    if (FLAGS_fkernel_cache_path != "")
+    {
+        m_path = FLAGS_fkernel_cache_path;
+    }
+    {
+        size_t pos = m_path.find_last_of("/");
+        if (pos != std::string::npos && pos != (m_path.size() - 1))
         {
-            NNFUSION_LOG(ERROR) << "Invalid path to kernel cache: " << m_path << ", "
-                                << sqlite3_errmsg(kernel_cache)
-                                << ", kernel cache will be disabled";
-            kernel_cache = nullptr;
+            std::string cache_folder = m_path.substr(0, pos);
+
+            struct stat s;
+            if (stat(cache_folder.c_str(), &s) != 0)
+            {
+                std::string cmd_create_folder = "mkdir -p " + cache_folder;
+                system(cmd_create_folder.c_str());
+            }
         }
     }
 
@@ -90,12 +395,57 @@ CREATE TABLE IF NOT EXISTS KernelCache(
                               "Fused_Convolution_Add_Relu",
                               "Matched_Pattern"});
     }
+    m_support_ops = SupportOpList;
+    m_support_ops.insert(extra_ops.begin(), extra_ops.end());
+
+    // The connection stays open until exit, other managers reuse it and its cached entries.
+    m_db = KernelCacheDB::open(m_path);
 }
 
 KernelCacheManager::~KernelCacheManager()
 {
-    NNFUSION_CHECK(SQLITE_OK == sqlite3_close(kernel_cache));
-    kernel_cache = NULL;
+}
+
+void KernelCacheManager::prefetch(const std::vector<std::string>& identifiers,
+                                  const std::string& device_type)
+{
+    if (!m_db)
+        return;
+    std::lock_guard<std::mutex> lock(m_db->mutex);
+    std::unordered_set<std::string> unique;
+    std::vector<std::string> todo;
+    for (auto& identifier : identifiers)
+    {
+        if (identifier != "" && unique.insert(identifier).second)
+            todo.push_back(identifier);
+    }
+    if (todo.empty())
+        return;
+
+    // Query the identifiers in chunks, each within the limit of bound parameters, rather than
+    // one by one or the whole table of the device type.
+    int max_params = sqlite3_limit(m_db->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+    size_t chunk = std::min<size_t>(std::max(max_params - 1, 1), 500);
+    size_t found = 0;
+    for (size_t begin = 0; begin < todo.size(); begin += chunk)
+    {
+        size_t count = std::min(chunk, todo.size() - begin);
+        auto stmt = m_db->get_prefetch_stmt(count);
+        bind_string(stmt, 1, device_type);
+        for (size_t i = 0; i < count; i++)
+            bind_string(stmt, i + 2, todo[begin + i]);
+        auto fetched = m_db->query(stmt);
+        for (size_t i = begin; i < begin + count; i++)
+        {
+            auto it = fetched.find(todo[i]);
+            if (it != fetched.end() && !it->second.empty())
+                found++;
+            m_db->store(entry_key(todo[i], device_type),
+                        it != fetched.end() ? it->second : std::vector<KernelEntry_p>());
+        }
+    }
+    NNFUSION_LOG(INFO) << "Prefetched kernel cache for " << todo.size() << " identifiers on "
+                       << device_type << ", " << found << " found.";
 }
 
 std::vector<KernelEntry_p> KernelCacheManager::fetch_all(std::string identifier,
@@ -103,80 +453,47 @@ std::vector<KernelEntry_p> KernelCacheManager::fetch_all(std::string identifier,
 {
     NNFUSION_LOG(DEBUG) << "Trying to fetch kernel " << identifier
                         << " on DeviceType: " << device_type;
-    sqlite3_stmt* pStmt;
-    const char* fetch = R"(
-SELECT Key, Identifier, OpType, Attributes, Source, DeviceType, Function, Tags, Miscs FROM KernelCache WHERE (Identifier = ?) AND (DeviceType = ?);
-    )";
-    NNFUSION_CHECK(SQLITE_OK == sqlite3_prepare(kernel_cache, fetch, -1, &pStmt, 0));
-    sqlite3_bind_text(pStmt, 1, identifier.data(), identifier.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 2, device_type.data(), device_type.size(), SQLITE_STATIC);
-
     std::vector<KernelEntry_p> fetched;
-    while (SQLITE_ROW == sqlite3_step(pStmt))
-    {
-        KernelEntry_p fetched_kernel = std::make_shared<KernelEntry>();
+    if (!m_db)
+        return fetched;
 
-        fetched_kernel->key = std::string((char*)sqlite3_column_text(pStmt, 0));
-        fetched_kernel->identifier = std::string((char*)sqlite3_column_text(pStmt, 1));
-        fetched_kernel->op_type = std::string((char*)sqlite3_column_text(pStmt, 2));
-        fetched_kernel->attributes =
-            nlohmann::json::parse(std::string((char*)sqlite3_column_text(pStmt, 3)));
-        fetched_kernel->source = std::string((char*)sqlite3_column_text(pStmt, 4));
-        fetched_kernel->device_type = std::string((char*)sqlite3_column_text(pStmt, 5));
-        fetched_kernel->function =
-            nlohmann::json::parse(std::string((char*)sqlite3_column_text(pStmt, 6)));
-        fetched_kernel->miscs =
-            nlohmann::json::parse(std::string((char*)sqlite3_column_text(pStmt, 8)));
-
-        if (SupportOpList.find(fetched_kernel->op_type) == SupportOpList.end())
+    std::lock_guard<std::mutex> lock(m_db->mutex);
+    auto key = entry_key(identifier, device_type);
+    if (m_db->lookup(key, fetched))
+    {
+        m_db->stats.memory_hits++;
+    }
+    else
+    {
+        bind_string(m_db->fetch_stmt, 1, identifier);
+        bind_string(m_db->fetch_stmt, 2, device_type);
+        auto queried = m_db->query(m_db->fetch_stmt);
+        if (queried.count(identifier) > 0)
+            fetched = queried[identifier];
+        m_db->store(key, fetched);
+        fetched = copy_entries(fetched);
+    }
+    // The entries are shared by all managers, each one filters by the ops it supports.
+    for (auto& entry : fetched)
+    {
+        if (m_support_ops.find(entry->op_type) == m_support_ops.end())
         {
-            NNFUSION_LOG(DEBUG) << "Unsupported op_type: " << fetched_kernel->op_type
+            NNFUSION_LOG(DEBUG) << "Unsupported op_type: " << entry->op_type
                                 << ", ingore this fetch";
             fetched.clear();
             break;
         }
-
-        // parse input tags
-        size_t pos = 0;
-        std::string fetched_tags = std::string((char*)sqlite3_column_text(pStmt, 7));
-        while ((pos = fetched_tags.find(",")) != std::string::npos)
-        {
-            fetched_kernel->tags.insert(fetched_tags.substr(0, pos));
-            fetched_tags.erase(0, pos + 1);
-        }
-        if (fetched_tags != "")
-        {
-            fetched_kernel->tags.insert(fetched_tags);
-        }
-
-        // parse profiling information
-        size_t subpos = 0;
-        auto miscs = fetched_kernel->miscs;
-        if (miscs.find("external_profile") != miscs.end())
-        {
-            std::string fetched_profile = miscs["external_profile"]["time"];
-            while ((pos = fetched_profile.find(";")) != std::string::npos)
-            {
-                subpos = fetched_profile.find(":");
-                fetched_kernel->profile[fetched_profile.substr(0, subpos)] =
-                    stof(fetched_profile.substr(subpos + 1, pos));
-                fetched_profile.erase(0, pos + 1);
-            }
-
-            fetched_kernel->resource = miscs["external_profile"]["resource"];
-        }
-
-        fetched.push_back(fetched_kernel);
     }
 
-    NNFUSION_CHECK(SQLITE_OK == sqlite3_finalize(pStmt));
     if (fetched.size() > 0)
     {
+        m_db->stats.hits++;
         NNFUSION_LOG(DEBUG) << fetched.size() << " cached kernel fetched " << identifier
                             << " on: " << device_type;
     }
     else
     {
+        m_db->stats.misses++;
         NNFUSION_LOG(DEBUG) << "Failed to fetch, fallback plan will be uses";
     }
     return fetched;
@@ -264,7 +581,7 @@ bool KernelCacheManager::insert_kernel_entry(const KernelEntry_p kernel_entry, b
         return false;
     }
 
-    if (SupportOpList.find(kernel_entry->op_type) == SupportOpList.end())
+    if (m_support_ops.find(kernel_entry->op_type) == m_support_ops.end())
     {
         NNFUSION_LOG(DEBUG) << "Unsupported op_type: " << kernel_entry->op_type
                             << ", unable to insert into kernel cache DB";
@@ -299,36 +616,88 @@ bool KernelCacheManager::insert_kernel_entry(const KernelEntry_p kernel_entry, b
     NNFUSION_CHECK(key != "" && identifier != "" && op_type != "" && source != "" &&
                    device_type != "" && function != "");
 
+    if (!m_db)
+        return false;
+    std::lock_guard<std::mutex> lock(m_db->mutex);
     if (overwrite)
     {
         NNFUSION_LOG(DEBUG) << "Allow overwriting kernel " << kernel_entry->identifier
                             << " in kernel cache DB";
-        sqlite3_stmt* pStmt;
-        const char* sql_delete = R"(
-DELETE FROM KernelCache WHERE (Key = ?);
-        )";
-        NNFUSION_CHECK(SQLITE_OK == sqlite3_prepare(kernel_cache, sql_delete, -1, &pStmt, 0));
-        sqlite3_bind_text(pStmt, 1, key.data(), key.size(), SQLITE_STATIC);
-        NNFUSION_CHECK(SQLITE_DONE == sqlite3_step(pStmt));
-        NNFUSION_CHECK(SQLITE_OK == sqlite3_finalize(pStmt));
-    }
-
-    sqlite3_stmt* pStmt;
-    const char* sql_insert = R"(
-INSERT INTO KernelCache (Key,Identifier,OpType,Attributes,Source,DeviceType,Function,Tags,Miscs) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);
-    )";
-    NNFUSION_CHECK(SQLITE_OK == sqlite3_prepare(kernel_cache, sql_insert, -1, &pStmt, 0));
-    sqlite3_bind_text(pStmt, 1, key.data(), key.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 2, identifier.data(), identifier.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 3, op_type.data(), op_type.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 4, attributes.data(), attributes.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 5, source.data(), source.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 6, device_type.data(), device_type.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 7, function.data(), function.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 8, tags.data(), tags.size(), SQLITE_STATIC);
-    sqlite3_bind_text(pStmt, 9, miscs.data(), miscs.size(), SQLITE_STATIC);
-    NNFUSION_CHECK(SQLITE_DONE == sqlite3_step(pStmt));
-    NNFUSION_CHECK(SQLITE_OK == sqlite3_finalize(pStmt));
+    }
 
+    sqlite3_stmt* pStmt = overwrite ? m_db->replace_stmt : m_db->insert_stmt;
+    bind_string(pStmt, 1, key);
+    bind_string(pStmt, 2, identifier);
+    bind_string(pStmt, 3, op_type);
+    bind_string(pStmt, 4, attributes);
+    bind_string(pStmt, 5, source);
+    bind_string(pStmt, 6, device_type);
+    bind_string(pStmt, 7, function);
+    bind_string(pStmt, 8, tags);
+    bind_string(pStmt, 9, miscs);
+    int rc = sqlite3_step(pStmt);
+    finish(pStmt);
+    NNFUSION_CHECK(SQLITE_DONE == rc) << sqlite3_errmsg(m_db->db);
+    m_db->invalidate(entry_key(identifier, device_type));
+
+    return true;
+}
+
+bool KernelCacheManager::fetch_profile(const std::string& key_code,
+                                       const std::string& device_type,
+                                       double& cost)
+{
+    if (!m_db)
+        return false;
+    std::lock_guard<std::mutex> lock(m_db->mutex);
+    m_db->load_profiles(device_type);
+    auto it = m_db->profiles.find(entry_key(key_code, device_type));
+    if (it == m_db->profiles.end())
+    {
+        m_db->stats.profile_misses++;
+        return false;
+    }
+    m_db->stats.profile_hits++;
+    cost = it->second;
     return true;
-}
\ No newline at end of file
+}
+
+bool KernelCacheManager::insert_profile(const std::string& key_code,
+                                        const std::string& key_op,
+                                        const std::string& device_type,
+                                        double cost)
+{
+    if (!m_db)
+        return false;
+    std::lock_guard<std::mutex> lock(m_db->mutex);
+    auto pStmt = m_db->profile_insert_stmt;
+    bind_string(pStmt, 1, key_code);
+    bind_string(pStmt, 2, key_op);
+    bind_string(pStmt, 3, device_type);
+    sqlite3_bind_double(pStmt, 4, cost);
+    int rc = sqlite3_step(pStmt);
+    finish(pStmt);
+    NNFUSION_CHECK(SQLITE_DONE == rc) << sqlite3_errmsg(m_db->db);
+    m_db->profiles[entry_key(key_code, device_type)] = cost;
+    return true;
+}
+
+CacheStats KernelCacheManager::get_stats()
+{
+    std::lock_guard<std::mutex> lock(global_kernel_cache_mutex);
+    if (!global_kernel_cache)
+        return CacheStats();
+    std::lock_guard<std::mutex> db_lock(global_kernel_cache->mutex);
+    return global_kernel_cache->stats;
+}
+
+std::string KernelCacheManager::get_stats_string()
+{
+    auto stats = get_stats();
+    std::stringstream ss;
+    ss << "kernel lookups: " << stats.hits << " hits, " << stats.misses << " misses ("
+       << stats.memory_hits << " served from memory); profile lookups: " << stats.profile_hits
+       << " hits, " << stats.profile_misses << " misses; " << stats.db_queries
+       << " DB queries";
+    return ss.str();
+}
@@ -7,12 +7,14 @@
 #include <sqlite3.h>
 #include "nnfusion/common/common.hpp"
 
+DECLARE_string(fkernel_cache_path);
+DECLARE_int32(fkernel_cache_capacity);
+
 namespace nnfusion
 {
     namespace cache
     {
-        // presently only kernel cache database supported
-        // Todo: integrate the interfaces of profiling cache database
+        // The kernel cache database also holds the profiling results of the kernel profiler
         struct KernelEntry
         {
             std::string key;
@@ -44,12 +46,35 @@ namespace nnfusion
 
         using KernelEntry_p = std::shared_ptr<KernelEntry>;
 
+        struct CacheStats
+        {
+            // Lookups by identifier, split by whether any entry was found.
+            size_t hits = 0;
+            size_t misses = 0;
+            // Lookups answered by the in-memory cache, without a database query.
+            size_t memory_hits = 0;
+            size_t db_queries = 0;
+            size_t profile_hits = 0;
+            size_t profile_misses = 0;
+        };
+
+        class KernelCacheDB;
+
+        ///\brief All managers share one database connection (WAL mode, prepared statements
+        // reused) and one in-memory LRU of fetched entries keyed by identifier and device type.
+        // Entries are returned as copies, so callers are free to modify them.
         class KernelCacheManager
         {
         public:
-            KernelCacheManager();
+            // Entries are fetched and inserted for the ops of SupportOpList and extra_ops.
+            KernelCacheManager(const std::unordered_set<std::string>& extra_ops = {});
             ~KernelCacheManager();
 
+            // Load the entries of all the identifiers with a few queries, later fetches of
+            // these identifiers do not touch the database.
+            void prefetch(const std::vector<std::string>& identifiers,
+                          const std::string& device_type);
+
             std::vector<KernelEntry_p> fetch_all(std::string identifier, std::string device_type);
             KernelEntry_p fetch_with_tags(std::string identifier,
                                           std::string device_type,
@@ -59,14 +84,28 @@ namespace nnfusion
                                                          std::string device_type,
                                                          std::string source);
             bool insert_kernel_entry(const KernelEntry_p kernel_entry, bool overwrite = false);
-            bool is_valid() { return kernel_cache != nullptr; }
+            bool is_valid() { return m_db != nullptr; }
+            // Profiled time cost of a kernel body, all the costs of a device type are loaded
+            // on its first lookup.
+            bool fetch_profile(const std::string& key_code,
+                               const std::string& device_type,
+                               double& cost);
+            bool insert_profile(const std::string& key_code,
+                                const std::string& key_op,
+                                const std::string& device_type,
+                                double cost);
+
+            static CacheStats get_stats();
+            static std::string get_stats_string();
+
         public:
             // TODO(lingm): SupportOpList depends on the correctness of the KernelContext identifier
             static std::unordered_set<std::string> SupportOpList;
 
         private:
             std::string m_path;
-            static sqlite3* kernel_cache;
+            KernelCacheDB* m_db;
+            std::unordered_set<std::string> m_support_ops;
         };
     } //namespace cache
 } //namespace nnfusion
\ No newline at end of file
@@ -11,7 +11,9 @@
 #include "nnfusion/engine/pass/graph/batchnorm_inference_folding_pass.hpp"
 #include "nnfusion/engine/pass/graph/blockfusion_pass.hpp"
 #include "nnfusion/engine/pass/graph/common_subexpression_elimination_pass.hpp"
+#include "nnfusion/engine/pass/graph/control_flow_pass.hpp"
 #include "nnfusion/engine/pass/graph/dot_transpose_pass.hpp"
+#include "nnfusion/engine/pass/graph/gemm_epilogue_fusion_pass.hpp"
 #include "nnfusion/engine/pass/graph/gemm_fusion_pass.hpp"
 #include "nnfusion/engine/pass/graph/gnode_device_dispatcher.hpp"
 #include "nnfusion/engine/pass/graph/gradient_weight_mapping_pass.hpp"
@@ -20,9 +22,12 @@
 #include "nnfusion/engine/pass/graph/kernel_profiling_pass.hpp"
 #include "nnfusion/engine/pass/graph/kernel_selection.hpp"
 #include "nnfusion/engine/pass/graph/kernel_tuning.hpp"
+#include "nnfusion/engine/pass/graph/loop_fusion_pass.hpp"
 #include "nnfusion/engine/pass/graph/multi_reshape_folding_pass.hpp"
+#include "nnfusion/engine/pass/graph/nchwc_layout_pass.hpp"
 #include "nnfusion/engine/pass/graph/op_inplace_pass.hpp"
 #include "nnfusion/engine/pass/graph/pattern_substitution.hpp"
+#include "nnfusion/engine/pass/graph/quantization_pass.hpp"
 #include "nnfusion/engine/pass/graph/runtime_const_folding_pass.hpp"
 #include "nnfusion/engine/pass/graph/vector_dot_transpose_pass.hpp"
 #include "nnfusion/engine/pass/tensor/inplace_tensor_analysis.hpp"
@@ -37,7 +42,9 @@ using namespace nnfusion::engine;
 using namespace nnfusion::pass::graph;
 using namespace nnfusion::pass;
 
-CpuEngine::CpuEngine()
+CpuEngine::CpuEngine(const std::string& codegen_folder,
+                     const std::string& entry_prefix,
+                     std::shared_ptr<codegen::ShapeBucketContext> bucket_context)
     : Engine()
 {
     g_passes->push_back(make_shared<CSEPass>());
@@ -46,13 +53,18 @@ CpuEngine::CpuEngine()
     g_passes->push_back(make_shared<RuntimeConstantFoldingPass>());
     g_passes->push_back(make_shared<MultiReshapeFoldingPass>());
     g_passes->push_back(make_shared<VectorDotTransposePass>());
+    g_passes->push_back(make_shared<QuantizationPass>());
     g_passes->push_back(make_shared<GemmFusionPass>());
     g_passes->push_back(make_shared<BatchNormInferenceFoldingPass>());
+    g_passes->push_back(make_shared<NchwcLayoutPass>());
+    g_passes->push_back(make_shared<GemmEpilogueFusionPass>());
+    g_passes->push_back(make_shared<ControlFlowPass>());
     g_passes->push_back(make_shared<AssignLayoutPass>());
     g_passes->push_back(make_shared<OpInplacePass>());
 
     g_passes->push_back(make_shared<IRBasedFusionPass>());
     g_passes->push_back(make_shared<PatternSubstitutionPass>());
+    g_passes->push_back(make_shared<LoopFusionPass>());
 
     // Kernel selection
     g_passes->push_back(make_shared<DefaultGNodeDeviceDispatcher>());
@@ -83,5 +95,6 @@ CpuEngine::CpuEngine()
     m_passes->push_back(make_shared<AssignTensorMemoryLayout>(64, false));
 
     // Do codegen
-    m_passes->push_back(make_shared<CpuCodegenPass>());
+    m_passes->push_back(make_shared<CpuCodegenPass>(
+        codegen_folder, codegen_folder, ".cpp", entry_prefix, bucket_context));
 }
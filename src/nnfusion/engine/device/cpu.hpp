@@ -8,12 +8,21 @@
 
 namespace nnfusion
 {
+    namespace codegen
+    {
+        struct ShapeBucketContext;
+    }
+
     namespace engine
     {
         class CpuEngine : public Engine
         {
         public:
-            CpuEngine();
+            ///\param entry_prefix see CpuCodegenPass, empty for a standalone runtime.
+            ///\param bucket_context shared by the buckets of a multi-shape runtime.
+            CpuEngine(const std::string& codegen_folder = "./nnfusion_rt/cpu_codegen/",
+                      const std::string& entry_prefix = "",
+                      std::shared_ptr<codegen::ShapeBucketContext> bucket_context = nullptr);
         };
     } // namespace engine
 } // namespace nnfusion
\ No newline at end of file
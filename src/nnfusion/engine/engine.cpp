@@ -1,11 +1,16 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT License.
 
+#include <cxxabi.h>
 #include "engine.hpp"
 #include "nnfusion/engine/pass/extract_graph_signature.hpp"
 
 DEFINE_bool(fkernels_as_files, false, "Saving kernels as standalone source code files.");
 DEFINE_int64(fkernels_files_number, -1, "Saving kernels into how many source code files.");
+DEFINE_string(fkernel_cache_dir,
+              "",
+              "Directory where the project of -fkernels_as_files caches the object files of its "
+              "kernels across builds. Disabled when not set.");
 DEFINE_bool(ftraining_mode, false, "Turn on training mode.");
 DEFINE_bool(fextern_result_memory, false, "Model result tensor memory is managed externally.");
 DEFINE_int32(fwarmup_step, 5, "Warm up step.");
@@ -18,9 +23,71 @@ DEFINE_bool(fhost_entry, false, "provide entry on host memory");
 DEFINE_bool(fuse_cpuprofiler, false, "");
 DEFINE_bool(fcodegen_pybind, false, "");
 DEFINE_bool(ffunction_codegen, false, "");
+DEFINE_bool(fgraph_pass_report,
+            false,
+            "Log the wall time of every graph pass and the size of the graph after it.");
 
 using namespace nnfusion;
 
+namespace
+{
+    std::string get_pass_name(const nnfusion::pass::graph::GraphPassBase& pass)
+    {
+        const char* mangled = typeid(pass).name();
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+        std::string name = status == 0 ? demangled : mangled;
+        free(demangled);
+        return name.substr(name.rfind("::") == std::string::npos ? 0 : name.rfind("::") + 2);
+    }
+}
+
+bool GraphPassManager::run_on_graph(graph::Graph::Pointer graph, EngineContext::Pointer context)
+{
+    bool status = true;
+    if (context != nullptr)
+        context->m_legacy_graph = graph;
+
+    std::vector<std::pair<std::string, double>> pass_ms;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& pass : *this)
+    {
+        auto pass_start = std::chrono::steady_clock::now();
+        size_t rebuilds = graph->get_ordered_ops_rebuilds();
+        status = pass->run_on_graph(graph);
+        if (FLAGS_fgraph_pass_report)
+        {
+            double ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - pass_start)
+                            .count();
+            pass_ms.push_back(std::make_pair(get_pass_name(*pass), ms));
+            NNFUSION_LOG(INFO) << "Graph pass " << pass_ms.back().first << ": " << ms
+                               << " ms, nodes " << graph->get_node_size() << ", edges "
+                               << graph->get_edge_size() << ", order rebuilds "
+                               << graph->get_ordered_ops_rebuilds() - rebuilds;
+        }
+        if (!status)
+            break;
+    }
+
+    if (FLAGS_fgraph_pass_report)
+    {
+        double total_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                .count();
+        using PassTime = std::pair<std::string, double>;
+        std::stable_sort(pass_ms.begin(), pass_ms.end(), [](const PassTime& a, const PassTime& b) {
+            return a.second > b.second;
+        });
+        std::stringstream report;
+        report << "Graph passes took " << total_ms << " ms, slowest:";
+        for (size_t i = 0; i < std::min<size_t>(pass_ms.size(), 5); i++)
+            report << " " << pass_ms[i].first << " (" << pass_ms[i].second << " ms)";
+        NNFUSION_LOG(INFO) << report.str();
+    }
+    return status;
+}
+
 Engine::Engine()
 {
     m_passes = make_shared<InterpreterPassManager>();
@@ -79,21 +79,10 @@ namespace nnfusion
     {
     public:
         using Pointer = shared_ptr<GraphPassManager>;
+        // With -fgraph_pass_report, logs the wall time of every pass and the node count, edge
+        // count and topological order rebuilds of the graph after it.
         virtual bool run_on_graph(graph::Graph::Pointer graph,
-                                  EngineContext::Pointer context = nullptr)
-        {
-            bool status;
-            if (context != nullptr)
-                context->m_legacy_graph = graph;
-
-            for (auto& pass : *this)
-            {
-                status = pass->run_on_graph(graph);
-                if (!status)
-                    break;
-            }
-            return status;
-        };
+                                  EngineContext::Pointer context = nullptr);
     };
 
     class Engine
@@ -5,6 +5,9 @@
 DECLARE_string(fhlsl_codegen_type);
 DECLARE_bool(fcustomized_mem_imp);
 DECLARE_bool(ffunction_codegen);
+DEFINE_bool(fmem_offline_plan,
+            false,
+            "Place tensors by an offline planner which sees all tensor lifetimes at once.");
 
 nnfusion::MemoryAllocator::node::node(size_t size, block_state state)
     : m_size{size}
@@ -18,7 +21,10 @@ nnfusion::MemoryAllocator::MemoryAllocator(size_t alignment,
                                            size_t device_id,
                                            const std::string& symbol)
     : m_alignment{alignment}
-    , m_scheme{disable_memory_reuse ? allocation_scheme::NO_REUSE : allocation_scheme::FIRST_FIT}
+    , m_scheme{disable_memory_reuse
+                   ? allocation_scheme::NO_REUSE
+                   : (FLAGS_fmem_offline_plan ? allocation_scheme::OFFLINE
+                                              : allocation_scheme::FIRST_FIT)}
     , m_device_type(device_type)
     , m_device_id(device_id)
     , m_max_allocated{0}
@@ -50,6 +56,10 @@ void nnfusion::MemoryAllocator::allocate(std::vector<shared_ptr<descriptor::Tens
     case allocation_scheme::FIRST_FIT: rc = first_fit(total_size); break;
     case allocation_scheme::BEST_FIT: rc = best_fit(total_size); break;
     case allocation_scheme::NO_REUSE: rc = no_reuse_allocator(total_size); break;
+    case allocation_scheme::OFFLINE:
+        rc = first_fit(total_size);
+        record_block(tensors, rc, total_size);
+        break;
     }
     for (auto tensor : tensors)
     {
@@ -73,6 +83,10 @@ void nnfusion::MemoryAllocator::allocate(shared_ptr<descriptor::Tensor> tensor)
     case allocation_scheme::FIRST_FIT: rc = first_fit(size); break;
     case allocation_scheme::BEST_FIT: rc = best_fit(size); break;
     case allocation_scheme::NO_REUSE: rc = no_reuse_allocator(size); break;
+    case allocation_scheme::OFFLINE:
+        rc = first_fit(size);
+        record_block({tensor}, rc, size);
+        break;
     }
     tensor->set_pool_offset(rc);
     tensor->set_pool(this->get_name());
@@ -96,6 +110,8 @@ void nnfusion::MemoryAllocator::allocate(shared_ptr<descriptor::Tensor> tensor,
     size_t ref_count = root->ref();
     NNFUSION_CHECK(ref_count > 1);
     m_allocated_tensors.push_back(tensor);
+    if (m_scheme == allocation_scheme::OFFLINE)
+        m_ref_tensors.emplace_back(tensor, offset - root->get_pool_offset());
 
     if (record_trace)
     {
@@ -202,9 +218,26 @@ void nnfusion::MemoryAllocator::free(shared_ptr<descriptor::Tensor> tensor)
     if (tensor->deref() > 0)
         return;
 
-    size_t offset = tensor->get_pool_offset();
+    bool found = free_block(tensor->get_pool_offset());
+    if (found && m_scheme == allocation_scheme::OFFLINE)
+    {
+        auto it = m_block_of.find(tensor.get());
+        if (it != m_block_of.end())
+        {
+            m_blocks[it->second].end = m_events.size();
+            m_events.emplace_back(false, it->second);
+        }
+    }
+    if (record_trace)
+    {
+        this->record("[free]", tensor);
+    }
+    NNFUSION_CHECK(found) << "bad free";
+}
+
+bool nnfusion::MemoryAllocator::free_block(size_t offset)
+{
     size_t search_offset = 0;
-    bool found = false;
     for (auto it = m_node_list.begin(); it != m_node_list.end(); ++it)
     {
         if (offset == search_offset)
@@ -232,16 +265,152 @@ void nnfusion::MemoryAllocator::free(shared_ptr<descriptor::Tensor> tensor)
                 m_node_list.erase(it_next);
             }
             it->m_state = block_state::FREE;
-            found = true;
-            break;
+            return true;
         }
         search_offset += it->m_size;
     }
-    if (record_trace)
+    return false;
+}
+
+void nnfusion::MemoryAllocator::record_block(std::vector<shared_ptr<descriptor::Tensor>> tensors,
+                                             size_t offset,
+                                             size_t size)
+{
+    lifetime_block block;
+    block.size = align(size, m_alignment);
+    block.start = m_events.size();
+    block.end = numeric_limits<size_t>::max();
+    block.offset = offset;
+    block.tensors = std::move(tensors);
+    m_block_of[block.tensors.front().get()] = m_blocks.size();
+    m_events.emplace_back(true, m_blocks.size());
+    m_blocks.push_back(std::move(block));
+}
+
+size_t nnfusion::MemoryAllocator::simulate(allocation_scheme scheme) const
+{
+    MemoryAllocator sim(m_alignment, false, m_device_type, m_device_id, m_symbol);
+    sim.record_trace = false;
+    std::vector<size_t> offsets(m_blocks.size());
+    for (auto& event : m_events)
     {
-        this->record("[free]", tensor);
+        auto& block = m_blocks[event.second];
+        if (event.first)
+        {
+            switch (scheme)
+            {
+            case allocation_scheme::BEST_FIT:
+                offsets[event.second] = sim.best_fit(block.size);
+                break;
+            case allocation_scheme::NO_REUSE:
+                offsets[event.second] = sim.no_reuse_allocator(block.size);
+                break;
+            default: offsets[event.second] = sim.first_fit(block.size); break;
+            }
+        }
+        else if (scheme != allocation_scheme::NO_REUSE)
+        {
+            sim.free_block(offsets[event.second]);
+        }
     }
-    NNFUSION_CHECK(found) << "bad free";
+    return sim.m_max_allocated;
+}
+
+void nnfusion::MemoryAllocator::plan()
+{
+    if (m_scheme != allocation_scheme::OFFLINE || m_blocks.empty())
+        return;
+
+    // Greedy by size: place the largest blocks first, each into the smallest gap left by the
+    // already placed blocks whose lifetimes overlap with it.
+    std::vector<size_t> order(m_blocks.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return m_blocks[a].size > m_blocks[b].size;
+    });
+
+    std::vector<size_t> planned(m_blocks.size());
+    std::vector<size_t> placed;
+    size_t peak = 0;
+    for (auto i : order)
+    {
+        auto& block = m_blocks[i];
+        std::vector<std::pair<size_t, size_t>> busy;
+        for (auto j : placed)
+        {
+            auto& other = m_blocks[j];
+            if (block.start <= other.end && other.start <= block.end)
+                busy.emplace_back(planned[j], planned[j] + other.size);
+        }
+        std::sort(busy.begin(), busy.end());
+
+        size_t best_offset = numeric_limits<size_t>::max();
+        size_t best_gap = numeric_limits<size_t>::max();
+        size_t gap_begin = 0;
+        for (auto& range : busy)
+        {
+            if (range.first > gap_begin)
+            {
+                size_t gap = range.first - gap_begin;
+                if (gap >= block.size && gap < best_gap)
+                {
+                    best_gap = gap;
+                    best_offset = gap_begin;
+                }
+            }
+            gap_begin = max(gap_begin, range.second);
+        }
+        if (best_offset == numeric_limits<size_t>::max())
+            best_offset = gap_begin;
+
+        planned[i] = best_offset;
+        placed.push_back(i);
+        peak = max(peak, best_offset + block.size);
+    }
+
+    // Lower bound: the most memory alive at the same time.
+    size_t live = 0, lower_bound = 0;
+    for (auto& event : m_events)
+    {
+        if (event.first)
+        {
+            live += m_blocks[event.second].size;
+            lower_bound = max(lower_bound, live);
+        }
+        else
+        {
+            live -= m_blocks[event.second].size;
+        }
+    }
+
+    size_t first_fit_peak = m_max_allocated;
+    bool use_plan = peak < first_fit_peak;
+    if (use_plan)
+    {
+        for (size_t i = 0; i < m_blocks.size(); i++)
+        {
+            auto& block = m_blocks[i];
+            for (auto& tensor : block.tensors)
+                tensor->set_pool_offset(planned[i] + (tensor->get_pool_offset() - block.offset));
+            block.offset = planned[i];
+        }
+        for (auto& ref : m_ref_tensors)
+        {
+            auto root = ref.first->get_root_tensor();
+            ref.first->set_pool_offset(root->get_pool_offset() + ref.second);
+        }
+        m_max_allocated = peak;
+    }
+
+    std::stringstream report;
+    report << get_name() << " offline plan: " << m_blocks.size() << " blocks, peak " << peak
+           << " bytes (first_fit " << first_fit_peak << ", best_fit "
+           << simulate(allocation_scheme::BEST_FIT) << ", no_reuse "
+           << simulate(allocation_scheme::NO_REUSE) << ", lower bound " << lower_bound << ")"
+           << (use_plan ? "" : ", keep first_fit placement");
+    m_plan_report = report.str();
+    NNFUSION_LOG(INFO) << m_plan_report;
 }
 
 void nnfusion::MemoryAllocator::dump(ofstream& out)
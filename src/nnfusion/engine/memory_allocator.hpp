@@ -10,6 +10,7 @@
 #include <list>
 
 DECLARE_bool(fmem_trace);
+DECLARE_bool(fmem_offline_plan);
 
 namespace nnfusion
 {
@@ -28,7 +29,10 @@ namespace nnfusion
         {
             FIRST_FIT,
             BEST_FIT,
-            NO_REUSE
+            NO_REUSE,
+            // Place tensors greedily during allocation like FIRST_FIT, while recording the
+            // lifetime of every block; plan() then re-places all blocks at once.
+            OFFLINE
         };
 
         class node
@@ -50,6 +54,10 @@ namespace nnfusion
                               shared_ptr<descriptor::Tensor> root_tensor,
                               size_t offset = 0);
         virtual void free(shared_ptr<descriptor::Tensor> tensor);
+        // Re-place the recorded blocks of the OFFLINE scheme with all lifetimes known, to
+        // minimize the pool size. Must be called after the last allocate/free.
+        virtual void plan();
+        const std::string& get_plan_report() const { return m_plan_report; }
 
         void dump(std::ofstream&);
         void record(string symbol, shared_ptr<descriptor::Tensor> tensor);
@@ -67,6 +75,10 @@ namespace nnfusion
         std::list<node>::const_iterator end() const { return m_node_list.cend(); }
         const std::list<node>& get_node_list() const { return m_node_list; }
         size_t max_allocated() const { return m_max_allocated; }
+        const std::vector<shared_ptr<descriptor::Tensor>>& get_allocated_tensors() const
+        {
+            return m_allocated_tensors;
+        }
         size_t cur_allocated() const;
         size_t memory_in_use() const;
         void set_alloc_scheme(allocation_scheme alloc_schem) { m_scheme = alloc_schem; }
@@ -81,6 +93,23 @@ namespace nnfusion
         size_t first_fit(size_t size);
         size_t best_fit(size_t size);
         size_t no_reuse_allocator(size_t size);
+        bool free_block(size_t offset);
+        // Peak pool size of replaying the recorded allocation trace with the given scheme.
+        size_t simulate(allocation_scheme scheme) const;
+
+        // A root tensor, or a group of tensors allocated together, and its liveness interval
+        // in allocation events.
+        struct lifetime_block
+        {
+            size_t size;
+            size_t start;
+            size_t end;
+            size_t offset;
+            std::vector<shared_ptr<descriptor::Tensor>> tensors;
+        };
+        void record_block(std::vector<shared_ptr<descriptor::Tensor>> tensors,
+                          size_t offset,
+                          size_t size);
 
         std::list<node> m_node_list;
         size_t m_alignment;
@@ -93,6 +122,13 @@ namespace nnfusion
         bool record_trace = FLAGS_fmem_trace;
         std::string m_symbol;
         std::string m_name;
+        // OFFLINE scheme only: recorded blocks, allocation (true) / free events in program
+        // order, and the offset of ref tensors relative to their root tensor.
+        std::vector<lifetime_block> m_blocks;
+        std::vector<std::pair<bool, size_t>> m_events;
+        std::unordered_map<descriptor::Tensor*, size_t> m_block_of;
+        std::vector<std::pair<shared_ptr<descriptor::Tensor>, size_t>> m_ref_tensors;
+        std::string m_plan_report;
         MemoryAllocator(size_t alignment = 1,
                         bool disable_reuse = false,
                         NNFusion_DeviceType device_type = CUDA_GPU,
@@ -2,6 +2,8 @@
 // Licensed under the MIT License.
 
 #include "base_codegen_pass.hpp"
+#include <dirent.h>
+#include "codegen_langunit.hpp"
 #include "nnfusion/core/kernels/kernel_emitter.hpp"
 
 using namespace nnfusion;
@@ -14,6 +16,8 @@ DECLARE_int64(fkernels_files_number);
 DECLARE_bool(fcustomized_mem_imp);
 DECLARE_string(fantares_perf_file);
 DECLARE_bool(ffunction_codegen);
+DECLARE_string(fkernel_cache_dir);
+
 bool BaseCodegenPass::run(std::shared_ptr<InterpreterContext> ctx,
                           std::shared_ptr<TranslationUnit> tu)
 {
@@ -27,7 +31,8 @@ bool BaseCodegenPass::run(std::shared_ptr<InterpreterContext> ctx,
     projgen->codegen();
     NNFUSION_CHECK(after_projgen());
     NNFUSION_LOG(INFO) << "Codegen for " << get_device_str(device_type()) << " done.";
-    exit(0);
+    if (exit_after_codegen())
+        exit(0);
 
     return true;
 }
@@ -67,19 +72,45 @@ void BaseCodegenPass::separate_func_defs_files(int file_number, const string& ke
 
     if (file_number <= 0)
     {
+        // One file per kernel, named by the SHA-1 of its code, so that an unchanged kernel keeps
+        // its file and its cached object across projects and builds of nnfusion.
+        std::unordered_set<std::string> kernel_files;
+        // the code of each file name taken, to tell a collision from a repeated kernel
+        std::unordered_map<std::string, std::string> file_codes;
         for (auto it : kernel_func_defs)
         {
             LanguageUnit_p func_def = it.second.second;
             if (func_def->pwd.empty())
                 func_def->pwd = kernel_folder;
-            string fname = func_def->symbol;
-            if (fname.length() > 128)
+            if (func_def->write_to.empty())
             {
-                size_t hashcode = std::hash<std::string>{}(fname);
-                fname = "compressed_src_" + std::to_string(hashcode);
+                std::string code = func_def->get_code();
+                for (auto& dep : func_def->local_symbol)
+                    code += dep.second->get_code();
+                std::string fname = "kernel_" + nnfusion::sha1_digest(code + m_kernel_suffix);
+                std::string write_to = fname + m_kernel_suffix;
+                for (int i = 1; file_codes.count(write_to) > 0 && file_codes[write_to] != code;
+                     i++)
+                {
+                    NNFUSION_LOG(NNFUSION_WARNING) << "Kernel file name collision on " << write_to;
+                    write_to = fname + "_" + to_string(i) + m_kernel_suffix;
+                }
+                file_codes[write_to] = code;
+                func_def->write_to = write_to;
             }
-            if (func_def->write_to.empty())
-                func_def->write_to = fname + m_kernel_suffix;
+            kernel_files.insert(func_def->write_to);
+        }
+
+        // The project globs its kernels, drop the ones an earlier codegen left behind.
+        if (DIR* dir = opendir(kernel_folder.c_str()))
+        {
+            while (struct dirent* entry = readdir(dir))
+            {
+                std::string fname(entry->d_name);
+                if (fname.compare(0, 7, "kernel_") == 0 && kernel_files.count(fname) == 0)
+                    remove((kernel_folder + fname).c_str());
+            }
+            closedir(dir);
         }
     }
     else
@@ -96,6 +127,27 @@ void BaseCodegenPass::separate_func_defs_files(int file_number, const string& ke
     }
 }
 
+bool BaseCodegenPass::codegen_kernel_cache()
+{
+    if (!FLAGS_fkernels_as_files || FLAGS_fkernel_cache_dir.empty())
+        return false;
+    std::string cache_dir = FLAGS_fkernel_cache_dir;
+    if (cache_dir[0] != '/')
+    {
+        char* cwd = get_current_dir_name();
+        cache_dir = cwd + std::string("/") + cache_dir;
+        free(cwd);
+    }
+
+    LanguageUnit_p lup_kernel_cache = std::make_shared<LanguageUnit>("codegen_kernel_cache");
+    projgen->lup_codegen->require(lup_kernel_cache);
+    lup_kernel_cache->pwd = m_codegen_folder;
+    lup_kernel_cache->write_to = "kernel_cache.sh";
+    *lup_kernel_cache << "#!/bin/bash\ncache_dir=\"" << cache_dir << "\"\n"
+                      << nnfusion::codegen::helper::kernel_cache->get_code();
+    return true;
+}
+
 void BaseCodegenPass::add_init_and_exit_pair(LanguageUnit_p lup_in_init, LanguageUnit_p lup_in_exit)
 {
     //add to init
@@ -206,10 +258,11 @@ bool BaseCodegenPass::collect_mem(std::shared_ptr<InterpreterContext> ctx,
 bool BaseCodegenPass::after_projgen()
 {
     struct stat s;
-    std::string constant_folder = get_current_dir_name() + std::string("/Constant");
-    std::string para_info_json = get_current_dir_name() + std::string("/para_info.json");
-    std::string antares_perf_path =
-        get_current_dir_name() + std::string("/") + FLAGS_fantares_perf_file;
+    char* cwd = get_current_dir_name();
+    std::string constant_folder = cwd + std::string("/Constant");
+    std::string para_info_json = cwd + std::string("/para_info.json");
+    std::string antares_perf_path = cwd + std::string("/") + FLAGS_fantares_perf_file;
+    free(cwd);
     if (stat(constant_folder.c_str(), &s) == 0)
     {
         std::string nnfusion_rt_const_folder = m_codegen_folder + std::string("Constant");
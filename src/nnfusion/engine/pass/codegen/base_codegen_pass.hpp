@@ -43,6 +43,8 @@ namespace nnfusion
             }
             virtual bool modify_codegen() { return true; }
             virtual bool after_projgen();
+            // The process ends with the codegen unless another project is generated after it.
+            virtual bool exit_after_codegen() { return true; }
             virtual nnfusion::codegen::CodegenFuncCallsUnit_p
                 get_kernel_func_calls(const string& calls_symbol,
                                       CodegenMainBlockUnit_p main_block);
@@ -64,6 +66,9 @@ namespace nnfusion
             const std::string& get_kernel_suffix() const { return m_kernel_suffix; }
             const std::string& get_kernel_folder() const { return m_kernel_folder; }
             void separate_func_defs_files(int file_number, const std::string& kernel_folder);
+            // Writes kernel_cache.sh, the compiler wrapper of -fkernel_cache_dir, returns false
+            // when kernels are not cached.
+            bool codegen_kernel_cache();
             void add_init_and_exit_pair(LanguageUnit_p lup_in_init, LanguageUnit_p lup_in_exit);
 
             template <typename LanguageUnitType1, typename LanguageUnitType2>
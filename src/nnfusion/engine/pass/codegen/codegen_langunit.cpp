@@ -8,7 +8,7 @@ LU_DEFINE(nnfusion::codegen::cmake::cblas,
 if (NOT TARGET libmkl)
 include(mkl/mkl.cmake)
 endif()
-target_link_libraries(nnfusion_cpu_rt pthread libmkl)
+target_link_libraries(${TARGET_NAME} pthread libmkl)
 )");
 
 LU_DEFINE(nnfusion::codegen::cmake::eigen,
@@ -104,6 +104,23 @@ add_dependencies(${TARGET_NAME} CUB)
 include_directories(${CUB_INCLUDE_DIR})
 )");
 
+LU_DEFINE(nnfusion::codegen::cmake::kernel_cache_launcher,
+          R"(
+set(CMAKE_CXX_COMPILER_LAUNCHER bash ${CMAKE_CURRENT_SOURCE_DIR}/kernel_cache.sh)
+)");
+
+LU_DEFINE(nnfusion::codegen::cmake::kernel_cache_nvcc,
+          R"(
+file(WRITE ${CMAKE_CURRENT_BINARY_DIR}/kernel_cache/nvcc_cached
+    "#!/bin/sh\nexec bash ${CMAKE_CURRENT_SOURCE_DIR}/kernel_cache.sh "
+    "${CUDA_NVCC_EXECUTABLE} \"$@\"\n")
+file(COPY ${CMAKE_CURRENT_BINARY_DIR}/kernel_cache/nvcc_cached
+    DESTINATION ${CMAKE_CURRENT_BINARY_DIR}
+    FILE_PERMISSIONS OWNER_READ OWNER_WRITE OWNER_EXECUTE
+                     GROUP_READ GROUP_EXECUTE WORLD_READ WORLD_EXECUTE)
+set(CUDA_NVCC_EXECUTABLE ${CMAKE_CURRENT_BINARY_DIR}/nvcc_cached)
+)");
+
 LU_DEFINE(nnfusion::codegen::helper::debug,
           R"(
 
@@ -136,3 +153,91 @@ inline void Debug(std::string name, float* tensor_ptr, std::string inputs, size_
     free(host_tensor);
 }
 )");
+
+LU_DEFINE(nnfusion::codegen::helper::kernel_cache,
+          R"(
+# Runs a compile command of the project through a cache of object files, keyed by the compiler,
+# its command line and the preprocessed source, so that a kernel which an earlier project has
+# already compiled is copied instead of compiled again. Other commands run as they are.
+cache_dir="${NNFUSION_KERNEL_CACHE_DIR:-$cache_dir}"
+# the folder of the project, which is left out of the key so that projects share their objects
+project="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+out=""
+compile=0
+prev=""
+# the command line without the output files, and the command which preprocesses the source
+key_args=()
+pre_args=()
+for arg in "$@"; do
+    case "$prev" in
+    -o)
+        out="$arg"
+        prev=""
+        continue
+        ;;
+    -MF | -MT | -MQ)
+        pre_args+=("$arg")
+        prev=""
+        continue
+        ;;
+    -gencode | -arch | --generate-code | --gpu-architecture)
+        key_args+=("$arg")
+        prev=""
+        continue
+        ;;
+    esac
+    prev="$arg"
+    case "$arg" in
+    -o)
+        continue
+        ;;
+    -MF | -MT | -MQ | -MD | -MMD)
+        # a cache hit still writes the dependencies of the object
+        pre_args+=("$arg")
+        continue
+        ;;
+    -gencode | -arch | --generate-code | --gpu-architecture | -gencode=* | -arch=* | \
+        --generate-code=* | --gpu-architecture=*)
+        # nvcc preprocesses for a single architecture only
+        key_args+=("$arg")
+        continue
+        ;;
+    -c)
+        compile=1
+        key_args+=("$arg")
+        pre_args+=(-E)
+        continue
+        ;;
+    esac
+    key_args+=("$arg")
+    pre_args+=("$arg")
+done
+
+if [ $compile = 0 ] || [ -z "$out" ] || [ -z "$cache_dir" ]; then
+    exec "$@"
+fi
+source=$("${pre_args[@]}" 2>/dev/null) || exec "$@"
+# the paths of the command line and of the linemarkers, relative to the project
+key=$({
+    printf '%s\n' "${key_args[@]}"
+    "$1" --version 2>&1
+    printf '%s\n' "$source"
+} | project="$project" awk '{
+    line = ""
+    while ((i = index($0, ENVIRON["project"])) > 0)
+    {
+        line = line substr($0, 1, i - 1) "."
+        $0 = substr($0, i + length(ENVIRON["project"]))
+    }
+    print line $0
+}' | sha1sum | cut -d' ' -f1)
+
+mkdir -p "$cache_dir"
+object="$cache_dir/$key.o"
+if [ -f "$object" ]; then
+    cp "$object" "$out"
+    exit 0
+fi
+"$@" || exit $?
+cp "$out" "$object.$$" && mv "$object.$$" "$object"
+)");
@@ -20,10 +20,13 @@ namespace nnfusion
             LU_DECLARE(cuda_lib);
             LU_DECLARE(rocm_lib);
             LU_DECLARE(cub);
+            LU_DECLARE(kernel_cache_launcher);
+            LU_DECLARE(kernel_cache_nvcc);
         } // namespace cmake
         namespace helper
         {
             LU_DECLARE(debug);
+            LU_DECLARE(kernel_cache);
         } // namespace helper
     }     // namespace codegen
 } // namespace nnfusion
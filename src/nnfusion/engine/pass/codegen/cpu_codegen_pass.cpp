@@ -14,9 +14,15 @@
 #include "nnfusion/common/descriptor/tensor.hpp"
 #include "nnfusion/core/kernels/common_langunit.hpp"
 #include "nnfusion/core/kernels/cpu/barrier.hpp"
+#include "nnfusion/core/kernels/cpu/cpu_kernel_emitter.hpp"
 #include "nnfusion/core/kernels/cpu/cpu_langunit.hpp"
+#include "nnfusion/core/kernels/cpu/general/control_flow.hpp"
+#include "nnfusion/core/kernels/cpu/kernel_trace.hpp"
 #include "nnfusion/core/kernels/cpu/reference/reference_common.hpp"
+#include "nnfusion/core/kernels/cpu/task_graph.hpp"
 #include "nnfusion/core/kernels/cuda_gpu/cuda_langunit.hpp"
+#include "nnfusion/core/kernels/weight_pack.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
 
 using namespace nnfusion;
 using namespace nnfusion::graph;
@@ -26,19 +32,247 @@ using namespace nnfusion::async;
 
 DEFINE_int32(fnuma_node_num, 1, "");
 DEFINE_int32(fthread_num_per_node, 0, "");
+DEFINE_bool(fcpu_task_graph,
+            false,
+            "Run the CPU kernels as a task graph on a work-stealing executor instead of in order.");
+DEFINE_int32(fcpu_task_graph_threads,
+             0,
+             "Number of threads of the CPU task graph executor, 0 means all cores.");
+DEFINE_string(fkernel_trace,
+              "",
+              "Time every kernel call of kernel_entry, cpu_free writes a Chrome trace to this file "
+              "and prints the time per node and op type.");
+DEFINE_int32(fkernel_trace_events, 65536, "Number of latest kernel calls kept for the trace.");
+DEFINE_bool(fmlas_prepack, true, "Pack the constant weights of MLAS GEMM kernels in cpu_init.");
+DEFINE_bool(fcpu_sessions,
+            false,
+            "Also emit nnf_session_create/run/destroy: sessions share the weights of cpu_init and "
+            "own their intermediate tensors, so that threads can run them concurrently.");
 DECLARE_bool(fkernels_as_files);
+DECLARE_int32(fwarmup_step);
+DECLARE_int32(frun_step);
 DECLARE_int64(fkernels_files_number);
 DECLARE_bool(frt_const_folding);
 DECLARE_bool(fextern_result_memory);
 DECLARE_bool(fcustomized_mem_imp);
 DECLARE_bool(ffunction_codegen);
 
+namespace
+{
+    // The code of a kernel and its dependencies with its own name left out, kernels of different
+    // buckets with the same key compute the same function.
+    std::string get_bucket_kernel_key(FunctionUnit_p fu, const std::string& code)
+    {
+        std::string name = fu->name_unit->get_code();
+        std::string key = code;
+        for (size_t pos = key.find(name); pos != std::string::npos; pos = key.find(name, pos))
+            key.replace(pos, name.size(), "@function_name@");
+        for (auto& it : fu->dep_unit->local_symbol)
+            key += it.second->get_code();
+        return key;
+    }
+
+    // Byte range of a tensor buffer, tensors outside the memory pools only alias themselves.
+    struct MemRange
+    {
+        std::string pool;
+        size_t begin;
+        size_t end;
+    };
+
+    MemRange get_mem_range(const std::shared_ptr<nnfusion::descriptor::Tensor>& tensor)
+    {
+        if (tensor->get_pool().empty() || tensor->get_pool_offset() == SIZE_MAX)
+            return MemRange{"tensor:" + tensor->get_name(), 0, 1};
+        size_t begin = tensor->get_pool_offset();
+        return MemRange{tensor->get_pool(), begin, begin + std::max<size_t>(tensor->size(), 1)};
+    }
+
+    bool overlap(const std::vector<MemRange>& a, const std::vector<MemRange>& b)
+    {
+        for (auto& x : a)
+            for (auto& y : b)
+                if (x.pool == y.pool && x.begin < y.end && y.begin < x.end)
+                    return true;
+        return false;
+    }
+
+    // Predecessors of every task: task j waits for an earlier task i when both touch the same
+    // memory and one of them writes it. Edges implied by other edges are dropped.
+    std::vector<std::vector<int>>
+        get_task_dependencies(const std::vector<nnfusion::ir::Instruction::Pointer>& tasks)
+    {
+        size_t n = tasks.size();
+        std::vector<std::vector<MemRange>> reads(n), writes(n);
+        std::vector<bool> unknown(n, false);
+        for (size_t i = 0; i < n; i++)
+        {
+            auto kernel = tasks[i]->getKernel();
+            if (!kernel || !kernel->m_context)
+            {
+                unknown[i] = true;
+                continue;
+            }
+            for (auto& tensor : kernel->m_context->inputs)
+                reads[i].push_back(get_mem_range(tensor));
+            for (auto& tensor : kernel->m_context->outputs)
+                writes[i].push_back(get_mem_range(tensor));
+            for (auto& tensor : kernel->m_context->tensors)
+                writes[i].push_back(get_mem_range(tensor));
+        }
+
+        auto conflict = [&](size_t i, size_t j) {
+            return unknown[i] || unknown[j] || overlap(writes[i], reads[j]) ||
+                   overlap(writes[i], writes[j]) || overlap(reads[i], writes[j]);
+        };
+
+        // The reachability matrix costs n * n bits, huge graphs keep all edges.
+        bool reduce = n <= 16384;
+        std::vector<std::vector<bool>> reach(reduce ? n : 0);
+        std::vector<std::vector<int>> preds(n);
+        for (size_t j = 0; j < n; j++)
+        {
+            if (reduce)
+                reach[j].assign(j, false);
+            for (int i = (int)j - 1; i >= 0; i--)
+            {
+                if ((reduce && reach[j][i]) || !conflict(i, j))
+                    continue;
+                preds[j].push_back(i);
+                if (reduce)
+                {
+                    reach[j][i] = true;
+                    for (int k = 0; k < i; k++)
+                        if (reach[i][k])
+                            reach[j][k] = true;
+                }
+            }
+        }
+        return preds;
+    }
+
+    void emit_int_array(LanguageUnit& lu, const std::string& name, const std::vector<int>& values)
+    {
+        lu << "static const int " << name << "[] = {";
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            if (i % 32 == 0)
+                lu << "\n    ";
+            lu << values[i] << (i + 1 < values.size() ? ", " : "");
+        }
+        // zero-sized arrays are not allowed
+        if (values.empty())
+            lu << "-1";
+        lu << "};\n";
+    }
+
+    // s as a quoted C string literal, for names and paths pasted into the generated code.
+    std::string c_string_literal(const std::string& s)
+    {
+        std::string out = "\"";
+        for (unsigned char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (c < 0x20 || c == 0x7f)
+            {
+                char code[8];
+                snprintf(code, sizeof(code), "\\%03o", c);
+                out += code;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        return out + "\"";
+    }
+}
+
 void CpuCodegenPass::set_global_member(std::shared_ptr<InterpreterContext> ctx,
                                        std::shared_ptr<TranslationUnit> tu)
 {
     this->host_async_manager =
         AsyncManagerFactory::get_host_async_manager(tu->m_graph, GENERIC_CPU);
 
+    use_task_graph = FLAGS_fcpu_task_graph;
+    if (use_task_graph && FLAGS_fcustomized_mem_imp)
+    {
+        NNFUSION_LOG(NNFUSION_WARNING)
+            << "-fcpu_task_graph is not supported with -fcustomized_mem_imp, kernels run in order.";
+        use_task_graph = false;
+    }
+    // The task graph orders the kernels by their memory dependencies, the host streams and
+    // barriers are not used.
+    if (use_task_graph)
+        this->host_async_manager = nullptr;
+
+    // A session points the intermediate tensors of the calling thread into its workspace, every
+    // kernel of kernel_entry has to run on that thread or get its tensors as arguments.
+    use_sessions = FLAGS_fcpu_sessions;
+    std::string session_conflict;
+    if (use_task_graph)
+        session_conflict = "-fcpu_task_graph";
+    else if (!FLAGS_fkernel_trace.empty())
+        session_conflict = "-fkernel_trace";
+    else if (FLAGS_fcustomized_mem_imp)
+        session_conflict = "-fcustomized_mem_imp";
+    else if (FLAGS_ffunction_codegen)
+        session_conflict = "-ffunction_codegen";
+    else if (host_async_manager && host_async_manager->num_non_default_stream() > 0)
+        session_conflict = "host streams";
+    if (use_sessions && session_conflict.empty())
+    {
+        std::vector<std::shared_ptr<nnfusion::descriptor::Tensor>> init_tensors;
+        for (auto iterator : tu->program)
+        {
+            for (auto ins : *iterator)
+            {
+                auto gnode = ins->getGNode();
+                if (!gnode || gnode->is_parameter() || !is_init_instruction(ins))
+                    continue;
+                init_tensors.insert(
+                    init_tensors.end(), ins->get_outputs().begin(), ins->get_outputs().end());
+                auto kernel = ins->getKernel();
+                if (kernel && kernel->m_context)
+                    init_tensors.insert(init_tensors.end(),
+                                        kernel->m_context->tensors.begin(),
+                                        kernel->m_context->tensors.end());
+            }
+        }
+        for (auto& tensor : init_tensors)
+        {
+            if (!tensor->get_root_tensor())
+                shared_tensors.insert(tensor->get_name());
+        }
+        // e.g. a constant placed in the output of an inplace concat, which cpu_init would only
+        // fill in its own copy
+        for (auto& tensor : init_tensors)
+        {
+            if (!is_shared_tensor(tensor))
+                session_conflict = "the constant " + tensor->get_name() +
+                                   " inside the intermediate tensor " +
+                                   tensor->get_root_tensor()->get_name();
+        }
+    }
+    if (use_sessions && !session_conflict.empty())
+    {
+        NNFUSION_LOG(NNFUSION_WARNING) << "-fcpu_sessions is not supported with "
+                                       << session_conflict << ", no session API is emitted.";
+        use_sessions = false;
+    }
+    if (use_sessions)
+    {
+        for (const auto& allocator : tu->memory_allocator_factory->get_allocator_list())
+        {
+            session_pool_offset[allocator.second->get_name()] = session_workspace_size;
+            session_workspace_size += allocator.second->max_allocated();
+        }
+    }
+
     auto& prog = tu->program;
     for (auto iterator : prog)
     {
@@ -109,9 +343,10 @@ void CpuCodegenPass::initialize(std::shared_ptr<InterpreterContext> ctx,
     auto& lu_init_begin = *(projgen->lup_init->begin);
     {
         if (FLAGS_ffunction_codegen)
-            lu_init_begin << "\nextern \"C\" void cpu_init(char* workspace)\n{\n";
+            lu_init_begin << "\nextern \"C\" void " << m_entry_prefix
+                          << "cpu_init(char* workspace)\n{\n";
         else
-            lu_init_begin << "\nextern \"C\" void cpu_init()\n{\n";
+            lu_init_begin << "\nextern \"C\" void " << m_entry_prefix << "cpu_init()\n{\n";
     }
 
     auto& lu_init_end = *(projgen->lup_init->end);
@@ -122,7 +357,12 @@ void CpuCodegenPass::initialize(std::shared_ptr<InterpreterContext> ctx,
     auto& lu_exec_begin = *(projgen->lup_exec->begin);
     {
         std::string params = get_kernel_entry_paras(tu);
-        lu_exec_begin << "extern \"C\" int kernel_entry(" << params << ")\n{\n";
+        // kernel_entry runs the default session, see emit_session_api.
+        if (use_sessions)
+            lu_exec_begin << "static int nnf_session_entry(" << params << ")\n{\n";
+        else
+            lu_exec_begin << "extern \"C\" int " << m_entry_prefix << "kernel_entry(" << params
+                          << ")\n{\n";
     }
 
     auto& lu_exec_init = *(projgen->lup_exec->begin);
@@ -132,10 +372,14 @@ void CpuCodegenPass::initialize(std::shared_ptr<InterpreterContext> ctx,
         // emit memset
         for (const auto& allocator : allocator_list)
         {
-            if (allocator.first.find("memset") != std::string::npos)
-            {
+            if (allocator.first.find("memset") == std::string::npos)
+                continue;
+            if (use_sessions)
+                lu_exec_init << "memset(nnf_session_workspace + "
+                             << session_pool_offset[allocator.second->get_name()] << ", 0, "
+                             << allocator.second->max_allocated() << ");\n";
+            else
                 lu_exec_init << allocator.second->emit_memory_set(0)->get_code();
-            }
         }
     }
 
@@ -147,20 +391,31 @@ void CpuCodegenPass::initialize(std::shared_ptr<InterpreterContext> ctx,
 
     auto& lu_exit_begin = *(projgen->lup_exit->begin);
     {
-        lu_exit_begin << "extern \"C\" void cpu_free()\n{\n";
+        lu_exit_begin << "extern \"C\" void " << m_entry_prefix << "cpu_free()\n{\n";
     }
 
     auto& lu_exit_end = *(projgen->lup_exit->end);
     {
         lu_exit_end << "}\n";
     }
+    if (!m_entry_prefix.empty())
+    {
+        LanguageUnit_p shared_decl =
+            std::make_shared<LanguageUnit>("declaration::bucket_shared_resources");
+        *shared_decl << "// filled in by the dispatcher before cpu_init, see ShapeBucketContext\n"
+                     << "extern \"C\"\n{\nvoid* " << m_entry_prefix << "shared_resources["
+                     << ShapeBucketContext::NumSharedResources << "];\n}\n";
+        projgen->lup_codegen->require(shared_decl);
+    }
+
     //add requirements
     projgen->lup_codegen->require(codegen_device_type());
     projgen->lup_codegen->require(codegen_workspace_size(tu));
     // add component
     // create_graph_config(ctx, tu);
     create_header_file(ctx, tu);
-    create_main_file(ctx, tu);
+    if (m_entry_prefix.empty())
+        create_main_file(ctx, tu);
     create_cmake_file(ctx, tu);
 
     return;
@@ -170,18 +425,29 @@ void CpuCodegenPass::initialize(std::shared_ptr<InterpreterContext> ctx,
 void CpuCodegenPass::create_cmake_file(std::shared_ptr<InterpreterContext> ctx,
                                        std::shared_ptr<TranslationUnit> tu)
 {
-    LanguageUnit_p lup_cmake = std::make_shared<LanguageUnit>("codegen_cmake");
+    lup_cmake = std::make_shared<LanguageUnit>("codegen_cmake");
     projgen->lup_codegen->require(lup_cmake);
     lup_cmake->pwd = m_codegen_folder;
     lup_cmake->write_to = "CMakeLists.txt";
 
     auto& lu = *lup_cmake;
-    lu << R"(project(main_test)
+    if (!m_entry_prefix.empty())
+    {
+        // Built by the dispatcher project through add_subdirectory, every bucket keeps its
+        // symbols private except those in the exports.map the dispatcher writes.
+        lu << "SET(SRC \"nnfusion_rt.cpp\")\n";
+        lu << "SET(TARGET_NAME \"nnfusion_" << m_entry_prefix << "cpu_rt\")\n";
+    }
+    else
+    {
+        lu << R"(project(main_test)
 cmake_minimum_required(VERSION 3.5)
 
 SET(SRC "nnfusion_rt.cpp" CACHE STRING "codegen source file")
 SET(TARGET_NAME "nnfusion_cpu_rt" CACHE STRING "codegen target name")
-
+)";
+    }
+    lu << R"(
 set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fPIC -std=gnu++11 -O3 -march=native -pthread")
 )";
 
@@ -189,10 +455,21 @@ set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fPIC -std=gnu++11 -O3 -march=native -p
     {
         lu << "\nfile(GLOB kernels kernels/*" << m_kernel_suffix << ")\n";
         lu << "list(APPEND SRC ${kernels} shared" << m_kernel_suffix << ")\n";
-        lu << "include_directories(${CMAKE_SOURCE_DIR})\n\n";
+        lu << "include_directories(${CMAKE_CURRENT_SOURCE_DIR})\n\n";
+        if (codegen_kernel_cache())
+            lu << nnfusion::codegen::cmake::kernel_cache_launcher->get_code();
     }
 
-    lu << "add_library(${TARGET_NAME} ${SRC})\n";
+    if (!m_entry_prefix.empty())
+    {
+        lu << "add_library(${TARGET_NAME} SHARED ${SRC})\n";
+        lu << "set_target_properties(${TARGET_NAME} PROPERTIES LINK_FLAGS "
+              "\"-Wl,--version-script=${CMAKE_CURRENT_SOURCE_DIR}/exports.map\")\n";
+    }
+    else
+    {
+        lu << "add_library(${TARGET_NAME} ${SRC})\n";
+    }
 
     // Prepare submodule
     {
@@ -202,7 +479,8 @@ set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fPIC -std=gnu++11 -O3 -march=native -p
             lu << nnfusion::codegen::cmake::cblas->get_code();
         }
 
-        if (need_intra_node_threadpool || host_async_manager->num_non_default_stream() > 0)
+        if (need_intra_node_threadpool ||
+            (host_async_manager && host_async_manager->num_non_default_stream() > 0))
         {
             // add eigen
             lu << nnfusion::codegen::cmake::eigen->get_code();
@@ -221,11 +499,14 @@ set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fPIC -std=gnu++11 -O3 -march=native -p
         lu << nnfusion::codegen::cmake::threads->get_code();
     }
 
-    lu << R"(
+    if (m_entry_prefix.empty())
+    {
+        lu << R"(
 add_executable(main_test main_test.cpp)   
 target_link_libraries(main_test ${TARGET_NAME}) 
 
 )";
+    }
     return;
 }
 
@@ -244,6 +525,14 @@ void CpuCodegenPass::create_main_file(std::shared_ptr<InterpreterContext> ctx,
     re_main->require(header::stdlib);
     re_main->require(header::sstream);
     re_main->require(header::stdexcept);
+    re_main->require(header::cstring);
+    re_main->require(header::fstream);
+    re_main->require(header::vector);
+    re_main->require(header::algorithm);
+    re_main->require(header::thread);
+    re_main->require(header::mutex);
+    re_main->require(header::random);
+    re_main->require(header::resource);
 
     re_main->require(header::chrono);
 
@@ -253,104 +542,227 @@ void CpuCodegenPass::create_main_file(std::shared_ptr<InterpreterContext> ctx,
         if (it.second->symbol.find("header::") != string::npos)
             lu_main << it.second->get_code();
 
-    lu_main << "using Clock = std::chrono::high_resolution_clock;\n\n";
+    lu_main << "using Clock = std::chrono::high_resolution_clock;\n";
+    lu_main << op::create_code_from_template(
+        R"(
+struct nnfusion_bench_args
+{
+    int threads = 1;
+    int warmup = @warmup@;
+    int steps = @steps@;
+    bool random = false;
+    unsigned seed = 0;
+    const char* csv = nullptr;
+};
+
+static nnfusion_bench_args nnfusion_bench_parse(int argc, char** argv)
+{
+    nnfusion_bench_args args;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--threads" && has_value)
+            args.threads = std::max(atoi(argv[++i]), 1);
+        else if (arg == "--warmup" && has_value)
+            args.warmup = std::max(atoi(argv[++i]), 0);
+        else if (arg == "--steps" && has_value)
+            args.steps = std::max(atoi(argv[++i]), 1);
+        else if (arg == "--seed" && has_value)
+            args.seed = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--csv" && has_value)
+            args.csv = argv[++i];
+        else if (arg == "--random")
+            args.random = true;
+        else
+        {
+            printf("usage: %s [--threads N] [--warmup N] [--steps N] [--random] [--seed S] "
+                   "[--csv FILE]\n",
+                   argv[0]);
+            exit(arg == "--help" ? 0 : 1);
+        }
+    }
+    return args;
+}
+
+// Nearest-rank percentile of sorted latencies.
+static double nnfusion_bench_percentile(const std::vector<double>& sorted, double p)
+{
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::min(std::max(rank, static_cast<size_t>(1)), sorted.size()) - 1];
+}
+
+template <typename T>
+static void nnfusion_bench_fill(T* data, size_t size, bool random, unsigned seed)
+{
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (size_t i = 0; i < size; ++i)
+        data[i] = random ? static_cast<T>(dist(engine)) : static_cast<T>(1.0f);
+}
 
-    LanguageUnit fillval("fillval");
+)",
+        {{"warmup", FLAGS_fwarmup_step}, {"steps", FLAGS_frun_step}});
 
-    lu_main << "int main(void)";
+    lu_main << "int main(int argc, char** argv)";
     lu_main.block_begin();
     {
+        lu_main << "nnfusion_bench_args args = nnfusion_bench_parse(argc, argv);\n";
         lu_main << "\ncpu_init();\n\n";
 
+        // Every client thread owns its inputs and outputs.
+        vector<string> entry_args;
+        lu_main << "//input arguments of each thread\n";
         for (size_t i = 0; i < tu->arg.size(); i++)
         {
             auto& tensor = *tu->arg[i];
-            //malloc host input arg
-            lu_main << "//input argument\n";
-            lu_main << tensor.get_element_type().c_type_string() << "* " << tensor.get_name()
-                    << "_host = (" << tensor.get_element_type().c_type_string() << "*)"
-                    << "malloc( sizeof(" << tensor.get_element_type().c_type_string() << ")* "
-                    << tensor.get_tensor_layout()->get_size() << ");\n";
-
-            fillval << "for (int i = 0; i < " << tensor.get_tensor_layout()->get_size() << "; ++i) "
-                    << tensor.get_name() << "_host[i] = 1.0f;\n";
+            auto type = tensor.get_element_type().c_type_string();
+            auto size = tensor.get_tensor_layout()->get_size();
+            lu_main << "std::vector<" << type << "*> " << tensor.get_name()
+                    << "_host(args.threads);\n";
+            lu_main << "for (int t = 0; t < args.threads; ++t)";
+            lu_main.block_begin();
+            lu_main << tensor.get_name() << "_host[t] = (" << type << "*)malloc(sizeof(" << type
+                    << ") * " << size << ");\n";
+            // Integer inputs usually index into tables, only floating point ones are randomized.
+            bool random = tensor.get_element_type().is_real();
+            lu_main << "nnfusion_bench_fill(" << tensor.get_name() << "_host[t], " << size << ", "
+                    << (random ? "args.random" : "false") << ", args.seed + t * "
+                    << tu->arg.size() << " + " << i << ");\n";
+            lu_main.block_end();
+            entry_args.push_back(tensor.get_name() + "_host[t]");
         }
 
-        lu_main << "\n//output arguments\n";
+        lu_main << "\n//output arguments of each thread\n";
         for (size_t i = 0; i < tu->out.size(); i++)
         {
             auto& tensor = *tu->out[i];
-            //malloc host output arg
+            auto type = tensor.get_element_type().c_type_string();
+            lu_main << "std::vector<" << type << "*> " << tensor.get_name()
+                    << "_host(args.threads);\n";
             if (FLAGS_fextern_result_memory)
             {
-                lu_main << tensor.get_element_type().c_type_string() << "* " << tensor.get_name()
-                        << "_host = (" << tensor.get_element_type().c_type_string() << "*)"
-                        << "malloc( sizeof(" << tensor.get_element_type().c_type_string() << ")* "
-                        << tensor.get_tensor_layout()->get_size() << ");\n ";
+                lu_main << "for (int t = 0; t < args.threads; ++t) " << tensor.get_name()
+                        << "_host[t] = (" << type << "*)malloc(sizeof(" << type << ") * "
+                        << tensor.get_tensor_layout()->get_size() << ");\n";
+                entry_args.push_back(tensor.get_name() + "_host[t]");
             }
             else
             {
-                lu_main << tensor.get_element_type().c_type_string() << "* " << tensor.get_name()
-                        << "_host;\n";
+                entry_args.push_back("&" + tensor.get_name() + "_host[t]");
             }
         }
-        lu_main << "\n//fill input values\n";
-        lu_main << fillval.get_code();
-        std::string args = get_kernel_entry_args(tu, true);
+        std::string args = join(entry_args, ", ");
+        // Every client thread runs its own session, or all of them share the runtime globals.
+        std::string entry_call = "kernel_entry(" + args + ");\n";
+        if (use_sessions)
+        {
+            lu_main << "\n//sessions of each thread\n";
+            lu_main << "std::vector<nnf_session*> sessions(args.threads);\n";
+            lu_main << "for (int t = 0; t < args.threads; ++t)\n";
+            lu_main << "sessions[t] = nnf_session_create();\n";
+            entry_call = "nnf_session_run(sessions[t], " + args + ");\n";
+        }
 
         lu_main << "\n//warm up\n";
-        lu_main << "int warm_steps = 5;\n";
-        lu_main << "for(int i_=0; i_<warm_steps; i_++)\n";
-        lu_main.block_begin();
-        // kernel launch
-        lu_main << "kernel_entry(" << args << ");\n";
-        lu_main.block_end();
-
-        lu_main << "\n//time measurement\n";
-        lu_main << "auto t_start = Clock::now();\n\n";
-        lu_main << "//kernel call\n";
-        lu_main << "int test_steps = 100;\n";
-        lu_main << "for(int i_=0; i_<test_steps; i_++)\n";
+        lu_main << "for (int t = 0; t < args.threads; ++t)\n";
+        lu_main << "for (int i_ = 0; i_ < std::max(args.warmup, 1); i_++)\n";
         lu_main.block_begin();
-        // kernel launch
-        lu_main << "kernel_entry(" << args << ");\n";
+        lu_main << entry_call;
         lu_main.block_end();
 
-        lu_main << "\n//time measurement\n";
-        lu_main << "auto t_end = Clock::now();\n";
-        lu_main << "std::chrono::duration<double, std::milli> fp_ms = t_end - t_start;\n\n";
-
+        lu_main << "\n{\nint t = 0;\n";
         for (size_t i = 0; i < tu->out.size(); i++)
         {
             auto& tensor = *tu->out[i];
             lu_main << "printf(\"%s \\n\", \"" << tensor.get_name() << ":\");\n"
                     << "for (int i = 0; i < "
                     << std::min(size_t(10), tensor.get_tensor_layout()->get_size())
-                    << "; ++i) printf(\"%e \", (float)" << tensor.get_name() << "_host[i]); "
+                    << "; ++i) printf(\"%e \", (float)" << tensor.get_name() << "_host[t][i]); "
                     << "\nprintf(\" .. (size = " << tensor.get_tensor_layout()->get_size()
-                    << ", ends with %e);\\n\", (float)" << tensor.get_name() << "_host["
+                    << ", ends with %e);\\n\", (float)" << tensor.get_name() << "_host[t]["
                     << tensor.get_tensor_layout()->get_size() - 1 << "]);\n";
         }
+        lu_main << "}\n";
+
+        // Without sessions the runtime keeps its intermediate tensors in globals, so calls of
+        // concurrent clients are serialized and their latency includes the time spent waiting for
+        // the runtime.
+        if (!use_sessions)
+            entry_call = "std::lock_guard<std::mutex> lock(entry_mutex);\n" + entry_call;
+        lu_main << op::create_code_from_template(
+            R"(
+//time measurement
+std::mutex entry_mutex;
+std::vector<std::vector<double>> start_ms(args.threads), latency_ms(args.threads);
+auto bench_start = Clock::now();
+auto client = [&](int t)
+{
+    for (int i_ = 0; i_ < args.steps; i_++)
+    {
+        auto t_start = Clock::now();
+        {
+            @entry_call@
+        }
+        auto t_end = Clock::now();
+        using ms = std::chrono::duration<double, std::milli>;
+        start_ms[t].push_back(ms(t_start - bench_start).count());
+        latency_ms[t].push_back(ms(t_end - t_start).count());
+    }
+};
+std::vector<std::thread> clients;
+for (int t = 1; t < args.threads; ++t)
+    clients.emplace_back(client, t);
+client(0);
+for (auto& c : clients)
+    c.join();
+double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - bench_start).count();
+
+std::vector<double> sorted;
+for (auto& l : latency_ms)
+    sorted.insert(sorted.end(), l.begin(), l.end());
+std::sort(sorted.begin(), sorted.end());
+double total_ms = 0;
+for (double l : sorted)
+    total_ms += l;
+
+if (args.csv)
+{
+    std::ofstream csv(args.csv);
+    csv << "thread,iteration,start_ms,latency_ms\n";
+    for (int t = 0; t < args.threads; ++t)
+        for (size_t i = 0; i < latency_ms[t].size(); ++i)
+            csv << t << "," << i << "," << start_ms[t][i] << "," << latency_ms[t][i] << "\n";
+}
+
+struct rusage usage;
+getrusage(RUSAGE_SELF, &usage);
+printf("threads: %d, steps per thread: %d, random inputs: %s\n", args.threads, args.steps,
+       args.random ? "yes" : "no");
+printf("latency: min %f, p50 %f, p90 %f, p99 %f, max %f ms\n", sorted.front(),
+       nnfusion_bench_percentile(sorted, 50), nnfusion_bench_percentile(sorted, 90),
+       nnfusion_bench_percentile(sorted, 99), sorted.back());
+printf("throughput: %f inferences/s\n", sorted.size() / wall_ms * 1000.0);
+printf("peak RSS: %ld KB\n", usage.ru_maxrss);
+printf("function execution time: %f ms\n", total_ms / sorted.size());
+)",
+            {{"entry_call", entry_call}});
 
-        lu_main << "\nprintf(\"function execution time: %f ms\\n\", fp_ms.count()/test_steps);\n";
         lu_main << "\n//free context\n";
+        if (use_sessions)
+            lu_main << "for (int t = 0; t < args.threads; ++t) nnf_session_destroy(sessions[t]);\n";
         lu_main << "cpu_free();\n";
 
-        //free host input args
+        lu_main << "for (int t = 0; t < args.threads; ++t)";
+        lu_main.block_begin();
         for (size_t i = 0; i < tu->arg.size(); i++)
-        {
-            auto& tensor = *tu->arg[i];
-            lu_main << "free(" << tensor.get_name() << "_host);\n";
-        }
-        // free host output args
+            lu_main << "free(" << tu->arg[i]->get_name() << "_host[t]);\n";
         if (FLAGS_fextern_result_memory)
         {
             for (size_t i = 0; i < tu->out.size(); i++)
-            {
-                auto& tensor = *tu->out[i];
-                lu_main << "free(" << tensor.get_name() << "_host);\n";
-            }
+                lu_main << "free(" << tu->out[i]->get_name() << "_host[t]);\n";
         }
+        lu_main.block_end();
         lu_main << "\nreturn 0;\n";
     }
     lu_main.block_end();
@@ -358,6 +770,216 @@ void CpuCodegenPass::create_main_file(std::shared_ptr<InterpreterContext> ctx,
     return;
 }
 
+std::pair<LanguageUnit_p, LanguageUnit_p>
+    CpuCodegenPass::get_weights_load_and_free(std::shared_ptr<TranslationUnit> tu)
+{
+    // Constants are used in place from a private file mapping: pages stay shared in the page
+    // cache across processes until some kernel writes to them.
+    auto weights = WeightPack::Global();
+    std::string blob_path = WeightPack::folder + WeightPack::blob_name;
+
+    LanguageUnit_p weights_decl = std::make_shared<LanguageUnit>(
+        "declaration::nnfusion_weights_def", "char* nnfusion_weights;\n");
+
+    LanguageUnit_p _lu_load(new LanguageUnit("WEIGHTS_LOAD"));
+    auto& lu_load = *_lu_load;
+    LanguageUnit_p _lu_free(new LanguageUnit("WEIGHTS_FREE"));
+    _lu_free->require(weights_decl);
+    if (!m_entry_prefix.empty())
+    {
+        // All the buckets use the mapping of the dispatcher.
+        lu_load << "nnfusion_weights = (char*)" << m_entry_prefix << "shared_resources["
+                << ShapeBucketContext::Weights << "];\n";
+        lu_load << get_weights_binding(tu)->get_code();
+        _lu_load->require(weights_decl);
+        return std::make_pair(_lu_load, _lu_free);
+    }
+
+    lu_load << "// packed constants: " << blob_path << "\n";
+    lu_load << "int weights_fd = open(\"" << blob_path << "\", O_RDONLY);\n"
+            << "if (weights_fd < 0)\n"
+            << "{\n"
+            << "\tprintf(\"Load " << blob_path << " failed.\\n\");\n"
+            << "\texit(1);\n"
+            << "}\n"
+            << "nnfusion_weights = (char*)mmap(NULL, " << weights->size()
+            << ", PROT_READ | PROT_WRITE, MAP_PRIVATE, weights_fd, 0);\n"
+            << "close(weights_fd);\n"
+            << "if (nnfusion_weights == MAP_FAILED)\n"
+            << "{\n"
+            << "\tprintf(\"Map " << blob_path << " failed.\\n\");\n"
+            << "\texit(1);\n"
+            << "}\n";
+    lu_load << get_weights_binding(tu)->get_code();
+    _lu_load->require(header::mman);
+    _lu_load->require(header::stdio);
+    _lu_load->require(header::stdlib);
+    _lu_load->require(weights_decl);
+
+    *_lu_free << "munmap(nnfusion_weights, " << weights->size() << ");\n";
+
+    return std::make_pair(_lu_load, _lu_free);
+}
+
+bool CpuCodegenPass::is_shared_tensor(const std::shared_ptr<nnfusion::descriptor::Tensor>& tensor)
+{
+    auto root = tensor->get_root_tensor() ? tensor->get_root_tensor() : tensor;
+    return shared_tensors.count(root->get_name()) > 0;
+}
+
+bool CpuCodegenPass::collect_mem(std::shared_ptr<InterpreterContext> ctx,
+                                 std::shared_ptr<TranslationUnit> tu)
+{
+    if (!use_sessions)
+        return CudaCodegenPass::collect_mem(ctx, tu);
+    if (!tu)
+        return false;
+
+    // The tensors written in cpu_init keep their global pointers into the pools, every other
+    // tensor has a thread_local pointer which nnf_session_bind points into a session workspace,
+    // at the offset of its pool given by session_pool_offset.
+    auto mem_pair = create_init_and_exit_pair<LanguageUnitwithVec, LanguageUnitwithVec>("MEM_ALLOC",
+                                                                                        "MEM_FREE");
+    auto lup_mem_alloc = mem_pair.first;
+    auto lup_mem_free = mem_pair.second;
+    LanguageUnit_p lup_bind = std::make_shared<LanguageUnit>("declaration::nnf_session_bind");
+    auto& lu_bind = *lup_bind;
+    lu_bind << "// Point the intermediate tensors of the calling thread into the workspace of "
+               "session.\n";
+    lu_bind << "static void nnf_session_bind(nnf_session* session)\n{\n";
+    lu_bind << "if (nnf_bound_session == session->id)\n    return;\n";
+    lu_bind << "nnf_bound_session = session->id;\n";
+    lu_bind << "nnf_session_workspace = session->workspace;\n";
+    lu_bind << "char* workspace = session->workspace;\n";
+
+    size_t shared_alloc = 0;
+    for (const auto& allocator : tu->memory_allocator_factory->get_allocator_list())
+    {
+        auto pool = allocator.second;
+        if (pool->max_allocated() == 0)
+            continue;
+        std::string pool_name = pool->get_name() + "_memory_pool";
+        size_t session_offset = session_pool_offset[pool->get_name()];
+        LanguageUnit_p init(new LanguageUnit("declaration::" + pool->get_name() + "_init"));
+        LanguageUnit_p alloc(new LanguageUnit(pool->get_name() + "_alloc"));
+        LanguageUnit_p free(new LanguageUnit(pool->get_name() + "_free"));
+        std::stringstream shared_decl, session_decl, shared_binding;
+        for (auto& tensor : pool->get_allocated_tensors())
+        {
+            NNFUSION_CHECK(tensor->get_pool() == pool->get_name());
+            auto type = tensor->get_element_type().c_type_string();
+            // external tensors have no memory in the pool
+            std::string binding = tensor->get_pool_offset() == SIZE_MAX ? "// " : "";
+            if (is_shared_tensor(tensor))
+            {
+                shared_decl << type << "* " << tensor->get_name() << ";\n";
+                shared_binding << binding << tensor->get_name() << " = (" << type << "*)("
+                               << pool_name << "+" << tensor->get_pool_offset() << ");\n";
+            }
+            else
+            {
+                session_decl << "thread_local " << type << "* " << tensor->get_name() << ";\n";
+                lu_bind << binding << tensor->get_name() << " = (" << type << "*)(workspace+"
+                        << session_offset + tensor->get_pool_offset() << ");\n";
+            }
+        }
+        // Sessions leave the part of shared tensors in their workspace untouched, the pool only
+        // exists once for them.
+        if (!shared_decl.str().empty())
+        {
+            *init << "char* " << pool_name << ";\n";
+            *alloc << pool_name << " = (char *)malloc(" << pool->max_allocated() << ");\n";
+            *alloc << shared_binding.str();
+            *free << "free(" << pool_name << ");\n";
+            shared_alloc += pool->max_allocated();
+        }
+        *init << shared_decl.str() << session_decl.str();
+
+        lup_mem_alloc->unit_vec.push_back(alloc);
+        lup_mem_alloc->require(init);
+        lup_mem_free->unit_vec.push_back(free);
+        lup_mem_free->require(init);
+        lup_bind->require(init);
+    }
+    lu_bind << "}\n";
+    LanguageUnit_p total = std::make_shared<LanguageUnit>(
+        "total_memory",
+        "// shared memory:" + to_string(shared_alloc) + ", memory per session:" +
+            to_string(session_workspace_size) + "\n");
+    lup_mem_alloc->unit_vec.insert(lup_mem_alloc->unit_vec.begin(), total);
+
+    if (FLAGS_fpack_constants && !WeightPack::Global()->empty())
+    {
+        WeightPack::Global()->save();
+        auto weights_pair = get_weights_load_and_free(tu);
+        add_init_and_exit_pair(weights_pair.first, weights_pair.second);
+    }
+
+    emit_session_api(tu, lup_bind);
+    return true;
+}
+
+void CpuCodegenPass::emit_session_api(std::shared_ptr<TranslationUnit> tu, LanguageUnit_p lup_bind)
+{
+    LanguageUnit_p session_decl = std::make_shared<LanguageUnit>("declaration::nnf_session_decl");
+    auto& lu_decl = *session_decl;
+    {
+        // Ids are never reused, so that a thread cannot mistake a new session at the address of
+        // a destroyed one for the session it is bound to.
+        lu_decl << "struct nnf_session\n{\n    size_t id;\n    char* workspace;\n};\n";
+        lu_decl << "static std::atomic<size_t> nnf_session_count(0);\n";
+        lu_decl << "static thread_local size_t nnf_bound_session = 0;\n";
+        lu_decl << "static thread_local char* nnf_session_workspace = nullptr;\n";
+        session_decl->require(
+            std::make_shared<LanguageUnit>("header::atomic", "#include <atomic>\n"));
+        session_decl->require(header::stdlib);
+        session_decl->require(header::cstring);
+    }
+    lup_bind->require(session_decl);
+    projgen->lup_exec->require(session_decl);
+
+    std::string params = get_kernel_entry_paras(tu);
+    std::string args = get_kernel_entry_args(tu);
+    LanguageUnit_p session_api = std::make_shared<LanguageUnit>("declaration::nnf_session_api");
+    auto& lu_api = *session_api;
+    {
+        lu_api << "static int nnf_session_entry(" << params << ");\n\n";
+        lu_api << "extern \"C\" nnf_session* " << m_entry_prefix << "nnf_session_create()\n{\n";
+        lu_api << "nnf_session* session = new nnf_session;\n";
+        lu_api << "session->id = ++nnf_session_count;\n";
+        lu_api << "session->workspace = (char*)malloc(" << session_workspace_size << ");\n";
+        lu_api << "return session;\n}\n\n";
+
+        lu_api << "extern \"C\" int " << m_entry_prefix << "nnf_session_run(nnf_session* session, "
+               << params << ")\n{\n";
+        lu_api << "nnf_session_bind(session);\n";
+        lu_api << "return nnf_session_entry(" << args << ");\n}\n\n";
+
+        lu_api << "extern \"C\" void " << m_entry_prefix
+               << "nnf_session_destroy(nnf_session* session)\n{\n";
+        lu_api << "if (nnf_bound_session == session->id)\n    nnf_bound_session = 0;\n";
+        lu_api << "free(session->workspace);\n";
+        lu_api << "delete session;\n}\n\n";
+
+        // kernel_entry keeps working for single threaded callers.
+        lu_api << "static nnf_session* nnf_default_session;\n";
+        lu_api << "extern \"C\" int " << m_entry_prefix << "kernel_entry(" << params << ")\n{\n";
+        lu_api << "return " << m_entry_prefix << "nnf_session_run(nnf_default_session, " << args
+               << ");\n}\n";
+    }
+    session_api->require(lup_bind);
+
+    auto default_session_pair = create_init_and_exit_pair<LanguageUnit, LanguageUnit>(
+        "init_nnf_default_session", "del_nnf_default_session");
+    *default_session_pair.first << "nnf_default_session = " << m_entry_prefix
+                                << "nnf_session_create();\n";
+    *default_session_pair.second << m_entry_prefix << "nnf_session_destroy(nnf_default_session);\n";
+    default_session_pair.first->require(session_api);
+    default_session_pair.second->require(session_api);
+    NNFUSION_LOG(INFO) << "CPU sessions: " << session_workspace_size
+                       << " bytes of workspace per session.";
+}
+
 void CpuCodegenPass::create_header_file(std::shared_ptr<InterpreterContext> ctx,
                                         std::shared_ptr<TranslationUnit> tu)
 {
@@ -374,15 +996,30 @@ void CpuCodegenPass::create_header_file(std::shared_ptr<InterpreterContext> ctx,
     //     lu_header << header::cuda->get_code();
     lu_header << "extern \"C\" int get_device_type();\n";
     lu_header << "extern \"C\" int get_workspace_size();\n";
-    lu_header << "extern \"C\" int kernel_entry(";
+    lu_header << "extern \"C\" int " << m_entry_prefix << "kernel_entry(";
     std::string params = get_kernel_entry_paras(tu);
     lu_header << params;
     lu_header << ");\n";
     if (FLAGS_ffunction_codegen)
-        lu_header << "extern \"C\" void cpu_init(char* workspace);\n";
+        lu_header << "extern \"C\" void " << m_entry_prefix << "cpu_init(char* workspace);\n";
     else
-        lu_header << "extern \"C\" void cpu_init();\n";
-    lu_header << "extern \"C\" void cpu_free();\n";
+        lu_header << "extern \"C\" void " << m_entry_prefix << "cpu_init();\n";
+    lu_header << "extern \"C\" void " << m_entry_prefix << "cpu_free();\n";
+    if (use_sessions)
+    {
+        lu_header << R"(
+// Sessions share the weights loaded by cpu_init and each own a workspace of get_workspace_size()
+// bytes for the intermediate tensors, so that threads can run different sessions concurrently.
+// Create them after cpu_init and destroy them before cpu_free. Outputs returned by pointer stay
+// in the workspace until the next run of the session.
+struct nnf_session;
+)";
+        lu_header << "extern \"C\" nnf_session* " << m_entry_prefix << "nnf_session_create();\n";
+        lu_header << "extern \"C\" int " << m_entry_prefix
+                  << "nnf_session_run(nnf_session* session, " << params << ");\n";
+        lu_header << "extern \"C\" void " << m_entry_prefix
+                  << "nnf_session_destroy(nnf_session* session);\n";
+    }
 
     LanguageUnit_p h =
         std::make_shared<LanguageUnit>("header::nnfusion_rt.h", "#include \"nnfusion_rt.h\"\n");
@@ -399,6 +1036,36 @@ bool CpuCodegenPass::collect_funcs(std::shared_ptr<InterpreterContext> ctx,
 
     // collect code
     auto pairs = collect_ins(ctx, tu);
+    LanguageUnit_p kernel_tracer_decl;
+    if (!FLAGS_fkernel_trace.empty())
+        kernel_tracer_decl = std::make_shared<LanguageUnit>("declaration::kernel_tracer_decl");
+    std::vector<std::pair<LanguageUnit_p, LanguageUnit_p>> prepacks;
+    std::unordered_set<std::string> prepacked;
+    if (use_task_graph)
+    {
+        // Everything runs on the default thread in program order, the task graph brings back
+        // the parallelism.
+        std::unordered_map<nnfusion::ir::Instruction::Pointer, std::string> block_of;
+        for (auto& it : pairs)
+            for (auto ins : it.second)
+                block_of[ins] = it.first.substr(0, it.first.find(":"));
+        std::vector<nnfusion::ir::Instruction::Pointer> init_ins, exec_ins;
+        for (auto iterator : tu->program)
+        {
+            for (auto ins : *iterator)
+            {
+                auto block = block_of.find(ins);
+                if (block == block_of.end())
+                    continue;
+                (block->second == "init" ? init_ins : exec_ins).push_back(ins);
+            }
+        }
+        pairs.clear();
+        if (!init_ins.empty())
+            pairs.push_back(std::make_pair("init:default_thread", init_ins));
+        if (!exec_ins.empty())
+            pairs.push_back(std::make_pair("exec:default_thread", exec_ins));
+    }
     for (size_t i = 0; i < pairs.size(); i++)
     {
         int numa_node = i % numa_node_num;
@@ -416,6 +1083,9 @@ bool CpuCodegenPass::collect_funcs(std::shared_ptr<InterpreterContext> ctx,
             thread_call_args = ", " + thread_call_args;
 
         bool func_call_only = (main_block == "init");
+        bool as_task_graph = use_task_graph && main_block == "exec";
+        std::vector<nnfusion::ir::Instruction::Pointer> tasks;
+        std::vector<LanguageUnit_p> task_calls;
 
         size_t cpu_func_count = 0;
         for (auto ins : it.second)
@@ -427,7 +1097,44 @@ bool CpuCodegenPass::collect_funcs(std::shared_ptr<InterpreterContext> ctx,
             string body_str = fu->body_unit->get_code();
             string func_name = fu->name_unit->get_code();
             body_str = fu->signature_unit->get_code() + body_str;
-            if (!body_str.empty())
+
+            // Kernels an earlier bucket defines with the same code are called from its library.
+            bool imported = false;
+            if (m_bucket_context && !body_str.empty() && !kernel->is_static_function() &&
+                !kernel->is_eliminative() &&
+                kernel_func_defs.find(body_str) == kernel_func_defs.end())
+            {
+                auto key = get_bucket_kernel_key(fu, body_str);
+                auto shared = m_bucket_context->kernels.find(key);
+                if (shared == m_bucket_context->kernels.end())
+                {
+                    m_bucket_context->kernels[key] = {func_name, m_entry_prefix};
+                }
+                else if (shared->second.bucket != m_entry_prefix)
+                {
+                    imported = true;
+                    func_name = shared->second.function_name;
+                    std::string decl = fu->get_specialized_signature(func_name);
+                    if (decl.find("extern ") != 0)
+                        decl = "extern " + decl;
+                    LanguageUnit_p import = std::make_shared<LanguageUnit>(
+                        "declaration::" + func_name + "_import", decl + ";\n");
+                    for (auto& it : fu->dep_unit->local_symbol)
+                        import->require(it.second);
+                    lup_func_calls->require(import);
+                    m_bucket_context->exported_kernels[shared->second.bucket].insert(func_name);
+                    m_imported_buckets.insert(shared->second.bucket);
+                }
+            }
+
+            auto mlas_kernel = std::dynamic_pointer_cast<kernels::cpu::MlasKernelEmitter>(kernel);
+            if (FLAGS_fmlas_prepack && mlas_kernel && main_block == "exec" && !imported)
+            {
+                auto prepack = mlas_kernel->emit_prepack();
+                if (prepack.first && prepacked.insert(prepack.first->get_code()).second)
+                    prepacks.push_back(prepack);
+            }
+            if (!body_str.empty() && !imported)
             {
                 if (kernel->is_static_function() ||
                     kernel_func_defs.find(body_str) == kernel_func_defs.end())
@@ -453,6 +1160,21 @@ bool CpuCodegenPass::collect_funcs(std::shared_ptr<InterpreterContext> ctx,
                             kernel_func_defs[body_str].second->extern_decl_unit);
                 }
             }
+            // If, Loop and Scan call the kernels of their bodies by name, each needs its own
+            // definition.
+            if (auto control_flow =
+                    std::dynamic_pointer_cast<kernels::cpu::ControlFlowKernelEmitter>(kernel))
+            {
+                for (auto& body_kernel : control_flow->get_body_kernels())
+                {
+                    auto key = "control_flow_body::" + body_kernel->get_function_name();
+                    if (kernel_func_defs.find(key) == kernel_func_defs.end())
+                        kernel_func_defs[key] = std::make_pair(
+                            body_kernel->get_function_name(),
+                            codegenerator::CPUFunctionFile::convert_from(body_kernel));
+                    lup_func_calls->require(kernel_func_defs[key].second);
+                }
+            }
 
             std::string function_call;
             if (thread_name == "default_thread")
@@ -493,7 +1215,30 @@ bool CpuCodegenPass::collect_funcs(std::shared_ptr<InterpreterContext> ctx,
                 }
             }
 
-            LanguageUnit_p kernel_func_call = func_call_codegen(ins, func_call_only, function_call);
+            // Eliminated calls are emitted as a one line comment and cost nothing.
+            bool traced = kernel_tracer_decl && main_block == "exec" && !kernel->is_eliminative() &&
+                          !(FLAGS_fextern_result_memory && gnode &&
+                            gnode->get_op_ptr()->is_output());
+            if (traced)
+            {
+                function_call = "{\nuint64_t trace_begin = nnfusion::cpu::KernelTracer::Now();\n" +
+                                function_call + "kernel_tracer->Record(" +
+                                std::to_string(trace_nodes.size()) + ", trace_begin);\n}\n";
+                if (gnode)
+                    trace_nodes.push_back(std::make_pair(gnode->get_name(), gnode->get_op_type()));
+                else
+                    trace_nodes.push_back(std::make_pair(ins->name(), ins->name()));
+                lup_func_calls->require(kernel_tracer_decl);
+            }
+
+            LanguageUnit_p kernel_func_call =
+                func_call_codegen(ins, func_call_only || as_task_graph, function_call);
+            if (as_task_graph)
+            {
+                tasks.push_back(ins);
+                task_calls.push_back(kernel_func_call);
+                continue;
+            }
             if (FLAGS_fcustomized_mem_imp)
                 lup_func_calls->unit_vec.push_back(get_customized_mem_imp(ins).first);
             lup_func_calls->unit_vec.push_back(kernel_func_call);
@@ -502,6 +1247,9 @@ bool CpuCodegenPass::collect_funcs(std::shared_ptr<InterpreterContext> ctx,
             ++cpu_func_count;
         }
 
+        if (as_task_graph)
+            emit_task_graph(lup_func_calls, tasks, task_calls);
+
         if (thread_name != "default_thread")
         {
             LanguageUnit_p new_caller =
@@ -554,12 +1302,131 @@ bool CpuCodegenPass::collect_funcs(std::shared_ptr<InterpreterContext> ctx,
         }
     }
 
+    if (kernel_tracer_decl)
+        emit_kernel_tracer(kernel_tracer_decl);
+
+    if (!prepacks.empty())
+        emit_mlas_prepack(prepacks);
+
     if (FLAGS_fkernels_as_files)
         separate_func_defs_files(FLAGS_fkernels_files_number, m_codegen_folder + "kernels/");
 
     return true;
 }
 
+void CpuCodegenPass::emit_mlas_prepack(
+    const std::vector<std::pair<LanguageUnit_p, LanguageUnit_p>>& prepacks)
+{
+    auto prepack_pair = create_init_and_exit_pair<LanguageUnit, LanguageUnit>("init_mlas_prepack",
+                                                                              "del_mlas_prepack");
+    auto& lu_init = *prepack_pair.first;
+    auto& lu_exit = *prepack_pair.second;
+    for (auto& prepack : prepacks)
+    {
+        lu_init << prepack.first->get_code();
+        lu_exit << prepack.second->get_code();
+        for (auto& it : prepack.first->local_symbol)
+            prepack_pair.first->require(it.second);
+        for (auto& it : prepack.second->local_symbol)
+            prepack_pair.second->require(it.second);
+    }
+    NNFUSION_LOG(INFO) << "MLAS weights packed in cpu_init: " << prepacks.size();
+}
+
+void CpuCodegenPass::emit_kernel_tracer(LanguageUnit_p kernel_tracer_decl)
+{
+    auto& lu_decl = *kernel_tracer_decl;
+    {
+        kernel_tracer_decl->require(header::kernel_trace);
+        lu_decl << "static const char* kernel_trace_names[] = {";
+        for (auto& node : trace_nodes)
+            lu_decl << "\n    " << c_string_literal(node.first) << ",";
+        lu_decl << "\n    nullptr};\n";
+        lu_decl << "static const char* kernel_trace_op_types[] = {";
+        for (auto& node : trace_nodes)
+            lu_decl << "\n    " << c_string_literal(node.second) << ",";
+        lu_decl << "\n    nullptr};\n";
+        lu_decl << "nnfusion::cpu::KernelTracer* kernel_tracer;\n";
+    }
+
+    auto kernel_tracer_pair = create_init_and_exit_pair<LanguageUnit, LanguageUnit>(
+        "init_kernel_tracer", "del_kernel_tracer");
+    auto& lu_init = *kernel_tracer_pair.first;
+    {
+        lu_init << "kernel_tracer = new nnfusion::cpu::KernelTracer(" << trace_nodes.size()
+                << ", kernel_trace_names, kernel_trace_op_types, " << FLAGS_fkernel_trace_events
+                << ");\n";
+    }
+    auto& lu_del = *kernel_tracer_pair.second;
+    {
+        lu_del << "kernel_tracer->Dump(" << c_string_literal(FLAGS_fkernel_trace) << ");\n";
+        lu_del << "delete kernel_tracer;\n";
+    }
+    NNFUSION_LOG(INFO) << "Kernel trace: " << trace_nodes.size() << " kernel calls are timed.";
+}
+
+void CpuCodegenPass::emit_task_graph(CodegenFuncCallsUnit_p lup_func_calls,
+                                     const std::vector<nnfusion::ir::Instruction::Pointer>& tasks,
+                                     const std::vector<LanguageUnit_p>& task_calls)
+{
+    auto preds = get_task_dependencies(tasks);
+    std::vector<std::vector<int>> succs(tasks.size());
+    for (size_t j = 0; j < tasks.size(); j++)
+        for (auto i : preds[j])
+            succs[i].push_back(j);
+
+    std::vector<int> dep_count, succ_offset, succ;
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        dep_count.push_back(preds[i].size());
+        succ_offset.push_back(succ.size());
+        succ.insert(succ.end(), succs[i].begin(), succs[i].end());
+    }
+    succ_offset.push_back(succ.size());
+    NNFUSION_LOG(INFO) << "CPU task graph: " << tasks.size() << " tasks, " << succ.size()
+                       << " dependencies.";
+
+    LanguageUnit_p task_graph_decl = std::make_shared<LanguageUnit>("declaration::task_graph_decl");
+    auto& lu_decl = *task_graph_decl;
+    {
+        task_graph_decl->require(header::task_graph);
+        emit_int_array(lu_decl, "task_graph_dep_count", dep_count);
+        emit_int_array(lu_decl, "task_graph_succ_offset", succ_offset);
+        emit_int_array(lu_decl, "task_graph_succ", succ);
+        lu_decl << "nnfusion::cpu::TaskGraphExecutor* task_graph_executor;\n";
+    }
+    lup_func_calls->require(task_graph_decl);
+
+    auto task_graph_pair = create_init_and_exit_pair<LanguageUnit, LanguageUnit>(
+        "init_task_graph_executor", "del_task_graph_executor");
+    auto& lu_init = *task_graph_pair.first;
+    {
+        lu_init << "task_graph_executor = new nnfusion::cpu::TaskGraphExecutor(" << tasks.size()
+                << ", task_graph_dep_count, task_graph_succ_offset, task_graph_succ, "
+                << FLAGS_fcpu_task_graph_threads << ");\n";
+    }
+    auto& lu_del = *task_graph_pair.second;
+    {
+        lu_del << "delete task_graph_executor;\n";
+    }
+
+    auto& body = lup_func_calls->unit_vec;
+    body.push_back(std::make_shared<LanguageUnit>(
+        "task_graph_run_begin", "auto run_task = [&](int task_id) {\nswitch (task_id)\n{\n"));
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        LanguageUnit_p task_case =
+            std::make_shared<LanguageUnit>(task_calls[i]->symbol + "_task_" + std::to_string(i));
+        auto& lu_case = *task_case;
+        lu_case << "case " << i << ":\n{\n" << task_calls[i]->get_code() << "break;\n}\n";
+        for (auto& it : task_calls[i]->local_symbol)
+            task_case->require(it.second);
+        body.push_back(task_case);
+    }
+    body.push_back(std::make_shared<LanguageUnit>(
+        "task_graph_run_end", "}\n};\ntask_graph_executor->Run(run_task);\n"));
+}
+
 bool CpuCodegenPass::modify_codegen()
 {
     if (global_required.count("header::eigen_spatial_convolution") > 0)
@@ -575,21 +1442,10 @@ bool CpuCodegenPass::modify_codegen()
         projgen->lup_codegen->require(header::threadpool);
         projgen->lup_codegen->require(declaration::worker_thread_pool);
         // worker thread pool
-        auto worker_thread_pool_pair = create_init_and_exit_pair<LanguageUnit, LanguageUnit>(
-            "init_worker_thread_pool", "del_worker_thread_pool");
-        auto lup_worker_thread_pool_init = worker_thread_pool_pair.first;
-        auto lup_worker_thread_pool_del = worker_thread_pool_pair.second;
-
-        auto& lu_worker_thread_pool_init = *lup_worker_thread_pool_init;
-        {
-            lu_worker_thread_pool_init
-                << "worker_thread_pool = new concurrency::NumaAwareThreadPool(" << numa_node_num
-                << ", " << FLAGS_fthread_num_per_node << ");\n";
-        }
-        auto& lu_worker_thread_pool_del = *lup_worker_thread_pool_del;
-        {
-            lu_worker_thread_pool_del << "delete worker_thread_pool;\n";
-        }
+        emit_thread_pool("worker_thread_pool",
+                         ShapeBucketContext::WorkerThreadPool,
+                         std::to_string(numa_node_num) + ", " +
+                             std::to_string(FLAGS_fthread_num_per_node));
     }
 
     if (host_async_manager && host_async_manager->num_non_default_stream() > 0)
@@ -640,20 +1496,7 @@ bool CpuCodegenPass::modify_codegen()
             std::make_shared<LanguageUnit>("init_barrier_wait", "init_barrier.Wait();\n");
         body.insert(body.begin(), init_barrier_wait);
         // schedule thread pool
-        auto schedule_thread_pool_pair = create_init_and_exit_pair<LanguageUnit, LanguageUnit>(
-            "init_schedule_thread_pool", "del_schedule_thread_pool");
-        auto lup_schedule_thread_pool_init = schedule_thread_pool_pair.first;
-        auto lup_schedule_thread_pool_del = schedule_thread_pool_pair.second;
-
-        auto& lu_schedule_thread_pool_init = *lup_schedule_thread_pool_init;
-        {
-            lu_schedule_thread_pool_init
-                << "schedule_thread_pool = new concurrency::NumaAwareThreadPool();\n";
-        }
-        auto& lu_schedule_thread_pool_del = *lup_schedule_thread_pool_del;
-        {
-            lu_schedule_thread_pool_del << "delete schedule_thread_pool;\n";
-        }
+        emit_thread_pool("schedule_thread_pool", ShapeBucketContext::ScheduleThreadPool, "");
     }
 
     if (host_async_manager && host_async_manager->num_event() > 0)
@@ -669,11 +1512,56 @@ bool CpuCodegenPass::modify_codegen()
         barrier_header->write_to = barrier_header->symbol;
     }
 
+    if (use_task_graph)
+    {
+        projgen->lup_codegen->require(task_graph_header);
+        task_graph_header->write_to = task_graph_header->symbol;
+    }
+
+    if (!trace_nodes.empty())
+    {
+        projgen->lup_codegen->require(kernel_trace_header);
+        kernel_trace_header->write_to = kernel_trace_header->symbol;
+    }
+
     if (global_required.count("header::reference_common") > 0)
     {
         projgen->lup_codegen->require(reference_common_header);
         reference_common_header->write_to = reference_common_header->symbol;
     }
 
+    for (auto& bucket : m_imported_buckets)
+        *lup_cmake << "target_link_libraries(${TARGET_NAME} nnfusion_" << bucket << "cpu_rt)\n";
+
     return true;
+}
+
+void CpuCodegenPass::emit_thread_pool(const std::string& pool,
+                                      ShapeBucketContext::SharedResource slot,
+                                      const std::string& args)
+{
+    auto pool_pair =
+        create_init_and_exit_pair<LanguageUnit, LanguageUnit>("init_" + pool, "del_" + pool);
+    auto& lu_init = *pool_pair.first;
+    auto& lu_del = *pool_pair.second;
+    std::string create = "new concurrency::NumaAwareThreadPool(" + args + ")";
+    if (m_entry_prefix.empty())
+    {
+        lu_init << pool << " = " << create << ";\n";
+        lu_del << "delete " << pool << ";\n";
+        return;
+    }
+
+    std::string shared = m_entry_prefix + "shared_resources[" + std::to_string(slot) + "]";
+    LanguageUnit_p owner_decl = std::make_shared<LanguageUnit>("declaration::own_" + pool,
+                                                               "bool own_" + pool + " = false;\n");
+    pool_pair.first->require(owner_decl);
+    pool_pair.second->require(owner_decl);
+    lu_init << "if (!" << shared << ")\n";
+    lu_init.block_begin();
+    lu_init << shared << " = " << create << ";\n";
+    lu_init << "own_" << pool << " = true;\n";
+    lu_init.block_end();
+    lu_init << pool << " = (concurrency::NumaAwareThreadPool*)" << shared << ";\n";
+    lu_del << "if (own_" << pool << ")\n    delete " << pool << ";\n";
 }
\ No newline at end of file
@@ -13,13 +13,43 @@ namespace nnfusion
 {
     namespace codegen
     {
+        ///\brief What the buckets of a multi-shape runtime share, see ShapeBucketCompiler.
+        struct ShapeBucketContext
+        {
+            // Slots of the <prefix>shared_resources array of every bucket. The dispatcher maps
+            // the weights, the first bucket needing a thread pool creates it for all the others.
+            enum SharedResource
+            {
+                Weights,
+                WorkerThreadPool,
+                ScheduleThreadPool,
+                NumSharedResources
+            };
+
+            struct Kernel
+            {
+                std::string function_name;
+                // entry prefix of the bucket defining the kernel
+                std::string bucket;
+            };
+            // code of a kernel with its function name left out -> its first definition, later
+            // buckets call that definition instead of compiling their own copy
+            std::unordered_map<std::string, Kernel> kernels;
+            // entry prefix -> the kernels of the bucket which other buckets call
+            std::map<std::string, std::set<std::string>> exported_kernels;
+        };
+
         class CpuCodegenPass : public CudaCodegenPass
         {
         public:
             CpuCodegenPass(const std::string& codegen_folder = "./nnfusion_rt/cpu_codegen/",
                            const std::string& kernel_folder = "./nnfusion_rt/cpu_codegen/",
-                           const std::string kernel_suffix = ".cpp")
+                           const std::string kernel_suffix = ".cpp",
+                           const std::string& entry_prefix = "",
+                           std::shared_ptr<ShapeBucketContext> bucket_context = nullptr)
                 : CudaCodegenPass(codegen_folder, kernel_folder, kernel_suffix)
+                , m_entry_prefix(entry_prefix)
+                , m_bucket_context(bucket_context)
             {
             }
 
@@ -33,6 +63,8 @@ namespace nnfusion
             }
             virtual void initialize(std::shared_ptr<InterpreterContext> ctx,
                                     std::shared_ptr<TranslationUnit> tu) override;
+            virtual bool collect_mem(std::shared_ptr<InterpreterContext> ctx,
+                                     std::shared_ptr<TranslationUnit> tu) override;
             virtual void create_cmake_file(std::shared_ptr<InterpreterContext> ctx,
                                            std::shared_ptr<TranslationUnit> tu) override;
             virtual void create_main_file(std::shared_ptr<InterpreterContext> ctx,
@@ -40,11 +72,50 @@ namespace nnfusion
             virtual bool collect_funcs(std::shared_ptr<InterpreterContext> ctx,
                                        std::shared_ptr<TranslationUnit> tu) override;
             virtual bool modify_codegen() override;
+            virtual bool exit_after_codegen() override { return m_entry_prefix.empty(); }
             virtual void create_header_file(std::shared_ptr<InterpreterContext> ctx,
                                             std::shared_ptr<TranslationUnit> tu) override;
+            virtual std::pair<LanguageUnit_p, LanguageUnit_p>
+                get_weights_load_and_free(std::shared_ptr<TranslationUnit> tu) override;
             virtual NNFusion_DeviceType device_type() { return NNFusion_DeviceType::GENERIC_CPU; }
+            // Wrap the calls of the exec instructions into one task graph run by the
+            // TaskGraphExecutor of the runtime.
+            void emit_task_graph(CodegenFuncCallsUnit_p lup_func_calls,
+                                 const std::vector<nnfusion::ir::Instruction::Pointer>& tasks,
+                                 const std::vector<LanguageUnit_p>& task_calls);
+            // Declare the names of the timed kernel calls and the tracer which dumps them in
+            // cpu_free.
+            void emit_kernel_tracer(LanguageUnit_p kernel_tracer_decl);
+            // Pack the constant weights of the MLAS kernels once in cpu_init and release them in
+            // cpu_free.
+            void emit_mlas_prepack(
+                const std::vector<std::pair<LanguageUnit_p, LanguageUnit_p>>& prepacks);
+            // Emit nnf_session_create/run/destroy, and kernel_entry on a default session.
+            void emit_session_api(std::shared_ptr<TranslationUnit> tu, LanguageUnit_p lup_bind);
+            // Whether tensor is written in cpu_init, and is shared by all sessions.
+            bool is_shared_tensor(const std::shared_ptr<nnfusion::descriptor::Tensor>& tensor);
+            // Emit the pool into worker_thread_pool or schedule_thread_pool, a bucket of a
+            // multi-shape runtime takes the pool of an earlier bucket when there is one.
+            void emit_thread_pool(const std::string& pool,
+                                  ShapeBucketContext::SharedResource slot,
+                                  const std::string& args);
+            // A non-empty prefix builds the runtime as one bucket of a multi-shape runtime: a
+            // shared library exporting only the prefixed entry points, without main_test.
+            std::string m_entry_prefix;
+            std::shared_ptr<ShapeBucketContext> m_bucket_context;
+            // the buckets defining the kernels this bucket calls
+            std::set<std::string> m_imported_buckets;
+            LanguageUnit_p lup_cmake;
             bool need_intra_node_threadpool = false;
+            bool use_task_graph = false;
+            bool use_sessions = false;
+            // tensors written in cpu_init, and the offset of every pool in a session workspace
+            std::unordered_set<std::string> shared_tensors;
+            std::unordered_map<std::string, size_t> session_pool_offset;
+            size_t session_workspace_size = 0;
             int numa_node_num;
+            // name and op type of every timed kernel call, indexed by its trace id
+            std::vector<std::pair<std::string, std::string>> trace_nodes;
             unordered_map<std::string, int> cpu_kernel_thread_idx;
         };
     }
@@ -12,6 +12,7 @@
 #include "nnfusion/core/kernels/cuda_gpu/cuda_langunit.hpp"
 #include "nnfusion/core/kernels/kernel_emitter.hpp"
 #include "nnfusion/core/kernels/kernel_registration.hpp"
+#include "nnfusion/core/kernels/weight_pack.hpp"
 
 #include <regex>
 
@@ -468,8 +469,7 @@ std::vector<std::pair<string, vector<nnfusion::ir::Instruction::Pointer>>>
             auto thread = async_info.execution_thread;
             auto thread_name = thread->get_name();
             std::string key;
-            if (gnode->is_constant() || gnode->is_variable() ||
-                (FLAGS_frt_const_folding && (*ins)["rt_const_folding"].is_valid_as<bool>()))
+            if (is_init_instruction(ins))
             {
                 key = "init:" + thread_name;
             }
@@ -512,6 +512,13 @@ std::vector<std::pair<string, vector<nnfusion::ir::Instruction::Pointer>>>
     return pairs;
 }
 
+bool CudaCodegenPass::is_init_instruction(nnfusion::ir::Instruction::Pointer ins)
+{
+    auto gnode = ins->getGNode();
+    return gnode->is_constant() || gnode->is_variable() ||
+           (FLAGS_frt_const_folding && (*ins)["rt_const_folding"].is_valid_as<bool>());
+}
+
 std::string CudaCodegenPass::get_kernel_entry_paras(std::shared_ptr<TranslationUnit> tu,
                                                     bool is_host)
 {
@@ -917,9 +924,120 @@ bool CudaCodegenPass::collect_mem(std::shared_ptr<InterpreterContext> ctx,
         lup_mem_free->require(init);
     }
 
+    if (FLAGS_fpack_constants && !WeightPack::Global()->empty())
+    {
+        WeightPack::Global()->save();
+        auto weights_pair = get_weights_load_and_free(tu);
+        add_init_and_exit_pair(weights_pair.first, weights_pair.second);
+    }
+
     return true;
 }
 
+std::pair<LanguageUnit_p, LanguageUnit_p>
+    CudaCodegenPass::get_weights_load_and_free(std::shared_ptr<TranslationUnit> tu)
+{
+    auto weights = WeightPack::Global();
+    std::string blob_path = WeightPack::folder + WeightPack::blob_name;
+    int device_id = 0;
+    bool found = false;
+    for (auto iterator : tu->program)
+    {
+        for (auto ins : *iterator)
+        {
+            auto gnode = ins->getGNode();
+            if (gnode && gnode->is_constant() && ins->get_outputs().size() > 0 &&
+                weights->contains(ins->get_outputs()[0]->get_name()))
+            {
+                device_id = ins->get_outputs()[0]->get_device_id();
+                found = true;
+                break;
+            }
+        }
+        if (found)
+            break;
+    }
+
+    LanguageUnit_p weights_decl =
+        std::make_shared<LanguageUnit>("declaration::nnfusion_weights_def",
+                                       "char* nnfusion_weights;\nchar* nnfusion_weights_host;\n");
+
+    LanguageUnit_p _lu_load(new LanguageUnit("WEIGHTS_LOAD"));
+    auto& lu_load = *_lu_load;
+    lu_load << "// packed constants: " << blob_path << "\n";
+    lu_load << "int weights_fd = open(\"" << blob_path << "\", O_RDONLY);\n"
+            << "if (weights_fd < 0)\n"
+            << "{\n"
+            << "\tprintf(\"Load " << blob_path << " failed.\\n\");\n"
+            << "\texit(1);\n"
+            << "}\n"
+            << "nnfusion_weights_host = (char*)mmap(NULL, " << weights->size()
+            << ", PROT_READ, MAP_PRIVATE, weights_fd, 0);\n"
+            << "close(weights_fd);\n"
+            << "if (nnfusion_weights_host == MAP_FAILED)\n"
+            << "{\n"
+            << "\tprintf(\"Map " << blob_path << " failed.\\n\");\n"
+            << "\texit(1);\n"
+            << "}\n";
+    lu_load << "CUDA_SAFE_CALL(cudaSetDevice(" << device_id << "));\n";
+    lu_load << "CUDA_SAFE_CALL(cudaMalloc((void**)&nnfusion_weights, " << weights->size()
+            << "));\n";
+    // The blob is pageable mmap'd memory, copy it synchronously so that the weights are on the
+    // device before a kernel on any stream reads them.
+    lu_load << "CUDA_SAFE_CALL(cudaMemcpy(nnfusion_weights, nnfusion_weights_host, "
+            << weights->size() << ", cudaMemcpyHostToDevice));\n";
+    lu_load << get_weights_binding(tu, device_id)->get_code();
+    _lu_load->require(header::mman);
+    _lu_load->require(weights_decl);
+
+    LanguageUnit_p _lu_free(new LanguageUnit("WEIGHTS_FREE"));
+    auto& lu_free = *_lu_free;
+    lu_free << "CUDA_SAFE_CALL(cudaSetDevice(" << device_id << "));\n";
+    lu_free << "CUDA_SAFE_CALL(cudaFree(nnfusion_weights));\n";
+    lu_free << "munmap(nnfusion_weights_host, " << weights->size() << ");\n";
+    _lu_free->require(weights_decl);
+
+    return std::make_pair(_lu_load, _lu_free);
+}
+
+LanguageUnit_p CudaCodegenPass::get_weights_binding(std::shared_ptr<TranslationUnit> tu,
+                                                    int device_id)
+{
+    // Point every packed constant, and every tensor allocated inplace on top of one, into
+    // the weight blob. Constants which are themselves inplace views (e.g. concat inputs)
+    // keep their pool memory and are filled by their Constant kernel.
+    LanguageUnit_p _lu(new LanguageUnit("weights_binding"));
+    if (FLAGS_fcustomized_mem_imp)
+        return _lu;
+
+    auto& lu = *_lu;
+    auto weights = WeightPack::Global();
+    std::unordered_set<std::string> bound;
+    for (auto iterator : tu->program)
+    {
+        for (auto ins : *iterator)
+        {
+            std::vector<std::shared_ptr<nnfusion::descriptor::Tensor>> tensors(
+                ins->get_inputs().begin(), ins->get_inputs().end());
+            tensors.insert(tensors.end(), ins->get_outputs().begin(), ins->get_outputs().end());
+            for (auto tensor : tensors)
+            {
+                auto root = tensor->get_root_tensor() ? tensor->get_root_tensor() : tensor;
+                if (tensor->get_device_type() != device_type() ||
+                    tensor->get_device_id() != device_id || !weights->contains(root->get_name()) ||
+                    tensor->get_pool_offset() == SIZE_MAX || bound.count(tensor->get_name()) > 0)
+                    continue;
+                bound.insert(tensor->get_name());
+                size_t offset = weights->get(root->get_name()).offset + tensor->get_pool_offset() -
+                                root->get_pool_offset();
+                lu << tensor->get_name() << " = (" << tensor->get_element_type().c_type_string()
+                   << "*)(nnfusion_weights + " << offset << ");\n";
+            }
+        }
+    }
+    return _lu;
+}
+
 bool CudaCodegenPass::modify_codegen()
 {
     if (global_required.count("declaration::num_SMs") > 0)
@@ -1396,6 +1514,8 @@ set(CUDA_NVCC_FLAGS "${CUDA_NVCC_FLAGS} --expt-relaxed-constexpr")
         lu << "list(APPEND SRC ${kernels} shared" << m_kernel_suffix << ")\n";
 
         lu << "include_directories(${CMAKE_SOURCE_DIR})\n\n";
+        if (codegen_kernel_cache())
+            lu << nnfusion::codegen::cmake::kernel_cache_nvcc->get_code();
     }
 
     lu << "cuda_add_library(${TARGET_NAME} SHARED ${SRC})\n";
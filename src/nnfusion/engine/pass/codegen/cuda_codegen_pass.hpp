@@ -46,6 +46,9 @@ namespace nnfusion
             virtual std::vector<std::pair<string, vector<nnfusion::ir::Instruction::Pointer>>>
                 collect_ins(std::shared_ptr<InterpreterContext> ctx,
                             std::shared_ptr<TranslationUnit> tu);
+            // Whether collect_ins puts ins into the init block: constants, variables and the
+            // nodes of runtime constant folding.
+            bool is_init_instruction(nnfusion::ir::Instruction::Pointer ins);
             virtual void create_graph_config(std::shared_ptr<InterpreterContext> ctx,
                                              std::shared_ptr<TranslationUnit> tu);
             virtual void create_header_file(std::shared_ptr<InterpreterContext> ctx,
@@ -76,6 +79,11 @@ namespace nnfusion
             virtual LanguageUnit_p get_h2dcopy(std::shared_ptr<TranslationUnit> tu);
             virtual LanguageUnit_p get_sync();
             virtual void fill_exec_host(std::shared_ptr<TranslationUnit> tu);
+            // code to map the packed weight file (-fpack_constants) in init and release it in exit
+            virtual std::pair<LanguageUnit_p, LanguageUnit_p>
+                get_weights_load_and_free(std::shared_ptr<TranslationUnit> tu);
+            LanguageUnit_p get_weights_binding(std::shared_ptr<TranslationUnit> tu,
+                                               int device_id = 0);
             nnfusion::async::HostAsyncManager* host_async_manager;
             nnfusion::async::DeviceStreamAsyncManager* device_async_manager;
             unordered_set<string> global_required;
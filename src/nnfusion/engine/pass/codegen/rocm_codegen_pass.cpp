@@ -160,6 +160,8 @@ set(CMAKE_CXX_FLAGS "-O2 -Wno-ignored-attributes -Wno-duplicate-decl-specifier")
            << ".cpp"
            << ")\n";
         lu << "include_directories(${CMAKE_SOURCE_DIR})\n\n";
+        if (codegen_kernel_cache())
+            lu << nnfusion::codegen::cmake::kernel_cache_launcher->get_code();
     }
     lu << "add_library(${TARGET_NAME} SHARED ${SRC})\n";
 
@@ -3,6 +3,8 @@
 
 #include "assign_async_info_pass.hpp"
 #include <queue>
+#include <thread>
+#include "heft_scheduler.hpp"
 #include "kernel_profiling_pass.hpp"
 #include "nnfusion/core/kernels/cuda_gpu/cuda_emitter.hpp"
 #include "nnfusion/util/util.hpp"
@@ -22,7 +24,7 @@ DEFINE_string(fcuda_init_stream, "default", "The stream of kernels in cuda_init(
 DECLARE_bool(fenable_kernel_profiling);
 DEFINE_string(fstream_assign_policy,
               "naive",
-              "Choose stream-assign policy from [naive, kernel_prof_based].");
+              "Choose stream-assign policy from [naive, kernel_prof_based, heft].");
 
 AssignAsyncInfoPass::AssignAsyncInfoPass()
 {
@@ -53,6 +55,11 @@ bool AssignAsyncInfoPass::run_on_graph(std::shared_ptr<Graph>& graph)
         {
             kernel_prof_based_assign_thread_info(graph);
         }
+        else if (FLAGS_fstream_assign_policy == "heft")
+        {
+            heft_assign_thread_info(graph);
+            assign_event_info(graph);
+        }
         else
         {
             naive_assign_thread_info(graph);
@@ -898,6 +905,83 @@ void AssignAsyncInfoPass::kernel_prof_based_assign_thread_info(std::shared_ptr<G
     NNFUSION_LOG(INFO) << "assign thread info-------------------------------";
 }
 
+void AssignAsyncInfoPass::heft_assign_thread_info(std::shared_ptr<Graph>& graph)
+{
+    auto async_manager = AsyncManagerFactory::get_host_async_manager(graph, GENERIC_CPU);
+    int n_stream = FLAGS_fnum_stream;
+    if (n_stream == 0)
+        n_stream = std::max(1u, std::thread::hardware_concurrency());
+    if (n_stream <= 1)
+    {
+        naive_assign_thread_info(graph);
+        return;
+    }
+
+    // Constants, parameters and runtime folded nodes already run on the default thread, in
+    // cpu_init or before any kernel, and cost nothing here.
+    std::vector<std::shared_ptr<GNode>> nodes;
+    std::unordered_map<std::shared_ptr<GNode>, int> index;
+    for (auto gnode : graph->get_ordered_ops())
+    {
+        if (!(*gnode)["Async_info"].is_valid())
+            (*gnode)["Async_info"] = AsyncExecutionInfo();
+        if ((*gnode)["Async_info"].as<AsyncExecutionInfo>().execution_thread)
+            continue;
+        index[gnode] = nodes.size();
+        nodes.push_back(gnode);
+    }
+
+    std::vector<double> cost;
+    std::vector<std::vector<int>> preds(nodes.size());
+    size_t profiled = 0;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        auto& gnode = nodes[i];
+        KernelProfilingRecord::Pointer record;
+        if ((*gnode)["Kernel_Profiling_Result"].is_valid())
+            record = (*gnode)["Kernel_Profiling_Result"].as<KernelProfilingRecord::Pointer>();
+        if (record && record->valid)
+        {
+            cost.push_back(get_time_cost(gnode));
+            profiled++;
+        }
+        else
+        {
+            cost.push_back(estimate_time_cost(gnode));
+        }
+        for (auto& edge : gnode->get_in_edges())
+        {
+            auto src = index.find(edge->get_src());
+            if (src != index.end())
+                preds[i].push_back(src->second);
+        }
+    }
+
+    // the cost of a barrier notify and wait in us
+    const double event_cost = 5;
+    auto schedule = heft_schedule(cost, preds, n_stream, event_cost);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        auto& async_info = (*nodes[i])["Async_info"].as<AsyncExecutionInfo>();
+        // A single thread runs in kernel_entry itself, without barriers.
+        if (schedule.num_threads == 1)
+            async_info.execution_thread = async_manager->set_stream(0, "default");
+        else
+            async_info.execution_thread =
+                async_manager->set_stream(0, "heft" + to_string(schedule.thread[i]));
+    }
+
+    NNFUSION_LOG(INFO) << "HEFT schedule: " << nodes.size() << " kernels (" << profiled
+                       << " profiled) on " << schedule.num_threads << " of " << n_stream
+                       << " threads, " << schedule.cross_thread_deps
+                       << " cross-thread dependencies.";
+    NNFUSION_LOG(INFO) << "HEFT schedule: predicted makespan " << schedule.makespan
+                       << " us, serial time " << schedule.serial << " us, speedup "
+                       << (schedule.makespan > 0 ? schedule.serial / schedule.makespan : 1.0)
+                       << ".";
+    NNFUSION_LOG(INFO) << "assign thread info-------------------------------";
+}
+
 void AssignAsyncInfoPass::assign_default_info(std::shared_ptr<Graph>& graph)
 {
     auto host_async_manager = AsyncManagerFactory::get_host_async_manager(graph, GENERIC_CPU);
@@ -964,3 +1048,58 @@ uint64_t AssignAsyncInfoPass::get_time_cost(std::shared_ptr<nnfusion::graph::GNo
         return 0;
     }
 }
+
+double AssignAsyncInfoPass::estimate_time_cost(std::shared_ptr<nnfusion::graph::GNode> gnode)
+{
+    if ((*gnode)["Kernel_Selection_Result"].is_valid() &&
+        (*gnode)["Kernel_Selection_Result"]
+            .as<pair<NNFusion_DeviceType, KernelEmitter::Pointer>>()
+            .second->is_eliminative())
+    {
+        return 0;
+    }
+
+    // The larger of moving the tensors at 10 GB/s and the multiply-adds at 50 GFLOP/s of one
+    // core, plus the call overhead. Only the ratios between kernels matter to the scheduler.
+    double bytes = 0;
+    for (size_t i = 0; i < gnode->get_input_size(); i++)
+        bytes += shape_size(gnode->get_input_shape(i)) * gnode->get_input_element_type(i).size();
+    double out_size = 0;
+    for (size_t i = 0; i < gnode->get_output_size(); i++)
+    {
+        out_size += shape_size(gnode->get_output_shape(i));
+        bytes += shape_size(gnode->get_output_shape(i)) * gnode->get_output_element_type(i).size();
+    }
+
+    double flops = out_size;
+    auto op_type = gnode->get_op_type();
+    if ((op_type == "Dot" || op_type == "BatchMatMul") && gnode->get_input_size() == 2 &&
+        out_size > 0)
+    {
+        // Every output element takes k multiply-adds, k being the size of the reduction axes of
+        // input 0. The sizes of the operands do not tell k when B is broadcast.
+        auto& a_shape = gnode->get_input_shape(0);
+        double k = 1;
+        if (op_type == "Dot")
+        {
+            auto dot = std::static_pointer_cast<op::Dot>(gnode->get_op_ptr());
+            size_t axes = dot->get_reduction_axes_count();
+            for (size_t i = 0; i < axes && axes <= a_shape.size(); i++)
+                k *= a_shape[dot->get_transpose_A() ? i : a_shape.size() - axes + i];
+        }
+        else if (a_shape.size() >= 2)
+        {
+            auto generic_op = std::static_pointer_cast<op::GenericOp>(gnode->get_op_ptr());
+            bool trans_a = generic_op->localOpConfig.getRoot()["adj_x"]["b"];
+            k = a_shape[a_shape.size() - (trans_a ? 2 : 1)];
+        }
+        flops = 2 * out_size * k;
+    }
+    else if (op_type == "Convolution" && gnode->get_input_size() == 2)
+    {
+        auto& filter = gnode->get_input_shape(1);
+        if (!filter.empty() && filter[0] > 0)
+            flops = 2 * out_size * (shape_size(filter) / filter[0]);
+    }
+    return std::max(bytes / 1e4, flops / 5e4) + 1;
+}
@@ -29,9 +29,14 @@ namespace nnfusion
                 void init_assign_async_info(std::shared_ptr<Graph>& graph);
                 void kernel_prof_based_assign_stream_info(std::shared_ptr<Graph>& graph);
                 void kernel_prof_based_assign_thread_info(std::shared_ptr<Graph>& graph);
+                // List schedule the CPU kernels onto -fnum_stream threads by their critical paths.
+                void heft_assign_thread_info(std::shared_ptr<Graph>& graph);
                 void assign_default_info(std::shared_ptr<Graph>& graph);
                 KernelEmitter::Pointer get_kernel(std::shared_ptr<nnfusion::graph::GNode> gnode);
                 uint64_t get_time_cost(std::shared_ptr<nnfusion::graph::GNode> gnode);
+                // Time of the kernel of gnode in us by a roofline cost model, for kernels which
+                // are not profiled.
+                double estimate_time_cost(std::shared_ptr<nnfusion::graph::GNode> gnode);
             };
         }
     }
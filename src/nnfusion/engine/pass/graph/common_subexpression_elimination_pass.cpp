@@ -28,6 +28,8 @@
 #include "nnfusion/core/operators/generic_op/generic_op.hpp"
 
 DEFINE_bool(fcse, true, "Common subexpression elimination.");
+DECLARE_bool(fautodiff);
+DECLARE_bool(ftraining_mode);
 
 using namespace nnfusion::graph;
 using namespace nnfusion::pass::graph;
@@ -66,8 +68,28 @@ static bool cse_reshape(shared_ptr<GNode> a, shared_ptr<GNode> b)
            (reshape_a->get_output_shape() == reshape_b->get_output_shape());
 }
 
+// Constants with the same bytes, compared by the hash cached on their data. Trained weights
+// which start out equal must stay apart.
+static bool cse_eligible_constant(const shared_ptr<op::Constant>& constant)
+{
+    return constant != nullptr && !FLAGS_fautodiff && !FLAGS_ftraining_mode &&
+           !constant->is_weight();
+}
+
+static bool cse_constant(shared_ptr<GNode> a, shared_ptr<GNode> b)
+{
+    const auto constant_a = std::dynamic_pointer_cast<op::Constant>(a->get_op_ptr());
+    const auto constant_b = std::dynamic_pointer_cast<op::Constant>(b->get_op_ptr());
+    if (!cse_eligible_constant(constant_a) || !cse_eligible_constant(constant_b))
+    {
+        return false;
+    }
+    return constant_a->data_equals(*constant_b);
+}
+
 static unordered_map<std::string, function<bool(shared_ptr<GNode>, shared_ptr<GNode>)>>
-    ops_to_cse_handlers = {{"Broadcast", cse_broadcast}, {"Reshape", cse_reshape}};
+    ops_to_cse_handlers = {
+        {"Broadcast", cse_broadcast}, {"Reshape", cse_reshape}, {"Constant", cse_constant}};
 
 class NodeKey
 {
@@ -133,6 +155,12 @@ namespace std
                 arg_ids.push_back(edge->get_src()->get_instance_id());
                 arg_ids.push_back(edge->get_src_output());
             }
+            // Only the constants which may be merged are worth hashing their bytes.
+            auto constant = std::dynamic_pointer_cast<op::Constant>(gnode->get_op_ptr());
+            if (cse_eligible_constant(constant))
+            {
+                arg_ids.push_back(constant->get_data_hash());
+            }
 
             auto hashc = hash_combine(arg_ids);
             return hashc;
@@ -0,0 +1,661 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "constant_evaluator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include "nnfusion/core/operators/op_define/broadcast.hpp"
+#include "nnfusion/core/operators/op_define/concat.hpp"
+#include "nnfusion/core/operators/op_define/dot.hpp"
+#include "nnfusion/core/operators/op_define/pad.hpp"
+#include "nnfusion/core/operators/op_define/reshape.hpp"
+#include "nnfusion/core/operators/op_define/reverse.hpp"
+#include "nnfusion/core/operators/op_define/slice.hpp"
+#include "nnfusion/core/operators/util/arithmetic_reduction.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::graph;
+using namespace nnfusion::pass::graph;
+
+namespace
+{
+    using Inputs = std::vector<const char*>;
+
+    std::vector<int64_t> strides_of(const Shape& shape)
+    {
+        std::vector<int64_t> strides(shape.size());
+        int64_t stride = 1;
+        for (size_t axis = shape.size(); axis-- > 0;)
+        {
+            strides[axis] = stride;
+            stride *= shape[axis];
+        }
+        return strides;
+    }
+
+    // Calls f(a, b) for every coordinate of shape in row-major order, with a and b the offsets
+    // of the coordinate in two tensors of the given strides, starting at offsets a and b.
+    template <typename F>
+    void walk(const Shape& shape,
+              const std::vector<int64_t>& a_strides,
+              int64_t a,
+              const std::vector<int64_t>& b_strides,
+              int64_t b,
+              F f)
+    {
+        size_t count = shape_size(shape);
+        std::vector<size_t> coord(shape.size(), 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            f(a, b);
+            for (size_t axis = shape.size(); axis-- > 0;)
+            {
+                a += a_strides[axis];
+                b += b_strides[axis];
+                if (++coord[axis] < shape[axis])
+                    break;
+                a -= a_strides[axis] * shape[axis];
+                b -= b_strides[axis] * shape[axis];
+                coord[axis] = 0;
+            }
+        }
+    }
+
+    // Copies the elements of in at the offsets of in_strides to out in row-major order.
+    void gather(const Shape& out_shape,
+                const std::vector<int64_t>& in_strides,
+                int64_t in_offset,
+                size_t element_size,
+                const char* in,
+                char* out)
+    {
+        walk(out_shape,
+             strides_of(out_shape),
+             0,
+             in_strides,
+             in_offset,
+             [&](int64_t o, int64_t i) {
+                 std::memcpy(out + o * element_size, in + i * element_size, element_size);
+             });
+    }
+
+    // Calls f.apply<T>() with the C++ type of an element type, returns false for the types
+    // which are not evaluated in process.
+    template <typename F>
+    bool dispatch(const element::Type& type, F& f)
+    {
+        if (type == element::f32)
+            return f.template apply<float>();
+        if (type == element::f64)
+            return f.template apply<double>();
+        if (type == element::i32)
+            return f.template apply<int32_t>();
+        if (type == element::i64)
+            return f.template apply<int64_t>();
+        if (type == element::i8)
+            return f.template apply<int8_t>();
+        if (type == element::u8)
+            return f.template apply<uint8_t>();
+        if (type == element::boolean)
+            return f.template apply<char>();
+        return false;
+    }
+
+    template <typename T>
+    using UnaryFunction = T (*)(T);
+
+    template <typename T>
+    UnaryFunction<T> unary_function(const std::string& op_type)
+    {
+        if (op_type == "Negative")
+            return [](T x) { return T(-x); };
+        if (op_type == "Abs")
+            return [](T x) { return x < T(0) ? T(-x) : x; };
+        if (op_type == "Square")
+            return [](T x) { return T(x * x); };
+        if (op_type == "Relu")
+            return [](T x) { return x > T(0) ? x : T(0); };
+        if (op_type == "Sign")
+            return [](T x) { return T((T(0) < x) - (x < T(0))); };
+        if (op_type == "Exp")
+            return [](T x) { return T(std::exp(x)); };
+        if (op_type == "Log")
+            return [](T x) { return T(std::log(x)); };
+        if (op_type == "Sqrt")
+            return [](T x) { return T(std::sqrt(x)); };
+        if (op_type == "Rsqrt")
+            return [](T x) { return T(1 / std::sqrt(x)); };
+        if (op_type == "Sigmoid")
+            return [](T x) { return T(1 / (1 + std::exp(-double(x)))); };
+        if (op_type == "Tanh")
+            return [](T x) { return T(std::tanh(x)); };
+        if (op_type == "Erf")
+            return [](T x) { return T(std::erf(x)); };
+        if (op_type == "Floor")
+            return [](T x) { return T(std::floor(x)); };
+        if (op_type == "Ceiling")
+            return [](T x) { return T(std::ceil(x)); };
+        if (op_type == "Sin")
+            return [](T x) { return T(std::sin(x)); };
+        if (op_type == "Cos")
+            return [](T x) { return T(std::cos(x)); };
+        if (op_type == "Not")
+            return [](T x) { return T(!x); };
+        return nullptr;
+    }
+
+    template <typename T>
+    using BinaryFunction = T (*)(T, T);
+
+    template <typename T>
+    BinaryFunction<T> binary_function(const std::string& op_type)
+    {
+        if (op_type == "Add")
+            return [](T a, T b) { return T(a + b); };
+        if (op_type == "Subtract")
+            return [](T a, T b) { return T(a - b); };
+        if (op_type == "Multiply")
+            return [](T a, T b) { return T(a * b); };
+        if (op_type == "Divide")
+            return [](T a, T b) { return T(a / b); };
+        if (op_type == "Maximum")
+            return [](T a, T b) { return a > b ? a : b; };
+        if (op_type == "Minimum")
+            return [](T a, T b) { return a < b ? a : b; };
+        if (op_type == "Power")
+            return [](T a, T b) { return T(std::pow(a, b)); };
+        if (op_type == "And")
+            return [](T a, T b) { return T(a && b); };
+        if (op_type == "Or")
+            return [](T a, T b) { return T(a || b); };
+        return nullptr;
+    }
+
+    template <typename T>
+    using CompareFunction = bool (*)(T, T);
+
+    template <typename T>
+    CompareFunction<T> compare_function(const std::string& op_type)
+    {
+        if (op_type == "Equal")
+            return [](T a, T b) { return a == b; };
+        if (op_type == "NotEqual")
+            return [](T a, T b) { return a != b; };
+        if (op_type == "Less")
+            return [](T a, T b) { return a < b; };
+        if (op_type == "LessEq")
+            return [](T a, T b) { return a <= b; };
+        if (op_type == "Greater")
+            return [](T a, T b) { return a > b; };
+        if (op_type == "GreaterEq")
+            return [](T a, T b) { return a >= b; };
+        return nullptr;
+    }
+
+    struct Elementwise
+    {
+        const GNode& node;
+        const Inputs& in;
+        char* out;
+
+        template <typename T>
+        bool apply()
+        {
+            auto op_type = node.get_op_type();
+            size_t count = shape_size(node.get_output_shape(0));
+            auto x = reinterpret_cast<const T*>(in[0]);
+            if (auto f = unary_function<T>(op_type))
+            {
+                auto y = reinterpret_cast<T*>(out);
+                for (size_t i = 0; i < count; ++i)
+                    y[i] = f(x[i]);
+                return true;
+            }
+            auto z = reinterpret_cast<const T*>(in[1]);
+            if (auto f = compare_function<T>(op_type))
+            {
+                for (size_t i = 0; i < count; ++i)
+                    out[i] = f(x[i], z[i]);
+                return true;
+            }
+            auto f = binary_function<T>(op_type);
+            if (!f)
+                return false;
+            // the reference kernel would trap on an integer division by zero
+            if (op_type == "Divide" && std::numeric_limits<T>::is_integer &&
+                std::find(z, z + count, T(0)) != z + count)
+                return false;
+            auto y = reinterpret_cast<T*>(out);
+            for (size_t i = 0; i < count; ++i)
+                y[i] = f(x[i], z[i]);
+            return true;
+        }
+    };
+
+    struct Select
+    {
+        const GNode& node;
+        const Inputs& in;
+        char* out;
+
+        template <typename T>
+        bool apply()
+        {
+            size_t count = shape_size(node.get_output_shape(0));
+            auto a = reinterpret_cast<const T*>(in[1]);
+            auto b = reinterpret_cast<const T*>(in[2]);
+            auto y = reinterpret_cast<T*>(out);
+            for (size_t i = 0; i < count; ++i)
+                y[i] = in[0][i] ? a[i] : b[i];
+            return true;
+        }
+    };
+
+    template <typename From>
+    struct ConvertTo
+    {
+        const From* x;
+        char* out;
+        size_t count;
+
+        template <typename T>
+        bool apply()
+        {
+            auto y = reinterpret_cast<T*>(out);
+            // a boolean is 1 for any non-zero value, not its truncation
+            bool to_boolean = std::is_same<T, char>::value;
+            for (size_t i = 0; i < count; ++i)
+                y[i] = to_boolean ? T(x[i] != From(0)) : T(x[i]);
+            return true;
+        }
+    };
+
+    struct Convert
+    {
+        const GNode& node;
+        const Inputs& in;
+        char* out;
+
+        template <typename T>
+        bool apply()
+        {
+            ConvertTo<T> to{reinterpret_cast<const T*>(in[0]),
+                            out,
+                            shape_size(node.get_output_shape(0))};
+            return dispatch(node.get_output_element_type(0), to);
+        }
+    };
+
+    struct Reduction
+    {
+        const GNode& node;
+        const Inputs& in;
+        char* out;
+
+        template <typename T>
+        bool apply()
+        {
+            auto op_type = node.get_op_type();
+            auto reduce = std::static_pointer_cast<op::ArithmeticReduction>(node.get_op_ptr());
+            auto& axes = reduce->get_reduction_axes();
+            auto& in_shape = node.get_input_shape(0);
+            auto out_strides = strides_of(node.get_output_shape(0));
+            // a reduced axis adds nothing to the output offset
+            std::vector<int64_t> to_out(in_shape.size(), 0);
+            for (size_t axis = 0, j = 0; axis < in_shape.size(); ++axis)
+            {
+                if (axes.count(axis) == 0)
+                    to_out[axis] = out_strides[j++];
+            }
+
+            T init = op_type == "Sum" ? T(0) : op_type == "Product"
+                                                   ? T(1)
+                                                   : op_type == "Max"
+                                                         ? std::numeric_limits<T>::lowest()
+                                                         : std::numeric_limits<T>::max();
+            auto x = reinterpret_cast<const T*>(in[0]);
+            auto y = reinterpret_cast<T*>(out);
+            std::fill(y, y + shape_size(node.get_output_shape(0)), init);
+            auto in_strides = strides_of(in_shape);
+            if (op_type == "Sum")
+                walk(in_shape, in_strides, 0, to_out, 0, [&](int64_t i, int64_t o) {
+                    y[o] += x[i];
+                });
+            else if (op_type == "Product")
+                walk(in_shape, in_strides, 0, to_out, 0, [&](int64_t i, int64_t o) {
+                    y[o] *= x[i];
+                });
+            else if (op_type == "Max")
+                walk(in_shape, in_strides, 0, to_out, 0, [&](int64_t i, int64_t o) {
+                    y[o] = std::max(y[o], x[i]);
+                });
+            else
+                walk(in_shape, in_strides, 0, to_out, 0, [&](int64_t i, int64_t o) {
+                    y[o] = std::min(y[o], x[i]);
+                });
+            return true;
+        }
+    };
+
+    struct Dot
+    {
+        const GNode& node;
+        const Inputs& in;
+        char* out;
+
+        template <typename T>
+        bool apply()
+        {
+            auto dot = std::static_pointer_cast<op::Dot>(node.get_op_ptr());
+            auto& a_shape = node.get_input_shape(0);
+            auto& b_shape = node.get_input_shape(1);
+            size_t k_axes = dot->get_reduction_axes_count();
+            bool trans_a = dot->get_transpose_A(), trans_b = dot->get_transpose_B();
+            if ((trans_a && a_shape.size() != 2) || (trans_b && b_shape.size() != 2))
+                return false;
+            if (k_axes > a_shape.size() || k_axes > b_shape.size())
+                return false;
+            size_t m = 1, k = 1, n = 1;
+            for (size_t axis = 0; axis < a_shape.size(); ++axis)
+                (axis < a_shape.size() - k_axes ? m : k) *= a_shape[trans_a ? 1 - axis : axis];
+            for (size_t axis = k_axes; axis < b_shape.size(); ++axis)
+                n *= b_shape[trans_b ? 1 - axis : axis];
+
+            auto a = reinterpret_cast<const T*>(in[0]);
+            auto b = reinterpret_cast<const T*>(in[1]);
+            auto y = reinterpret_cast<T*>(out);
+            for (size_t i = 0; i < m; ++i)
+            {
+                for (size_t j = 0; j < n; ++j)
+                {
+                    T sum = T(0);
+                    for (size_t l = 0; l < k; ++l)
+                        sum += a[trans_a ? l * m + i : i * k + l] *
+                               b[trans_b ? j * k + l : l * n + j];
+                    y[i * n + j] = sum;
+                }
+            }
+            return true;
+        }
+    };
+
+    // Runs Kernel for the element type of input type_input.
+    template <typename Kernel, size_t type_input = 0>
+    bool typed(const GNode& node, const Inputs& in, char* out)
+    {
+        Kernel kernel{node, in, out};
+        return dispatch(node.get_input_element_type(type_input), kernel);
+    }
+
+    bool reshape(const GNode& node, const Inputs& in, char* out)
+    {
+        auto reshape = std::static_pointer_cast<op::Reshape>(node.get_op_ptr());
+        auto& in_shape = node.get_input_shape(0);
+        auto in_strides = strides_of(in_shape);
+        Shape permuted;
+        std::vector<int64_t> strides;
+        for (auto axis : reshape->get_input_order())
+        {
+            permuted.push_back(in_shape[axis]);
+            strides.push_back(in_strides[axis]);
+        }
+        gather(permuted, strides, 0, node.get_input_element_type(0).size(), in[0], out);
+        return true;
+    }
+
+    bool broadcast(const GNode& node, const Inputs& in, char* out)
+    {
+        auto broadcast = std::static_pointer_cast<op::Broadcast>(node.get_op_ptr());
+        auto& axes = broadcast->get_broadcast_axes();
+        auto& out_shape = node.get_output_shape(0);
+        auto in_strides = strides_of(node.get_input_shape(0));
+        std::vector<int64_t> strides(out_shape.size(), 0);
+        for (size_t axis = 0, j = 0; axis < out_shape.size(); ++axis)
+        {
+            if (axes.count(axis) == 0)
+                strides[axis] = in_strides[j++];
+        }
+        gather(out_shape, strides, 0, node.get_input_element_type(0).size(), in[0], out);
+        return true;
+    }
+
+    bool slice(const GNode& node, const Inputs& in, char* out)
+    {
+        auto slice = std::static_pointer_cast<op::Slice>(node.get_op_ptr());
+        auto in_strides = strides_of(node.get_input_shape(0));
+        std::vector<int64_t> strides(in_strides.size());
+        int64_t offset = 0;
+        for (size_t axis = 0; axis < in_strides.size(); ++axis)
+        {
+            strides[axis] = in_strides[axis] * slice->get_strides()[axis];
+            offset += in_strides[axis] * slice->get_lower_bounds()[axis];
+        }
+        gather(node.get_output_shape(0),
+               strides,
+               offset,
+               node.get_input_element_type(0).size(),
+               in[0],
+               out);
+        return true;
+    }
+
+    bool reverse(const GNode& node, const Inputs& in, char* out)
+    {
+        auto reverse = std::static_pointer_cast<op::Reverse>(node.get_op_ptr());
+        auto& shape = node.get_input_shape(0);
+        auto strides = strides_of(shape);
+        int64_t offset = 0;
+        for (auto axis : reverse->get_reversed_axes())
+        {
+            offset += (shape[axis] - 1) * strides[axis];
+            strides[axis] = -strides[axis];
+        }
+        gather(shape, strides, offset, node.get_input_element_type(0).size(), in[0], out);
+        return true;
+    }
+
+    bool concat(const GNode& node, const Inputs& in, char* out)
+    {
+        auto concat = std::static_pointer_cast<op::Concat>(node.get_op_ptr());
+        size_t axis = concat->get_concatenation_axis();
+        auto& out_shape = node.get_output_shape(0);
+        size_t element_size = node.get_output_element_type(0).size();
+        size_t outer = 1, inner = element_size;
+        for (size_t i = 0; i < axis; ++i)
+            outer *= out_shape[i];
+        for (size_t i = axis + 1; i < out_shape.size(); ++i)
+            inner *= out_shape[i];
+        size_t row = out_shape[axis] * inner, column = 0;
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            size_t block = node.get_input_shape(i)[axis] * inner;
+            for (size_t o = 0; o < outer; ++o)
+                std::memcpy(out + o * row + column, in[i] + o * block, block);
+            column += block;
+        }
+        return true;
+    }
+
+    bool pad(const GNode& node, const Inputs& in, char* out)
+    {
+        auto pad = std::static_pointer_cast<op::Pad>(node.get_op_ptr());
+        auto& in_shape = node.get_input_shape(0);
+        auto out_strides = strides_of(node.get_output_shape(0));
+        size_t element_size = node.get_input_element_type(0).size();
+        size_t count = shape_size(node.get_output_shape(0));
+        for (size_t i = 0; i < count; ++i)
+            std::memcpy(out + i * element_size, in[1], element_size);
+
+        std::vector<int64_t> strides(in_shape.size());
+        int64_t offset = 0;
+        for (size_t axis = 0; axis < in_shape.size(); ++axis)
+        {
+            strides[axis] = out_strides[axis] * (pad->get_padding_interior()[axis] + 1);
+            offset += out_strides[axis] * pad->get_padding_below()[axis];
+        }
+        walk(in_shape, strides_of(in_shape), 0, strides, offset, [&](int64_t i, int64_t o) {
+            std::memcpy(out + o * element_size, in[0] + i * element_size, element_size);
+        });
+        return true;
+    }
+
+    bool identity(const GNode& node, const Inputs& in, char* out)
+    {
+        std::memcpy(out,
+                    in[0],
+                    shape_size(node.get_output_shape(0)) *
+                        node.get_output_element_type(0).size());
+        return true;
+    }
+
+    template <typename T>
+    std::string attributes_of(const T& value)
+    {
+        std::stringstream ss;
+        ss << value;
+        return ss.str();
+    }
+
+    std::string no_attributes(const GNode&) { return ""; }
+
+    struct Kernel
+    {
+        std::function<bool(const GNode&, const Inputs&, char*)> compute;
+        // the attributes of the op which the output depends on
+        std::function<std::string(const GNode&)> attributes;
+    };
+
+    const std::unordered_map<std::string, Kernel>& kernels()
+    {
+        static std::unordered_map<std::string, Kernel> kernels;
+        if (!kernels.empty())
+            return kernels;
+
+        Kernel elementwise{typed<Elementwise>, no_attributes};
+        for (auto op_type : {"Negative", "Abs",      "Square",  "Relu",     "Sign",  "Exp",
+                             "Log",      "Sqrt",     "Rsqrt",   "Sigmoid",  "Tanh",  "Erf",
+                             "Floor",    "Ceiling",  "Sin",     "Cos",      "Not",   "Add",
+                             "Subtract", "Multiply", "Divide",  "Maximum",  "Minimum", "Power",
+                             "And",      "Or",       "Equal",   "NotEqual", "Less",  "LessEq",
+                             "Greater",  "GreaterEq"})
+            kernels[op_type] = elementwise;
+
+        Kernel reduction{typed<Reduction>, [](const GNode& node) {
+                             return attributes_of(
+                                 std::static_pointer_cast<op::ArithmeticReduction>(
+                                     node.get_op_ptr())
+                                     ->get_reduction_axes());
+                         }};
+        for (auto op_type : {"Sum", "Product", "Max", "Min"})
+            kernels[op_type] = reduction;
+
+        kernels["Select"] = {typed<Select, 1>, no_attributes};
+        kernels["Convert"] = {typed<Convert>, no_attributes};
+        kernels["Dot"] = {typed<Dot>, [](const GNode& node) {
+                              auto dot = std::static_pointer_cast<op::Dot>(node.get_op_ptr());
+                              return attributes_of(dot->get_reduction_axes_count()) +
+                                     (dot->get_transpose_A() ? "T" : "N") +
+                                     (dot->get_transpose_B() ? "T" : "N");
+                          }};
+        kernels["Reshape"] = {reshape, [](const GNode& node) {
+                                  return attributes_of(
+                                      std::static_pointer_cast<op::Reshape>(node.get_op_ptr())
+                                          ->get_input_order());
+                              }};
+        kernels["Broadcast"] = {broadcast, [](const GNode& node) {
+                                    return attributes_of(
+                                        std::static_pointer_cast<op::Broadcast>(
+                                            node.get_op_ptr())
+                                            ->get_broadcast_axes());
+                                }};
+        kernels["Slice"] = {slice, [](const GNode& node) {
+                                auto slice =
+                                    std::static_pointer_cast<op::Slice>(node.get_op_ptr());
+                                return attributes_of(slice->get_lower_bounds()) +
+                                       attributes_of(slice->get_strides());
+                            }};
+        kernels["Reverse"] = {reverse, [](const GNode& node) {
+                                  return attributes_of(
+                                      std::static_pointer_cast<op::Reverse>(node.get_op_ptr())
+                                          ->get_reversed_axes());
+                              }};
+        kernels["Concat"] = {concat, [](const GNode& node) {
+                                 return attributes_of(
+                                     std::static_pointer_cast<op::Concat>(node.get_op_ptr())
+                                         ->get_concatenation_axis());
+                             }};
+        kernels["Pad"] = {pad, [](const GNode& node) {
+                              auto pad = std::static_pointer_cast<op::Pad>(node.get_op_ptr());
+                              return attributes_of(pad->get_padding_below()) +
+                                     attributes_of(pad->get_padding_interior());
+                          }};
+        kernels["StopGradient"] = {identity, no_attributes};
+        return kernels;
+    }
+} // namespace
+
+bool ConstantEvaluator::supports(const std::shared_ptr<GNode>& node)
+{
+    return node->get_output_size() == 1 && kernels().count(node->get_op_type()) > 0;
+}
+
+std::shared_ptr<op::ConstantData>
+    ConstantEvaluator::evaluate(const std::shared_ptr<GNode>& node,
+                                const std::vector<std::shared_ptr<op::ConstantData>>& inputs)
+{
+    if (!supports(node))
+        return nullptr;
+    auto& kernel = kernels().at(node->get_op_type());
+
+    std::stringstream signature;
+    signature << node->get_op_type() << ":" << kernel.attributes(*node);
+    for (size_t i = 0; i < node->get_input_size(); ++i)
+        signature << ";" << node->get_input_element_type(i).c_type_string()
+                  << node->get_input_shape(i);
+    signature << "->" << node->get_output_element_type(0).c_type_string()
+              << node->get_output_shape(0);
+    for (auto& input : inputs)
+        signature << ";" << input->hash();
+    auto key = signature.str();
+
+    auto range = m_cache.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        bool same = true;
+        for (size_t i = 0; same && i < inputs.size(); ++i)
+            same = it->second.inputs[i]->equals(*inputs[i]);
+        if (same)
+        {
+            ++m_cache_hits;
+            return it->second.output;
+        }
+    }
+
+    auto& dtype = node->get_output_element_type(0);
+    auto output = std::make_shared<op::ConstantData>(
+        shape_size(node->get_output_shape(0)) * dtype.size(), dtype.size());
+    Inputs in;
+    for (auto& input : inputs)
+        in.push_back(static_cast<const char*>(input->data()));
+    if (!kernel.compute(*node, in, static_cast<char*>(output->data())))
+        return nullptr;
+
+    ++m_evaluated;
+    m_cache.emplace(key, CacheEntry{inputs, output});
+    return output;
+}
+
+void ConstantEvaluator::release(const std::shared_ptr<op::ConstantData>& data)
+{
+    for (auto it = m_cache.begin(); it != m_cache.end();)
+    {
+        auto& inputs = it->second.inputs;
+        if (it->second.output == data ||
+            std::find(inputs.begin(), inputs.end(), data) != inputs.end())
+            it = m_cache.erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "nnfusion/core/graph/gnode.hpp"
+#include "nnfusion/core/operators/op_define/constant.hpp"
+
+namespace nnfusion
+{
+    namespace pass
+    {
+        namespace graph
+        {
+            // Evaluates an op on constant inputs inside nnfusion, with C++ versions of the CPU
+            // reference kernels, so that constant folding does not build and run a kernel per
+            // node. Covers the elementwise, data movement, reduction and Dot ops that constant
+            // subgraphs are made of; the others are left to the profiling runtimes.
+            //
+            // Results are cached by the signature of the op, i.e. its type, attributes and
+            // tensor types, and the hashes of its input data, so that a subgraph repeated over
+            // the layers of a model is only evaluated once.
+            class ConstantEvaluator
+            {
+            public:
+                static bool supports(const std::shared_ptr<nnfusion::graph::GNode>& node);
+
+                // The output of node for the data of its inputs, or nullptr if the op or its
+                // element types are not supported.
+                std::shared_ptr<op::ConstantData>
+                    evaluate(const std::shared_ptr<nnfusion::graph::GNode>& node,
+                             const std::vector<std::shared_ptr<op::ConstantData>>& inputs);
+
+                // Drops the cached results which read or hold data, once its constant is out of
+                // the graph, so that the cache does not keep the intermediate tensors of constant
+                // subgraphs alive.
+                void release(const std::shared_ptr<op::ConstantData>& data);
+
+                size_t get_evaluated_count() const { return m_evaluated; }
+                size_t get_cache_hit_count() const { return m_cache_hits; }
+                size_t get_cached_count() const { return m_cache.size(); }
+            private:
+                struct CacheEntry
+                {
+                    std::vector<std::shared_ptr<op::ConstantData>> inputs;
+                    std::shared_ptr<op::ConstantData> output;
+                };
+
+                // op signature and input hashes -> results
+                std::unordered_multimap<std::string, CacheEntry> m_cache;
+                size_t m_evaluated = 0;
+                size_t m_cache_hits = 0;
+            };
+        } // namespace graph
+    }     // namespace pass
+} // namespace nnfusion
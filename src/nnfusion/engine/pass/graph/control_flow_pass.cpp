@@ -0,0 +1,104 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "control_flow_pass.hpp"
+#include "assign_layout_pass.hpp"
+#include "common_subexpression_elimination_pass.hpp"
+#include "gnode_device_dispatcher.hpp"
+#include "kernel_selection.hpp"
+#include "multi_reshape_folding_pass.hpp"
+#include "nnfusion/core/operators/op_define/control_flow.hpp"
+#include "runtime_const_folding_pass.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::graph;
+using namespace nnfusion::pass::graph;
+
+namespace
+{
+    // Move the constants of a body to the enclosing graph, where the codegen loads them with the
+    // other weights, and bind the body to them as captured inputs of the op.
+    void hoist_constants(std::shared_ptr<Graph>& graph,
+                         std::shared_ptr<GNode> gnode,
+                         op::ControlFlowBody& body)
+    {
+        for (auto node : body.graph->get_nodes())
+        {
+            if (!node->is_constant())
+                continue;
+            auto constant = graph->add_node_and_edge(node->get_op_ptr(), GNodeVector());
+            auto param_op = std::make_shared<op::Parameter>(node->get_output_element_type(0),
+                                                            node->get_output_shape(0));
+            auto param = std::make_shared<GNode>(param_op, GNodeVector());
+            body.graph->replace_node(node, param, false);
+
+            size_t input = gnode->get_input_size();
+            gnode->set_input(input,
+                             std::make_shared<Input>(constant->get_output_element_type(0),
+                                                     constant->get_output_shape(0)));
+            graph->add_edge(constant, 0, gnode, input);
+            body.captures.emplace_back(param, input);
+        }
+        body.graph->set_default_parameters();
+    }
+
+    bool compile_body(std::shared_ptr<Graph>& graph,
+                      std::shared_ptr<GNode> gnode,
+                      op::ControlFlowBody& body)
+    {
+        std::vector<std::shared_ptr<GraphPassBase>> simplify{
+            std::make_shared<CSEPass>(),
+            std::make_shared<RuntimeConstantFoldingPass>(),
+            std::make_shared<MultiReshapeFoldingPass>(),
+            std::make_shared<ControlFlowPass>()};
+        for (auto& pass : simplify)
+        {
+            if (!pass->run_on_graph(body.graph))
+                return false;
+        }
+
+        hoist_constants(graph, gnode, body);
+
+        std::vector<std::shared_ptr<GraphPassBase>> select{
+            std::make_shared<AssignLayoutPass>(),
+            std::make_shared<DefaultGNodeDeviceDispatcher>(),
+            std::make_shared<DefaultKernelSelector>()};
+        for (auto& pass : select)
+        {
+            if (!pass->run_on_graph(body.graph))
+                return false;
+        }
+
+        for (auto node : body.graph->get_ordered_ops())
+        {
+            if (node->is_parameter() || node->get_op_ptr()->is_output())
+                continue;
+            NNFUSION_CHECK((*node)["Kernel_Selection_Result"].is_valid())
+                << "No kernel for " << node->get_name() << " (" << node->get_op_type()
+                << ") in a body of " << gnode->get_name();
+        }
+        return true;
+    }
+}
+
+bool ControlFlowPass::run_on_graph(std::shared_ptr<Graph>& graph)
+{
+    size_t compiled = 0;
+    for (auto gnode : graph->get_ordered_ops())
+    {
+        auto op = std::dynamic_pointer_cast<op::ControlFlowOp>(gnode->get_op_ptr());
+        if (!op)
+            continue;
+        for (auto& body : op->get_bodies())
+        {
+            if (!compile_body(graph, gnode, body))
+                return false;
+            compiled++;
+        }
+        // the hoisted constants are new inputs
+        op->revalidate_and_infer_types(gnode);
+    }
+    if (compiled > 0)
+        NNFUSION_LOG(INFO) << "Control flow: " << compiled << " bodies compiled.";
+    return true;
+}
@@ -0,0 +1,25 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "graph_pass_base.hpp"
+
+namespace nnfusion
+{
+    namespace pass
+    {
+        namespace graph
+        {
+            // Compile the bodies of If, Loop and Scan as graphs of their own: simplify them,
+            // move their constants out to the enclosing graph as captured weights, and select a
+            // kernel for every node, which the kernel of the op then calls once per iteration
+            // or branch taken. Runs before the kernel selection of the enclosing graph.
+            class ControlFlowPass : public GraphPassBase
+            {
+            public:
+                bool run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& graph) override;
+            };
+        } // namespace graph
+    }     // namespace pass
+} // namespace nnfusion
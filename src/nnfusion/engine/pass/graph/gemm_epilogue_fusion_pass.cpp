@@ -0,0 +1,247 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "gemm_epilogue_fusion_pass.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+#include "nnfusion/core/operators/op_define/broadcast.hpp"
+#include "nnfusion/core/operators/op_define/convolution.hpp"
+#include "nnfusion/core/operators/op_define/dot.hpp"
+
+DEFINE_bool(fgemm_epilogue_fusion,
+            false,
+            "Fuse the bias add, residual add and activation after CPU Dot and Convolution ops "
+            "into their MLAS kernels.");
+
+using namespace nnfusion;
+using namespace nnfusion::graph;
+using namespace nnfusion::pass::graph;
+
+namespace
+{
+    // Activations MLAS applies to the convolution output, the Dot kernel also runs gelu.
+    const std::unordered_map<std::string, std::string> kActivations = {
+        {"Relu", "relu"}, {"Sigmoid", "sigmoid"}, {"Tanh", "tanh"}, {"Gelu", "gelu"}};
+
+    template <typename T>
+    std::vector<int64_t> to_int64(const T& values)
+    {
+        return std::vector<int64_t>(values.begin(), values.end());
+    }
+
+    class GemmEpilogueFusion
+    {
+    public:
+        GemmEpilogueFusion(std::shared_ptr<Graph>& graph)
+            : m_graph(graph)
+            , m_outputs(graph->get_outputs())
+        {
+        }
+
+        void run()
+        {
+            for (auto& node : m_graph->get_ordered_ops())
+            {
+                if (m_removed.count(node) || node->get_output_size() != 1 ||
+                    node->get_output_element_type(0) != element::f32 ||
+                    node->get_input_element_type(0) != element::f32 ||
+                    node->get_input_element_type(1) != element::f32)
+                    continue;
+                auto type = node->get_op_type();
+                if (type == "Dot")
+                    fuse_dot(node);
+                else if (type == "Convolution")
+                    fuse_convolution(node);
+            }
+            m_graph->set_outputs(m_outputs);
+
+            if (m_fused > 0)
+                NNFUSION_LOG(INFO) << "GEMM epilogue fusion: " << m_fused
+                                   << " ops fused into Dot and Convolution kernels.";
+        }
+
+    private:
+        // The ops after a GEMM which its kernel applies: bias is the tensor broadcast to the
+        // output over the axes but the channel or column one, residual a tensor of the output
+        // shape.
+        struct Epilogue
+        {
+            GNodeVector fused;
+            GNodeIndex bias, residual;
+            std::shared_ptr<GNode> broadcast;
+            std::string activation;
+        };
+
+        GNodeIndex input_of(const std::shared_ptr<GNode>& node, size_t i)
+        {
+            auto edge = node->get_in_edge(i);
+            NNFUSION_CHECK_NOT_NULLPTR(edge);
+            return GNodeIndex(edge->get_src(), edge->get_src_output());
+        }
+
+        // The only consumer of node if it has one and is not a graph output.
+        std::shared_ptr<GNode> single_consumer(const std::shared_ptr<GNode>& node)
+        {
+            if (node->get_out_edges().size() != 1 ||
+                std::find(m_outputs.begin(), m_outputs.end(), node) != m_outputs.end())
+                return nullptr;
+            auto edge = *node->get_out_edges().begin();
+            return edge->is_control_edge() ? nullptr : edge->get_dst();
+        }
+
+        // The other input of an f32 Add of node, nullptr if consumer is not one.
+        std::shared_ptr<GNode> add_operand(const std::shared_ptr<GNode>& consumer,
+                                           const std::shared_ptr<GNode>& node,
+                                           GNodeIndex& other)
+        {
+            if (!consumer || consumer->get_op_type() != "Add" ||
+                consumer->get_output_element_type(0) != element::f32 ||
+                consumer->get_input_shape(0) != consumer->get_input_shape(1))
+                return nullptr;
+            other = input_of(consumer, 0).gnode == node ? input_of(consumer, 1)
+                                                          : input_of(consumer, 0);
+            return other.gnode == node ? nullptr : consumer;
+        }
+
+        Epilogue find_epilogue(const std::shared_ptr<GNode>& node,
+                               const AxisSet& bias_axes,
+                               bool allow_gelu)
+        {
+            Epilogue epilogue;
+            epilogue.fused.push_back(node);
+            const Shape& shape = node->get_output_shape(0);
+            auto last = node;
+            auto consumer = single_consumer(last);
+
+            GNodeIndex other;
+            if (add_operand(consumer, last, other))
+            {
+                auto broadcast =
+                    std::dynamic_pointer_cast<op::Broadcast>(other.gnode->get_op_ptr());
+                if (broadcast && broadcast->get_broadcast_axes() == bias_axes &&
+                    other.gnode->get_input_element_type(0) == element::f32)
+                {
+                    epilogue.bias = input_of(other.gnode, 0);
+                    epilogue.broadcast = other.gnode;
+                    epilogue.fused.push_back(consumer);
+                    last = consumer;
+                    consumer = single_consumer(last);
+                }
+            }
+            if (add_operand(consumer, last, other) && other.get_shape() == shape &&
+                other.get_element_type() == element::f32)
+            {
+                epilogue.residual = other;
+                epilogue.fused.push_back(consumer);
+                last = consumer;
+                consumer = single_consumer(last);
+            }
+            if (consumer && consumer->get_output_element_type(0) == element::f32)
+            {
+                auto it = kActivations.find(consumer->get_op_type());
+                if (it != kActivations.end() && (allow_gelu || it->second != "gelu"))
+                {
+                    epilogue.activation = it->second;
+                    epilogue.fused.push_back(consumer);
+                }
+            }
+            return epilogue;
+        }
+
+        void fuse_dot(const std::shared_ptr<GNode>& node)
+        {
+            auto dot = std::dynamic_pointer_cast<op::Dot>(node->get_op_ptr());
+            if (dot->get_reduction_axes_count() != 1 || node->get_input_shape(0).size() != 2 ||
+                node->get_input_shape(1).size() != 2)
+                return;
+            auto epilogue = find_epilogue(node, AxisSet({0}), true);
+            if (epilogue.fused.size() == 1)
+                return;
+
+            op::OpConfig::any config;
+            config["trans_A"] = dot->get_transpose_A();
+            config["trans_B"] = dot->get_transpose_B();
+            replace(node, "FusedDot", config, epilogue);
+        }
+
+        void fuse_convolution(const std::shared_ptr<GNode>& node)
+        {
+            auto conv = std::dynamic_pointer_cast<op::Convolution>(node->get_op_ptr());
+            auto& format = conv->get_data_format();
+            const Shape& input_shape = node->get_input_shape(0);
+            const Shape& filter_shape = node->get_input_shape(1);
+            // The shapes ConvolutionMlas runs: no groups and no data dilation.
+            if ((format != "NCHW" && format != "NCW") ||
+                filter_shape.size() != input_shape.size() || filter_shape[1] != input_shape[1])
+                return;
+            for (auto stride : conv->get_data_dilation_strides())
+                if (stride != 1)
+                    return;
+            AxisSet bias_axes{0};
+            for (size_t axis = 2; axis < input_shape.size(); axis++)
+                bias_axes.insert(axis);
+            auto epilogue = find_epilogue(node, bias_axes, false);
+            if (epilogue.fused.size() == 1)
+                return;
+
+            op::OpConfig::any config;
+            config["strides"] = to_int64(conv->get_window_movement_strides());
+            config["dilations"] = to_int64(conv->get_window_dilation_strides());
+            config["padding_below"] = to_int64(conv->get_padding_below());
+            config["padding_above"] = to_int64(conv->get_padding_above());
+            config["data_format"] = format;
+            replace(node, "FusedConv", config, epilogue);
+        }
+
+        // Replace the last op of the epilogue by the fused op and remove the others.
+        void replace(const std::shared_ptr<GNode>& node,
+                     const std::string& op_type,
+                     op::OpConfig::any& config,
+                     const Epilogue& epilogue)
+        {
+            config["activation"] = epilogue.activation;
+            config["has_bias"] = !epilogue.bias.empty();
+            config["has_residual"] = !epilogue.residual.empty();
+            GNodeIndexVector inputs({input_of(node, 0), input_of(node, 1)});
+            if (!epilogue.bias.empty())
+                inputs.push_back(epilogue.bias);
+            if (!epilogue.residual.empty())
+                inputs.push_back(epilogue.residual);
+            auto fused_op = std::make_shared<op::GenericOp>(node->get_name() + "_epilogue",
+                                                            op_type, config);
+            auto fused = m_graph->add_node_and_edge(fused_op, inputs);
+            auto last = epilogue.fused.back();
+            NNFUSION_CHECK(fused->get_output_shape(0) == last->get_output_shape(0));
+
+            std::replace(m_outputs.begin(), m_outputs.end(), last, fused);
+            m_graph->replace_node(last, fused, false);
+            m_removed.insert(last);
+            for (auto it = epilogue.fused.rbegin(); it != epilogue.fused.rend(); ++it)
+            {
+                if (*it != last && (*it)->get_out_edges().empty())
+                {
+                    m_graph->remove_node(*it);
+                    m_removed.insert(*it);
+                }
+            }
+            if (epilogue.broadcast && epilogue.broadcast->get_out_edges().empty())
+            {
+                m_graph->remove_node(epilogue.broadcast);
+                m_removed.insert(epilogue.broadcast);
+            }
+            m_fused += epilogue.fused.size() - 1;
+        }
+
+        std::shared_ptr<Graph>& m_graph;
+        GNodeVector m_outputs;
+        std::unordered_set<std::shared_ptr<GNode>> m_removed;
+        size_t m_fused = 0;
+    };
+} // namespace
+
+bool GemmEpilogueFusionPass::run_on_graph(std::shared_ptr<Graph>& graph)
+{
+    if (!FLAGS_fgemm_epilogue_fusion)
+        return true;
+    GemmEpilogueFusion(graph).run();
+    return true;
+}
@@ -0,0 +1,24 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "graph_pass_base.hpp"
+
+namespace nnfusion
+{
+    namespace pass
+    {
+        namespace graph
+        {
+            // Fold the bias add, residual add and activation after a CPU 2D Dot or NCHW/NCW
+            // Convolution into a FusedDot or FusedConv, whose MLAS kernel applies them to the
+            // GEMM output while it is in cache instead of passing over the tensor once per op.
+            class GemmEpilogueFusionPass : public GraphPassBase
+            {
+            public:
+                bool run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& graph) override;
+            };
+        } // namespace graph
+    }     // namespace pass
+} // namespace nnfusion
@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "heft_scheduler.hpp"
+#include <algorithm>
+#include <limits>
+#include "nnfusion/util/util.hpp"
+
+using namespace nnfusion::pass::graph;
+
+HeftSchedule nnfusion::pass::graph::heft_schedule(const std::vector<double>& cost,
+                                                  const std::vector<std::vector<int>>& preds,
+                                                  size_t max_threads,
+                                                  double event_cost)
+{
+    size_t n = cost.size();
+    NNFUSION_CHECK(preds.size() == n);
+    max_threads = std::max<size_t>(max_threads, 1);
+
+    std::vector<std::vector<int>> succs(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (auto p : preds[i])
+        {
+            NNFUSION_CHECK(p >= 0 && p < (int)i) << "Tasks are not in topological order.";
+            succs[p].push_back(i);
+        }
+    }
+
+    std::vector<double> rank(n, 0);
+    for (size_t i = n; i-- > 0;)
+    {
+        double tail = 0;
+        for (auto s : succs[i])
+            tail = std::max(tail, event_cost + rank[s]);
+        rank[i] = cost[i] + tail;
+    }
+    // A task outranks its successors unless both cost nothing, the stable sort keeps them in
+    // topological order then.
+    std::vector<int> order(n);
+    for (size_t i = 0; i < n; i++)
+        order[i] = i;
+    std::stable_sort(
+        order.begin(), order.end(), [&](int a, int b) { return rank[a] > rank[b]; });
+
+    HeftSchedule schedule;
+    schedule.thread.assign(n, -1);
+    schedule.start.assign(n, 0);
+    schedule.finish.assign(n, 0);
+    // time when every thread becomes idle
+    std::vector<double> available;
+    const double eps = 1e-9;
+    for (auto i : order)
+    {
+        int best_thread = -1;
+        double best_start = 0, best_finish = std::numeric_limits<double>::max();
+        size_t best_local = 0;
+        // the open threads, and a new one while there are threads left
+        size_t candidates = std::min(available.size() + 1, max_threads);
+        for (size_t t = 0; t < candidates; t++)
+        {
+            double ready = t < available.size() ? available[t] : 0;
+            size_t local = 0;
+            for (auto p : preds[i])
+            {
+                NNFUSION_CHECK(schedule.thread[p] >= 0);
+                bool same = schedule.thread[p] == (int)t;
+                local += same;
+                ready = std::max(ready, schedule.finish[p] + (same ? 0 : event_cost));
+            }
+            double finish = ready + cost[i];
+            if (finish < best_finish - eps || (finish <= best_finish + eps && local > best_local))
+            {
+                best_thread = t;
+                best_start = ready;
+                best_finish = finish;
+                best_local = local;
+            }
+        }
+        if (best_thread == (int)available.size())
+            available.push_back(0);
+        available[best_thread] = best_finish;
+        schedule.thread[i] = best_thread;
+        schedule.start[i] = best_start;
+        schedule.finish[i] = best_finish;
+        schedule.makespan = std::max(schedule.makespan, best_finish);
+        schedule.serial += cost[i];
+    }
+
+    schedule.num_threads = available.size();
+    for (size_t i = 0; i < n; i++)
+    {
+        for (auto p : preds[i])
+            schedule.cross_thread_deps += schedule.thread[p] != schedule.thread[i];
+    }
+    return schedule;
+}
@@ -0,0 +1,41 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace nnfusion
+{
+    namespace pass
+    {
+        namespace graph
+        {
+            struct HeftSchedule
+            {
+                // thread, start and finish time of every task
+                std::vector<int> thread;
+                std::vector<double> start;
+                std::vector<double> finish;
+                size_t num_threads = 0;
+                double makespan = 0;
+                // the time of running all tasks on one thread
+                double serial = 0;
+                // dependencies between tasks of different threads, each one waits on an event
+                size_t cross_thread_deps = 0;
+            };
+
+            // HEFT list scheduling on up to max_threads identical threads. Tasks are given in
+            // topological order with their cost and predecessors. A dependency between two
+            // threads delays its successor by event_cost. Tasks are taken by decreasing upward
+            // rank, i.e. the length of the critical path from the task to the end of the graph,
+            // and go to the thread where they finish first; ties go to the thread holding most
+            // of their predecessors, so that no event is added for nothing.
+            HeftSchedule heft_schedule(const std::vector<double>& cost,
+                                       const std::vector<std::vector<int>>& preds,
+                                       size_t max_threads,
+                                       double event_cost);
+        } // namespace graph
+    }     // namespace pass
+} // namespace nnfusion
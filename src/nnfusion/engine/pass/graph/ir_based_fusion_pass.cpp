@@ -12,6 +12,8 @@ using namespace nnfusion::pass::graph;
 using namespace nnfusion::kernels;
 
 DECLARE_bool(fantares_mode);
+DECLARE_bool(fantares_cpu_builtin);
+DECLARE_string(fdefault_device);
 DECLARE_string(ftuning_blocklist);
 DEFINE_bool(fir_based_fusion, false, "");
 DEFINE_string(firfusion_blocklist,
@@ -137,7 +139,7 @@ private:
 
     bool parse_block_list()
     {
-        fLS::clstring blocklist_str;
+        std::string blocklist_str;
         if (FLAGS_ftuning_blocklist != "")
             blocklist_str = FLAGS_ftuning_blocklist + ",";
 
@@ -160,7 +162,9 @@ private:
 
 bool IRBasedFusionPass::run_on_graph(std::shared_ptr<Graph>& graph)
 {
-    if (FLAGS_fir_based_fusion && FLAGS_fantares_mode)
+    // without the antares mode, only the CPU kernels lowered in nnfusion can run fused groups
+    bool builtin = FLAGS_fantares_cpu_builtin && FLAGS_fdefault_device == "CPU";
+    if (FLAGS_fir_based_fusion && (FLAGS_fantares_mode || builtin))
     {
         IRBasedFusionOptimizer optimizer(graph);
         auto status = optimizer.Optimize();
@@ -24,6 +24,48 @@ bool KernelProfilingPass::run_on_graph(std::shared_ptr<nnfusion::graph::Graph>&
 
 bool KernelProfilingPass::default_profiling_pass(std::shared_ptr<nnfusion::graph::Graph>& graph)
 {
+    auto profiling_kernel =
+        [](KernelEmitter::Pointer kernel,
+           IProfilingRuntime::Pointer runtime,
+           ProfilingContext::Pointer pctx) -> KernelProfilingRecord::Pointer {
+        if (kernel->get_or_emit_source())
+        {
+            if (pctx == nullptr)
+                pctx = make_shared<nnfusion::profiler::ProfilingContext>(kernel);
+            nnfusion::profiler::Profiler prof(runtime, pctx);
+
+            if (prof.execute())
+            {
+                double kernel_time = pctx->result.get_device_avg();
+                auto record = make_shared<KernelProfilingRecord>();
+                record->kernel_time_in_us = kernel_time;
+                record->valid = true;
+
+                NNFUSION_LOG(INFO) << "Profiling kernel: " << kernel->get_function_name()
+                                   << ", kernel time(us):" << kernel_time;
+                return record;
+            }
+            else
+            {
+                NNFUSION_LOG(INFO) << "Kernel Failed.";
+            }
+        }
+        return nullptr;
+    };
+
+    struct PendingKernel
+    {
+        std::shared_ptr<GNode> gnode;
+        NNFusion_DeviceType device_type;
+        KernelEmitter::Pointer kernel;
+        IProfilingRuntime::Pointer runtime;
+        ProfilingContext::Pointer pctx;
+    };
+
+    // Compile all kernels of the graph up front so that builds run in parallel, then profile
+    // them one by one.
+    std::vector<PendingKernel> pending;
+    std::unordered_map<IProfilingRuntime::Pointer, std::shared_ptr<CompileScheduler>> schedulers;
     std::vector<std::shared_ptr<GNode>> nodes = graph->get_nodes();
     for (auto it : nodes)
     {
@@ -36,59 +78,45 @@ bool KernelProfilingPass::default_profiling_pass(std::shared_ptr<nnfusion::graph
 
             if (!(*it)["Kernel_Profiling_Result"].is_valid() && !it->is_constant())
             {
-                auto profiling_kernel =
-                    [](KernelEmitter::Pointer kernel,
-                       IProfilingRuntime::Pointer runtime) -> KernelProfilingRecord::Pointer {
-                    if (kernel->get_or_emit_source())
-                    {
-                        auto pctx = make_shared<nnfusion::profiler::ProfilingContext>(kernel);
-                        nnfusion::profiler::Profiler prof(runtime, pctx);
-
-                        if (prof.execute())
-                        {
-                            double kernel_time = pctx->result.get_device_avg();
-                            auto record = make_shared<KernelProfilingRecord>();
-                            record->kernel_time_in_us = kernel_time;
-                            record->valid = true;
-
-                            NNFUSION_LOG(INFO)
-                                << "Profiling kernel: " << kernel->get_function_name()
-                                << ", kernel time(us):" << kernel_time;
-                            return record;
-                        }
-                        else
-                        {
-                            NNFUSION_LOG(INFO) << "Kernel Failed.";
-                        }
-                    }
-                    return nullptr;
-                };
-                KernelProfilingRecord::Pointer result;
-
+                IProfilingRuntime::Pointer runtime;
                 if (n_device_type == CUDA_GPU)
-                {
-                    result = profiling_kernel(kernel, CUPTIRuntime::Runtime());
-                }
+                    runtime = CUPTIRuntime::Runtime();
                 else if (n_device_type == GENERIC_CPU)
-                {
-                    result = profiling_kernel(kernel, CPUDefaultRuntime::Runtime());
-                }
+                    runtime = CPUDefaultRuntime::Runtime();
                 else
-                {
-                    result = profiling_kernel(kernel, get_default_runtime(n_device_type));
-                    if (!result && n_device_type == ROCM_GPU)
-                    {
-                        result = profiling_kernel(kernel, get_default_runtime(CUDA_GPU));
-                    }
-                }
+                    runtime = get_default_runtime(n_device_type);
 
-                if (result)
+                ProfilingContext::Pointer pctx = nullptr;
+                if (runtime != nullptr && kernel->get_or_emit_source())
                 {
-                    (*it)["Kernel_Profiling_Result"] = result;
+                    pctx = make_shared<nnfusion::profiler::ProfilingContext>(kernel);
+                    if (schedulers.find(runtime) == schedulers.end())
+                        schedulers[runtime] = make_shared<CompileScheduler>(runtime);
+                    schedulers[runtime]->add(pctx);
                 }
+                pending.push_back({it, n_device_type, kernel, runtime, pctx});
             }
         }
     }
+
+    for (auto& it : schedulers)
+        it.second->run();
+
+    for (auto& item : pending)
+    {
+        KernelProfilingRecord::Pointer result;
+        if (item.runtime != nullptr)
+            result = profiling_kernel(item.kernel, item.runtime, item.pctx);
+        if (!result && item.device_type == ROCM_GPU)
+        {
+            result = profiling_kernel(item.kernel, get_default_runtime(CUDA_GPU), nullptr);
+        }
+
+        if (result)
+        {
+            (*item.gnode)["Kernel_Profiling_Result"] = result;
+        }
+    }
     return true;
 }
 
@@ -39,6 +39,9 @@ pair<NNFusion_DeviceType, kernels::KernelEmitter::Pointer>
     };
     priority_queue<ProfilingContext::Pointer, vector<ProfilingContext::Pointer>, decltype(comparef)>
         prof_res(comparef);
+    // Build all candidates together before running any of them.
+    vector<ProfilingContext::Pointer> candidates;
+    CompileScheduler scheduler(runtime);
     for (auto kernel_reg : kernel_regs)
     {
         auto kernel = kernel_reg->m_factory(ctx);
@@ -46,16 +49,24 @@ pair<NNFusion_DeviceType, kernels::KernelEmitter::Pointer>
         {
             has_valid_kernel = true;
             auto pctx = make_shared<nnfusion::profiler::ProfilingContext>(kernel);
-            nnfusion::profiler::Profiler prof(runtime, pctx);
+            candidates.push_back(pctx);
+            scheduler.add(pctx);
+        }
+    }
+    if (runtime != nullptr)
+        scheduler.run();
 
-            if (!prof.execute())
-                NNFUSION_LOG(INFO) << "Kernel Failed.";
-            else
-            {
-                NNFUSION_LOG(INFO) << "Kernel Emitter#" << prof_res.size()
-                                   << " time cost(ms):" << pctx->result.get_device_avg();
-                prof_res.push(pctx);
-            }
+    for (auto& pctx : candidates)
+    {
+        nnfusion::profiler::Profiler prof(runtime, pctx);
+
+        if (!prof.execute())
+            NNFUSION_LOG(INFO) << "Kernel Failed.";
+        else
+        {
+            NNFUSION_LOG(INFO) << "Kernel Emitter#" << prof_res.size()
+                               << " time cost(ms):" << pctx->result.get_device_avg();
+            prof_res.push(pctx);
         }
     }
 
@@ -401,6 +412,19 @@ bool FetchBasedSelector::run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& g
     // NNFusion_DeviceType default_device = nnfusion::get_device_type(dev_name);
 
     std::vector<std::shared_ptr<GNode>> nodes = graph->get_nodes();
+    // Load the entries of the whole graph at once instead of querying node by node.
+    std::unordered_map<std::string, std::vector<std::string>> identifiers;
+    for (auto it : nodes)
+    {
+        if ((*it)["Kernel_Selection_Result"].is_valid() || !(*it)["DeviceType"].is_valid())
+            continue;
+        shared_ptr<KernelContext> ctx(new KernelContext(it));
+        identifiers[get_device_str((*it)["DeviceType"].as<NNFusion_DeviceType>())].push_back(
+            ctx->generate_identifier());
+    }
+    for (auto& it : identifiers)
+        cache_manager->prefetch(it.second, it.first);
+
     for (auto it : nodes)
     {
         if (!(*it)["Kernel_Selection_Result"].is_valid())
@@ -418,6 +442,7 @@ bool FetchBasedSelector::run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& g
                 (*it)["Kernel_Selection_Result"] = ans;
         }
     }
+    NNFUSION_LOG(INFO) << "Kernel cache " << cache::KernelCacheManager::get_stats_string();
 
     return true;
 }
\ No newline at end of file
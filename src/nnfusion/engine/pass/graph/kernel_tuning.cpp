@@ -9,6 +9,7 @@
 #include "nnfusion/core/kernels/cpu/cpu_kernel_emitter.hpp"
 #include "nnfusion/core/kernels/cuda_gpu/cuda_emitter.hpp"
 #include "nnfusion/core/kernels/hlsl/hlsl_kernel_emitter.hpp"
+#include "nnfusion/engine/profiler/profiler.hpp"
 #include "nnfusion/util/curl_request.hpp"
 
 using namespace nnfusion;
@@ -22,10 +23,15 @@ DEFINE_string(ftuning_blocklist,
               "List of op types that skip kernel tuning pass, e.g., \"Softmax,Add\"");
 DEFINE_string(fantares_perf_file, "./antares_perf.csv", "File to save Antares kernel performance.");
 DEFINE_string(ftuning_platform, "", "Antares platform: e.g., win64, xbox, etc.");
+DEFINE_bool(fantares_cpu_builtin,
+            false,
+            "Lower the Antares IR of ops to C++ loops in nnfusion for the CPU kernels which the "
+            "Antares codegen server or kernel cache has no code for.");
 DECLARE_bool(fantares_mode);
 DECLARE_string(fantares_codegen_server);
 DECLARE_string(fproduct_name);
 DECLARE_string(fdefault_device);
+DECLARE_int32(fthread_num_per_node);
 
 std::string send_tuning_request(std::string& ir, int64_t step)
 {
@@ -170,6 +176,15 @@ std::pair<std::vector<std::shared_ptr<GNode>>, std::vector<std::shared_ptr<Tunin
         {
             std::unordered_map<std::string, std::shared_ptr<TuningStatus>> ir2kernel;
             std::vector<std::shared_ptr<GNode>> non_cached_candidates;
+            std::unordered_map<std::string, std::vector<std::string>> identifiers;
+            for (auto gnode : candidates)
+            {
+                shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+                identifiers[get_device_str((*gnode)["DeviceType"].as<NNFusion_DeviceType>())]
+                    .push_back(ctx->generate_identifier());
+            }
+            for (auto& it : identifiers)
+                cache_manager->prefetch(it.second, it.first);
             for (auto gnode : candidates)
             {
                 auto ir = nnfusion::op::get_translation(gnode);
@@ -406,6 +421,296 @@ void KernelTuning::tuning_kernels_sync(std::vector<std::shared_ptr<GNode>>& node
     }
 }
 
+// CPU model which local tuning results are recorded for, -fproduct_name when given.
+std::string get_cpu_model()
+{
+    if (FLAGS_fproduct_name != "default")
+        return FLAGS_fproduct_name;
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+    {
+        auto colon = line.find(':');
+        if (line.compare(0, 10, "model name") == 0 && colon != std::string::npos)
+        {
+            auto begin = line.find_first_not_of(" \t", colon + 1);
+            if (begin != std::string::npos)
+                return line.substr(begin);
+        }
+    }
+    return "unknown";
+}
+
+// Whether kernel selection falls back to the built-in Antares kernel for the op, i.e. the CPU
+// has no kernel for it but the reference ones.
+bool uses_builtin_cpu_kernel(std::shared_ptr<GNode> gnode)
+{
+    for (auto kernel_reg : KernelRegistry::Global()->FindKernelRegistrations(
+             gnode->get_op_type(), GENERIC_CPU, element::f32))
+    {
+        if (kernel_reg->m_tag != "antares" && kernel_reg->m_priority > 0)
+            return false;
+    }
+    return true;
+}
+
+struct ScheduleKnob
+{
+    std::vector<int64_t> values;
+    std::function<void(cpu::AntaresCpuSchedule&, int64_t)> apply;
+};
+
+// Knobs of the schedule of a built-in kernel, in the order the local tuning walks them.
+std::vector<ScheduleKnob> get_schedule_knobs(const cpu::AntaresLowering& lowering)
+{
+    std::vector<ScheduleKnob> knobs;
+    if (lowering.has_reduction_order())
+    {
+        knobs.push_back({{0, 1}, [](cpu::AntaresCpuSchedule& schedule, int64_t value) {
+                             schedule.reduce_outside = value;
+                         }});
+    }
+    ScheduleKnob tiles{{}, [](cpu::AntaresCpuSchedule& schedule, int64_t value) {
+                           schedule.tile = value;
+                       }};
+    for (int64_t tile : {64, 256, 1024, 4096})
+    {
+        if (tile < lowering.get_max_row_length())
+            tiles.values.push_back(tile);
+    }
+    knobs.push_back(tiles);
+    knobs.push_back({{4, 8, 16}, [](cpu::AntaresCpuSchedule& schedule, int64_t value) {
+                         schedule.vector_width = value;
+                     }});
+    knobs.push_back({{1, 2, 4, 8}, [](cpu::AntaresCpuSchedule& schedule, int64_t value) {
+                         schedule.shards_per_thread = value;
+                     }});
+    return knobs;
+}
+
+// Compile the built-in kernels of gnode for the schedules together, then time them one by one
+// on a thread pool like the one of the generated code. Times are in us, -1 for failures.
+std::vector<double> profile_cpu_schedules(std::shared_ptr<GNode> gnode,
+                                          const std::vector<cpu::AntaresCpuSchedule>& schedules)
+{
+    auto runtime = profiler::CPUDefaultRuntime::Runtime();
+    profiler::CompileScheduler scheduler(runtime);
+    std::vector<profiler::ProfilingContext::Pointer> pctxs;
+    for (auto& schedule : schedules)
+    {
+        shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+        auto kernel = std::make_shared<cpu::AntaresCpuKernelEmitter>(ctx);
+        kernel->m_schedule = schedule;
+        profiler::ProfilingContext::Pointer pctx;
+        if (kernel->get_or_emit_source())
+        {
+            pctx = std::make_shared<profiler::ProfilingContext>(kernel);
+            pctx->num_threads = FLAGS_fthread_num_per_node;
+            scheduler.add(pctx);
+        }
+        pctxs.push_back(pctx);
+    }
+    scheduler.run();
+
+    std::vector<double> times;
+    for (auto& pctx : pctxs)
+    {
+        double time = -1.0;
+        if (pctx != nullptr)
+        {
+            profiler::Profiler prof(runtime, pctx);
+            if (prof.execute())
+                time = pctx->result.get_device_avg();
+        }
+        times.push_back(time);
+    }
+    return times;
+}
+
+cpu::AntaresCpuSchedule tune_cpu_schedule(std::shared_ptr<GNode> gnode,
+                                          const cpu::AntaresLowering& lowering,
+                                          std::shared_ptr<TuningStatus> status,
+                                          int64_t& trials)
+{
+    cpu::AntaresCpuSchedule best;
+    double best_time = profile_cpu_schedules(gnode, {best})[0];
+    trials = 1;
+    status->progress_step = 1;
+
+    // one knob at a time, starting from the best schedule so far
+    for (auto& knob : get_schedule_knobs(lowering))
+    {
+        std::vector<cpu::AntaresCpuSchedule> variants;
+        for (auto value : knob.values)
+        {
+            if (trials + static_cast<int64_t>(variants.size()) >= FLAGS_fkernel_tuning_steps)
+                break;
+            auto schedule = best;
+            knob.apply(schedule, value);
+            if (schedule.to_string() != best.to_string())
+                variants.push_back(schedule);
+        }
+        if (variants.empty())
+            continue;
+
+        auto times = profile_cpu_schedules(gnode, variants);
+        for (size_t i = 0; i < variants.size(); ++i)
+        {
+            ++trials;
+            // a variant has to beat the noise of the measurement to replace the best one
+            if (times[i] > 0 && (best_time <= 0 || times[i] < best_time * 0.98))
+            {
+                best = variants[i];
+                best_time = times[i];
+                status->progress_step = trials;
+            }
+        }
+    }
+
+    status->status = best_time > 0 ? "completed" : "failed";
+    status->best_perf = best_time > 0 ? best_time / 1000.0 : -1.0;
+    return best;
+}
+
+void KernelTuning::tuning_cpu_kernels_local(std::shared_ptr<nnfusion::graph::Graph>& graph)
+{
+    // the CPU ops left to built-in kernels, deduped by their IR
+    std::vector<std::shared_ptr<GNode>> candidates;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<GNode>>> ir2nodes;
+    std::unordered_map<std::string, size_t> ir2cnt;
+    for (auto gnode : graph->get_ordered_ops())
+    {
+        if (!(*gnode)["DeviceType"].is_valid() ||
+            (*gnode)["DeviceType"].as<NNFusion_DeviceType>() != GENERIC_CPU ||
+            BlockList.count(gnode->get_op_type()) || !uses_builtin_cpu_kernel(gnode))
+        {
+            continue;
+        }
+        std::string ir;
+        try
+        {
+            ir = nnfusion::op::get_translation(gnode);
+        }
+        catch (const std::exception&)
+        {
+            continue;
+        }
+        if (ir.empty())
+            continue;
+        if (ir2nodes[ir].empty())
+            candidates.push_back(gnode);
+        ir2nodes[ir].push_back(gnode);
+        ir2cnt[ir] += 1;
+    }
+    if (candidates.empty())
+        return;
+
+    auto cpu_model = get_cpu_model();
+    auto device_type = get_device_str(GENERIC_CPU);
+    // the IR in the entries makes it safe to cache the schedules of ops outside of
+    // SupportOpList
+    std::unordered_set<std::string> op_types;
+    for (auto gnode : candidates)
+        op_types.insert(gnode->get_op_type());
+    auto cache_manager = std::make_shared<cache::KernelCacheManager>(op_types);
+    if (!cache_manager->is_valid())
+    {
+        NNFUSION_LOG(INFO) << "No valid kernel cache, tuned schedules will not be kept";
+    }
+    else
+    {
+        std::vector<std::string> identifiers;
+        for (auto gnode : candidates)
+            identifiers.push_back(KernelContext(gnode).generate_identifier());
+        cache_manager->prefetch(identifiers, device_type);
+    }
+
+    std::vector<std::shared_ptr<TuningStatus>> tuned_kernels;
+    size_t id = 0;
+    for (auto gnode : candidates)
+    {
+        shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+        auto kernel = std::make_shared<cpu::AntaresCpuKernelEmitter>(ctx);
+        auto lowering = kernel->get_builtin_lowering();
+        if (lowering == nullptr)
+            continue;
+
+        auto ir = nnfusion::op::get_translation(gnode);
+        auto identifier = ctx->generate_identifier();
+        auto status = std::make_shared<TuningStatus>(gnode);
+        status->ir = ir;
+
+        // results are keyed by the identifier and CPU model, and the IR since identifiers
+        // leave out some attributes
+        cpu::AntaresCpuSchedule schedule;
+        bool found = false;
+        if (cache_manager->is_valid() && !identifier.empty())
+        {
+            for (auto fetch : cache_manager->fetch_with_source(identifier, device_type, "NNFusion"))
+            {
+                auto& tuning = fetch->miscs["cpu_tuning"];
+                if (fetch->tags.count("AntaresCpuSchedule") == 0 ||
+                    tuning["cpu_model"] != cpu_model || tuning["ir"] != ir ||
+                    tuning["trials"] < FLAGS_fkernel_tuning_steps)
+                {
+                    continue;
+                }
+                schedule = cpu::AntaresCpuSchedule::from_json(tuning["schedule"]);
+                status->status = "completed";
+                status->progress_step = tuning["step_produced"];
+                status->best_perf = double(tuning["time"]) / 1000;
+                found = true;
+                break;
+            }
+        }
+
+        if (!found && FLAGS_fkernel_tuning_steps > 0)
+        {
+            std::cout << "\nTuning [" << id << "/" << candidates.size()
+                      << " ops] locally: op=" << status->op_type << ", name="
+                      << ((status->op_name.size() > 26) ? (status->op_name.substr(0, 24) + "..")
+                                                        : status->op_name)
+                      << std::endl;
+            int64_t trials = 0;
+            schedule = tune_cpu_schedule(gnode, *lowering, status, trials);
+            found = status->best_perf > 0;
+
+            if (found && cache_manager->is_valid() && !identifier.empty())
+            {
+                kernel->m_schedule = schedule;
+                auto entry = std::make_shared<cache::KernelEntry>();
+                entry->key = "AntaresCpuSchedule:" + cpu_model + ":" + ir;
+                entry->identifier = identifier;
+                entry->source = "NNFusion";
+                entry->tags.insert("AntaresCpuSchedule");
+                entry->miscs["cpu_tuning"] = {{"cpu_model", cpu_model},
+                                              {"ir", ir},
+                                              {"schedule", schedule.to_json()},
+                                              {"time", status->best_perf * 1000},
+                                              {"trials", trials},
+                                              {"step_produced", status->progress_step}};
+                entry = kernel->get_kernel_cache_entry(entry);
+                cache_manager->insert_kernel_entry(entry, true);
+            }
+        }
+        ++id;
+
+        if (found)
+        {
+            for (auto node : ir2nodes[ir])
+                (*node)["AntaresCpuSchedule"] = schedule;
+        }
+        if (!status->status.empty())
+            tuned_kernels.push_back(status);
+    }
+
+    if (!tuned_kernels.empty())
+    {
+        print_tuning_results(tuned_kernels, {});
+        dump_perf(FLAGS_fantares_perf_file, tuned_kernels, ir2cnt);
+    }
+}
+
 bool KernelTuning::run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& graph)
 {
     if (FLAGS_fantares_mode)
@@ -414,6 +719,18 @@ bool KernelTuning::run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& graph)
         // register antares kernels anyway here in case kernel selection pass will use them
         register_antares_kernel();
     }
+    else if (FLAGS_fantares_cpu_builtin)
+    {
+        parse_block_list();
+        // untuned antares kernels only rank above the reference kernels, see
+        // DefaultKernelSelector::pick_first
+        register_builtin_cpu_kernel();
+        if (FLAGS_fdefault_device == "CPU")
+        {
+            // schedules of the built-in kernels, tuned on this machine without the server
+            tuning_cpu_kernels_local(graph);
+        }
+    }
 
     if (FLAGS_fkernel_tuning_steps <= 0 || !FLAGS_fantares_mode)
     {
@@ -456,32 +773,48 @@ void KernelTuning::register_single_kernel(const std::string& op_name)
                 return make_shared<kernels::cuda::AntaresCudaKernelEmitter>(context);
             })
             .Build());
-    kernels::KernelRegistrar kernel_registrar_cpu(
+    register_cpu_kernel(op_name);
+    kernels::KernelRegistrar kernel_registrar_hlsl(
         op_name,
         kernels::Name(op_name)
-            .Device(GENERIC_CPU)
+            .Device(HLSL)
             .TypeConstraint(element::f32)
             .Tag("antares")
             .Priority(9)
             .KernelFactory([](shared_ptr<kernels::KernelContext> context)
                                -> shared_ptr<kernels::KernelEmitter> {
-                return make_shared<kernels::cpu::AntaresCpuKernelEmitter>(context);
+                return make_shared<kernels::hlsl::AntaresHLSLKernelEmitter>(context);
             })
             .Build());
-    kernels::KernelRegistrar kernel_registrar_hlsl(
+}
+
+void KernelTuning::register_cpu_kernel(const std::string& op_name)
+{
+    kernels::KernelRegistrar kernel_registrar_cpu(
         op_name,
         kernels::Name(op_name)
-            .Device(HLSL)
+            .Device(GENERIC_CPU)
             .TypeConstraint(element::f32)
             .Tag("antares")
             .Priority(9)
             .KernelFactory([](shared_ptr<kernels::KernelContext> context)
                                -> shared_ptr<kernels::KernelEmitter> {
-                return make_shared<kernels::hlsl::AntaresHLSLKernelEmitter>(context);
+                return make_shared<kernels::cpu::AntaresCpuKernelEmitter>(context);
             })
             .Build());
 }
 
+bool KernelTuning::register_builtin_cpu_kernel()
+{
+    for (auto& pair : nnfusion::op::get_op_configs())
+    {
+        if (pair.second.f_translate_v2 == nullptr || BlockList.count(pair.first))
+            continue;
+        register_cpu_kernel(pair.first);
+    }
+    return true;
+}
+
 bool KernelTuning::register_antares_kernel()
 {
     for (auto pair : nnfusion::op::get_op_configs())
@@ -36,8 +36,12 @@ namespace nnfusion
                 bool run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& graph) override;
                 static void register_single_kernel(const std::string& op_name);
                 bool register_antares_kernel();
+                // Register the CPU antares kernels alone, for the built-in lowering of
+                // -fantares_cpu_builtin without the antares mode.
+                bool register_builtin_cpu_kernel();
 
             private:
+                static void register_cpu_kernel(const std::string& op_name);
                 bool parse_block_list();
                 void submit_tuning_batch_asyc(
                     std::vector<std::shared_ptr<nnfusion::graph::GNode>>& nodes,
@@ -48,6 +52,10 @@ namespace nnfusion
                                         std::vector<std::shared_ptr<TuningStatus>>& tuned_kernels);
                 bool insert_to_kernel_cache(
                     const std::vector<std::shared_ptr<nnfusion::graph::GNode>>& nodes);
+                // Set the schedules of the built-in CPU kernels, fetched from the kernel cache for
+                // this CPU model or, with -fkernel_tuning_steps, searched by profiling candidates
+                // with the CPU profiling runtime and saved to the kernel cache.
+                void tuning_cpu_kernels_local(std::shared_ptr<nnfusion::graph::Graph>& graph);
 
             private:
                 std::unordered_set<std::string> BlockList;
@@ -0,0 +1,258 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "loop_fusion_pass.hpp"
+#include "gflags/gflags.h"
+#include "nnfusion/core/operators/op_define/broadcast.hpp"
+#include "nnfusion/core/operators/op_define/fused.hpp"
+#include "nnfusion/core/operators/op_define/reshape.hpp"
+#include "nnfusion/core/operators/util/arithmetic_reduction.hpp"
+
+DEFINE_bool(fcpu_loop_fusion,
+            false,
+            "Fuse CPU reductions over the last axes with the elementwise ops of the same rows.");
+
+using namespace nnfusion;
+using namespace nnfusion::graph;
+using namespace nnfusion::pass::graph;
+
+namespace
+{
+    // Elementwise ops which cpu::LoopFused has a vector instruction for.
+    const std::unordered_set<std::string> kLoopOps = {"Abs",
+                                                       "Add",
+                                                       "Divide",
+                                                       "Exp",
+                                                       "Maximum",
+                                                       "Minimum",
+                                                       "Multiply",
+                                                       "Negative",
+                                                       "Relu",
+                                                       "Rsqrt",
+                                                       "Sqrt",
+                                                       "Square",
+                                                       "Subtract"};
+
+    const std::unordered_set<std::string> kReductionOps = {"Sum", "Max", "Min"};
+
+    // A group works on a tensor of rows x cols elements, its values are either full tensors or
+    // hold one value per row.
+    struct Domain
+    {
+        size_t rows = 0;
+        size_t cols = 0;
+
+        bool is_full(const Shape& shape) const { return shape_size(shape) == rows * cols; }
+        bool is_row(const Shape& shape) const { return shape_size(shape) == rows; }
+    };
+
+    bool is_float(const std::shared_ptr<GNode>& node)
+    {
+        for (size_t i = 0; i < node->get_input_size(); ++i)
+        {
+            if (node->get_input_element_type(i) != element::f32)
+                return false;
+        }
+        return node->get_output_size() == 1 && node->get_output_element_type(0) == element::f32;
+    }
+
+    // The domain of a reduction over the trailing axes of its input, with more than one column.
+    bool trailing_reduction(const std::shared_ptr<GNode>& node, Domain& domain)
+    {
+        if (kReductionOps.count(node->get_op_type()) == 0 || !is_float(node))
+            return false;
+        auto reduce = std::dynamic_pointer_cast<op::ArithmeticReduction>(node->get_op_ptr());
+        auto& shape = node->get_input_shape(0);
+        auto& axes = reduce->get_reduction_axes();
+        if (axes.empty())
+            return false;
+        size_t cols = 1;
+        for (size_t axis = shape.size() - axes.size(); axis < shape.size(); ++axis)
+        {
+            if (axes.count(axis) == 0)
+                return false;
+            cols *= shape[axis];
+        }
+        if (cols < 2)
+            return false;
+        domain.rows = shape_size(shape) / cols;
+        domain.cols = cols;
+        return true;
+    }
+
+    // Whether cpu::LoopFused can read the broadcast of an input to a full tensor of domain, see
+    // LoopFused::broadcast_value: a value per row, a tensor repeated over the leading axes or a
+    // scalar.
+    bool loopable_broadcast(const std::shared_ptr<GNode>& node, const Domain& domain, bool internal)
+    {
+        auto broadcast = std::static_pointer_cast<op::Broadcast>(node->get_op_ptr());
+        auto& axes = broadcast->get_broadcast_axes();
+        auto& shape = node->get_output_shape(0);
+        size_t in_size = shape_size(node->get_input_shape(0));
+        if (in_size == 1 && !internal)
+            return domain.is_full(shape) || domain.is_row(shape);
+        if (!domain.is_full(shape) || axes.empty())
+            return false;
+
+        size_t first = *axes.begin(), last = *axes.rbegin();
+        if (last - first + 1 != axes.size())
+            return false;
+        if (last + 1 == shape.size())
+        {
+            size_t cols = 1;
+            for (auto axis : axes)
+                cols *= shape[axis];
+            return cols == domain.cols && in_size == domain.rows;
+        }
+        return first == 0 && !internal && in_size % domain.cols == 0;
+    }
+
+    class LoopGroup
+    {
+    public:
+        LoopGroup(const std::shared_ptr<GNode>& seed, const Domain& domain)
+            : m_domain(domain)
+        {
+            m_nodes.insert(seed);
+        }
+
+        bool contains(const std::shared_ptr<GNode>& node) const { return m_nodes.count(node) > 0; }
+        const std::unordered_set<std::shared_ptr<GNode>>& nodes() const { return m_nodes; }
+        void add(const std::shared_ptr<GNode>& node) { m_nodes.insert(node); }
+        // Whether node reads or writes data of the group as a member.
+        bool accepts(const std::shared_ptr<GNode>& node) const
+        {
+            if (!is_float(node))
+                return false;
+            auto& out_shape = node->get_output_shape(0);
+            auto op_type = node->get_op_type();
+            if (kLoopOps.count(op_type))
+            {
+                return m_domain.is_full(out_shape) || m_domain.is_row(out_shape);
+            }
+            if (op_type == "Reshape")
+            {
+                auto reshape = std::static_pointer_cast<op::Reshape>(node->get_op_ptr());
+                return !reshape->get_is_transpose() &&
+                       (m_domain.is_full(out_shape) || m_domain.is_row(out_shape));
+            }
+            if (op_type == "Broadcast")
+            {
+                auto src = node->get_in_edge(0)->get_src();
+                return loopable_broadcast(node, m_domain, contains(src));
+            }
+            Domain domain;
+            return trailing_reduction(node, domain) && domain.rows == m_domain.rows &&
+                   domain.cols == m_domain.cols;
+        }
+
+    private:
+        Domain m_domain;
+        std::unordered_set<std::shared_ptr<GNode>> m_nodes;
+    };
+
+    class LoopFusionOptimizer
+    {
+    public:
+        LoopFusionOptimizer(std::shared_ptr<Graph>& graph)
+            : m_graph(graph)
+        {
+            auto outputs = graph->get_outputs();
+            m_outputs.insert(outputs.begin(), outputs.end());
+        }
+
+        void run()
+        {
+            auto ordered_ops = m_graph->get_ordered_ops();
+            std::vector<LoopGroup> groups;
+            for (size_t i = 0; i < ordered_ops.size(); ++i)
+            {
+                Domain domain;
+                if (m_grouped.count(ordered_ops[i]) || m_outputs.count(ordered_ops[i]) ||
+                    !trailing_reduction(ordered_ops[i], domain))
+                    continue;
+                auto group = grow(ordered_ops, i, domain);
+                if (group.nodes().size() > 1)
+                {
+                    m_grouped.insert(group.nodes().begin(), group.nodes().end());
+                    groups.push_back(group);
+                }
+            }
+
+            for (auto& group : groups)
+                fuse(group);
+            if (!groups.empty())
+                NNFUSION_LOG(INFO) << "Loop fusion: " << groups.size() << " fused CPU loops.";
+        }
+
+    private:
+        // Add the nodes after a reduction that work on its rows. A node which depends on the
+        // group through a node outside of it cannot join, as the fused node would be a cycle.
+        LoopGroup grow(const std::vector<std::shared_ptr<GNode>>& ordered_ops,
+                       size_t seed,
+                       const Domain& domain)
+        {
+            LoopGroup group(ordered_ops[seed], domain);
+            std::unordered_set<std::shared_ptr<GNode>> tainted;
+            for (size_t i = seed + 1; i < ordered_ops.size(); ++i)
+            {
+                auto& node = ordered_ops[i];
+                bool from_group = false, from_tainted = false;
+                for (auto& edge : node->get_in_edges())
+                {
+                    from_group |= group.contains(edge->get_src());
+                    from_tainted |= tainted.count(edge->get_src()) > 0;
+                }
+                if (!from_group && !from_tainted)
+                    continue;
+                if (from_tainted || m_grouped.count(node) || m_outputs.count(node) ||
+                    !group.accepts(node))
+                {
+                    tainted.insert(node);
+                    continue;
+                }
+                add_leaves(group, node, tainted);
+                group.add(node);
+            }
+            return group;
+        }
+
+        // Take the broadcasts of outside tensors which only node reads, e.g. the scale of a
+        // layer norm, into the group.
+        void add_leaves(LoopGroup& group,
+                        const std::shared_ptr<GNode>& node,
+                        const std::unordered_set<std::shared_ptr<GNode>>& tainted)
+        {
+            for (size_t i = 0; i < node->get_input_size(); ++i)
+            {
+                auto src = node->get_in_edge(i)->get_src();
+                if (group.contains(src) || src->get_op_type() != "Broadcast" ||
+                    src->get_out_edges().size() != 1 || m_grouped.count(src) ||
+                    m_outputs.count(src) || tainted.count(src->get_in_edge(0)->get_src()))
+                    continue;
+                if (group.accepts(src))
+                    group.add(src);
+            }
+        }
+
+        void fuse(const LoopGroup& group)
+        {
+            auto fused_op = std::make_shared<op::Fused>("fused_kernel", "LoopFused");
+            auto fused_node = std::make_shared<FusedGNode>(fused_op);
+            fused_node->build_fused_node(group.nodes(), m_graph, true);
+            m_graph->add_node(fused_node);
+        }
+
+        std::shared_ptr<Graph>& m_graph;
+        std::unordered_set<std::shared_ptr<GNode>> m_outputs;
+        std::unordered_set<std::shared_ptr<GNode>> m_grouped;
+    };
+} // namespace
+
+bool LoopFusionPass::run_on_graph(std::shared_ptr<Graph>& graph)
+{
+    if (!FLAGS_fcpu_loop_fusion)
+        return true;
+    LoopFusionOptimizer(graph).run();
+    return true;
+}
@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "graph_pass_base.hpp"
+
+namespace nnfusion
+{
+    namespace pass
+    {
+        namespace graph
+        {
+            // Fuse a Sum, Max or Min over the trailing axes of a CPU tensor with the elementwise
+            // ops, broadcasts, reshapes and further reductions of the same rows that follow it,
+            // like the ones of a softmax or a layer norm. Each group becomes a LoopFused node
+            // which the CPU backend generates as one row-parallel loop nest, with a pass over
+            // the columns of a row for every reduction.
+            class LoopFusionPass : public GraphPassBase
+            {
+            public:
+                bool run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& graph) override;
+            };
+        } // namespace graph
+    }     // namespace pass
+} // namespace nnfusion
@@ -0,0 +1,340 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "nchwc_layout_pass.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+#include "nnfusion/core/operators/op_define/avg_pool.hpp"
+#include "nnfusion/core/operators/op_define/broadcast.hpp"
+#include "nnfusion/core/operators/op_define/convolution.hpp"
+#include "nnfusion/core/operators/op_define/max_pool.hpp"
+
+DEFINE_bool(fnchwc_layout,
+            false,
+            "Run the convolutions and poolings of the CPU backend on the NCHWc layout of MLAS.");
+
+using namespace nnfusion;
+using namespace nnfusion::graph;
+using namespace nnfusion::pass::graph;
+
+namespace
+{
+    // MLAS picks a NCHWc block of 8 or 16 channels at run time, blocked tensors have a multiple
+    // of both so that no channel padding is needed.
+    const size_t kChannelAlign = 16;
+
+    // Ops which compute every element from the elements at the same offset of their inputs,
+    // and thus give the same result on any layout of inputs of the same shape.
+    const std::unordered_set<std::string> kLayoutAgnosticOps = {
+        "Abs",      "Add",     "Divide",  "Exp",     "Maximum", "Minimum", "Multiply",
+        "Negative", "Relu",    "Relu6",   "Sigmoid", "Sqrt",    "Subtract", "Tanh"};
+
+    bool is_blockable(const Shape& shape)
+    {
+        return shape.size() == 4 && shape[1] % kChannelAlign == 0;
+    }
+
+    std::vector<int64_t> to_int64(const std::vector<size_t>& values)
+    {
+        return std::vector<int64_t>(values.begin(), values.end());
+    }
+
+    template <typename Below, typename Above>
+    std::vector<int64_t> to_pads(const Below& below, const Above& above)
+    {
+        return {int64_t(below[0]), int64_t(below[1]), int64_t(above[0]), int64_t(above[1])};
+    }
+
+    class NchwcRewriter
+    {
+    public:
+        NchwcRewriter(std::shared_ptr<Graph>& graph)
+            : m_graph(graph)
+            , m_outputs(graph->get_outputs())
+        {
+        }
+
+        void run()
+        {
+            for (auto& node : m_graph->get_ordered_ops())
+            {
+                if (m_removed.count(node) || node->get_output_size() != 1 ||
+                    node->get_output_element_type(0) != element::f32)
+                    continue;
+                auto type = node->get_op_type();
+                if (type == "Convolution")
+                    rewrite_convolution(node);
+                else if (type == "MaxPool" || type == "AvgPool")
+                    rewrite_pool(node);
+                else if (kLayoutAgnosticOps.count(type))
+                    rewrite_elementwise(node);
+            }
+
+            // Reorders to NCHW which are only read by blocked ops are dead now.
+            for (auto& reorder : m_reorder_outputs)
+            {
+                if (reorder->get_out_edges().empty() &&
+                    std::find(m_outputs.begin(), m_outputs.end(), reorder) == m_outputs.end())
+                    m_graph->remove_node(reorder);
+                else
+                    m_boundaries++;
+            }
+            m_graph->set_outputs(m_outputs);
+
+            if (m_converted > 0)
+                NNFUSION_LOG(INFO) << "NCHWc layout: " << m_converted
+                                   << " convolutions and poolings blocked, " << m_fused
+                                   << " ops fused, " << m_reorder_inputs.size() + m_boundaries
+                                   << " reorders at layout boundaries.";
+        }
+
+    private:
+        GNodeIndex input_of(const std::shared_ptr<GNode>& node, size_t i)
+        {
+            auto edge = node->get_in_edge(i);
+            NNFUSION_CHECK_NOT_NULLPTR(edge);
+            return GNodeIndex(edge->get_src(), edge->get_src_output());
+        }
+
+        // The only consumer of node if it has one and is not a graph output.
+        std::shared_ptr<GNode> single_consumer(const std::shared_ptr<GNode>& node)
+        {
+            if (node->get_out_edges().size() != 1 ||
+                std::find(m_outputs.begin(), m_outputs.end(), node) != m_outputs.end())
+                return nullptr;
+            auto edge = *node->get_out_edges().begin();
+            return edge->is_control_edge() ? nullptr : edge->get_dst();
+        }
+
+        // The blocked version of a plain tensor; the tensor reordered to NCHW by a previous
+        // rewrite is used as it is.
+        GNodeIndex blocked(const GNodeIndex& tensor)
+        {
+            if (tensor.gnode->get_op_type() == "NchwcReorderOutput")
+                return input_of(tensor.gnode, 0);
+            auto key = std::make_pair(tensor.gnode, tensor.index);
+            auto it = m_reorder_inputs.find(key);
+            if (it == m_reorder_inputs.end())
+            {
+                auto reorder_op = std::make_shared<op::GenericOp>(
+                    tensor.gnode->get_name() + "_" + std::to_string(tensor.index) + "_nchwc",
+                    "NchwcReorderInput",
+                    op::OpConfig::any());
+                auto reorder = m_graph->add_node_and_edge(reorder_op, GNodeIndexVector({tensor}));
+                it = m_reorder_inputs.emplace(key, reorder).first;
+            }
+            return GNodeIndex(it->second, 0);
+        }
+
+        // Add a reorder of the blocked output of node to NCHW.
+        std::shared_ptr<GNode> reorder_output(const std::shared_ptr<GNode>& node)
+        {
+            auto reorder_op = std::make_shared<op::GenericOp>(
+                node->get_name() + "_nchw", "NchwcReorderOutput", op::OpConfig::any());
+            auto reorder = m_graph->add_node_and_edge(reorder_op, GNodeVector({node}));
+            m_reorder_outputs.push_back(reorder);
+            return reorder;
+        }
+
+        // Replace last by the blocked node, read through a reorder to NCHW, and remove the
+        // nodes fused into it.
+        void replace(const std::shared_ptr<GNode>& last,
+                     const std::shared_ptr<GNode>& node,
+                     const GNodeVector& fused)
+        {
+            auto reorder = reorder_output(node);
+            std::replace(m_outputs.begin(), m_outputs.end(), last, reorder);
+            m_graph->replace_node(last, reorder, false);
+            m_removed.insert(last);
+            for (auto it = fused.rbegin(); it != fused.rend(); ++it)
+            {
+                if (*it != last && (*it)->get_out_edges().empty())
+                {
+                    m_graph->remove_node(*it);
+                    m_removed.insert(*it);
+                }
+            }
+            m_converted++;
+            m_fused += fused.size() - 1;
+        }
+
+        // The bias [O] of an Add with a Broadcast of a Constant over the N, H and W axes.
+        std::shared_ptr<GNode> find_bias(const std::shared_ptr<GNode>& add,
+                                         const std::shared_ptr<GNode>& conv,
+                                         std::shared_ptr<GNode>& broadcast)
+        {
+            if (add->get_op_type() != "Add" || add->get_in_edges().size() != 2)
+                return nullptr;
+            auto other = input_of(add, 0).gnode == conv ? input_of(add, 1) : input_of(add, 0);
+            auto broadcast_op = std::dynamic_pointer_cast<op::Broadcast>(other.gnode->get_op_ptr());
+            if (!broadcast_op || other.gnode == conv ||
+                broadcast_op->get_broadcast_axes() != AxisSet({0, 2, 3}))
+                return nullptr;
+            auto bias = input_of(other.gnode, 0);
+            if (!bias.gnode->is_constant() ||
+                bias.gnode->get_output_shape(0) != Shape({conv->get_output_shape(0)[1]}))
+                return nullptr;
+            broadcast = other.gnode;
+            return bias.gnode;
+        }
+
+        void rewrite_convolution(const std::shared_ptr<GNode>& node)
+        {
+            auto conv = std::dynamic_pointer_cast<op::Convolution>(node->get_op_ptr());
+            auto filter = input_of(node, 1);
+            const Shape& filter_shape = node->get_input_shape(1);
+            if (conv->get_data_format() != "NCHW" || filter_shape.size() != 4 ||
+                !filter.gnode->is_constant() || filter_shape[0] % kChannelAlign != 0)
+                return;
+            for (auto stride : conv->get_data_dilation_strides())
+                if (stride != 1)
+                    return;
+            for (auto pad : conv->get_padding_below())
+                if (pad < 0)
+                    return;
+            for (auto pad : conv->get_padding_above())
+                if (pad < 0)
+                    return;
+            // Fewer input channels than any NCHWc block run on the NCHW input.
+            bool nchw_input = filter_shape[1] < 8;
+            if (!nchw_input && filter_shape[1] % kChannelAlign != 0)
+                return;
+
+            GNodeVector fused({node});
+            std::shared_ptr<GNode> bias, broadcast;
+            auto consumer = single_consumer(node);
+            if (consumer && (bias = find_bias(consumer, node, broadcast)))
+            {
+                fused.push_back(consumer);
+                consumer = single_consumer(consumer);
+            }
+            std::string activation;
+            if (consumer && consumer->get_op_type() == "Relu")
+            {
+                activation = "relu";
+                fused.push_back(consumer);
+            }
+
+            op::OpConfig::any config;
+            config["strides"] = to_int64(conv->get_window_movement_strides());
+            config["dilations"] = to_int64(conv->get_window_dilation_strides());
+            config["pads"] = to_pads(conv->get_padding_below(), conv->get_padding_above());
+            config["activation"] = activation;
+            config["nchw_input"] = nchw_input;
+            auto input = input_of(node, 0);
+            GNodeIndexVector inputs({nchw_input ? input : blocked(input), filter});
+            if (bias)
+                inputs.push_back(GNodeIndex(bias, 0));
+            auto nchwc_op =
+                std::make_shared<op::GenericOp>(node->get_name() + "_nchwc", "NchwcConv", config);
+            auto nchwc = m_graph->add_node_and_edge(nchwc_op, inputs);
+            NNFUSION_CHECK(nchwc->get_output_shape(0) == fused.back()->get_output_shape(0));
+
+            replace(fused.back(), nchwc, fused);
+            if (broadcast && broadcast->get_out_edges().empty())
+            {
+                m_graph->remove_node(broadcast);
+                m_removed.insert(broadcast);
+            }
+        }
+
+        void rewrite_pool(const std::shared_ptr<GNode>& node)
+        {
+            auto input = input_of(node, 0);
+            // Pooling alone does not pay for the reorders, it is blocked after a blocked op.
+            if (!is_blockable(node->get_input_shape(0)) ||
+                input.gnode->get_op_type() != "NchwcReorderOutput")
+                return;
+
+            op::OpConfig::any config;
+            if (auto max_pool = std::dynamic_pointer_cast<op::MaxPool>(node->get_op_ptr()))
+            {
+                if (max_pool->get_data_format() != "NCHW" ||
+                    max_pool->get_window_shape().size() != 2)
+                    return;
+                config["kind"] = "max";
+                config["window"] = to_int64(max_pool->get_window_shape());
+                config["strides"] = to_int64(max_pool->get_window_movement_strides());
+                config["pads"] =
+                    to_pads(max_pool->get_padding_below(), max_pool->get_padding_above());
+            }
+            else
+            {
+                auto avg_pool = std::dynamic_pointer_cast<op::AvgPool>(node->get_op_ptr());
+                if (!avg_pool || avg_pool->get_data_format() != "NCHW" ||
+                    avg_pool->get_window_shape().size() != 2)
+                    return;
+                config["kind"] = avg_pool->get_include_padding_in_avg_computation()
+                                     ? "avg_include_pad"
+                                     : "avg_exclude_pad";
+                config["window"] = to_int64(avg_pool->get_window_shape());
+                config["strides"] = to_int64(avg_pool->get_window_movement_strides());
+                config["pads"] =
+                    to_pads(avg_pool->get_padding_below(), avg_pool->get_padding_above());
+            }
+
+            auto nchwc_op =
+                std::make_shared<op::GenericOp>(node->get_name() + "_nchwc", "NchwcPool", config);
+            auto nchwc = m_graph->add_node_and_edge(nchwc_op, GNodeIndexVector({blocked(input)}));
+            NNFUSION_CHECK(nchwc->get_output_shape(0) == node->get_output_shape(0));
+            replace(node, nchwc, GNodeVector({node}));
+        }
+
+        // Rewire an elementwise op with a blocked input to read all its inputs blocked.
+        void rewrite_elementwise(const std::shared_ptr<GNode>& node)
+        {
+            const Shape& shape = node->get_output_shape(0);
+            if (!is_blockable(shape))
+                return;
+            bool has_blocked_input = false;
+            for (size_t i = 0; i < node->get_input_size(); i++)
+            {
+                auto input = input_of(node, i);
+                if (node->get_input_shape(i) != shape ||
+                    node->get_input_element_type(i) != element::f32)
+                    return;
+                has_blocked_input |= input.gnode->get_op_type() == "NchwcReorderOutput";
+            }
+            if (!has_blocked_input)
+                return;
+
+            for (size_t i = 0; i < node->get_input_size(); i++)
+            {
+                auto edge = node->get_in_edge(i);
+                auto input = blocked(GNodeIndex(edge->get_src(), edge->get_src_output()));
+                m_graph->remove_edge(edge);
+                m_graph->add_edge(input.gnode, input.index, node, i);
+            }
+
+            std::vector<std::shared_ptr<Edge>> out_edges;
+            for (auto& edge : node->get_out_edges())
+                if (!edge->is_control_edge())
+                    out_edges.push_back(edge);
+            auto reorder = reorder_output(node);
+            for (auto& edge : out_edges)
+            {
+                auto dst = edge->get_dst();
+                int dst_input = edge->get_dst_input();
+                m_graph->remove_edge(edge);
+                m_graph->add_edge(reorder, 0, dst, dst_input);
+            }
+            std::replace(m_outputs.begin(), m_outputs.end(), node, reorder);
+        }
+
+        std::shared_ptr<Graph>& m_graph;
+        GNodeVector m_outputs;
+        std::unordered_set<std::shared_ptr<GNode>> m_removed;
+        std::map<std::pair<std::shared_ptr<GNode>, int>, std::shared_ptr<GNode>> m_reorder_inputs;
+        GNodeVector m_reorder_outputs;
+        size_t m_converted = 0;
+        size_t m_fused = 0;
+        size_t m_boundaries = 0;
+    };
+} // namespace
+
+bool NchwcLayoutPass::run_on_graph(std::shared_ptr<Graph>& graph)
+{
+    if (!FLAGS_fnchwc_layout)
+        return true;
+    NchwcRewriter(graph).run();
+    return true;
+}
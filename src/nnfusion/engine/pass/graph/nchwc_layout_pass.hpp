@@ -0,0 +1,27 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "graph_pass_base.hpp"
+
+namespace nnfusion
+{
+    namespace pass
+    {
+        namespace graph
+        {
+            // Run the 2D convolutions and poolings of the CPU backend on the NCHWc blocked
+            // layout of MLAS. Each of them becomes a NchwcConv or NchwcPool, with its bias and
+            // Relu fused, between a NchwcReorderInput and a NchwcReorderOutput. Elementwise ops
+            // on blocked tensors work on the blocked layout as well, and every reorder of a
+            // reordered tensor is dropped, so that reorders are only left where a plain tensor
+            // meets a blocked one.
+            class NchwcLayoutPass : public GraphPassBase
+            {
+            public:
+                bool run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& graph) override;
+            };
+        } // namespace graph
+    }     // namespace pass
+} // namespace nnfusion
@@ -0,0 +1,337 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "quantization_pass.hpp"
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+#include "nnfusion/core/operators/op_define/constant.hpp"
+#include "nnfusion/core/operators/op_define/dot.hpp"
+#include "nnfusion/engine/profiler/profiler.hpp"
+
+DEFINE_string(fquantize_calibration,
+              "",
+              "Quantize Dot and BatchMatMul to INT8 on CPU, calibrated with the raw input "
+              "samples of this file. Disable when not set.");
+
+using namespace nnfusion;
+using namespace nnfusion::graph;
+using namespace nnfusion::pass::graph;
+
+namespace
+{
+    // Symmetric int8 weights are limited to 7 bits so that the pairwise uint8 x int8 products
+    // of the AVX2 kernels of MLAS can not saturate their int16 sums.
+    const int kWeightMax = 63;
+
+    struct QuantParams
+    {
+        float scale;
+        int zero_point;
+    };
+
+    // A MatMul to quantize, as A[..., M, K] x B[..., K, N]; B is a constant whenever b_const
+    // is set, stored as [..., N, K] if trans_b.
+    struct Candidate
+    {
+        std::shared_ptr<GNode> node;
+        GNodeIndex a;
+        GNodeIndex b;
+        bool b_const;
+        bool trans_b;
+    };
+
+    struct Range
+    {
+        float min = std::numeric_limits<float>::max();
+        float max = std::numeric_limits<float>::lowest();
+    };
+
+    using TensorKey = std::pair<std::shared_ptr<GNode>, int>;
+
+    TensorKey key_of(const GNodeIndex& tensor)
+    {
+        return std::make_pair(tensor.gnode, tensor.index);
+    }
+
+    GNodeIndex input_of(const std::shared_ptr<GNode>& node, size_t i)
+    {
+        auto edge = node->get_in_edge(i);
+        NNFUSION_CHECK_NOT_NULLPTR(edge);
+        return GNodeIndex(edge->get_src(), edge->get_src_output());
+    }
+
+    bool is_float_tensor(const GNodeIndex& tensor)
+    {
+        return tensor.gnode->get_output_element_type(tensor.index) == element::f32;
+    }
+
+    bool find_candidate(const std::shared_ptr<GNode>& node, Candidate& candidate)
+    {
+        if (node->get_input_size() != 2 || node->get_output_size() != 1)
+            return false;
+        candidate.node = node;
+        candidate.a = input_of(node, 0);
+        candidate.b = input_of(node, 1);
+        candidate.b_const = candidate.b.gnode->is_constant();
+        if (!is_float_tensor(candidate.a) || !is_float_tensor(candidate.b) ||
+            candidate.a.gnode->is_constant())
+            return false;
+
+        const Shape& a_shape = node->get_input_shape(0);
+        const Shape& b_shape = node->get_input_shape(1);
+        if (node->get_op_type() == "Dot")
+        {
+            auto dot = std::dynamic_pointer_cast<op::Dot>(node->get_op_ptr());
+            if (dot->get_reduction_axes_count() != 1 || dot->get_transpose_A() ||
+                a_shape.size() < 2 || b_shape.size() != 2 || !candidate.b_const)
+                return false;
+            candidate.trans_b = dot->get_transpose_B();
+            return true;
+        }
+        if (node->get_op_type() == "BatchMatMul")
+        {
+            auto generic_op = std::dynamic_pointer_cast<op::GenericOp>(node->get_op_ptr());
+            bool adj_x = generic_op->localOpConfig.getRoot()["adj_x"]["b"];
+            bool adj_y = generic_op->localOpConfig.getRoot()["adj_y"]["b"];
+            // A dynamic B is quantized as uint8, which has no transposed MlasGemm.
+            if (adj_x || (adj_y && !candidate.b_const) || a_shape.size() < 2 ||
+                a_shape.size() != b_shape.size())
+                return false;
+            candidate.trans_b = adj_y;
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<std::vector<std::vector<char>>> load_calibration(std::shared_ptr<Graph>& graph,
+                                                                 const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        NNFUSION_CHECK(file.good()) << "Cannot open the calibration file " << path;
+        std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+
+        std::vector<size_t> input_bytes;
+        size_t sample_bytes = 0;
+        for (auto& param : graph->get_parameters())
+        {
+            input_bytes.push_back(shape_size(param->get_output_shape(0)) *
+                                  param->get_output_element_type(0).size());
+            sample_bytes += input_bytes.back();
+        }
+        NNFUSION_CHECK(sample_bytes > 0 && !data.empty() && data.size() % sample_bytes == 0)
+            << "The calibration file holds " << data.size()
+            << " bytes, which is not a multiple of the " << sample_bytes
+            << " bytes of all the graph inputs.";
+
+        std::vector<std::vector<std::vector<char>>> samples;
+        for (size_t offset = 0; offset < data.size();)
+        {
+            std::vector<std::vector<char>> sample;
+            for (size_t bytes : input_bytes)
+            {
+                sample.emplace_back(data.begin() + offset, data.begin() + offset + bytes);
+                offset += bytes;
+            }
+            samples.push_back(std::move(sample));
+        }
+        return samples;
+    }
+
+    // Evaluate the graph on every sample with the tensors as its outputs and keep their range.
+    bool calibrate(std::shared_ptr<Graph>& graph,
+                   const std::vector<std::vector<std::vector<char>>>& samples,
+                   std::map<TensorKey, Range>& ranges)
+    {
+        GNodeVector producers;
+        for (auto& it : ranges)
+        {
+            if (std::find(producers.begin(), producers.end(), it.first.first) == producers.end())
+                producers.push_back(it.first.first);
+        }
+
+        auto outputs = graph->get_outputs();
+        graph->set_outputs(producers);
+        for (auto& sample : samples)
+        {
+            nnfusion::profiler::GraphEvaluate eval(graph, GENERIC_CPU);
+            auto result = eval.mixed_type_eval(sample);
+            for (auto& it : ranges)
+            {
+                auto found = result.find(it.first.first->get_unique_name());
+                if (found == result.end() ||
+                    found->second.size() <= static_cast<size_t>(it.first.second))
+                {
+                    graph->set_outputs(outputs);
+                    return false;
+                }
+                const auto& raw = found->second[it.first.second];
+                const float* values = reinterpret_cast<const float*>(raw.data());
+                for (size_t i = 0; i < raw.size() / sizeof(float); i++)
+                {
+                    it.second.min = std::min(it.second.min, values[i]);
+                    it.second.max = std::max(it.second.max, values[i]);
+                }
+            }
+        }
+        graph->set_outputs(outputs);
+        return true;
+    }
+
+    // Asymmetric uint8 over a range extended to hold 0, so that zero padding stays exact.
+    QuantParams activation_params(const Range& range)
+    {
+        float min = std::min(range.min, 0.0f);
+        float max = std::max(range.max, 0.0f);
+        QuantParams params;
+        params.scale = max > min ? (max - min) / 255.0f : 1.0f;
+        params.zero_point =
+            std::min(std::max(static_cast<int>(std::nearbyint(-min / params.scale)), 0), 255);
+        return params;
+    }
+
+    // Quantize the constant B to a symmetric int8 [..., K, N] matrix, returns its scale.
+    float quantize_weight(const Candidate& candidate,
+                          std::shared_ptr<Graph>& graph,
+                          std::shared_ptr<GNode>& quantized)
+    {
+        auto weight = std::dynamic_pointer_cast<op::Constant>(candidate.b.gnode->get_op_ptr());
+        std::vector<float> values = weight->get_vector<float>();
+        Shape shape = candidate.b.gnode->get_output_shape(0);
+        size_t rank = shape.size();
+        size_t rows = shape[rank - 2], cols = shape[rank - 1];
+        size_t matrices = shape_size(shape) / (rows * cols);
+
+        float max_abs = 0;
+        for (float v : values)
+            max_abs = std::max(max_abs, std::abs(v));
+        float scale = max_abs > 0 ? max_abs / kWeightMax : 1.0f;
+
+        if (candidate.trans_b)
+            std::swap(shape[rank - 2], shape[rank - 1]);
+        std::vector<int8_t> data(values.size());
+        for (size_t m = 0; m < matrices; m++)
+        {
+            for (size_t r = 0; r < rows; r++)
+            {
+                for (size_t c = 0; c < cols; c++)
+                {
+                    size_t src = (m * rows + r) * cols + c;
+                    size_t dst = candidate.trans_b ? (m * cols + c) * rows + r : src;
+                    int q = static_cast<int>(std::nearbyint(values[src] / scale));
+                    data[dst] = static_cast<int8_t>(std::min(std::max(q, -kWeightMax), kWeightMax));
+                }
+            }
+        }
+
+        auto constant = std::make_shared<op::Constant>(element::i8, shape, data.data());
+        constant->set_name(candidate.b.gnode->get_name() + "_int8");
+        quantized = graph->add_node_and_edge(constant, GNodeVector({}));
+        return scale;
+    }
+} // namespace
+
+bool QuantizationPass::run_on_graph(std::shared_ptr<Graph>& graph)
+{
+    if (FLAGS_fquantize_calibration.empty())
+        return true;
+
+    std::vector<Candidate> candidates;
+    std::map<TensorKey, Range> ranges;
+    for (auto& node : graph->get_ordered_ops())
+    {
+        Candidate candidate;
+        if (!find_candidate(node, candidate))
+            continue;
+        candidates.push_back(candidate);
+        ranges[key_of(candidate.a)] = Range();
+        if (!candidate.b_const)
+            ranges[key_of(candidate.b)] = Range();
+    }
+    if (candidates.empty())
+        return true;
+
+    if (nnfusion::profiler::get_default_runtime(GENERIC_CPU) == nullptr)
+    {
+        NNFUSION_LOG(NNFUSION_WARNING)
+            << "No CPU runtime for calibration, INT8 quantization is skipped.";
+        return true;
+    }
+    auto samples = load_calibration(graph, FLAGS_fquantize_calibration);
+    if (!calibrate(graph, samples, ranges))
+    {
+        NNFUSION_LOG(NNFUSION_WARNING)
+            << "Calibration did not produce every quantized tensor, INT8 quantization is skipped.";
+        return true;
+    }
+
+    std::map<TensorKey, std::pair<std::shared_ptr<GNode>, QuantParams>> quantized_tensors;
+    auto quantize = [&](const GNodeIndex& tensor) {
+        auto key = key_of(tensor);
+        auto it = quantized_tensors.find(key);
+        if (it != quantized_tensors.end())
+            return it->second;
+
+        QuantParams params = activation_params(ranges[key]);
+        op::OpConfig::any config;
+        config["scale"] = params.scale;
+        config["zero_point"] = params.zero_point;
+        auto quantize_op = std::make_shared<op::GenericOp>(
+            tensor.gnode->get_name() + "_" + std::to_string(tensor.index) + "_quantize",
+            "QuantizeLinear",
+            config);
+        auto quantize_node = graph->add_node_and_edge(quantize_op, GNodeIndexVector({tensor}));
+        return quantized_tensors[key] = std::make_pair(quantize_node, params);
+    };
+
+    std::map<TensorKey, std::pair<std::shared_ptr<GNode>, float>> quantized_weights;
+    auto outputs = graph->get_outputs();
+    for (auto& candidate : candidates)
+    {
+        auto a = quantize(candidate.a);
+        std::shared_ptr<GNode> b_node;
+        QuantParams b_params{1.0f, 0};
+        if (candidate.b_const)
+        {
+            auto key = std::make_pair(candidate.b.gnode, candidate.trans_b ? 1 : 0);
+            auto it = quantized_weights.find(key);
+            if (it == quantized_weights.end())
+            {
+                float scale = quantize_weight(candidate, graph, b_node);
+                it = quantized_weights.emplace(key, std::make_pair(b_node, scale)).first;
+            }
+            b_node = it->second.first;
+            b_params.scale = it->second.second;
+        }
+        else
+        {
+            auto b = quantize(candidate.b);
+            b_node = b.first;
+            b_params = b.second;
+        }
+
+        op::OpConfig::any config;
+        config["a_zero_point"] = a.second.zero_point;
+        config["b_zero_point"] = b_params.zero_point;
+        config["scale"] = a.second.scale * b_params.scale;
+        auto matmul_op = std::make_shared<op::GenericOp>(
+            candidate.node->get_name() + "_int8", "QuantizedMatMul", config);
+        auto matmul_node = graph->add_node_and_edge(
+            matmul_op, GNodeIndexVector({GNodeIndex(a.first, 0), GNodeIndex(b_node, 0)}));
+        NNFUSION_CHECK(matmul_node->get_output_shape(0) == candidate.node->get_output_shape(0));
+
+        std::replace(outputs.begin(), outputs.end(), candidate.node, matmul_node);
+        auto b_source = candidate.b.gnode;
+        graph->replace_node(candidate.node, matmul_node, false);
+        if (candidate.b_const && b_source->get_out_edges().empty())
+            graph->remove_node(b_source);
+    }
+    graph->set_outputs(outputs);
+
+    NNFUSION_LOG(INFO) << "Quantized " << candidates.size() << " MatMuls of graph "
+                       << graph->get_name() << " to INT8 with " << samples.size()
+                       << " calibration samples.";
+    return true;
+}
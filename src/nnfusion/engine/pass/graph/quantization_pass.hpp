@@ -0,0 +1,25 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "graph_pass_base.hpp"
+
+namespace nnfusion
+{
+    namespace pass
+    {
+        namespace graph
+        {
+            // Post-training INT8 quantization of Dot and BatchMatMul for the CPU backend. The
+            // float inputs of every candidate are calibrated over the samples of
+            // -fquantize_calibration, then each candidate is rewritten to QuantizeLinear of its
+            // activations feeding a QuantizedMatMul, whose constant weights are quantized here.
+            class QuantizationPass : public GraphPassBase
+            {
+            public:
+                bool run_on_graph(std::shared_ptr<nnfusion::graph::Graph>& graph) override;
+            };
+        } // namespace graph
+    }     // namespace pass
+} // namespace nnfusion
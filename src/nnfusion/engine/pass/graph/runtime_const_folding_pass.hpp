@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "constant_evaluator.hpp"
 #include "graph_pass_base.hpp"
 #include "nnfusion/core/operators/op_define/constant.hpp"
 #include "nnfusion/engine/profiler/profiler.hpp"
@@ -17,9 +18,16 @@ namespace nnfusion
         {
             class RuntimeConstantFoldingPass : public GraphPassBase
             {
-                int runtime_const_folding_iterate_once(
-                    std::shared_ptr<Graph>& graph,
-                    std::set<std::shared_ptr<GNode>>& blocklist_nodes);
+                int fold_constant_subgraphs(std::shared_ptr<Graph>& graph,
+                                            std::set<std::shared_ptr<GNode>>& blocklist_nodes);
+                // Compiles and runs a kernel of the backend for a node the evaluator does not
+                // support.
+                bool run_on_backend(const std::shared_ptr<GNode>& node,
+                                    const std::vector<std::shared_ptr<op::ConstantData>>& inputs,
+                                    std::vector<std::vector<char>>& raw_outputs);
+                // The storage of a folded output, shared with an earlier output of the same
+                // bytes if there is one.
+                std::shared_ptr<op::ConstantData> fold_output(std::vector<char>&& output);
 
             public:
                 bool run_on_graph(std::shared_ptr<Graph>& graph) override;
@@ -27,6 +35,9 @@ namespace nnfusion
             private:
                 std::string backend;
                 bool fast_debug;
+                ConstantEvaluator m_evaluator;
+                // data hash -> storages of the folded constants
+                std::unordered_multimap<size_t, std::shared_ptr<op::ConstantData>> m_folded;
             };
         } // namespace pass
     }     // namespace graph
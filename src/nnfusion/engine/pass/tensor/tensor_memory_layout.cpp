@@ -175,6 +175,13 @@ bool AssignTensorMemoryLayout::run(std::shared_ptr<InterpreterContext> ctx,
         }
     }
 
+    for (const auto& allocator : maf->get_allocator_list())
+    {
+        allocator.second->plan();
+        if (dump_trace && !allocator.second->get_plan_report().empty())
+            mem_log << allocator.second->get_plan_report() << "\n";
+    }
+
     if (dump_trace)
     {
         // close memory log file.
@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "compile_scheduler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace nnfusion::profiler;
+using namespace std::chrono;
+
+DEFINE_int32(fprof_compile_workers,
+             0,
+             "Number of threads compiling kernels for profiling, 0 means all cores.");
+DEFINE_int32(fprof_compile_batch, 1, "Number of profiled kernels built into one shared library.");
+
+CompileScheduler::CompileScheduler(IProfilingRuntime::Pointer rt,
+                                   size_t num_workers,
+                                   size_t batch_size)
+    : rt(rt)
+    , num_workers(num_workers)
+    , batch_size(batch_size)
+{
+    if (this->num_workers == 0)
+        this->num_workers = FLAGS_fprof_compile_workers > 0 ? FLAGS_fprof_compile_workers : 0;
+    if (this->num_workers == 0)
+        this->num_workers = std::max(1u, std::thread::hardware_concurrency());
+    if (this->batch_size == 0)
+        this->batch_size = FLAGS_fprof_compile_batch > 0 ? FLAGS_fprof_compile_batch : 1;
+}
+
+void CompileScheduler::add(const ProfilingContext::Pointer& pctx)
+{
+    NNFUSION_CHECK_NOT_NULLPTR(pctx);
+    pending.push_back(pctx);
+}
+
+vector<vector<size_t>> CompileScheduler::make_batches(const vector<size_t>& todo)
+{
+    // Kernels are looked up by function name, so one library must not hold the same name twice.
+    vector<vector<size_t>> batches;
+    vector<unordered_set<string>> batch_names;
+    for (auto i : todo)
+    {
+        auto name = records[i].pctx->kernel->get_or_emit_source()->name_unit->get_code();
+        size_t b = 0;
+        while (b < batches.size() &&
+               (batches[b].size() >= batch_size || batch_names[b].count(name) > 0))
+            b++;
+        if (b == batches.size())
+        {
+            batches.emplace_back();
+            batch_names.emplace_back();
+        }
+        batches[b].push_back(i);
+        batch_names[b].insert(name);
+    }
+    return batches;
+}
+
+size_t CompileScheduler::run()
+{
+    records.clear();
+    vector<size_t> todo;
+    for (auto& pctx : pending)
+    {
+        CompileRecord record;
+        record.pctx = pctx;
+        if (pctx->entry_point != nullptr)
+            record.success = true;
+        else if (rt->codegen(pctx))
+            todo.push_back(records.size());
+        records.push_back(record);
+    }
+    pending.clear();
+
+    auto batches = make_batches(todo);
+    size_t workers = rt->is_compile_thread_safe() ? std::min(num_workers, batches.size()) : 1;
+
+    auto t_start = high_resolution_clock::now();
+    std::atomic<size_t> next_batch(0);
+    auto worker = [&]() {
+        size_t b;
+        while ((b = next_batch++) < batches.size())
+        {
+            vector<ProfilingContext::Pointer> batch;
+            for (auto i : batches[b])
+                batch.push_back(records[i].pctx);
+
+            auto t1 = high_resolution_clock::now();
+            rt->compile_batch(batch);
+            auto t2 = high_resolution_clock::now();
+            double ms = duration_cast<duration<double, std::milli>>(t2 - t1).count();
+            for (auto i : batches[b])
+            {
+                records[i].batch_id = b;
+                records[i].compile_time_in_ms = ms;
+                records[i].success = records[i].pctx->entry_point != nullptr;
+            }
+        }
+    };
+
+    if (workers <= 1)
+    {
+        worker();
+    }
+    else
+    {
+        vector<std::thread> threads;
+        for (size_t t = 0; t < workers; t++)
+            threads.emplace_back(worker);
+        for (auto& t : threads)
+            t.join();
+    }
+    auto t_end = high_resolution_clock::now();
+
+    size_t ready = 0;
+    for (auto& record : records)
+    {
+        if (record.success)
+            ready++;
+        NNFUSION_LOG(DEBUG) << rt->get_name() << "/"
+                            << record.pctx->kernel->get_or_emit_source()->name_unit->get_code()
+                            << ": batch " << record.batch_id << ", compile time(ms): "
+                            << record.compile_time_in_ms << (record.success ? "" : ", failed");
+    }
+    if (!batches.empty())
+    {
+        NNFUSION_LOG(INFO) << rt->get_name() << ": compiled " << ready << "/" << records.size()
+                           << " kernels in " << batches.size() << " libraries with " << workers
+                           << " workers, wall time(ms): "
+                           << duration_cast<duration<double, std::milli>>(t_end - t_start).count();
+    }
+    return ready;
+}
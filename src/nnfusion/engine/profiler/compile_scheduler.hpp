@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Compile many profiling contexts at once on a pool of workers
+ */
+#pragma once
+
+#include "profiling_runtime.hpp"
+
+DECLARE_int32(fprof_compile_workers);
+DECLARE_int32(fprof_compile_batch);
+
+namespace nnfusion
+{
+    namespace profiler
+    {
+        ///\brief Collects the pending profiling contexts of one runtime and builds them together:
+        // sources are generated one by one (codegen is not thread-safe), then the builds run on
+        // up to num_workers threads, packing up to batch_size kernels into one shared library.
+        // Contexts that fail here are simply left uncompiled, so the runtime retries them alone
+        // on first execution.
+        class CompileScheduler
+        {
+        public:
+            struct CompileRecord
+            {
+                ProfilingContext::Pointer pctx;
+                size_t batch_id = 0;
+                // Wall time of the build producing this kernel, shared by the whole batch.
+                double compile_time_in_ms = 0.0;
+                bool success = false;
+            };
+
+            ///\param num_workers 0 means -fprof_compile_workers.
+            ///\param batch_size 0 means -fprof_compile_batch.
+            CompileScheduler(IProfilingRuntime::Pointer rt,
+                             size_t num_workers = 0,
+                             size_t batch_size = 0);
+
+            void add(const ProfilingContext::Pointer& pctx);
+            size_t size() const { return pending.size(); }
+            ///\brief Generate and compile all pending contexts, return the number of kernels
+            // ready to run.
+            size_t run();
+            const vector<CompileRecord>& get_records() const { return records; }
+        private:
+            vector<vector<size_t>> make_batches(const vector<size_t>& todo);
+
+            IProfilingRuntime::Pointer rt;
+            size_t num_workers;
+            size_t batch_size;
+            vector<ProfilingContext::Pointer> pending;
+            vector<CompileRecord> records;
+        };
+    }
+}
@@ -17,10 +17,48 @@
 using namespace nnfusion::profiler;
 using namespace nnfusion::kernels;
 
+namespace
+{
+    // Enter a working directory and return to the previous one when leaving the scope, on
+    // failures as well, since the later relative paths of the process depend on it.
+    class ScopedWorkingDir
+    {
+    public:
+        ScopedWorkingDir(const std::string& dir)
+        {
+            NNFUSION_CHECK(getcwd(m_previous, PATH_MAX) != nullptr);
+            nnfusion::codegen::create_folder(dir);
+            NNFUSION_CHECK(chdir(dir.c_str()) == 0);
+        }
+        ~ScopedWorkingDir()
+        {
+            if (chdir(m_previous) != 0)
+                NNFUSION_LOG(ERROR) << "Failed to return to " << m_previous;
+        }
+
+    private:
+        char m_previous[PATH_MAX];
+    };
+
+    // The name of the source file of a kernel in the working directory, without suffix.
+    std::string get_source_name(const ProfilingContext::Pointer& ke)
+    {
+        string filename = ke->source_code->get_symbol();
+        if (filename.length() > 128)
+        {
+            size_t hashcode = std::hash<std::string>{}(filename);
+            filename = "compressed_src_" + std::to_string(hashcode);
+        }
+        return filename;
+    }
+}
+
 bool ReferenceRuntime::codegen(const ProfilingContext::Pointer& ke)
 {
     if (ke->source_code != nullptr)
         return true;
+    if (replace_with_reference_kernel(ke) == false)
+        return false;
     FunctionUnit_p fu = ke->kernel->get_or_emit_source();
     LanguageUnit writer(fu->name_unit->get_code() + ".cpp");
     writer << boilerplate::MIT1->get_code();
@@ -40,29 +78,30 @@ bool ReferenceRuntime::codegen(const ProfilingContext::Pointer& ke)
             if (it.second->symbol == "header::reference_common")
             {
                 writer << "// Unfolded reference_common.h begins\n";
-                writer << reference_common_header->get_code();
+                writer << guard_dependency(it.second->symbol,
+                                           reference_common_header->get_code());
                 writer << "using namespace reference_common;\n";
                 writer << "// Unfolded reference_common.h ends\n";
             }
             else
-                writer << it.second->get_code();
+                writer << guard_dependency(it.second->symbol, it.second->get_code());
         }
     writer << "\n";
 
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("macro::") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
 
     writer << "#include <chrono>\n#include <ctime>\n#include <ratio>\n#include <cmath>\n#include "
               "<numeric>\n";
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("declaration::") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
     writer << "\n";
 
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("cpu_reference_") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
     writer << "\n";
 
     //Write Code
@@ -194,33 +233,12 @@ bool ReferenceRuntime::codegen(const ProfilingContext::Pointer& ke)
     return true;
 }
 
-bool ReferenceRuntime::compile(const ProfilingContext::Pointer& ke)
+string ReferenceRuntime::get_compile_command(const string& srcname, const string& objname)
 {
-    if (ke->entry_point != nullptr)
-        return true;
-    string filename = string(nnfusion::tmpnam(nullptr));
-    string objname = filename + DLIB_SUFFIX;
-    string srcname = filename + ".cpp";
-    // ofstream source_file(ke->working_dir + "/" + ke->source_code->symbol);
-    ofstream source_file(srcname);
-    source_file << ke->source_code->get_code();
-    source_file.close();
-
-    int ret = system(("gcc\t-fPIC\t-shared\t-std=c++11\t" + srcname + "\t-o\t" + objname).c_str());
-    if (ret != 0)
-        return false;
-    if (!file_exsits(objname))
-        return false;
-    auto obj = get_library_handle(objname);
-    auto entry = get_funcion_pointer(
-        ke->kernel->get_or_emit_source()->name_unit->get_code() + "_entry", obj);
-    if (entry == nullptr)
-        return false;
-    ke->entry_point = (double (*)(void**, void**))entry;
-    return true;
+    return "gcc\t-fPIC\t-shared\t-std=c++11\t" + srcname + "\t-o\t" + objname;
 }
 
-double ReferenceRuntime::invoke(const ProfilingContext::Pointer& ke, void** input, void** output)
+bool ReferenceRuntime::replace_with_reference_kernel(const ProfilingContext::Pointer& ke)
 {
     // Replacing Existed Kernel with Reference Kenel
     auto& gnode = ke->kernel->m_context->gnode;
@@ -243,9 +261,11 @@ double ReferenceRuntime::invoke(const ProfilingContext::Pointer& ke, void** inpu
             ke->kernel = kernel;
         }
     }
+    return has_valid_kernel;
+}
 
-    if (!has_valid_kernel)
-        return -1.0;
+double ReferenceRuntime::invoke(const ProfilingContext::Pointer& ke, void** input, void** output)
+{
     if (codegen(ke) == false)
         return -1.0;
     if (compile(ke) == false)
@@ -268,11 +288,7 @@ bool CPUDefaultRuntime::codegen(const ProfilingContext::Pointer& ke)
     if (ke->source_code != nullptr)
         return true;
 
-    // setpwd
-    std::string working_dir = "./cpu_profiler/";
-    nnfusion::codegen::create_folder(working_dir);
-    int status = chdir(working_dir.c_str());
-    NNFUSION_CHECK(status == 0);
+    ScopedWorkingDir working_dir("./cpu_profiler/");
 
     FunctionUnit_p fu = ke->kernel->get_or_emit_source();
     LanguageUnit writer(fu->name_unit->get_code());
@@ -299,29 +315,30 @@ bool CPUDefaultRuntime::codegen(const ProfilingContext::Pointer& ke)
             if (it.second->symbol == "header::reference_common")
             {
                 writer << "// Unfolded reference_common.h begins\n";
-                writer << reference_common_header->get_code();
+                writer << guard_dependency(it.second->symbol,
+                                           reference_common_header->get_code());
                 writer << "using namespace reference_common;\n";
                 writer << "// Unfolded reference_common.h ends\n";
             }
             else
-                writer << it.second->get_code();
+                writer << guard_dependency(it.second->symbol, it.second->get_code());
         }
     writer << "\n";
 
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("macro::") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
 
     writer << "#include <chrono>\n#include <ctime>\n#include <ratio>\n#include <cmath>\n#include "
               "<numeric>\n#include<cstring>\nusing namespace std;\n";
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("declaration::") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
     writer << "\n";
 
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("cpu_reference_") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
     writer << "\n";
 
     //Write Code
@@ -456,7 +473,8 @@ bool CPUDefaultRuntime::codegen(const ProfilingContext::Pointer& ke)
         if (ke->kernel->is_parallelism())
         {
             writer << declaration::worker_thread_pool->get_code() << "\n";
-            writer << "worker_thread_pool = new concurrency::NumaAwareThreadPool(1, 1);\n";
+            writer << "worker_thread_pool = new concurrency::NumaAwareThreadPool(1, "
+                   << ke->num_threads << ");\n";
         }
 
         for (size_t i = 0; i < temp.size(); i++)
@@ -559,20 +577,10 @@ bool CPUDefaultRuntime::codegen(const ProfilingContext::Pointer& ke)
 
     ke->source_code = make_shared<LanguageUnit>(move(writer));
     // save src file
-    string filename = ke->source_code->get_symbol();
-    if (filename.length() > 128)
-    {
-        size_t hashcode = std::hash<std::string>{}(filename);
-        filename = "compressed_src_" + std::to_string(hashcode);
-    }
-
-    string srcname = filename + ".cpp";
+    string srcname = get_source_name(ke) + ".cpp";
     ofstream source_file(srcname);
     source_file << ke->source_code->get_code();
     source_file.close();
-
-    status = chdir("../");
-    NNFUSION_CHECK(status == 0);
     return true;
 }
 
@@ -580,16 +588,24 @@ bool CPUDefaultRuntime::cmake_codegen(const ProfilingContext::Pointer& ke)
 {
     if (ke->cmake_code != nullptr)
         return true;
+    return cmake_codegen(vector<ProfilingContext::Pointer>{ke});
+}
 
-    // setpwd
-    std::string working_dir = "./cpu_profiler/";
-    nnfusion::codegen::create_folder(working_dir);
-    int status = chdir(working_dir.c_str());
-    NNFUSION_CHECK(status == 0);
+bool CPUDefaultRuntime::cmake_codegen(const vector<ProfilingContext::Pointer>& batch)
+{
+    ScopedWorkingDir working_dir("./cpu_profiler/");
+
+    // The library links what any kernel of the batch needs.
+    bool require_cblas = false;
+    bool require_parallelism = false;
+    for (auto& ke : batch)
+    {
+        auto re = ke->kernel->get_or_emit_source()->dep_unit;
+        require_cblas |= re->local_symbol.count("header::cblas") > 0;
+        require_parallelism |= ke->kernel->is_parallelism();
+    }
 
-    FunctionUnit_p fu = ke->kernel->get_or_emit_source();
     LanguageUnit lu_cmake("CMakeLists.txt");
-    auto re = fu->dep_unit;
     lu_cmake << boilerplate::MIT2->get_code();
     lu_cmake << R"(
 project(cpu_profiler)
@@ -608,10 +624,9 @@ add_library(${TARGET_NAME} SHARED ${SOURCE_FILE})
     )"
              << "\n";
 
-    for (auto& it : re->local_symbol)
-        if (it.second->symbol == "header::cblas")
-        {
-            lu_cmake << R"(
+    if (require_cblas)
+    {
+        lu_cmake << R"(
 set(NNFUSION_THIRDPARTY_FOLDER "~/repo/Thirdparty" CACHE STRING "NNFusion Thirdpary libraries folder location")
 if(EXISTS "${NNFUSION_THIRDPARTY_FOLDER}")
 else()
@@ -626,9 +641,9 @@ foreach(LIB ${MKL_LIBS})
 endforeach()
 
 target_link_libraries(${TARGET_NAME} pthread libmkl)
-            )"
-                     << "\n";
-        }
+        )"
+                 << "\n";
+    }
 
     char exe_path[PATH_MAX];
     size_t count = readlink("/proc/self/exe", exe_path, PATH_MAX);
@@ -647,7 +662,7 @@ target_link_libraries(${TARGET_NAME} pthread libmkl)
     lu_cmake << "find_package(Threads REQUIRED)\n";
     lu_cmake << "target_link_libraries(${TARGET_NAME} Threads::Threads)\n\n";
 
-    if (ke->kernel->is_parallelism())
+    if (require_parallelism)
     {
         // Prepare eigen submodule.
         if (stat("./eigen", &s) != 0)
@@ -698,26 +713,21 @@ target_link_libraries(${TARGET_NAME} pthread libmkl)
         lu_cmake << "target_link_libraries(${TARGET_NAME} mlas)\n\n";
     }
 
-    ke->cmake_code = make_shared<LanguageUnit>(move(lu_cmake));
+    auto cmake_code = make_shared<LanguageUnit>(move(lu_cmake));
+    for (auto& ke : batch)
+        ke->cmake_code = cmake_code;
 
     // save cmake file
     string cmakename = "CMakeLists.txt";
     ofstream cmake_file(cmakename);
-    cmake_file << ke->cmake_code->get_code();
+    cmake_file << cmake_code->get_code();
     cmake_file.close();
-
-    status = chdir("../");
-    NNFUSION_CHECK(status == 0);
     return true;
 }
 
 bool CPUDefaultRuntime::general_cmake_codegen()
 {
-    // setpwd
-    std::string working_dir = "./cpu_profiler/";
-    nnfusion::codegen::create_folder(working_dir);
-    int status = chdir(working_dir.c_str());
-    NNFUSION_CHECK(status == 0);
+    ScopedWorkingDir working_dir("./cpu_profiler/");
 
     LanguageUnit lu_cmake("CMakeLists.txt");
     lu_cmake << boilerplate::MIT2->get_code();
@@ -808,9 +818,6 @@ add_library(${TARGET_NAME} SHARED ${SOURCE_FILE})
     ofstream cmake_file(cmakename);
     cmake_file << lu_cmake.get_code();
     cmake_file.close();
-
-    status = chdir("../");
-    NNFUSION_CHECK(status == 0);
     return true;
 }
 
@@ -818,40 +825,70 @@ bool CPUDefaultRuntime::compile(const ProfilingContext::Pointer& ke)
 {
     if (ke->entry_point != nullptr)
         return true;
-    // setpwd
-    std::string working_dir = "./cpu_profiler/";
-    nnfusion::codegen::create_folder(working_dir);
-    int status = chdir(working_dir.c_str());
-    NNFUSION_CHECK(status == 0);
+    string filename = get_source_name(ke);
+    return build_library(filename + ".cpp", filename, {ke});
+}
 
-    // src file
-    string filename = ke->source_code->get_symbol();
-    if (filename.length() > 128)
+bool CPUDefaultRuntime::compile_batch(const vector<ProfilingContext::Pointer>& batch)
+{
+    if (batch.size() == 1)
+        return cmake_codegen(batch[0]) && compile(batch[0]);
+
+    vector<ProfilingContext::Pointer> pending;
+    for (auto& ke : batch)
     {
-        size_t hashcode = std::hash<std::string>{}(filename);
-        filename = "compressed_src_" + std::to_string(hashcode);
+        if (ke->entry_point == nullptr && ke->source_code != nullptr)
+            pending.push_back(ke);
     }
+    if (pending.empty())
+        return true;
 
-    string objname = std::string("lib") + filename + DLIB_SUFFIX;
-    string srcname = filename + ".cpp";
+    // Each batch gets a library of its own, built from its sources only: the glob of
+    // general_compile() would also take the sources of earlier batches, and dlopen of a library
+    // already loaded returns the old handle. The sources are merged into one translation unit,
+    // where the guarded dependencies are defined once.
+    string target = "cpu_kernel_prof_" + to_string(m_num_batches++);
+    {
+        ScopedWorkingDir working_dir("./cpu_profiler/");
+        nnfusion::codegen::create_folder("./batches/");
+        ofstream source_file("./batches/" + target + ".cpp");
+        for (auto& ke : pending)
+            source_file << ke->source_code->get_code() << "\n";
+        source_file.close();
+    }
+    if (!cmake_codegen(pending))
+        return false;
+    return build_library("batches/" + target + ".cpp", target, pending);
+}
+
+bool CPUDefaultRuntime::build_library(const string& srcname,
+                                      const string& target,
+                                      const vector<ProfilingContext::Pointer>& kes)
+{
+    ScopedWorkingDir working_dir("./cpu_profiler/");
 
+    string objname = std::string("lib") + target + DLIB_SUFFIX;
     std::string cmd = std::string("cmake . -DSOURCE_FILE=") + srcname +
-                      std::string(" -DTARGET_NAME=") + filename + string("&& make -j");
+                      std::string(" -DTARGET_NAME=") + target + string("&& make -j");
     int ret = system((cmd.c_str()));
     if (ret != 0)
         return false;
     if (!file_exsits(objname))
         return false;
     auto obj = get_library_handle(objname);
-    auto entry = get_funcion_pointer(
-        ke->kernel->get_or_emit_source()->name_unit->get_code() + "_entry", obj);
-    if (entry == nullptr)
+    if (obj == nullptr)
         return false;
-    ke->entry_point = (double (*)(void**, void**))entry;
-
-    status = chdir("../");
-    NNFUSION_CHECK(status == 0);
-    return true;
+    bool all_bound = true;
+    for (auto& ke : kes)
+    {
+        auto entry = get_funcion_pointer(
+            ke->kernel->get_or_emit_source()->name_unit->get_code() + "_entry", obj);
+        if (entry == nullptr)
+            all_bound = false;
+        else
+            ke->entry_point = (double (*)(void**, void**))entry;
+    }
+    return all_bound;
 }
 
 bool CPUDefaultRuntime::general_compile()
@@ -860,11 +897,7 @@ bool CPUDefaultRuntime::general_compile()
     if (!general_cmake_codegen())
         return false;
 
-    // setpwd
-    std::string working_dir = "./cpu_profiler/";
-    nnfusion::codegen::create_folder(working_dir);
-    int status = chdir(working_dir.c_str());
-    NNFUSION_CHECK(status == 0);
+    ScopedWorkingDir working_dir("./cpu_profiler/");
 
     string objname = std::string("libcpu_kernel_prof") + DLIB_SUFFIX;
 
@@ -874,9 +907,6 @@ bool CPUDefaultRuntime::general_compile()
         return false;
     if (!file_exsits(objname))
         return false;
-
-    status = chdir("../");
-    NNFUSION_CHECK(status == 0);
     return true;
 }
 
@@ -22,19 +22,31 @@ namespace nnfusion
         public:
             static Pointer Runtime();
             CPUDefaultRuntime() { _dt = GENERIC_CPU; }
-            bool codegen(const ProfilingContext::Pointer& ke);
+            bool codegen(const ProfilingContext::Pointer& ke) override;
             bool general_compile();
+            // Batches of more than one kernel are merged into one source and built into a
+            // library named after the batch.
+            bool compile_batch(const vector<ProfilingContext::Pointer>& batch) override;
+            // Codegen and compile change the working directory of the process.
+            bool is_compile_thread_safe() override { return false; }
             double sep_invoke(const ProfilingContext::Pointer& ke, void** input, void** output);
 
         private:
             // Tiny codegen function for runtime
             // bool codegen(const ProfilingContext::Pointer& ke);
             bool cmake_codegen(const ProfilingContext::Pointer& ke);
-            bool compile(const ProfilingContext::Pointer& ke);
+            bool cmake_codegen(const vector<ProfilingContext::Pointer>& batch);
+            bool compile(const ProfilingContext::Pointer& ke) override;
+            // Build srcname in the working dir into the library of target and bind the entry
+            // points of kes.
+            bool build_library(const string& srcname,
+                               const string& target,
+                               const vector<ProfilingContext::Pointer>& kes);
             bool general_cmake_codegen();
             double
                 invoke(const ProfilingContext::Pointer& ke, void** input, void** output) override;
             unordered_set<string> global_required;
+            size_t m_num_batches = 0;
         };
 
         ///\brief Use this class to have a Interpreter runtime.
@@ -48,10 +60,11 @@ namespace nnfusion
         public:
             static Pointer Runtime();
             ReferenceRuntime() { _dt = GENERIC_CPU; }
+            bool codegen(const ProfilingContext::Pointer& ke) override;
+
         private:
-            // Tiny codegen function for runtime
-            bool codegen(const ProfilingContext::Pointer& ke);
-            bool compile(const ProfilingContext::Pointer& ke);
+            bool replace_with_reference_kernel(const ProfilingContext::Pointer& ke);
+            string get_compile_command(const string& srcname, const string& objname) override;
             double
                 invoke(const ProfilingContext::Pointer& ke, void** input, void** output) override;
         };
@@ -60,34 +60,34 @@ bool CudaDefaultRuntime::codegen(const ProfilingContext::Pointer& ke)
     for (auto& it : re->local_symbol)
     {
         if (it.second->symbol.find("header::") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
     }
 
     writer << "\n";
 
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("macro::") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
     writer << "\n";
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("declaration::") != string::npos)
         {
             for (auto& sub : it.second->local_symbol)
             {
-                writer << sub.second->get_code();
+                writer << guard_dependency(sub.second->symbol, sub.second->get_code());
             }
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
         }
     writer << "\n";
     if (auto kernel = std::dynamic_pointer_cast<CudaLibEmitter>(ke->kernel))
     {
         if (kernel->require_cudnn_handle())
         {
-            writer << "cudnnHandle_t cudnn_handle_0;\n";
+            writer << guard_dependency("cudnn_handle_0", "cudnnHandle_t cudnn_handle_0;");
         }
         if (kernel->require_cublas_handle())
         {
-            writer << "cublasHandle_t cublas_handle_0;\n";
+            writer << guard_dependency("cublas_handle_0", "cublasHandle_t cublas_handle_0;");
         }
     }
     // special for dropout
@@ -474,37 +474,13 @@ bool CudaDefaultRuntime::codegen(const ProfilingContext::Pointer& ke)
     */
 }
 
-bool CudaDefaultRuntime::compile(const ProfilingContext::Pointer& ke)
+string CudaDefaultRuntime::get_compile_command(const string& srcname, const string& objname)
 {
-    if (ke->entry_point != nullptr)
-        return true;
-    string filename = string(nnfusion::tmpnam(nullptr));
-    string objname = filename + DLIB_SUFFIX;
-    string srcname = filename + ".cu";
-    // ofstream source_file(ke->working_dir + "/" + ke->source_code->symbol);
-    NNFUSION_LOG(DEBUG) << "complie source file: " << srcname;
-    ofstream source_file(srcname);
-    source_file << ke->source_code->get_code();
-    source_file.close();
-
-    int ret = system(("nvcc\t-lcudnn\t-lcublas\t--compiler-options\t'-fPIC\t "
-                      "--shared'\t--cudart\tshared\t-O2\t-gencode="
-                      "arch=compute_60,code=compute_60\t-gencode=arch=compute_61,code=compute_61\t-"
-                      "std=c++11\t--expt-relaxed-constexpr\t" +
-                      srcname + "\t-o\t" + objname)
-                         .c_str());
-
-    if (ret != 0)
-        return false;
-    if (!file_exsits(objname))
-        return false;
-    auto obj = get_library_handle(objname);
-    auto entry = get_funcion_pointer(
-        ke->kernel->get_or_emit_source()->name_unit->get_code() + "_entry", obj);
-    if (entry == nullptr)
-        return false;
-    ke->entry_point = (double (*)(void**, void**))entry;
-    return true;
+    string cmd = "nvcc\t-lcudnn\t-lcublas\t--compiler-options\t'-fPIC\t "
+                 "--shared'\t--cudart\tshared\t-O2\t-gencode="
+                 "arch=compute_60,code=compute_60\t-gencode=arch=compute_61,code=compute_61\t-"
+                 "std=c++11\t--expt-relaxed-constexpr\t";
+    return cmd + srcname + "\t-o\t" + objname;
 }
 
 double CudaDefaultRuntime::invoke(const ProfilingContext::Pointer& ke, void** input, void** output)
@@ -574,21 +550,21 @@ bool CUPTIRuntime::codegen(const ProfilingContext::Pointer& ke)
     // Write Dependency
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("header::") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
     writer << "\n";
 
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("macro::") != string::npos)
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
     writer << "\n";
     for (auto& it : re->local_symbol)
         if (it.second->symbol.find("declaration::") != string::npos)
         {
             for (auto& sub : it.second->local_symbol)
             {
-                writer << sub.second->get_code();
+                writer << guard_dependency(sub.second->symbol, sub.second->get_code());
             }
-            writer << it.second->get_code();
+            writer << guard_dependency(it.second->symbol, it.second->get_code());
         }
     writer << "\n";
 
@@ -652,16 +628,16 @@ void CUPTIAPI bufferCompleted(CUcontext ctx, uint32_t streamId, uint8_t *buffer,
   free(buffer);
 }
     )";
-    writer << code << "\n";
+    writer << guard_dependency("cupti_buffer_callbacks", code) << "\n";
     if (auto kernel = std::dynamic_pointer_cast<CudaLibEmitter>(ke->kernel))
     {
         if (kernel->require_cudnn_handle())
         {
-            writer << "cudnnHandle_t cudnn_handle_0;\n";
+            writer << guard_dependency("cudnn_handle_0", "cudnnHandle_t cudnn_handle_0;");
         }
         if (kernel->require_cublas_handle())
         {
-            writer << "cublasHandle_t cublas_handle_0;\n";
+            writer << guard_dependency("cublas_handle_0", "cublasHandle_t cublas_handle_0;");
         }
     }
 
@@ -1013,37 +989,16 @@ void CUPTIAPI bufferCompleted(CUcontext ctx, uint32_t streamId, uint8_t *buffer,
     */
 }
 
-bool CUPTIRuntime::compile(const ProfilingContext::Pointer& ke)
+string CUPTIRuntime::get_compile_command(const string& srcname, const string& objname)
 {
-    if (ke->entry_point != nullptr)
-        return true;
-    string filename = string(nnfusion::tmpnam(nullptr));
-    string objname = filename + DLIB_SUFFIX;
-    string srcname = filename + ".cu";
-    // ofstream source_file(ke->working_dir + "/" + ke->source_code->symbol);
-    ofstream source_file(srcname);
-    source_file << ke->source_code->get_code();
-    source_file.close();
-    int ret =
-        system(("nvcc\t-lcudnn\t-lcublas\t-lcupti\t--compiler-options\t'-fPIC\t "
-                "-I/usr/local/cuda/extras/CUPTI/include\t-L/usr/local/cuda/extras/CUPTI/lib64\t"
-                "--shared'\t--cudart\tshared\t-O2\t-gencode="
-                "arch=compute_60,code=compute_60\t-gencode=arch=compute_61,code=compute_61\t"
-                "-gencode=arch=compute_70,code=compute_70\t-gencode=arch=compute_75,code=compute_"
-                "75\t-std=c++11\t--expt-relaxed-constexpr\t" +
-                srcname + "\t-o\t" + objname)
-                   .c_str());
-    if (ret != 0)
-        return false;
-    if (!file_exsits(objname))
-        return false;
-    auto obj = get_library_handle(objname);
-    auto entry = get_funcion_pointer(
-        ke->kernel->get_or_emit_source()->name_unit->get_code() + "_entry", obj);
-    if (entry == nullptr)
-        return false;
-    ke->entry_point = (double (*)(void**, void**))entry;
-    return true;
+    string cmd =
+        "nvcc\t-lcudnn\t-lcublas\t-lcupti\t--compiler-options\t'-fPIC\t "
+        "-I/usr/local/cuda/extras/CUPTI/include\t-L/usr/local/cuda/extras/CUPTI/lib64\t"
+        "--shared'\t--cudart\tshared\t-O2\t-gencode="
+        "arch=compute_60,code=compute_60\t-gencode=arch=compute_61,code=compute_61\t"
+        "-gencode=arch=compute_70,code=compute_70\t-gencode=arch=compute_75,code=compute_"
+        "75\t-std=c++11\t--expt-relaxed-constexpr\t";
+    return cmd + srcname + "\t-o\t" + objname;
 }
 
 double CUPTIRuntime::invoke(const ProfilingContext::Pointer& ke, void** input, void** output)
@@ -22,8 +22,9 @@ namespace nnfusion
             CudaDefaultRuntime() { _dt = CUDA_GPU; }
         protected:
             // Tiny codegen function for runtime
-            virtual bool codegen(const ProfilingContext::Pointer& ke);
-            virtual bool compile(const ProfilingContext::Pointer& ke);
+            bool codegen(const ProfilingContext::Pointer& ke) override;
+            string get_compile_command(const string& srcname, const string& objname) override;
+            string get_source_suffix() override { return ".cu"; }
             double
                 invoke(const ProfilingContext::Pointer& ke, void** input, void** output) override;
 
@@ -38,8 +39,9 @@ namespace nnfusion
             CUPTIRuntime() { _dt = CUDA_GPU; }
         protected:
             // Tiny codegen function for runtime
-            virtual bool codegen(const ProfilingContext::Pointer& ke);
-            virtual bool compile(const ProfilingContext::Pointer& ke);
+            bool codegen(const ProfilingContext::Pointer& ke) override;
+            string get_compile_command(const string& srcname, const string& objname) override;
+            string get_source_suffix() override { return ".cu"; }
             double
                 invoke(const ProfilingContext::Pointer& ke, void** input, void** output) override;
 
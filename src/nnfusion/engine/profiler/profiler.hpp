@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <string>
 
+#include "compile_scheduler.hpp"
 #include "cpu_runtime.hpp"
 #include "cuda_runtime.hpp"
 #include "nnfusion/common/type/data_buffer.hpp"
@@ -6,7 +6,10 @@
  * \author wenxh
  */
 
+#include <cctype>
+
 #include "profiling_runtime.hpp"
+#include "binary_utils.hpp"
 
 using namespace nnfusion::profiler;
 
@@ -62,4 +65,60 @@ double IProfilingRuntime::execute(const ProfilingContext::Pointer& ke, void** in
             ke, [&]() { return invoke(ke, input, output); }, this->get_name());
     else
         return invoke(ke, input, output);
-}
\ No newline at end of file
+}
+
+bool IProfilingRuntime::compile(const ProfilingContext::Pointer& ke)
+{
+    return compile_batch({ke});
+}
+
+bool IProfilingRuntime::compile_batch(const vector<ProfilingContext::Pointer>& batch)
+{
+    vector<ProfilingContext::Pointer> pending;
+    for (auto& ke : batch)
+    {
+        if (ke->entry_point == nullptr && ke->source_code != nullptr)
+            pending.push_back(ke);
+    }
+    if (pending.empty())
+        return true;
+
+    string filename = string(nnfusion::tmpnam(nullptr));
+    string objname = filename + DLIB_SUFFIX;
+    string srcname = filename + get_source_suffix();
+    NNFUSION_LOG(DEBUG) << "complie source file: " << srcname;
+    ofstream source_file(srcname);
+    for (auto& ke : pending)
+        source_file << ke->source_code->get_code() << "\n";
+    source_file.close();
+
+    string cmd = get_compile_command(srcname, objname);
+    if (cmd.empty())
+        return false;
+    int ret = system(cmd.c_str());
+    if (ret != 0)
+        return false;
+    if (!file_exsits(objname))
+        return false;
+
+    auto obj = get_library_handle(objname);
+    bool all_bound = true;
+    for (auto& ke : pending)
+    {
+        auto entry = get_funcion_pointer(
+            ke->kernel->get_or_emit_source()->name_unit->get_code() + "_entry", obj);
+        if (entry == nullptr)
+            all_bound = false;
+        else
+            ke->entry_point = (double (*)(void**, void**))entry;
+    }
+    return all_bound;
+}
+
+string IProfilingRuntime::guard_dependency(const string& symbol, const string& code)
+{
+    string guard = "NNFUSION_PROFILING_";
+    for (auto c : symbol)
+        guard += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    return "#ifndef " + guard + "\n#define " + guard + "\n" + code + "\n#endif\n";
+}
@@ -12,7 +12,6 @@
 #include <string>
 
 #include <pwd.h>
-#include <sqlite3.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -21,6 +20,7 @@
 #include "nnfusion/core/kernels/kernel_emitter.hpp"
 #include "nnfusion/core/kernels/kernel_registration.hpp"
 #include "nnfusion/core/operators/generic_op/generic_op.hpp"
+#include "nnfusion/engine/cache/manager.hpp"
 
 using namespace std;
 using namespace nnfusion;
@@ -86,8 +86,8 @@ namespace nnfusion
             using Pointer = shared_ptr<ProfilingResult>;
         };
 
-        ///\brief The cache to store the time cost data, this should be connected
-        // to some database tool.
+        ///\brief The cache to store the time cost data, kept in the ProfilingCache table of the
+        // kernel cache DB.
         struct ProfilingCache
         {
             using KernelEmitter = nnfusion::kernels::KernelEmitter;
@@ -157,24 +157,6 @@ namespace nnfusion
                 if (!ke->using_cache)
                     return func();
 
-                static sqlite3* sqldb = NULL;
-                if (!sqldb)
-                {
-                    NNFUSION_CHECK(SQLITE_OK ==
-                                   sqlite3_open((getpwuid(getuid())->pw_dir +
-                                                 std::string("/.cache/nnfusion_cache.db"))
-                                                    .c_str(),
-                                                &sqldb));
-                    const char* table_create = R"(
-CREATE TABLE IF NOT EXISTS KernelCache(
-  key_code TEXT PRIMARY KEY NOT NULL,
-  key_op TEXT NOT NULL,
-  device_type TEXT NOT NULL,
-  cost REAL );
-)";
-                    NNFUSION_CHECK(SQLITE_OK == sqlite3_exec(sqldb, table_create, NULL, 0, NULL));
-                }
-
                 auto key_code = get_key_code(emitter);
                 if (key_code.size() == 0)
                 {
@@ -186,19 +168,12 @@ CREATE TABLE IF NOT EXISTS KernelCache(
                     return func();
                 }
 
-                sqlite3_stmt* pStmt;
-
-                const char* table_query_body = R"(
-SELECT cost FROM KernelCache WHERE key_code = ?;
-)";
-                NNFUSION_CHECK(SQLITE_OK ==
-                               sqlite3_prepare(sqldb, table_query_body, -1, &pStmt, 0));
-                sqlite3_bind_text(pStmt, 1, key_code.data(), key_code.size(), SQLITE_STATIC);
-                if (SQLITE_DONE != sqlite3_step(pStmt))
+                // One manager for all the profiled kernels, sharing the connection and the
+                // in-memory cache of the kernel cache DB.
+                static nnfusion::cache::KernelCacheManager cache_manager;
+                double cost;
+                if (cache_manager.fetch_profile(key_code, device_type, cost))
                 {
-                    double cost = sqlite3_column_double(pStmt, 0);
-                    NNFUSION_CHECK(SQLITE_DONE == sqlite3_step(pStmt));
-                    NNFUSION_CHECK(SQLITE_OK == sqlite3_finalize(pStmt));
                     NNFUSION_LOG(INFO) << device_type << "/" << emitter->get_function_name()
                                        << ": Using cached kernel time cost = " << cost;
                     return cost;
@@ -209,16 +184,7 @@ SELECT cost FROM KernelCache WHERE key_code = ?;
                                    << ": Updated cached kernel time cost = " << result;
                 // NNFUSION_LOG(INFO) << get_key_op(emitter) << "\n" << key_code;
 
-                const char* table_insert = R"(
-INSERT INTO KernelCache(key_code, key_op, device_type, cost) VALUES(?, ?, ?, ?);
-)";
-                NNFUSION_CHECK(SQLITE_OK == sqlite3_prepare(sqldb, table_insert, -1, &pStmt, 0));
-                sqlite3_bind_text(pStmt, 1, key_code.data(), key_code.size(), SQLITE_STATIC);
-                sqlite3_bind_text(pStmt, 2, key_op.data(), key_op.size(), SQLITE_STATIC);
-                sqlite3_bind_text(pStmt, 3, device_type.data(), device_type.size(), SQLITE_STATIC);
-                sqlite3_bind_double(pStmt, 4, result);
-                NNFUSION_CHECK(SQLITE_DONE == sqlite3_step(pStmt));
-                NNFUSION_CHECK(SQLITE_OK == sqlite3_finalize(pStmt));
+                cache_manager.insert_profile(key_code, key_op, device_type, result);
                 return result;
             }
         };
@@ -474,6 +440,8 @@ INSERT INTO KernelCache(key_code, key_op, device_type, cost) VALUES(?, ?, ?, ?);
             size_t warmup_times = 5;
             size_t host_times = 1;
             size_t runtime_times = 100;
+            // threads of the pool which parallel CPU kernels run on, 0 for one per core
+            size_t num_threads = 1;
             // This emitter includes the kernel context;
             ProfilingResult result;
             kernels::KernelEmitter::Pointer kernel;
@@ -553,10 +521,31 @@ INSERT INTO KernelCache(key_code, key_op, device_type, cost) VALUES(?, ?, ?, ?);
             string get_device_name() { return nnfusion::get_device_str(_dt); };
             NNFusion_DeviceType get_device_type() { return _dt; };
             virtual string get_name() { return get_device_name(); };
+            ///\brief Generate the source code of the kernel, this is not thread-safe.
+            virtual bool codegen(const ProfilingContext::Pointer& ke) { return false; }
+            ///\brief Build the generated source into a library and bind the entry point.
+            virtual bool compile(const ProfilingContext::Pointer& ke);
+            ///\brief Build several generated sources into one shared library, each context
+            // still gets its own entry point. The sources are concatenated into one translation
+            // unit, so the runtimes guard the helpers they emit with guard_dependency().
+            virtual bool compile_batch(const vector<ProfilingContext::Pointer>& batch);
+            ///\brief Whether compile()/compile_batch() can run on different contexts from
+            // several threads at once.
+            virtual bool is_compile_thread_safe() { return true; }
         private:
             virtual double invoke(const ProfilingContext::Pointer& ke, void** input, void** output);
 
         protected:
+            // The command to build srcname into the shared library objname, runtimes using the
+            // default compile_batch() should override this.
+            virtual string get_compile_command(const string& srcname, const string& objname)
+            {
+                return "";
+            }
+            // Wrap the code of a dependency in an include guard named after its symbol, so that
+            // a helper required by several kernels of a batch is defined once.
+            static string guard_dependency(const string& symbol, const string& code);
+            virtual string get_source_suffix() { return ".cpp"; }
             NNFusion_DeviceType _dt;
             /*
             ///\todo To be provided in future, since we cannot use runtime api here.
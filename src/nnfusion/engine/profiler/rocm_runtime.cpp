@@ -17,6 +17,24 @@ bool RocmDefaultRuntime::check_env()
     return file_exsits("/opt/rocm/bin/hipcc");
 }
 
+bool RocmDefaultRuntime::codegen(const ProfilingContext::Pointer& ke)
+{
+    if (ke->source_code != nullptr)
+        return true;
+    if (CudaDefaultRuntime::codegen(ke) == false)
+        return false;
+    // This step may looks more like an option in future.
+    return hipfy(ke);
+}
+
+bool RocmDefaultRuntime::compile_batch(const vector<ProfilingContext::Pointer>& batch)
+{
+    bool ret = true;
+    for (auto& ke : batch)
+        ret = compile(ke) && ret;
+    return ret;
+}
+
 bool RocmDefaultRuntime::compile(const ProfilingContext::Pointer& ke)
 {
     if (ke->entry_point != nullptr)
@@ -92,12 +110,8 @@ bool RocmDefaultRuntime::hipfy(const ProfilingContext::Pointer& ke)
 
 double RocmDefaultRuntime::invoke(const ProfilingContext::Pointer& ke, void** input, void** output)
 {
-    // Reuse cuda codegen.
     if (codegen(ke) == false)
         return -1.0;
-    // This step may looks more like an option in future.
-    if (hipfy(ke) == false)
-        return -1.0;
     if (compile(ke) == false)
         return -1.0;
     if (ke->entry_point == nullptr)
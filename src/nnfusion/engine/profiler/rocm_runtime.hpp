@@ -23,10 +23,12 @@ namespace nnfusion
             bool check_env() override;
 
         private:
-            // Tiny codegen function for runtime
-            // bool codegen(const ProfilingContext::Pointer& ke) override;
+            // Tiny codegen function for runtime, reuse cuda codegen and hipfy the result.
+            bool codegen(const ProfilingContext::Pointer& ke) override;
             bool hipfy(const ProfilingContext::Pointer& ke);
             bool compile(const ProfilingContext::Pointer& ke) override;
+            // Hipified sources are built one by one.
+            bool compile_batch(const vector<ProfilingContext::Pointer>& batch) override;
             double
                 invoke(const ProfilingContext::Pointer& ke, void** input, void** output) override;
         };
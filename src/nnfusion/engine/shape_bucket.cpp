@@ -0,0 +1,728 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "shape_bucket.hpp"
+
+#include <sys/stat.h>
+
+#include "nnfusion/core/kernels/common_langunit.hpp"
+#include "nnfusion/core/kernels/weight_pack.hpp"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+#include "nnfusion/core/operators/op_define/avg_pool.hpp"
+#include "nnfusion/core/operators/op_define/convolution.hpp"
+#include "nnfusion/core/operators/op_define/max_pool.hpp"
+#include "nnfusion/core/operators/op_define/result.hpp"
+#include "nnfusion/core/operators/op_define/softmax.hpp"
+#include "nnfusion/core/operators/util/arithmetic_reduction.hpp"
+#include "nnfusion/core/operators/util/index_reduction.hpp"
+#include "nnfusion/engine/device/cpu.hpp"
+#include "nnfusion/engine/pass/codegen/cpu_codegen_pass.hpp"
+
+using namespace nnfusion;
+using namespace nnfusion::engine;
+
+DEFINE_string(fshape_buckets,
+              "",
+              "Compile an ONNX model for several values of its symbolic dims into one CPU "
+              "runtime, e.g. \"batch:1;seq:128|batch:8;seq:384\". Turns on -fpack_constants "
+              "and -fextern_result_memory.");
+DECLARE_bool(fextern_result_memory);
+
+namespace
+{
+    bool path_exists(const std::string& path)
+    {
+        struct stat s;
+        return stat(path.c_str(), &s) == 0;
+    }
+
+    void move_folder(const std::string& from, const std::string& to)
+    {
+        if (path_exists(to))
+            NNFUSION_CHECK(0 == system(("rm -rf " + to).c_str())) << "Failed to remove " << to;
+        NNFUSION_CHECK(0 == system(("mv " + from + " " + to).c_str())) << "Failed to move "
+                                                                      << from;
+    }
+
+    std::string bucket_name(size_t b) { return "bucket_" + std::to_string(b); }
+
+    // The spatial axes of a window op whose windows may cross the edge of the input, i.e. the
+    // ones of windows wider than one element or with padding. window holds the window sizes of
+    // the spatial axes, which follow the channel axis when channels_first.
+    template <typename Padding>
+    nnfusion::AxisSet get_window_axes(const nnfusion::Shape& input_shape,
+                                      const nnfusion::Shape& window,
+                                      const Padding& padding_below,
+                                      const Padding& padding_above,
+                                      bool channels_first)
+    {
+        nnfusion::AxisSet axes;
+        size_t first = channels_first ? 2 : 1;
+        for (size_t i = 0; i < window.size() && first + i < input_shape.size(); i++)
+        {
+            bool padded = (i < padding_below.size() && padding_below[i] != 0) ||
+                          (i < padding_above.size() && padding_above[i] != 0);
+            if (window[i] > 1 || padded)
+                axes.insert(first + i);
+        }
+        return axes;
+    }
+
+    // The shape a node reduces or normalizes and the axes it does so over, the valid part of
+    // its outputs depends on the padding along these axes. Pooling and convolution windows
+    // reduce over the spatial axes they slide along.
+    std::pair<nnfusion::Shape, nnfusion::AxisSet>
+        get_reduced_axes(const std::shared_ptr<graph::GNode>& gnode)
+    {
+        auto op_ptr = gnode->get_op_ptr();
+        if (auto pool = std::dynamic_pointer_cast<op::MaxPool>(op_ptr))
+        {
+            auto& shape = gnode->get_input_shape(0);
+            return std::make_pair(shape,
+                                  get_window_axes(shape,
+                                                  pool->get_window_shape(),
+                                                  pool->get_padding_below(),
+                                                  pool->get_padding_above(),
+                                                  pool->get_data_format() != "NHWC"));
+        }
+        if (auto pool = std::dynamic_pointer_cast<op::AvgPool>(op_ptr))
+        {
+            auto& shape = gnode->get_input_shape(0);
+            return std::make_pair(shape,
+                                  get_window_axes(shape,
+                                                  pool->get_window_shape(),
+                                                  pool->get_padding_below(),
+                                                  pool->get_padding_above(),
+                                                  pool->get_data_format() != "NHWC"));
+        }
+        if (auto conv = std::dynamic_pointer_cast<op::Convolution>(op_ptr))
+        {
+            // OIHW filters for NCHW data, HWIO for NHWC
+            auto& shape = gnode->get_input_shape(0);
+            auto& filter = gnode->get_input_shape(1);
+            bool channels_first = conv->get_data_format() != "NHWC";
+            nnfusion::Shape window(filter.begin() + (channels_first ? 2 : 0),
+                                   filter.end() - (channels_first ? 0 : 2));
+            return std::make_pair(shape,
+                                  get_window_axes(shape,
+                                                  window,
+                                                  conv->get_padding_below(),
+                                                  conv->get_padding_above(),
+                                                  channels_first));
+        }
+        if (auto reduction = std::dynamic_pointer_cast<op::ArithmeticReduction>(op_ptr))
+            return std::make_pair(gnode->get_input_shape(0), reduction->get_reduction_axes());
+        if (auto reduction = std::dynamic_pointer_cast<op::IndexReduction>(op_ptr))
+            return std::make_pair(gnode->get_input_shape(0),
+                                  nnfusion::AxisSet{reduction->get_reduction_axis()});
+        if (auto softmax = std::dynamic_pointer_cast<op::Softmax>(op_ptr))
+            return std::make_pair(gnode->get_input_shape(0), softmax->get_axes());
+
+        auto type = gnode->get_op_type();
+        if (type != "LayerNorm" && type != "SkipLayerNorm" && type != "EmbedLayerNorm")
+            return std::make_pair(nnfusion::Shape{}, nnfusion::AxisSet{});
+        // normalized over the last axes of the output
+        nnfusion::Shape shape = gnode->get_output_shape(0);
+        int axis = -1;
+        if (type == "LayerNorm")
+        {
+            auto generic_op = std::dynamic_pointer_cast<op::GenericOp>(op_ptr);
+            axis = generic_op->localOpConfig.getRoot()["axis"];
+        }
+        if (axis < 0)
+            axis += shape.size();
+        nnfusion::AxisSet axes;
+        for (size_t a = axis; a < shape.size(); a++)
+            axes.insert(a);
+        return std::make_pair(shape, axes);
+    }
+    template <typename T>
+    std::string braced(const std::vector<T>& values)
+    {
+        return "{" + join(values, ", ") + "}";
+    }
+}
+
+ShapeBucketCompiler::ShapeBucketCompiler(const std::vector<Bucket>& buckets,
+                                         const std::string& codegen_folder)
+    : m_buckets(buckets)
+    , m_codegen_folder(codegen_folder)
+{
+    NNFUSION_CHECK(m_buckets.size() > 1) << "Shape buckets need at least two buckets.";
+    for (auto& bucket : m_buckets)
+    {
+        NNFUSION_CHECK(bucket.size() == m_buckets[0].size()) << "All shape buckets must set the "
+                                                                "same dims.";
+        for (auto& dim : bucket)
+            NNFUSION_CHECK(m_buckets[0].count(dim.first)) << "Dim " << dim.first
+                                                          << " is missing in the first bucket.";
+    }
+    m_dims = get_dynamic_dims(m_buckets);
+    NNFUSION_CHECK(!m_dims.empty()) << "All shape buckets are the same.";
+}
+
+std::vector<std::string> ShapeBucketCompiler::get_dynamic_dims(const std::vector<Bucket>& buckets)
+{
+    std::vector<std::string> dims;
+    if (buckets.empty())
+        return dims;
+    for (auto& dim : buckets[0])
+    {
+        for (auto& bucket : buckets)
+        {
+            if (bucket.at(dim.first) != dim.second)
+            {
+                dims.push_back(dim.first);
+                break;
+            }
+        }
+    }
+    std::sort(dims.begin(), dims.end());
+    return dims;
+}
+
+std::vector<int> ShapeBucketCompiler::infer_axis_dims(const std::vector<nnfusion::Shape>& shapes,
+                                                      const std::vector<Bucket>& buckets,
+                                                      const std::vector<std::string>& dims)
+{
+    NNFUSION_CHECK(shapes.size() == buckets.size());
+    std::vector<int> axis_dims(shapes[0].size(), -1);
+    for (size_t a = 0; a < axis_dims.size(); a++)
+    {
+        bool changes = false;
+        for (auto& shape : shapes)
+        {
+            NNFUSION_CHECK(shape.size() == shapes[0].size()) << "Rank changes between buckets.";
+            changes |= shape[a] != shapes[0][a];
+        }
+        if (!changes)
+            continue;
+
+        for (size_t d = 0; d < dims.size(); d++)
+        {
+            bool follows = true;
+            for (size_t b = 0; b < buckets.size(); b++)
+                follows &= shapes[b][a] == buckets[b].at(dims[d]);
+            if (!follows)
+                continue;
+            NNFUSION_CHECK(axis_dims[a] < 0) << "Axis " << a << " follows both "
+                                             << dims[axis_dims[a]] << " and " << dims[d]
+                                             << ", add a bucket where they differ.";
+            axis_dims[a] = d;
+        }
+        NNFUSION_CHECK(axis_dims[a] >= 0) << "Axis " << a
+                                          << " changes between buckets but follows no single dim.";
+    }
+    return axis_dims;
+}
+
+void ShapeBucketCompiler::collect_signature(graph::Graph::Pointer graph)
+{
+    // Same order as the kernel_entry parameters of the bucket runtime.
+    std::vector<std::shared_ptr<descriptor::Tensor>> inputs, outputs;
+    for (auto gnode : graph->get_parameters())
+        for (size_t i = 0; i < gnode->get_output_size(); ++i)
+            inputs.push_back(gnode->get_output_tensor_ptr(i));
+    for (size_t i = 0; i < graph->get_output_size(); ++i)
+    {
+        auto node = graph->get_output_op(i);
+        auto res = std::dynamic_pointer_cast<op::Result>(node->get_op_ptr());
+        if (res && res->needs_copy_to_host())
+            outputs.push_back(node->get_output_tensor_ptr(0));
+    }
+
+    auto collect = [](const std::vector<std::shared_ptr<descriptor::Tensor>>& tensors,
+                      std::vector<TensorInfo>& infos) {
+        if (infos.empty())
+        {
+            for (auto& tensor : tensors)
+            {
+                TensorInfo info;
+                info.name = tensor->get_name();
+                info.type = tensor->get_element_type().c_type_string();
+                info.element_size = tensor->get_element_type().size();
+                infos.push_back(info);
+            }
+        }
+        NNFUSION_CHECK(infos.size() == tensors.size())
+            << "The signature of the model changes between buckets.";
+        for (size_t i = 0; i < tensors.size(); i++)
+        {
+            NNFUSION_CHECK(infos[i].type == tensors[i]->get_element_type().c_type_string())
+                << "The type of " << infos[i].name << " changes between buckets.";
+            infos[i].shapes.push_back(tensors[i]->get_shape());
+        }
+    };
+    collect(inputs, m_inputs);
+    collect(outputs, m_outputs);
+}
+
+void ShapeBucketCompiler::check_padding(const std::vector<graph::Graph::Pointer>& graphs)
+{
+    // the reducing nodes of every graph, in the order of the graph
+    std::vector<std::vector<std::shared_ptr<graph::GNode>>> nodes(graphs.size());
+    for (size_t b = 0; b < graphs.size(); b++)
+    {
+        for (auto gnode : graphs[b]->get_ordered_ops())
+        {
+            if (!get_reduced_axes(gnode).second.empty())
+                nodes[b].push_back(gnode);
+        }
+        NNFUSION_CHECK(nodes[b].size() == nodes[0].size())
+            << "The graph changes between buckets.";
+    }
+
+    for (size_t i = 0; i < nodes[0].size(); i++)
+    {
+        auto first = get_reduced_axes(nodes[0][i]);
+        for (size_t b = 1; b < graphs.size(); b++)
+        {
+            auto other = get_reduced_axes(nodes[b][i]);
+            for (auto axis : first.second)
+            {
+                NNFUSION_CHECK(axis < other.first.size() && first.first[axis] == other.first[axis])
+                    << nodes[0][i]->get_op_type() << " " << nodes[0][i]->get_name()
+                    << " reduces over axis " << axis << ", whose size changes between buckets: "
+                    << "the zero padding of smaller inputs would change its result.";
+            }
+        }
+    }
+}
+
+bool ShapeBucketCompiler::run(const GraphLoader& load)
+{
+    // Buckets share one weight file and write their outputs to caller memory.
+    if (!FLAGS_fpack_constants || !FLAGS_fextern_result_memory)
+        NNFUSION_LOG(INFO) << "-fshape_buckets turns on -fpack_constants and "
+                              "-fextern_result_memory.";
+    FLAGS_fpack_constants = true;
+    FLAGS_fextern_result_memory = true;
+
+    std::vector<graph::Graph::Pointer> graphs;
+    for (auto& bucket : m_buckets)
+        graphs.push_back(load(bucket));
+    check_padding(graphs);
+
+    auto weights = kernels::WeightPack::Global();
+    std::string constant_folder = kernels::WeightPack::folder;
+    constant_folder.pop_back();
+    m_context = std::make_shared<codegen::ShapeBucketContext>();
+    for (size_t b = 0; b < m_buckets.size(); b++)
+    {
+        NNFUSION_LOG(INFO) << "Compiling shape " << bucket_name(b);
+        // Each codegen moves the weight file into its own folder, bring it back for the next
+        // bucket to append to.
+        if (b > 0 && path_exists(m_codegen_folder + bucket_name(b - 1) + "/Constant"))
+            move_folder(m_codegen_folder + bucket_name(b - 1) + "/Constant", constant_folder);
+
+        weights->set_scope(bucket_name(b) + "/");
+        CpuEngine engine(m_codegen_folder + bucket_name(b) + "/", bucket_name(b) + "_", m_context);
+        if (!engine.run_on_graph(graphs[b]))
+            return false;
+        collect_signature(graphs[b]);
+        graphs[b].reset();
+    }
+    weights->set_scope("");
+
+    std::string last = m_codegen_folder + bucket_name(m_buckets.size() - 1) + "/Constant";
+    if (path_exists(last))
+        move_folder(last, m_codegen_folder + "Constant");
+
+    for (auto& info : m_inputs)
+        info.axis_dims = infer_axis_dims(info.shapes, m_buckets, m_dims);
+    for (auto& info : m_outputs)
+        info.axis_dims = infer_axis_dims(info.shapes, m_buckets, m_dims);
+
+    emit_dispatcher();
+    emit_exports();
+    size_t shared_kernels = 0;
+    for (auto& it : m_context->exported_kernels)
+        shared_kernels += it.second.size();
+    NNFUSION_LOG(INFO) << shared_kernels << " kernels are shared between buckets.";
+    NNFUSION_LOG(INFO) << "Compiled " << m_buckets.size() << " shape buckets over dims ("
+                       << join(m_dims) << ") into " << m_codegen_folder;
+    return true;
+}
+
+void ShapeBucketCompiler::emit_exports()
+{
+    for (size_t b = 0; b < m_buckets.size(); b++)
+    {
+        std::string prefix = bucket_name(b) + "_";
+        std::string path = m_codegen_folder + bucket_name(b) + "/exports.map";
+        std::ofstream out(path);
+        out << "{\n  global:\n    " << prefix << "*;\n    extern \"C++\"\n    {\n";
+        out << "      concurrency::*;\n      Eigen::*;\n";
+        for (auto& kernel : m_context->exported_kernels[prefix])
+            out << "      " << kernel << "*;\n";
+        out << "    };\n  local: *;\n};\n";
+        NNFUSION_CHECK(out.good()) << "Failed to write " << path;
+    }
+}
+
+std::vector<size_t> ShapeBucketCompiler::get_bucket_order() const
+{
+    std::vector<size_t> volume(m_buckets.size(), 0);
+    for (auto& info : m_inputs)
+        for (size_t b = 0; b < m_buckets.size(); b++)
+            volume[b] += shape_size(info.shapes[b]);
+    std::vector<size_t> order(m_buckets.size());
+    for (size_t b = 0; b < order.size(); b++)
+        order[b] = b;
+    std::stable_sort(
+        order.begin(), order.end(), [&](size_t x, size_t y) { return volume[x] < volume[y]; });
+    return order;
+}
+
+void ShapeBucketCompiler::emit_dispatcher()
+{
+    auto order = get_bucket_order();
+    std::vector<TensorInfo> tensors(m_inputs);
+    tensors.insert(tensors.end(), m_outputs.begin(), m_outputs.end());
+    size_t max_rank = 1;
+    for (auto& info : tensors)
+        max_rank = std::max(max_rank, info.axis_dims.size());
+
+    std::vector<std::string> params;
+    for (auto& info : m_inputs)
+        params.push_back(info.type + "* " + info.name);
+    for (auto& info : m_outputs)
+        params.push_back(info.type + "* " + info.name);
+
+    // nnfusion_rt.h
+    LanguageUnit header("dispatcher_header");
+    header << "#pragma once\n";
+    header << kernels::declaration::typedef_int->get_code() << "\n";
+    header << "#include <stdint.h>\n\n";
+    header << "// dims holds the values of (" << join(m_dims) << "), returns the rank of the "
+           << "bucket which ran (0 is the smallest) or -1 when none fits.\n";
+    header << "extern \"C\" int kernel_entry(const int64_t* dims, " << join(params, ", ")
+           << ");\n";
+    header << "extern \"C\" void cpu_init();\n";
+    header << "extern \"C\" void cpu_free();\n";
+
+    // nnfusion_rt.cpp
+    LanguageUnit source("dispatcher_source");
+    source << "#include <cstdio>\n#include <cstdlib>\n#include <cstring>\n#include <fcntl.h>\n";
+    source << "#include <sys/mman.h>\n#include <unistd.h>\n#include \"nnfusion_rt.h\"\n\n";
+    for (size_t b = 0; b < m_buckets.size(); b++)
+    {
+        std::string prefix = bucket_name(b) + "_";
+        source << "extern \"C\" void " << prefix << "cpu_init();\n";
+        source << "extern \"C\" int " << prefix << "kernel_entry(" << join(params, ", ")
+               << ");\n";
+        source << "extern \"C\" void " << prefix << "cpu_free();\n";
+        source << "extern \"C\" void* " << prefix << "shared_resources["
+               << codegen::ShapeBucketContext::NumSharedResources << "];\n";
+    }
+    source << "\nnamespace\n";
+    source.block_begin();
+    for (size_t b = 0; b < m_buckets.size(); b++)
+    {
+        std::vector<std::string> args;
+        for (size_t t = 0; t < tensors.size(); t++)
+            args.push_back("(" + tensors[t].type + "*)tensors[" + std::to_string(t) + "]");
+        source << "int " << bucket_name(b) << "_call(void** tensors)\n";
+        source.block_begin();
+        source << "return " << bucket_name(b) << "_kernel_entry(" << join(args, ", ") << ");\n";
+        source.block_end();
+    }
+
+    std::vector<std::string> bucket_dims, bucket_calls, bucket_shapes, bucket_inits, bucket_frees,
+        bucket_shared;
+    for (auto b : order)
+    {
+        bucket_shared.push_back(bucket_name(b) + "_shared_resources");
+        std::vector<size_t> dims;
+        for (auto& dim : m_dims)
+            dims.push_back(m_buckets[b].at(dim));
+        bucket_dims.push_back(braced(dims));
+        bucket_calls.push_back(bucket_name(b) + "_call");
+        bucket_inits.push_back(bucket_name(b) + "_cpu_init");
+        bucket_frees.push_back(bucket_name(b) + "_cpu_free");
+        std::vector<std::string> shapes;
+        for (auto& info : tensors)
+        {
+            std::vector<size_t> shape(info.shapes[b].begin(), info.shapes[b].end());
+            shape.resize(max_rank, 1);
+            shapes.push_back(braced(shape));
+        }
+        bucket_shapes.push_back(braced(shapes));
+    }
+    std::vector<size_t> ranks, element_sizes;
+    std::vector<std::string> axis_dims;
+    for (auto& info : tensors)
+    {
+        ranks.push_back(info.axis_dims.size());
+        element_sizes.push_back(info.element_size);
+        std::vector<int> axes(info.axis_dims);
+        axes.resize(max_rank, -1);
+        axis_dims.push_back(braced(axes));
+    }
+
+    // Tables list the buckets from the smallest, shapes are padded with 1 up to max_rank.
+    source << op::create_code_from_template(
+        R"(const int num_dims = @num_dims@;
+const int num_buckets = @num_buckets@;
+const int num_inputs = @num_inputs@;
+const int num_tensors = @num_tensors@;
+const int max_rank = @max_rank@;
+const int64_t bucket_dims[num_buckets][num_dims] = @bucket_dims@;
+int (*const bucket_calls[num_buckets])(void**) = @bucket_calls@;
+void (*const bucket_inits[num_buckets])() = @bucket_inits@;
+void (*const bucket_frees[num_buckets])() = @bucket_frees@;
+// see ShapeBucketContext
+const int num_shared_resources = @num_shared_resources@;
+void** const bucket_shared[num_buckets] = @bucket_shared@;
+const size_t weights_size = @weights_size@;
+char* weights = nullptr;
+const int64_t bucket_shapes[num_buckets][num_tensors][max_rank] = @bucket_shapes@;
+const int tensor_ranks[num_tensors] = @ranks@;
+const size_t element_sizes[num_tensors] = @element_sizes@;
+// the dim sizing each axis, -1 for static axes
+const int axis_dims[num_tensors][max_rank] = @axis_dims@;
+char* staging[num_buckets][num_tensors];
+
+// Map the weight file shared by all the buckets.
+void* map_weights()
+{
+    if (weights_size == 0)
+        return nullptr;
+    int weights_fd = open("@weights_path@", O_RDONLY);
+    if (weights_fd < 0)
+    {
+        printf("Load @weights_path@ failed.\n");
+        exit(1);
+    }
+    weights = (char*)mmap(NULL, weights_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, weights_fd, 0);
+    close(weights_fd);
+    if (weights == MAP_FAILED)
+    {
+        printf("Map @weights_path@ failed.\n");
+        exit(1);
+    }
+    return weights;
+}
+
+size_t volume(const int64_t* shape)
+{
+    size_t size = 1;
+    for (int a = 0; a < max_rank; a++)
+        size *= shape[a];
+    return size;
+}
+
+// Copy the leading box of a tensor of src_shape into a tensor of dst_shape.
+void copy_box(char* dst,
+              const char* src,
+              const int64_t* dst_shape,
+              const int64_t* src_shape,
+              const int64_t* box,
+              int rank,
+              size_t element_size)
+{
+    if (rank == 0)
+    {
+        memcpy(dst, src, element_size);
+        return;
+    }
+    if (rank == 1)
+    {
+        memcpy(dst, src, box[0] * element_size);
+        return;
+    }
+    size_t dst_stride = element_size, src_stride = element_size;
+    for (int a = 1; a < rank; a++)
+    {
+        dst_stride *= dst_shape[a];
+        src_stride *= src_shape[a];
+    }
+    for (int64_t i = 0; i < box[0]; i++)
+        copy_box(dst + i * dst_stride,
+                 src + i * src_stride,
+                 dst_shape + 1,
+                 src_shape + 1,
+                 box + 1,
+                 rank - 1,
+                 element_size);
+}
+
+int run_bucket(int b, const int64_t* dims, void** tensors)
+{
+    bool exact = true;
+    for (int d = 0; d < num_dims; d++)
+        exact &= dims[d] == bucket_dims[b][d];
+    if (exact)
+        return bucket_calls[b](tensors) == 0 ? b : -1;
+
+    void* padded[num_tensors];
+    int64_t shapes[num_tensors][max_rank];
+    for (int t = 0; t < num_tensors; t++)
+    {
+        for (int a = 0; a < max_rank; a++)
+            shapes[t][a] = axis_dims[t][a] < 0 ? bucket_shapes[b][t][a] : dims[axis_dims[t][a]];
+        padded[t] = staging[b][t];
+        if (t < num_inputs)
+        {
+            memset(staging[b][t], 0, volume(bucket_shapes[b][t]) * element_sizes[t]);
+            copy_box(staging[b][t],
+                     (const char*)tensors[t],
+                     bucket_shapes[b][t],
+                     shapes[t],
+                     shapes[t],
+                     tensor_ranks[t],
+                     element_sizes[t]);
+        }
+    }
+    if (bucket_calls[b](padded) != 0)
+        return -1;
+    for (int t = num_inputs; t < num_tensors; t++)
+        copy_box((char*)tensors[t],
+                 staging[b][t],
+                 shapes[t],
+                 bucket_shapes[b][t],
+                 shapes[t],
+                 tensor_ranks[t],
+                 element_sizes[t]);
+    return b;
+}
+)",
+        {{"num_dims", m_dims.size()},
+         {"num_buckets", m_buckets.size()},
+         {"num_inputs", m_inputs.size()},
+         {"num_tensors", tensors.size()},
+         {"max_rank", max_rank},
+         {"bucket_dims", braced(bucket_dims)},
+         {"bucket_calls", braced(bucket_calls)},
+         {"bucket_inits", braced(bucket_inits)},
+         {"bucket_frees", braced(bucket_frees)},
+         {"num_shared_resources", int(codegen::ShapeBucketContext::NumSharedResources)},
+         {"bucket_shared", braced(bucket_shared)},
+         {"weights_size", kernels::WeightPack::Global()->size()},
+         {"weights_path", kernels::WeightPack::folder + kernels::WeightPack::blob_name},
+         {"bucket_shapes", braced(bucket_shapes)},
+         {"ranks", braced(ranks)},
+         {"element_sizes", braced(element_sizes)},
+         {"axis_dims", braced(axis_dims)}});
+    source.block_end();
+
+    std::vector<std::string> tensor_names;
+    for (auto& info : tensors)
+        tensor_names.push_back("(void*)" + info.name);
+    source << R"(
+extern "C" void cpu_init()
+{
+    // Every bucket passes the thread pools it created on to the next ones.
+    void* shared_resources[num_shared_resources] = {map_weights()};
+    for (int b = 0; b < num_buckets; b++)
+    {
+        memcpy(bucket_shared[b], shared_resources, sizeof(shared_resources));
+        bucket_inits[b]();
+        memcpy(shared_resources, bucket_shared[b], sizeof(shared_resources));
+        for (int t = 0; t < num_tensors; t++)
+            staging[b][t] = (char*)malloc(volume(bucket_shapes[b][t]) * element_sizes[t]);
+    }
+}
+
+extern "C" void cpu_free()
+{
+    // in reverse, the bucket which created a thread pool deletes it last
+    for (int b = num_buckets - 1; b >= 0; b--)
+    {
+        bucket_frees[b]();
+        for (int t = 0; t < num_tensors; t++)
+            free(staging[b][t]);
+    }
+    if (weights)
+        munmap(weights, weights_size);
+}
+)";
+    source << "\nextern \"C\" int kernel_entry(const int64_t* dims, " << join(params, ", ")
+           << ")\n";
+    source.block_begin();
+    source << "void* tensors[num_tensors] = " << braced(tensor_names) << ";\n";
+    source << R"(// buckets are sorted by size, the first one fitting is the smallest
+for (int b = 0; b < num_buckets; b++)
+{
+    bool fits = true;
+    for (int d = 0; d < num_dims; d++)
+        fits &= dims[d] <= bucket_dims[b][d];
+    if (fits)
+        return run_bucket(b, dims, tensors);
+}
+return -1;
+)";
+    source.block_end();
+
+    // main_test.cpp runs every bucket at its own shape.
+    LanguageUnit main_test("dispatcher_main");
+    main_test << "#include <chrono>\n#include <stdio.h>\n#include <stdlib.h>\n";
+    main_test << "#include \"nnfusion_rt.h\"\n\n";
+    main_test << "int main(void)\n";
+    main_test.block_begin();
+    main_test << "cpu_init();\n";
+    std::vector<std::string> args;
+    for (size_t t = 0; t < tensors.size(); t++)
+    {
+        auto& info = tensors[t];
+        size_t size = 0;
+        for (auto& shape : info.shapes)
+            size = std::max(size, shape_size(shape));
+        std::string var = "tensor" + std::to_string(t);
+        main_test << info.type << "* " << var << " = (" << info.type << "*)malloc(sizeof("
+                  << info.type << ") * " << size << ");\n";
+        if (t < m_inputs.size())
+            main_test << "for (int i = 0; i < " << size << "; ++i) " << var << "[i] = 1;\n";
+        args.push_back(var);
+    }
+    for (auto b : order)
+    {
+        std::vector<size_t> dims;
+        for (auto& dim : m_dims)
+            dims.push_back(m_buckets[b].at(dim));
+        main_test.block_begin();
+        main_test << "int64_t dims[] = " << braced(dims) << ";\n";
+        main_test << "for (int i = 0; i < 5; i++)\n";
+        main_test << "    kernel_entry(dims, " << join(args, ", ") << ");\n";
+        main_test << "auto t_start = std::chrono::high_resolution_clock::now();\n";
+        main_test << "for (int i = 0; i < 100; i++)\n";
+        main_test << "    kernel_entry(dims, " << join(args, ", ") << ");\n";
+        main_test << "auto t_end = std::chrono::high_resolution_clock::now();\n";
+        main_test << "std::chrono::duration<double, std::milli> fp_ms = t_end - t_start;\n";
+        main_test << "printf(\"" << bucket_name(b) << " (" << join(m_dims) << " = "
+                  << join(dims) << "): %f ms\\n\", fp_ms.count() / 100);\n";
+        main_test.block_end();
+    }
+    for (auto& arg : args)
+        main_test << "free(" << arg << ");\n";
+    main_test << "cpu_free();\n";
+    main_test << "return 0;\n";
+    main_test.block_end();
+
+    LanguageUnit cmake("dispatcher_cmake");
+    cmake << R"(project(main_test)
+cmake_minimum_required(VERSION 3.5)
+
+set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fPIC -std=gnu++11 -O3 -march=native -pthread")
+)";
+    for (size_t b = 0; b < m_buckets.size(); b++)
+        cmake << "add_subdirectory(" << bucket_name(b) << ")\n";
+    cmake << "\nadd_library(nnfusion_cpu_rt nnfusion_rt.cpp)\n";
+    cmake << "target_link_libraries(nnfusion_cpu_rt";
+    for (size_t b = 0; b < m_buckets.size(); b++)
+        cmake << " nnfusion_" << bucket_name(b) << "_cpu_rt";
+    cmake << ")\n\nadd_executable(main_test main_test.cpp)\n";
+    cmake << "target_link_libraries(main_test nnfusion_cpu_rt)\n";
+
+    NNFUSION_CHECK(nnfusion::codegen::create_folder(m_codegen_folder));
+    std::vector<std::pair<std::string, LanguageUnit*>> files = {{"nnfusion_rt.h", &header},
+                                                               {"nnfusion_rt.cpp", &source},
+                                                               {"main_test.cpp", &main_test},
+                                                               {"CMakeLists.txt", &cmake}};
+    for (auto& file : files)
+    {
+        std::ofstream out(m_codegen_folder + file.first);
+        out << file.second->get_code();
+        NNFUSION_CHECK(out.good()) << "Failed to write " << m_codegen_folder + file.first;
+    }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Compile one model for several values of its symbolic dims into a single CPU runtime
+ */
+#pragma once
+
+#include "nnfusion/common/common.hpp"
+#include "nnfusion/core/graph/graph.hpp"
+
+DECLARE_string(fshape_buckets);
+
+namespace nnfusion
+{
+    namespace codegen
+    {
+        struct ShapeBucketContext;
+    }
+
+    namespace engine
+    {
+        ///\brief Every bucket (one value per symbolic dim) is compiled by the CPU engine into
+        // <codegen_folder>/bucket_<i>/ as a shared library exporting bucket_<i>_-prefixed entry
+        // points. All buckets pack their constants into one weight file which the dispatcher
+        // maps once, share their thread pools, and call the kernels an earlier bucket defines
+        // with the same code from the library of that bucket. The project in <codegen_folder>
+        // links them behind a dispatcher:
+        //     int kernel_entry(const int64_t* dims, inputs..., outputs...)
+        // dims holds the values of the dims which differ between buckets. The smallest bucket
+        // fitting dims runs, inputs are zero padded to its shapes and outputs are cut back.
+        // Graphs reducing or normalizing along a padded axis are rejected.
+        class ShapeBucketCompiler
+        {
+        public:
+            using Bucket = std::unordered_map<std::string, size_t>;
+            using GraphLoader = std::function<graph::Graph::Pointer(const Bucket&)>;
+
+            struct TensorInfo
+            {
+                std::string name;
+                std::string type;
+                size_t element_size;
+                // shape in each bucket
+                std::vector<nnfusion::Shape> shapes;
+                // index of the dynamic dim sizing each axis, -1 for static axes
+                std::vector<int> axis_dims;
+            };
+
+            ShapeBucketCompiler(const std::vector<Bucket>& buckets,
+                                const std::string& codegen_folder = "./nnfusion_rt/cpu_codegen/");
+
+            bool run(const GraphLoader& load);
+
+            // The dims whose values differ between buckets, sorted by name.
+            static std::vector<std::string> get_dynamic_dims(const std::vector<Bucket>& buckets);
+            // An axis is dynamic when its size changes between buckets, it must then follow
+            // exactly one dynamic dim.
+            static std::vector<int> infer_axis_dims(const std::vector<nnfusion::Shape>& shapes,
+                                                    const std::vector<Bucket>& buckets,
+                                                    const std::vector<std::string>& dims);
+            // Fail when a node of the graphs reduces or normalizes (e.g. Sum, Max, Softmax,
+            // LayerNorm) over an axis whose size changes between buckets, zero padding would
+            // change its result. graphs holds the graph of every bucket.
+            static void check_padding(const std::vector<graph::Graph::Pointer>& graphs);
+
+        private:
+            void collect_signature(graph::Graph::Pointer graph);
+            // Buckets sorted by the total size of their inputs.
+            std::vector<size_t> get_bucket_order() const;
+            void emit_dispatcher();
+            // The version script of every bucket: its entry points, the kernels other buckets
+            // call and the thread pool code, which all buckets then bind to one copy of.
+            void emit_exports();
+
+            std::vector<Bucket> m_buckets;
+            std::vector<std::string> m_dims;
+            std::string m_codegen_folder;
+            std::vector<TensorInfo> m_inputs;
+            std::vector<TensorInfo> m_outputs;
+            std::shared_ptr<codegen::ShapeBucketContext> m_context;
+        };
+    } // namespace engine
+} // namespace nnfusion
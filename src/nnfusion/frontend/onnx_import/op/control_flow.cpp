@@ -0,0 +1,210 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "control_flow.hpp"
+#include "../util/graph_convert.hpp"
+#include "../util/util.hpp"
+
+namespace nnfusion
+{
+    namespace frontend
+    {
+        namespace onnx_import
+        {
+            namespace
+            {
+                // The graph attribute itself rather than the copy Node gives, the converter of
+                // the body keeps pointers into it.
+                const onnx::GraphProto& get_body_proto(const onnx::NodeProto& node_proto,
+                                                       const std::string& name)
+                {
+                    for (const auto& attribute : node_proto.attribute())
+                    {
+                        if (attribute.name() == name &&
+                            attribute.type() == onnx::AttributeProto_AttributeType_GRAPH)
+                            return attribute.g();
+                    }
+                    NNFUSION_CHECK_FAIL() << node_proto.op_type() << " " << node_proto.name()
+                                          << " has no graph attribute " << name;
+                    return node_proto.attribute(0).g();
+                }
+
+                std::shared_ptr<op::Constant> get_constant(const GNodeIndex& value)
+                {
+                    if (value.empty() || !value.gnode->is_constant())
+                        return nullptr;
+                    return std::dynamic_pointer_cast<op::Constant>(value.gnode->get_op_ptr());
+                }
+
+                bool is_true(const GNodeIndex& value)
+                {
+                    auto constant = get_constant(value);
+                    return constant && shape_size(value.get_shape()) == 1 &&
+                           constant->get_vector<char>()[0] != 0;
+                }
+
+                NamedNodeVector get_outputs(const onnx::NodeProto& node_proto,
+                                            std::shared_ptr<graph::GNode> gnode)
+                {
+                    NamedNodeVector ret;
+                    for (size_t i = 0; i < static_cast<size_t>(node_proto.output_size()); i++)
+                    {
+                        if (!node_proto.output(i).empty())
+                            ret.emplace_back(node_proto.output(i), gnode, i);
+                    }
+                    return ret;
+                }
+
+                NamedNodeVector TranslateIfOp(const onnx::NodeProto& node_proto,
+                                              const NodeMap& all_ng_nodes,
+                                              std::shared_ptr<nnfusion::graph::Graph> m_graph,
+                                              GraphConvert& graph_convert)
+                {
+                    GNodeIndexVector inputs{GetInputIndex(all_ng_nodes, node_proto, 0)};
+                    auto then_branch = graph_convert.convert_body(
+                        get_body_proto(node_proto, "then_branch"), {}, inputs);
+                    auto else_branch = graph_convert.convert_body(
+                        get_body_proto(node_proto, "else_branch"), {}, inputs);
+
+                    auto if_op = std::make_shared<op::If>(then_branch, else_branch);
+                    if_op->set_name(node_proto.output(0));
+                    auto if_gnode =
+                        m_graph->add_node_and_edge(if_op, inputs, node_proto.output_size());
+                    return get_outputs(node_proto, if_gnode);
+                }
+
+                NamedNodeVector TranslateLoopOp(const onnx::NodeProto& node_proto,
+                                                const NodeMap& all_ng_nodes,
+                                                std::shared_ptr<nnfusion::graph::Graph> m_graph,
+                                                GraphConvert& graph_convert)
+                {
+                    auto input_indexes = GetAllInputIndex(all_ng_nodes, node_proto);
+                    NNFUSION_CHECK(input_indexes.size() >= 2)
+                        << "Loop takes the trip count and the condition, even if empty.";
+                    auto trip_count = input_indexes[0];
+                    auto condition = input_indexes[1];
+
+                    GNodeIndexVector inputs;
+                    int64_t max_trip_count = -1;
+                    if (!trip_count.empty())
+                    {
+                        inputs.push_back(trip_count);
+                        if (auto constant = get_constant(trip_count))
+                            max_trip_count = constant->get_vector<int64_t>().at(0);
+                    }
+                    if (!condition.empty())
+                        inputs.push_back(condition);
+
+                    std::vector<std::pair<element::Type, Shape>> body_types{
+                        {element::i64, Shape{}}, {element::boolean, Shape{}}};
+                    for (size_t i = 2; i < input_indexes.size(); i++)
+                    {
+                        NNFUSION_CHECK(!input_indexes[i].empty())
+                            << "Loop-carried value " << i - 2 << " of " << node_proto.name()
+                            << " has no initial value.";
+                        inputs.push_back(input_indexes[i]);
+                        body_types.emplace_back(input_indexes[i].get_element_type(),
+                                                input_indexes[i].get_shape());
+                    }
+
+                    auto body = graph_convert.convert_body(
+                        get_body_proto(node_proto, "body"), body_types, inputs);
+
+                    size_t carried = input_indexes.size() - 2;
+                    if (body.outputs.size() > 1 + carried)
+                    {
+                        // The scan outputs stack the slices of all iterations, so an early exit
+                        // would leave them shorter than their static shape.
+                        NNFUSION_CHECK(max_trip_count >= 0)
+                            << "Loop " << node_proto.name()
+                            << " has scan outputs, which need a constant trip count.";
+                        auto body_condition = body.outputs[0]->get_in_edge(0)->get_src();
+                        NNFUSION_CHECK(condition.empty() ||
+                                       (is_true(condition) &&
+                                        (body_condition == body.inputs[1] ||
+                                         is_true(GNodeIndex{body_condition}))))
+                            << "Loop " << node_proto.name()
+                            << " has scan outputs, which need it to run all iterations.";
+                    }
+
+                    auto loop_op = std::make_shared<op::Loop>(
+                        body, !trip_count.empty(), !condition.empty(), max_trip_count);
+                    loop_op->set_name(node_proto.output(0));
+                    auto loop_gnode =
+                        m_graph->add_node_and_edge(loop_op, inputs, node_proto.output_size());
+                    return get_outputs(node_proto, loop_gnode);
+                }
+
+                NamedNodeVector TranslateScanOp(const onnx::NodeProto& node_proto,
+                                                const NodeMap& all_ng_nodes,
+                                                std::shared_ptr<nnfusion::graph::Graph> m_graph,
+                                                GraphConvert& graph_convert)
+                {
+                    NNFUSION_CHECK(graph_convert.get_domain_version("") >= 9)
+                        << "Scan of opset 8, with sequence lengths and a batch axis, is not "
+                           "supported.";
+                    auto inputs = GetAllInputIndex(all_ng_nodes, node_proto);
+                    Node node(node_proto);
+                    size_t scan_inputs = node.get_attribute_value<int64_t>("num_scan_inputs");
+                    NNFUSION_CHECK(scan_inputs > 0 && scan_inputs <= inputs.size());
+                    size_t states = inputs.size() - scan_inputs;
+                    size_t scan_outputs = node_proto.output_size() - states;
+
+                    for (auto axes : {"scan_input_axes", "scan_output_axes"})
+                    {
+                        auto axis_values = node.get_attribute_value<std::vector<int64_t>>(
+                            axes, std::vector<int64_t>());
+                        for (auto axis : axis_values)
+                            NNFUSION_CHECK(axis == 0)
+                                << "Scan " << node_proto.name() << " only supports axis 0.";
+                    }
+                    auto get_reverse = [&node](const std::string& name, size_t size) {
+                        auto directions = node.get_attribute_value<std::vector<int64_t>>(
+                            name, std::vector<int64_t>(size, 0));
+                        NNFUSION_CHECK(directions.size() == size);
+                        return std::vector<bool>(directions.begin(), directions.end());
+                    };
+                    auto reverse_inputs = get_reverse("scan_input_directions", scan_inputs);
+                    auto reverse_outputs = get_reverse("scan_output_directions", scan_outputs);
+
+                    std::vector<std::pair<element::Type, Shape>> body_types;
+                    for (size_t i = 0; i < inputs.size(); i++)
+                    {
+                        Shape shape = inputs[i].get_shape();
+                        if (i >= states)
+                        {
+                            NNFUSION_CHECK(!shape.empty())
+                                << "Scan input " << i - states << " has no axis to scan.";
+                            shape.erase(shape.begin());
+                        }
+                        body_types.emplace_back(inputs[i].get_element_type(), shape);
+                    }
+
+                    auto body = graph_convert.convert_body(
+                        get_body_proto(node_proto, "body"), body_types, inputs);
+
+                    auto scan_op = std::make_shared<op::Scan>(
+                        body, scan_inputs, reverse_inputs, reverse_outputs);
+                    scan_op->set_name(node_proto.output(0));
+                    auto scan_gnode =
+                        m_graph->add_node_and_edge(scan_op, inputs, node_proto.output_size());
+                    return get_outputs(node_proto, scan_gnode);
+                }
+            } // namespace
+
+            NamedNodeVector TranslateControlFlowOp(const onnx::NodeProto& node_proto,
+                                                   const NodeMap& all_ng_nodes,
+                                                   std::shared_ptr<nnfusion::graph::Graph> m_graph,
+                                                   GraphConvert& graph_convert)
+            {
+                if (node_proto.op_type() == "If")
+                    return TranslateIfOp(node_proto, all_ng_nodes, m_graph, graph_convert);
+                if (node_proto.op_type() == "Loop")
+                    return TranslateLoopOp(node_proto, all_ng_nodes, m_graph, graph_convert);
+                NNFUSION_CHECK(node_proto.op_type() == "Scan") << "Not a control-flow op: "
+                                                               << node_proto.op_type();
+                return TranslateScanOp(node_proto, all_ng_nodes, m_graph, graph_convert);
+            }
+        } //namespace onnx_import
+    }     // namespace frontend
+} // namespace nnfusion
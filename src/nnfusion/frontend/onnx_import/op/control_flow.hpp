@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "core/node.hpp"
+#include "nnfusion/frontend/onnx_import/onnx_base.hpp"
+
+namespace nnfusion
+{
+    namespace frontend
+    {
+        namespace onnx_import
+        {
+            class GraphConvert;
+
+            /// \brief Translate If, Loop and Scan, whose bodies graph_convert converts to graphs
+            /// of their own. Unlike other translators it needs the converter, so it is not in
+            /// the operator sets but called by GraphConvert::convert_node.
+            NamedNodeVector TranslateControlFlowOp(const onnx::NodeProto& node_proto,
+                                                   const NodeMap& all_ng_nodes,
+                                                   std::shared_ptr<nnfusion::graph::Graph> m_graph,
+                                                   GraphConvert& graph_convert);
+        } //namespace onnx_import
+    }     // namespace frontend
+} // namespace nnfusion
@@ -20,13 +20,20 @@
 //----------------------------------------------------------------------------------------------
 
 #include "graph_convert.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <type_traits>
 #include "nnfusion/core/operators/generic_op/generic_op.hpp"
+#include "op/control_flow.hpp"
 #include "op/custom_op.hpp"
 #include "ops_bridge.hpp"
 
 DECLARE_bool(ftraining_mode);
+DEFINE_bool(fonnx_mmap_external_data,
+            true,
+            "Map the external data files of ONNX initializers instead of reading them to memory.");
 
 namespace nnfusion
 {
@@ -38,13 +45,61 @@ namespace nnfusion
             {
                 static ConvertFunc EMPTY_CONVERT_FUNC = nullptr;
 
+                std::vector<std::string> get_node_inputs(const onnx::NodeProto& node);
+
+                // Values which the nodes of a graph read from the graphs enclosing it, appended
+                // to values in order of first use.
+                void collect_outer_values(const onnx::GraphProto& graph,
+                                          std::vector<std::string>& values)
+                {
+                    std::unordered_set<std::string> defined{""};
+                    for (const auto& tensor : graph.initializer())
+                        defined.insert(tensor.name());
+                    for (const auto& input : graph.input())
+                        defined.insert(input.name());
+                    for (const auto& node : graph.node())
+                        defined.insert(std::begin(node.output()), std::end(node.output()));
+                    for (const auto& node : graph.node())
+                    {
+                        for (const auto& value : get_node_inputs(node))
+                        {
+                            if (defined.count(value) == 0 &&
+                                std::find(values.begin(), values.end(), value) == values.end())
+                                values.push_back(value);
+                        }
+                    }
+                    // a body may pass a value of the enclosing graph through as it is
+                    for (const auto& output : graph.output())
+                    {
+                        if (defined.count(output.name()) == 0 &&
+                            std::find(values.begin(), values.end(), output.name()) == values.end())
+                            values.push_back(output.name());
+                    }
+                }
+
+                // The inputs of a node, and the values of the enclosing graph which the bodies
+                // of a control-flow node read.
+                std::vector<std::string> get_node_inputs(const onnx::NodeProto& node)
+                {
+                    std::vector<std::string> inputs(std::begin(node.input()),
+                                                    std::end(node.input()));
+                    for (const auto& attribute : node.attribute())
+                    {
+                        if (attribute.type() == onnx::AttributeProto_AttributeType_GRAPH)
+                            collect_outer_values(attribute.g(), inputs);
+                        for (const auto& graph : attribute.graphs())
+                            collect_outer_values(graph, inputs);
+                    }
+                    return inputs;
+                }
+
                 bool is_sorted(const std::vector<onnx::NodeProto>& unsorted_nodes,
                                const std::unordered_set<std::string>& external_values)
                 {
                     std::unordered_set<std::string> ready_values = external_values;
                     for (auto node : unsorted_nodes)
                     {
-                        for (auto value : node.input())
+                        for (auto value : get_node_inputs(node))
                         {
                             if (ready_values.find(value) == ready_values.end())
                             {
@@ -78,7 +133,7 @@ namespace nnfusion
                             << "duplicate node name: " << node_name;
                         name2node[node_name] = n;
                         int in = 0;
-                        for (auto v : n.input())
+                        for (auto v : get_node_inputs(n))
                         {
                             auto p = value2uses[v].insert(node_name);
                             if (p.second)
@@ -182,41 +237,58 @@ namespace nnfusion
                     return buffer;
                 }
 
-                void move_external_to_rawdata(onnx::TensorProto& tensor, std::string model_dir)
+                bool is_external(const onnx::TensorProto& tensor)
                 {
-                    if (tensor.has_data_location() &&
-                        tensor.data_location() ==
-                            onnx::TensorProto_DataLocation::TensorProto_DataLocation_EXTERNAL)
+                    return tensor.has_data_location() &&
+                           tensor.data_location() ==
+                               onnx::TensorProto_DataLocation::TensorProto_DataLocation_EXTERNAL;
+                }
+
+                // The file, offset and length of an external tensor, a length of 0 means up to
+                // the end of the file.
+                void get_external_data(const onnx::TensorProto& tensor,
+                                       const std::string& model_dir,
+                                       std::string& path,
+                                       size_t& offset,
+                                       size_t& length)
+                {
+                    NNFUSION_CHECK(tensor.external_data_size() >= 1)
+                        << "initializer locate at external data, but no external proto "
+                           "provided";
+                    path = "";
+                    offset = 0;
+                    length = 0;
+                    for (auto i = 0; i < tensor.external_data_size(); i++)
                     {
-                        NNFUSION_CHECK(tensor.external_data_size() >= 1)
-                            << "initializer locate at external data, but no external proto "
-                               "provided";
-                        string const_file_path = "";
-                        size_t offset = 0;
-                        size_t length = 0;
-                        for (auto i = 0; i < tensor.external_data_size(); i++)
+                        auto& kv_pair = tensor.external_data(i);
+                        if (kv_pair.key() == "location")
                         {
-                            auto& kv_pair = tensor.external_data(i);
-                            if (kv_pair.key() == "location")
-                            {
-                                const_file_path = model_dir + "/" + kv_pair.value();
-                            }
-                            else if (kv_pair.key() == "offset")
-                            {
-                                offset = std::stoul(kv_pair.value());
-                            }
-                            else if (kv_pair.key() == "length")
-                            {
-                                length = std::stoul(kv_pair.value());
-                            }
-                            else
-                            {
-                                NNFUSION_CHECK_FAIL() << "unknown external proto key: "
-                                                      << kv_pair.key();
-                            }
+                            path = model_dir + "/" + kv_pair.value();
+                        }
+                        else if (kv_pair.key() == "offset")
+                        {
+                            offset = std::stoul(kv_pair.value());
                         }
-                        NNFUSION_CHECK(const_file_path != "")
-                            << "no external data location provided";
+                        else if (kv_pair.key() == "length")
+                        {
+                            length = std::stoul(kv_pair.value());
+                        }
+                        else
+                        {
+                            NNFUSION_CHECK_FAIL() << "unknown external proto key: "
+                                                  << kv_pair.key();
+                        }
+                    }
+                    NNFUSION_CHECK(path != "") << "no external data location provided";
+                }
+
+                void move_external_to_rawdata(onnx::TensorProto& tensor, std::string model_dir)
+                {
+                    if (is_external(tensor))
+                    {
+                        string const_file_path;
+                        size_t offset, length;
+                        get_external_data(tensor, model_dir, const_file_path, offset, length);
                         string raw_data =
                             readfile_with_offset_length(const_file_path, offset, length);
                         tensor.clear_data_location();
@@ -346,40 +418,7 @@ namespace nnfusion
                     m_output_names.insert(output.name());
                 }
 
-                for (auto tensor : onnx_graph_proto->initializer())
-                {
-                    if (tensor.has_name())
-                    {
-                        move_external_to_rawdata(tensor, model_dir);
-                        if (FLAGS_ftraining_mode)
-                        {
-                            element::Type type;
-                            ONNXDataTypeToNNFusionElementType(
-                                static_cast<onnx::TensorProto_DataType>(tensor.data_type()), &type);
-                            std::shared_ptr<graph::GNode> input_gnode;
-                            auto tensor_op = std::make_shared<op::Parameter>(
-                                type,
-                                Shape(std::begin(tensor.dims()), std::end(tensor.dims())),
-                                false,
-                                true);
-                            tensor_op->set_name(tensor.name());
-                            input_gnode =
-                                m_graph->add_node_and_edge(tensor_op, graph::GNodeVector({}));
-                            m_node_map[tensor.name()] = {GNodeIndex{input_gnode}};
-                        }
-                        else
-                        {
-                            auto tensor_op = make_constant_op(
-                                static_cast<onnx::TensorProto_DataType>(tensor.data_type()),
-                                Shape(std::begin(tensor.dims()), std::end(tensor.dims())),
-                                Tensor{tensor});
-                            tensor_op->set_name(tensor.name());
-                            auto tensor_gnode =
-                                m_graph->add_node_and_edge(tensor_op, graph::GNodeVector({}));
-                            m_node_map[tensor.name()] = {GNodeIndex{tensor_gnode}};
-                        }
-                    }
-                }
+                convert_initializers();
                 // Process all ONNX graph inputs, convert them to NNFusion nodes
                 for (const auto& input_proto : onnx_graph_proto->input())
                 {
@@ -457,20 +496,176 @@ namespace nnfusion
                 //     }
                 // }
 
+                convert_nodes();
+
+                // Sort nGraph output nodes in the order of ONNX output nodes
+                std::vector<std::string> output_names;
+                for (const auto& output : onnx_graph_proto->output())
+                {
+                    output_names.push_back(output.name());
+                }
+                sort(m_graph_outputs.begin(),
+                     m_graph_outputs.end(),
+                     [&output_names](const std::shared_ptr<nnfusion::graph::GNode>& a,
+                                     const std::shared_ptr<nnfusion::graph::GNode>& b) {
+                         return std::find(output_names.begin(), output_names.end(), a->get_name()) <
+                                std::find(output_names.begin(), output_names.end(), b->get_name());
+                     });
+
+                m_graph->set_default_parameters();
+                m_graph->set_outputs(m_graph_outputs);
+
+                NNFUSION_LOG(INFO) << "convert graph done";
+            }
+
+            GraphConvert::GraphConvert(const GraphConvert& parent,
+                                       const onnx::GraphProto& graph_proto)
+                : onnx_model_proto{parent.onnx_model_proto}
+                , onnx_graph_proto(&graph_proto)
+                , m_graph(new nnfusion::graph::Graph())
+                , m_domain_convert_func_map(parent.m_domain_convert_func_map)
+                , m_dim_params(parent.m_dim_params)
+                , model_dir(parent.model_dir)
+                , domain2version(parent.domain2version)
+            {
+                NNFUSION_CHECK(onnx_graph_proto->sparse_initializer_size() == 0)
+                    << "sparse_initializer not supported";
+            }
+
+            op::ControlFlowBody GraphConvert::convert_body(
+                const onnx::GraphProto& graph_proto,
+                const std::vector<std::pair<element::Type, Shape>>& input_types,
+                GNodeIndexVector& node_inputs)
+            {
+                GraphConvert child(*this, graph_proto);
+                op::ControlFlowBody body;
+                body.graph = child.m_graph;
+                child.convert_initializers();
+
+                NNFUSION_CHECK(static_cast<size_t>(graph_proto.input_size()) == input_types.size())
+                    << "Body " << graph_proto.name() << " takes " << graph_proto.input_size()
+                    << " inputs, expected " << input_types.size();
+                for (size_t i = 0; i < input_types.size(); i++)
+                {
+                    // the types of the op are authoritative, the shapes of bodies are often left
+                    // out by exporters
+                    auto input_op = std::make_shared<op::Parameter>(input_types[i].first,
+                                                                    input_types[i].second);
+                    input_op->set_name(graph_proto.input(i).name());
+                    auto input_gnode =
+                        child.m_graph->add_node_and_edge(input_op, graph::GNodeVector({}));
+                    child.m_node_map[graph_proto.input(i).name()] = {GNodeIndex{input_gnode}};
+                    body.inputs.push_back(input_gnode);
+                }
+
+                std::vector<std::string> outer_values;
+                collect_outer_values(graph_proto, outer_values);
+                for (const auto& name : outer_values)
+                {
+                    if (child.m_node_map.count(name))
+                        continue;
+                    auto it = m_node_map.find(name);
+                    NNFUSION_CHECK(it != m_node_map.end() && it->second.size() == 1)
+                        << "Body " << graph_proto.name() << " reads unknown value " << name;
+                    auto& value = it->second[0];
+                    auto capture_op = std::make_shared<op::Parameter>(value.get_element_type(),
+                                                                      value.get_shape());
+                    capture_op->set_name(name);
+                    auto capture_gnode =
+                        child.m_graph->add_node_and_edge(capture_op, graph::GNodeVector({}));
+                    child.m_node_map[name] = {GNodeIndex{capture_gnode}};
+
+                    auto input = std::find(node_inputs.begin(), node_inputs.end(), value);
+                    if (input == node_inputs.end())
+                        input = node_inputs.insert(node_inputs.end(), value);
+                    body.captures.emplace_back(capture_gnode, input - node_inputs.begin());
+                }
+
+                child.convert_nodes();
+
+                for (const auto& output : graph_proto.output())
+                {
+                    auto it = child.m_node_map.find(output.name());
+                    NNFUSION_CHECK(it != child.m_node_map.end())
+                        << "Body " << graph_proto.name() << " does not produce " << output.name();
+                    auto result_op = std::make_shared<op::Result>();
+                    result_op->set_needs_copy_to_host(false);
+                    auto result_gnode = child.m_graph->add_node_and_edge(
+                        result_op, GNodeIndexVector{it->second.at(0)});
+                    body.outputs.push_back(result_gnode);
+                }
+                child.m_graph->set_default_parameters();
+                child.m_graph->set_outputs(body.outputs);
+                return body;
+            }
+
+            void GraphConvert::convert_initializers()
+            {
+                // Initializers are not copied out of the proto, and external ones are only read
+                // if they cannot be mapped, so that weights are not held in memory several times.
+                for (const auto& tensor : onnx_graph_proto->initializer())
+                {
+                    if (tensor.has_name())
+                    {
+                        if (FLAGS_ftraining_mode)
+                        {
+                            element::Type type;
+                            ONNXDataTypeToNNFusionElementType(
+                                static_cast<onnx::TensorProto_DataType>(tensor.data_type()), &type);
+                            std::shared_ptr<graph::GNode> input_gnode;
+                            auto tensor_op = std::make_shared<op::Parameter>(
+                                type,
+                                Shape(std::begin(tensor.dims()), std::end(tensor.dims())),
+                                false,
+                                true);
+                            tensor_op->set_name(tensor.name());
+                            input_gnode =
+                                m_graph->add_node_and_edge(tensor_op, graph::GNodeVector({}));
+                            m_node_map[tensor.name()] = {GNodeIndex{input_gnode}};
+                        }
+                        else
+                        {
+                            std::shared_ptr<op::Constant> tensor_op;
+                            if (is_external(tensor) && FLAGS_fonnx_mmap_external_data)
+                            {
+                                tensor_op = map_external_constant(tensor);
+                            }
+                            if (!tensor_op)
+                            {
+                                onnx::TensorProto loaded;
+                                const onnx::TensorProto* data = &tensor;
+                                if (is_external(tensor))
+                                {
+                                    loaded.CopyFrom(tensor);
+                                    move_external_to_rawdata(loaded, model_dir);
+                                    data = &loaded;
+                                }
+                                tensor_op = make_constant_op(
+                                    static_cast<onnx::TensorProto_DataType>(tensor.data_type()),
+                                    Shape(std::begin(tensor.dims()), std::end(tensor.dims())),
+                                    Tensor{*data});
+                            }
+                            tensor_op->set_name(tensor.name());
+                            auto tensor_gnode =
+                                m_graph->add_node_and_edge(tensor_op, graph::GNodeVector({}));
+                            m_node_map[tensor.name()] = {GNodeIndex{tensor_gnode}};
+                        }
+                    }
+                }
+                m_mapped_files.clear();
+            }
+
+            void GraphConvert::convert_nodes()
+            {
                 // Process ONNX graph nodes, convert to nGraph nodes
                 // sorted to avoid non-stardard model
                 std::vector<onnx::NodeProto> onnx_nodes(std::begin(onnx_graph_proto->node()),
                                                         std::end(onnx_graph_proto->node()));
-                std::unordered_set<std::string> external_values{
-                    ""}; // values provided by initializers/params, empty string means option input
-                std::transform(std::begin(onnx_graph_proto->initializer()),
-                               std::end(onnx_graph_proto->initializer()),
-                               std::inserter(external_values, external_values.begin()),
-                               [](onnx::TensorProto t) -> std::string { return t.name(); });
-                std::transform(std::begin(onnx_graph_proto->input()),
-                               std::end(onnx_graph_proto->input()),
-                               std::inserter(external_values, external_values.begin()),
-                               [](onnx::ValueInfoProto v) -> std::string { return v.name(); });
+                // values provided by initializers/params/captures, empty string means option
+                // input
+                std::unordered_set<std::string> external_values{""};
+                for (const auto& value : m_node_map)
+                    external_values.insert(value.first);
                 if (!is_sorted(onnx_nodes, external_values))
                 {
                     NNFUSION_LOG(NNFUSION_WARNING) << "Resorting ONNX nodes...";
@@ -493,25 +688,6 @@ namespace nnfusion
                         }
                     }
                 }
-
-                // Sort nGraph output nodes in the order of ONNX output nodes
-                std::vector<std::string> output_names;
-                for (const auto& output : onnx_graph_proto->output())
-                {
-                    output_names.push_back(output.name());
-                }
-                sort(m_graph_outputs.begin(),
-                     m_graph_outputs.end(),
-                     [&output_names](const std::shared_ptr<nnfusion::graph::GNode>& a,
-                                     const std::shared_ptr<nnfusion::graph::GNode>& b) {
-                         return std::find(output_names.begin(), output_names.end(), a->get_name()) <
-                                std::find(output_names.begin(), output_names.end(), b->get_name());
-                     });
-
-                m_graph->set_default_parameters();
-                m_graph->set_outputs(m_graph_outputs);
-
-                NNFUSION_LOG(INFO) << "convert graph done";
             }
 
             NamedNodeVector GraphConvert::convert_node(const onnx::NodeProto& node_proto)
@@ -520,7 +696,14 @@ namespace nnfusion
                 const auto& convert_func =
                     get_convert_func(node_proto.op_type(), node_proto.domain());
                 NamedNodeVector ret;
-                if (convert_func)
+                if ((node_proto.domain().empty() || node_proto.domain() == "ai.onnx") &&
+                    (node_proto.op_type() == "If" || node_proto.op_type() == "Loop" ||
+                     node_proto.op_type() == "Scan"))
+                {
+                    // their bodies are converted by this converter, see convert_body
+                    ret = TranslateControlFlowOp(node_proto, m_node_map, m_graph, *this);
+                }
+                else if (convert_func)
                 {
                     ret = convert_func(node_proto, m_node_map, m_graph);
                 }
@@ -563,6 +746,64 @@ namespace nnfusion
                 return (op != std::end(dm->second));
             }
 
+            std::shared_ptr<op::Constant>
+                GraphConvert::map_external_constant(const onnx::TensorProto& tensor)
+            {
+                std::string path;
+                size_t offset, length;
+                get_external_data(tensor, model_dir, path, offset, length);
+                element::Type type;
+                if (!ONNXDataTypeToNNFusionElementType(
+                        static_cast<onnx::TensorProto_DataType>(tensor.data_type()), &type))
+                    return nullptr;
+                Shape shape(std::begin(tensor.dims()), std::end(tensor.dims()));
+                size_t size = shape_size(shape) * type.size();
+
+                auto it = m_mapped_files.find(path);
+                if (it == m_mapped_files.end())
+                {
+                    MappedFile file{nullptr, 0};
+                    int fd = open(path.c_str(), O_RDONLY);
+                    NNFUSION_CHECK(fd >= 0) << "path not exists: " << path;
+                    struct stat info;
+                    if (fstat(fd, &info) == 0 && info.st_size > 0)
+                    {
+                        // Private writable pages let the constants be written to without
+                        // touching the file, pages are only read in when used.
+                        void* data = mmap(nullptr,
+                                          info.st_size,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE,
+                                          fd,
+                                          0);
+                        if (data != MAP_FAILED)
+                        {
+                            size_t file_size = info.st_size;
+                            file.data = std::shared_ptr<const char>(
+                                static_cast<const char*>(data), [file_size](const char* p) {
+                                    munmap(const_cast<char*>(p), file_size);
+                                });
+                            file.size = file_size;
+                        }
+                    }
+                    close(fd);
+                    it = m_mapped_files.emplace(path, file).first;
+                }
+                auto& file = it->second;
+                if (length == 0 && offset <= file.size)
+                {
+                    length = file.size - offset;
+                }
+                if (!file.data || length != size || offset + length > file.size ||
+                    offset % type.size() != 0)
+                {
+                    return nullptr;
+                }
+                // The constant shares the ownership of the whole mapping.
+                std::shared_ptr<const void> data(file.data, file.data.get() + offset);
+                return std::make_shared<op::Constant>(type, shape, data);
+            }
+
         } // namespace onnx_import
     }     // namespace frontend
 } // namespace nnfusion
@@ -68,6 +68,21 @@ namespace nnfusion
 
                 NamedNodeVector convert_node(const onnx::NodeProto& node_proto);
 
+                /// \brief Convert a graph attribute of a control-flow node to a body of its own.
+                /// \param input_types Element types and static shapes of the formal inputs.
+                /// \param node_inputs Inputs of the node, to which the values of the enclosing
+                /// graphs that the body reads are appended, unless they are in it already. The
+                /// body binds them as captures.
+                op::ControlFlowBody convert_body(
+                    const onnx::GraphProto& graph_proto,
+                    const std::vector<std::pair<element::Type, Shape>>& input_types,
+                    GNodeIndexVector& node_inputs);
+
+                std::int64_t get_domain_version(const std::string& domain) const
+                {
+                    return domain2version.at(domain);
+                }
+
                 /// \brief Access an operator object by its type name and domain name
                 /// The function will return the operator object if it exists, or report an error
                 /// in case of domain or operator absence.
@@ -81,7 +96,28 @@ namespace nnfusion
                 /// \return `true` if the operator is available, otherwise it returns `false`.
                 bool is_operator_available(const onnx::NodeProto& node_proto) const;
 
+                /// \brief Make a Constant of an external initializer on a mapping of its file.
+                /// \return nullptr if the data cannot be used in place, e.g. is not aligned.
+                std::shared_ptr<op::Constant>
+                    map_external_constant(const onnx::TensorProto& tensor);
+
             private:
+                // Converter of a body, with the operator sets of the converter of the enclosing
+                // graph.
+                GraphConvert(const GraphConvert& parent, const onnx::GraphProto& graph_proto);
+
+                void convert_initializers();
+                // Convert the nodes in topological order, once the values they read from
+                // outside of the graph are in m_node_map.
+                void convert_nodes();
+
+                // A whole external data file mapped copy-on-write, shared by the constants in it.
+                struct MappedFile
+                {
+                    std::shared_ptr<const char> data;
+                    size_t size;
+                };
+
                 const onnx::ModelProto* onnx_model_proto;
                 const onnx::GraphProto* onnx_graph_proto;
 
@@ -99,6 +135,7 @@ namespace nnfusion
                 std::unordered_map<std::string, size_t> m_dim_params;
                 std::string model_dir;
                 std::unordered_map<std::string, std::int64_t> domain2version;
+                std::unordered_map<std::string, MappedFile> m_mapped_files;
             };
         } // namespace onnx_import
     }     // namespace frontend
@@ -108,5 +108,18 @@ namespace nnfusion
             }
             return ret;
         }
+
+        std::vector<std::unordered_map<std::string, size_t>> build_onnx_bucket_params_from_string(
+            const std::string& ss, const std::unordered_map<std::string, size_t>& base)
+        {
+            std::vector<std::unordered_map<std::string, size_t>> ret;
+            for (auto s : split_string(ss, "|"))
+            {
+                auto bucket = build_onnx_params_from_string(s);
+                bucket.insert(base.begin(), base.end());
+                ret.push_back(bucket);
+            }
+            return ret;
+        }
     } // namespace frontend
 } // namespace nnfusion
\ No newline at end of file
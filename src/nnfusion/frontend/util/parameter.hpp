@@ -26,5 +26,10 @@ namespace nnfusion
 
         std::unordered_map<std::string, size_t> build_onnx_params_from_string(const std::string&);
 
+        // Buckets separated by '|', each in the format of build_onnx_params_from_string and
+        // completed with the dims of base it does not set.
+        std::vector<std::unordered_map<std::string, size_t>> build_onnx_bucket_params_from_string(
+            const std::string&, const std::unordered_map<std::string, size_t>& base = {});
+
     } // namespace frontend
 } // namespace nnfusion
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include "nnfusion/engine/device/graphcore.hpp"
 #include "nnfusion/engine/device/hlsl.hpp"
 #include "nnfusion/engine/device/rocm.hpp"
+#include "nnfusion/engine/shape_bucket.hpp"
 
 using namespace std;
 
@@ -132,6 +133,23 @@ int main(int argc, char** argv)
     }
 #endif
 #if ONNX_FRONTEND
+    else if (format == "onnx" && !FLAGS_fshape_buckets.empty())
+    {
+        NNFUSION_CHECK(get_device_type(FLAGS_fdefault_device) == GENERIC_CPU)
+            << "Shape buckets are only supported on CPU.";
+        std::unordered_map<std::string, size_t> dim_params;
+        if (params != "##UNSET##")
+        {
+            dim_params = nnfusion::frontend::build_onnx_params_from_string(params);
+        }
+        auto buckets = nnfusion::frontend::build_onnx_bucket_params_from_string(
+            FLAGS_fshape_buckets, dim_params);
+        nnfusion::engine::ShapeBucketCompiler compiler(buckets);
+        bool ok = compiler.run([&](const std::unordered_map<std::string, size_t>& bucket) {
+            return nnfusion::frontend::load_onnx_model(model, bucket);
+        });
+        return ok ? 0 : 1;
+    }
     else if (format == "onnx")
     {
         std::unordered_map<std::string, size_t> dim_params;
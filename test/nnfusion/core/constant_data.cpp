@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the shared, copy-on-write data of Constant
+ */
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+
+TEST(nnfusion_core_constant, shared_data)
+{
+    Shape shape{4};
+    std::vector<float> values{1, 2, 3, 4};
+    auto a = make_shared<op::Constant>(element::f32, shape, values);
+    auto b = make_shared<op::Constant>(element::f32, shape, values);
+    EXPECT_NE(a->get_storage(), b->get_storage());
+    EXPECT_EQ(a->get_data_hash(), b->get_data_hash());
+    EXPECT_TRUE(a->data_equals(*b));
+
+    // A constant on the storage of another one shares its bytes until it writes them.
+    auto c = make_shared<op::Constant>(element::f32, shape, a->get_storage());
+    EXPECT_EQ(c->get_data_ptr(), a->get_data_ptr());
+    EXPECT_TRUE(a->data_equals(*c));
+    static_cast<float*>(c->get_mutable_data_ptr())[0] = 5;
+    EXPECT_NE(c->get_data_ptr(), a->get_data_ptr());
+    EXPECT_EQ(a->get_vector<float>()[0], 1);
+    EXPECT_EQ(c->get_vector<float>()[0], 5);
+    EXPECT_FALSE(a->data_equals(*c));
+    EXPECT_NE(a->get_data_hash(), c->get_data_hash());
+
+    // The only owner writes in place and hashes the new bytes.
+    const void* data = b->get_data_ptr();
+    static_cast<float*>(b->get_mutable_data_ptr())[0] = 5;
+    EXPECT_EQ(b->get_data_ptr(), data);
+    EXPECT_TRUE(b->data_equals(*c));
+    EXPECT_EQ(b->get_data_hash(), c->get_data_hash());
+
+    std::vector<float> other_values{5, 2, 3, 4};
+    auto e = make_shared<op::Constant>(element::f32, shape, other_values);
+    EXPECT_FALSE(a->data_equals(*e));
+    EXPECT_NE(a->get_data_hash(), e->get_data_hash());
+
+    // Bytes owned elsewhere are used in place.
+    auto buffer = std::make_shared<std::vector<float>>(values);
+    auto d = make_shared<op::Constant>(
+        element::f32, shape, std::shared_ptr<const void>(buffer, buffer->data()));
+    EXPECT_EQ(d->get_data_ptr(), buffer->data());
+    EXPECT_TRUE(a->data_equals(*d));
+    // and copied before they are written, e.g. when they are a read-only mapping.
+    static_cast<float*>(d->get_mutable_data_ptr())[1] = 7;
+    EXPECT_NE(d->get_data_ptr(), buffer->data());
+    EXPECT_EQ((*buffer)[1], 2);
+    EXPECT_EQ(d->get_vector<float>()[1], 7);
+}
@@ -0,0 +1,120 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the shape inference of If, Loop and Scan
+ */
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+
+namespace
+{
+    std::shared_ptr<GNode> add_parameter(op::ControlFlowBody& body,
+                                         const element::Type& type,
+                                         const Shape& shape)
+    {
+        auto param = body.graph->add_node_and_edge(make_shared<op::Parameter>(type, shape),
+                                                   GNodeVector({}));
+        body.inputs.push_back(param);
+        return param;
+    }
+
+    void add_output(op::ControlFlowBody& body, const std::shared_ptr<GNode>& value)
+    {
+        auto result_op = make_shared<op::Result>();
+        result_op->set_needs_copy_to_host(false);
+        body.outputs.push_back(body.graph->add_node_and_edge(result_op, GNodeVector({value})));
+    }
+
+    void finish(op::ControlFlowBody& body)
+    {
+        body.graph->set_default_parameters();
+        body.graph->set_outputs(body.outputs);
+    }
+}
+
+TEST(nnfusion_core_control_flow, loop_shapes)
+{
+    // sum = sum + x for 5 iterations, stacking every partial sum
+    op::ControlFlowBody body;
+    body.graph = std::make_shared<graph::Graph>();
+    add_parameter(body, element::i64, Shape{});
+    auto cond = add_parameter(body, element::boolean, Shape{});
+    auto sum = add_parameter(body, element::f32, Shape{4});
+    auto x = body.graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{4}),
+                                           GNodeVector({}));
+    auto add = body.graph->add_node_and_edge(make_shared<op::Add>(), GNodeVector({sum, x}));
+    add_output(body, cond);
+    add_output(body, add);
+    add_output(body, add);
+
+    auto graph = std::make_shared<graph::Graph>();
+    auto trip_count = graph->add_node_and_edge(
+        make_shared<op::Constant>(element::i64, Shape{}, std::vector<int64_t>{5}),
+        GNodeVector({}));
+    auto init = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{4}),
+                                         GNodeVector({}));
+    auto outer_x = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{4}),
+                                            GNodeVector({}));
+    body.captures.emplace_back(x, 2);
+    finish(body);
+
+    auto loop = graph->add_node_and_edge(make_shared<op::Loop>(body, true, false, 5),
+                                         GNodeVector({trip_count, init, outer_x}),
+                                         2);
+    EXPECT_EQ(loop->get_output_shape(0), Shape({4}));
+    EXPECT_EQ(loop->get_output_shape(1), Shape({5, 4}));
+    EXPECT_EQ(loop->get_output_element_type(1), element::f32);
+}
+
+TEST(nnfusion_core_control_flow, scan_shapes)
+{
+    // a running sum over the rows of a 3x4 input
+    op::ControlFlowBody body;
+    body.graph = std::make_shared<graph::Graph>();
+    auto sum = add_parameter(body, element::f32, Shape{4});
+    auto row = add_parameter(body, element::f32, Shape{4});
+    auto add = body.graph->add_node_and_edge(make_shared<op::Add>(), GNodeVector({sum, row}));
+    add_output(body, add);
+    add_output(body, add);
+    finish(body);
+
+    auto graph = std::make_shared<graph::Graph>();
+    auto init = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{4}),
+                                         GNodeVector({}));
+    auto rows = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{3, 4}),
+                                         GNodeVector({}));
+    auto scan_op =
+        make_shared<op::Scan>(body, 1, std::vector<bool>{true}, std::vector<bool>{false});
+    auto scan = graph->add_node_and_edge(scan_op, GNodeVector({init, rows}), 2);
+    EXPECT_EQ(scan_op->get_sequence_length(), 3);
+    EXPECT_EQ(scan->get_output_shape(0), Shape({4}));
+    EXPECT_EQ(scan->get_output_shape(1), Shape({3, 4}));
+}
+
+TEST(nnfusion_core_control_flow, if_shapes)
+{
+    auto make_branch = [](bool negate) {
+        op::ControlFlowBody body;
+        body.graph = std::make_shared<graph::Graph>();
+        auto x = body.graph->add_node_and_edge(
+            make_shared<op::Parameter>(element::f32, Shape{2, 3}), GNodeVector({}));
+        body.captures.emplace_back(x, 1);
+        std::shared_ptr<GNode> value = x;
+        if (negate)
+            value = body.graph->add_node_and_edge(make_shared<op::Negative>(), GNodeVector({x}));
+        add_output(body, value);
+        finish(body);
+        return body;
+    };
+
+    auto graph = std::make_shared<graph::Graph>();
+    auto cond = graph->add_node_and_edge(make_shared<op::Parameter>(element::boolean, Shape{}),
+                                         GNodeVector({}));
+    auto x = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{2, 3}),
+                                      GNodeVector({}));
+    auto if_node = graph->add_node_and_edge(
+        make_shared<op::If>(make_branch(false), make_branch(true)), GNodeVector({cond, x}), 1);
+    EXPECT_EQ(if_node->get_output_shape(0), Shape({2, 3}));
+}
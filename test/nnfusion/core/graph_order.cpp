@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the cached topological order of Graph
+ */
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+
+namespace
+{
+    size_t position(const GNodeVector& order, const std::shared_ptr<GNode>& node)
+    {
+        return std::find(order.begin(), order.end(), node) - order.begin();
+    }
+}
+
+TEST(nnfusion_core_graph, cached_ordered_ops)
+{
+    auto graph = std::make_shared<graph::Graph>();
+    Shape shape{4};
+    auto a = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, shape),
+                                      GNodeVector({}));
+    auto b = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, shape),
+                                      GNodeVector({}));
+    auto add = graph->add_node_and_edge(make_shared<op::Add>(), GNodeVector({a, b}));
+    auto relu = graph->add_node_and_edge(make_shared<op::Relu>(), GNodeVector({add}));
+    graph->set_outputs({relu});
+
+    auto order = graph->get_ordered_ops();
+    EXPECT_EQ(order.size(), 4);
+    graph->get_ordered_ops();
+    EXPECT_EQ(graph->get_ordered_ops_rebuilds(), 1);
+
+    // A node which is not reachable from the outputs leaves the order alone.
+    auto neg = graph->add_node_and_edge(make_shared<op::Negative>(), GNodeVector({add}));
+    EXPECT_EQ(graph->get_ordered_ops().size(), 4);
+    EXPECT_EQ(graph->get_ordered_ops_rebuilds(), 1);
+
+    // Replacing relu's input by neg makes neg reachable.
+    graph->remove_edge(*relu->get_in_edges().begin());
+    graph->add_edge(neg, 0, relu, 0);
+    order = graph->get_ordered_ops();
+    EXPECT_EQ(graph->get_ordered_ops_rebuilds(), 2);
+    EXPECT_EQ(order.size(), 5);
+    EXPECT_LT(position(order, add), position(order, neg));
+    EXPECT_LT(position(order, neg), position(order, relu));
+
+    // Removing neg makes add unreachable.
+    graph->remove_node(neg);
+    order = graph->get_ordered_ops();
+    EXPECT_EQ(order.size(), 1);
+    EXPECT_EQ(order[0], relu);
+}
@@ -0,0 +1,19 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unit tests for the helpers of nnfusion/common/util.hpp
+ */
+#include <string>
+
+#include "gtest/gtest.h"
+#include "nnfusion/common/util.hpp"
+
+TEST(nnfusion_core_util, sha1_digest)
+{
+    EXPECT_EQ(nnfusion::sha1_digest(""), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    EXPECT_EQ(nnfusion::sha1_digest("abc"), "a9993e364706816aba3e25717850c26c9cd0d89d");
+    // more than one block after the padding
+    EXPECT_EQ(nnfusion::sha1_digest(std::string(1000, 'x')),
+              "c3efa690fa3fdd2e2526853eed670538ea127638");
+}
@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the packed weight file of Constants
+ */
+
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/kernels/weight_pack.hpp"
+
+using namespace nnfusion::kernels;
+
+namespace
+{
+    std::shared_ptr<op::ConstantData> make_data(const std::vector<float>& values)
+    {
+        return make_shared<op::Constant>(element::f32, Shape{values.size()}, values)
+            ->get_storage();
+    }
+}
+
+TEST(nnfusion_core_weight_pack, offsets_index_and_dedup)
+{
+    auto pack = WeightPack::Global();
+    // Other tests may have packed constants already, names in a scope of their own.
+    std::string scope = pack->get_scope();
+    pack->set_scope("weight_pack_test/");
+
+    auto a = make_data({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+    auto b = make_data({1, 2, 3});
+    auto c = make_data({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+    auto d = make_data(std::vector<float>(25, 0.5f));
+
+    size_t offset_a = pack->add("a", a);
+    size_t offset_b = pack->add("b", b);
+    size_t offset_c = pack->add("c", c);
+    size_t offset_d = pack->add("d", d);
+    EXPECT_EQ(offset_a % WeightPack::alignment, 0u);
+    EXPECT_EQ(offset_b % WeightPack::alignment, 0u);
+    EXPECT_EQ(offset_d % WeightPack::alignment, 0u);
+    EXPECT_EQ(pack->size() % WeightPack::alignment, 0u);
+    EXPECT_GE(offset_b, offset_a + a->size());
+    EXPECT_GE(offset_d, offset_b + b->size());
+    EXPECT_GE(pack->size(), offset_d + d->size());
+
+    // The same bytes are stored once, the same name is packed once.
+    EXPECT_EQ(offset_c, offset_a);
+    EXPECT_EQ(pack->add("a", a), offset_a);
+    EXPECT_TRUE(pack->contains("c"));
+    EXPECT_FALSE(pack->contains("e"));
+    EXPECT_EQ(pack->get("c").size, c->size());
+
+    pack->save();
+
+    std::map<std::string, std::pair<size_t, size_t>> index;
+    std::ifstream index_file(WeightPack::folder + WeightPack::index_name);
+    ASSERT_TRUE(index_file.good());
+    std::string name;
+    size_t offset, size;
+    while (index_file >> name >> offset >> size)
+        index[name] = std::make_pair(offset, size);
+    for (auto& tensor : std::vector<std::string>{"a", "b", "c", "d"})
+    {
+        auto it = index.find("weight_pack_test/" + tensor);
+        ASSERT_TRUE(it != index.end()) << tensor;
+        EXPECT_EQ(it->second.first, pack->get(tensor).offset);
+        EXPECT_EQ(it->second.second, pack->get(tensor).size);
+    }
+
+    std::ifstream blob(WeightPack::folder + WeightPack::blob_name, std::ios::binary);
+    ASSERT_TRUE(blob.good());
+    std::map<std::string, std::shared_ptr<op::ConstantData>> packed{
+        {"a", a}, {"b", b}, {"c", c}, {"d", d}};
+    for (auto& tensor : packed)
+    {
+        auto& entry = pack->get(tensor.first);
+        std::vector<char> bytes(entry.size);
+        blob.seekg(entry.offset);
+        blob.read(bytes.data(), entry.size);
+        ASSERT_TRUE(blob.good());
+        EXPECT_EQ(std::memcmp(bytes.data(), tensor.second->data(), entry.size), 0)
+            << tensor.first;
+    }
+
+    pack->set_scope(scope);
+}
@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the benchmark main of the generated CPU runtime
+ */
+
+#include <fstream>
+#include <regex>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/op_define/relu.hpp"
+#include "nnfusion/test_util/cpu_runtime.hpp"
+
+TEST(nnfusion_engine_benchmark_main, statistics_and_iterations)
+{
+    auto graph = std::make_shared<graph::Graph>();
+    auto x = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{64}),
+                                      GNodeVector({}));
+    auto relu = graph->add_node_and_edge(make_shared<op::Relu>(), {x});
+    graph->set_default_parameters();
+    graph->set_outputs({graph->add_node_and_edge(make_shared<op::Result>(), {relu})});
+
+    nnfusion::test::CpuRuntime runtime(graph);
+    ASSERT_TRUE(runtime.compiled());
+    ASSERT_TRUE(runtime.build());
+    EXPECT_EQ(runtime.run("./main_test --help"), 0);
+    EXPECT_EQ(runtime.run("./main_test --steps"), 1);
+
+    std::string output;
+    ASSERT_EQ(runtime.run("./main_test --threads 2 --warmup 0 --steps 7 --random --csv lat.csv",
+                          &output),
+              0);
+    EXPECT_NE(output.find("threads: 2, steps per thread: 7, random inputs: yes\n"),
+              std::string::npos)
+        << output;
+    std::string number = "([0-9]+\\.[0-9]+)";
+    std::smatch latency;
+    ASSERT_TRUE(std::regex_search(output,
+                                  latency,
+                                  std::regex("latency: min " + number + ", p50 " + number +
+                                             ", p90 " + number + ", p99 " + number + ", max " +
+                                             number + " ms\n")))
+        << output;
+    for (size_t i = 1; i < 5; i++)
+        EXPECT_LE(std::stod(latency[i]), std::stod(latency[i + 1]));
+    EXPECT_TRUE(std::regex_search(output, std::regex("throughput: " + number + " inferences/s\n")));
+    EXPECT_TRUE(std::regex_search(output, std::regex("peak RSS: [0-9]+ KB\n")));
+    EXPECT_TRUE(
+        std::regex_search(output, std::regex("function execution time: " + number + " ms\n")));
+
+    // One row per timed call of every thread, the warmup calls are not timed.
+    std::ifstream csv(runtime.folder() + "lat.csv");
+    std::string line;
+    ASSERT_TRUE(std::getline(csv, line));
+    EXPECT_EQ(line, "thread,iteration,start_ms,latency_ms");
+    std::vector<int> calls(2, 0);
+    while (std::getline(csv, line))
+    {
+        int thread = -1, iteration = -1;
+        ASSERT_EQ(sscanf(line.c_str(), "%d,%d,", &thread, &iteration), 2) << line;
+        ASSERT_TRUE(thread == 0 || thread == 1) << line;
+        EXPECT_EQ(iteration, calls[thread]++);
+    }
+    EXPECT_EQ(calls, (std::vector<int>{7, 7}));
+}
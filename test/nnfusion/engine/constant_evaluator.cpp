@@ -0,0 +1,132 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the in-process evaluator of constant folding
+ */
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/engine/pass/graph/constant_evaluator.hpp"
+
+using nnfusion::pass::graph::ConstantEvaluator;
+
+namespace
+{
+    // Evaluates op on the constants args, returns its output values or nothing when the
+    // evaluator does not support it.
+    template <typename T>
+    std::vector<T> evaluate(std::shared_ptr<op::Op> op,
+                            const std::vector<std::shared_ptr<op::Constant>>& args)
+    {
+        auto graph = std::make_shared<graph::Graph>();
+        GNodeVector arg_gnodes;
+        std::vector<std::shared_ptr<op::ConstantData>> inputs;
+        for (auto& arg : args)
+        {
+            arg_gnodes.push_back(graph->add_node_and_edge(arg, GNodeVector({})));
+            inputs.push_back(arg->get_storage());
+        }
+        auto gnode = graph->add_node_and_edge(op, arg_gnodes);
+        ConstantEvaluator evaluator;
+        auto output = evaluator.evaluate(gnode, inputs);
+        if (output == nullptr)
+            return {};
+        auto data = static_cast<const T*>(output->data());
+        return std::vector<T>(data, data + shape_size(gnode->get_output_shape(0)));
+    }
+
+    std::shared_ptr<op::Constant> constant(const Shape& shape, const std::vector<float>& values)
+    {
+        return make_shared<op::Constant>(element::f32, shape, values);
+    }
+}
+
+TEST(nnfusion_engine_constant_evaluator, transpose_sum)
+{
+    auto graph = std::make_shared<graph::Graph>();
+    auto A = make_shared<op::Constant>(
+        element::f32, Shape{2, 3}, std::vector<float>{0, 1, 2, 3, 4, 5});
+    auto A_gnode = graph->add_node_and_edge(A, GNodeVector({}));
+    auto T = make_shared<op::Reshape>(AxisVector{1, 0}, Shape{3, 2});
+    auto T_gnode = graph->add_node_and_edge(T, {A_gnode});
+    auto S = make_shared<op::Sum>(AxisSet{1});
+    auto S_gnode = graph->add_node_and_edge(S, {T_gnode});
+
+    ConstantEvaluator evaluator;
+    auto transposed = evaluator.evaluate(T_gnode, {A->get_storage()});
+    ASSERT_NE(transposed, nullptr);
+    auto t = static_cast<const float*>(transposed->data());
+    EXPECT_EQ(std::vector<float>(t, t + 6), (std::vector<float>{0, 3, 1, 4, 2, 5}));
+
+    auto sum = evaluator.evaluate(S_gnode, {transposed});
+    ASSERT_NE(sum, nullptr);
+    auto s = static_cast<const float*>(sum->data());
+    EXPECT_EQ(std::vector<float>(s, s + 3), (std::vector<float>{3, 5, 7}));
+
+    // Equal inputs reuse the cached output.
+    auto B = make_shared<op::Constant>(element::f32, Shape{2, 3}, A->get_vector<float>());
+    EXPECT_EQ(evaluator.evaluate(T_gnode, {B->get_storage()}), transposed);
+    EXPECT_EQ(evaluator.get_evaluated_count(), 2u);
+    EXPECT_EQ(evaluator.get_cache_hit_count(), 1u);
+
+    // Once the transposed constant is folded away, neither its entry nor the one of the sum
+    // keeps it alive.
+    std::weak_ptr<op::ConstantData> released = transposed;
+    EXPECT_EQ(evaluator.get_cached_count(), 2u);
+    evaluator.release(transposed);
+    EXPECT_EQ(evaluator.get_cached_count(), 0u);
+    transposed.reset();
+    EXPECT_TRUE(released.expired());
+}
+
+TEST(nnfusion_engine_constant_evaluator, dot_transposed)
+{
+    // A^T is {{1, 3, 5}, {2, 4, 6}}, B^T is {{1, 0}, {0, 1}, {1, 0}}.
+    auto A = constant(Shape{3, 2}, {1, 2, 3, 4, 5, 6});
+    auto B = constant(Shape{2, 3}, {1, 0, 1, 0, 1, 0});
+    EXPECT_EQ(evaluate<float>(make_shared<op::Dot>(1, true, true, true), {A, B}),
+              (std::vector<float>{6, 3, 8, 4}));
+    EXPECT_EQ(evaluate<float>(make_shared<op::Dot>(1, true, true, false),
+                              {A, constant(Shape{3, 1}, {1, 1, 1})}),
+              (std::vector<float>{9, 12}));
+}
+
+TEST(nnfusion_engine_constant_evaluator, pad_interior)
+{
+    auto pad = make_shared<op::Pad>(Shape{0, 1}, Shape{1, 0}, Shape{1, 1});
+    EXPECT_EQ(evaluate<float>(pad, {constant(Shape{2, 2}, {1, 2, 3, 4}), constant(Shape{}, {9})}),
+              (std::vector<float>{9, 1, 9, 2, 9, 9, 9, 9, 9, 3, 9, 4, 9, 9, 9, 9}));
+}
+
+TEST(nnfusion_engine_constant_evaluator, slice_strided)
+{
+    auto slice = make_shared<op::Slice>(Coordinate{0, 1}, Coordinate{3, 4}, Strides{2, 2});
+    auto A = constant(Shape{3, 4}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+    EXPECT_EQ(evaluate<float>(slice, {A}), (std::vector<float>{1, 3, 9, 11}));
+}
+
+TEST(nnfusion_engine_constant_evaluator, broadcast)
+{
+    auto A = constant(Shape{3}, {1, 2, 3});
+    EXPECT_EQ(evaluate<float>(make_shared<op::Broadcast>(Shape{2, 3}, AxisSet{0}), {A}),
+              (std::vector<float>{1, 2, 3, 1, 2, 3}));
+    EXPECT_EQ(evaluate<float>(make_shared<op::Broadcast>(Shape{3, 2}, AxisSet{1}), {A}),
+              (std::vector<float>{1, 1, 2, 2, 3, 3}));
+}
+
+TEST(nnfusion_engine_constant_evaluator, concat_inner_axis)
+{
+    auto A = constant(Shape{2, 1}, {1, 2});
+    auto B = constant(Shape{2, 2}, {3, 4, 5, 6});
+    EXPECT_EQ(evaluate<float>(make_shared<op::Concat>(1), {A, B}),
+              (std::vector<float>{1, 3, 4, 2, 5, 6}));
+}
+
+TEST(nnfusion_engine_constant_evaluator, convert_to_boolean)
+{
+    // Any non-zero value is true, including the ones which truncate to zero.
+    auto A = constant(Shape{4}, {0, 0.5, -2, 0});
+    EXPECT_EQ(evaluate<char>(make_shared<op::Convert>(element::boolean), {A}),
+              (std::vector<char>{0, 1, 1, 0}));
+}
@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the sessions of the generated CPU runtime
+ */
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/op_define/add.hpp"
+#include "nnfusion/core/operators/op_define/multiply.hpp"
+#include "nnfusion/core/operators/op_define/relu.hpp"
+#include "nnfusion/test_util/cpu_runtime.hpp"
+
+DECLARE_bool(fcpu_sessions);
+
+namespace
+{
+    // Two threads run y = Relu(x) * x + x in sessions of their own on different inputs, the
+    // second one keeps running after the first one destroyed its session. The exit code has
+    // bit t set when thread t gets a wrong output.
+    const char* session_driver = R"(
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include "nnfusion_rt.h"
+
+static bool check(const float* x, const float* y)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        float expected = (x[i] > 0 ? x[i] * x[i] : 0) + x[i];
+        if (std::fabs(y[i] - expected) > 1e-4f * std::fmax(1.0f, std::fabs(expected)))
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    cpu_init();
+    nnf_session* sessions[2] = {nnf_session_create(), nnf_session_create()};
+    std::atomic<int> failed(0);
+    std::atomic<bool> destroyed(false);
+    auto client = [&](int t) {
+        float x[256], y[256];
+        for (int step = 0; step < 300; step++)
+        {
+            if (t == 1 && step == 200)
+                while (!destroyed)
+                    std::this_thread::yield();
+            for (int i = 0; i < 256; i++)
+                x[i] = (i % 13 - 6) * (t + 1) * 0.25f + step * 0.01f;
+            if (nnf_session_run(sessions[t], x, y) != 0 || !check(x, y))
+                failed |= 1 << t;
+            if (t == 0 && step == 199)
+            {
+                nnf_session_destroy(sessions[0]);
+                destroyed = true;
+                break;
+            }
+        }
+    };
+    std::thread other(client, 1);
+    client(0);
+    other.join();
+    nnf_session_destroy(sessions[1]);
+    cpu_free();
+    return failed;
+}
+)";
+}
+
+TEST(nnfusion_engine_cpu_sessions, concurrent_sessions)
+{
+    auto graph = std::make_shared<graph::Graph>();
+    auto x = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{256}),
+                                      GNodeVector({}));
+    auto relu = graph->add_node_and_edge(make_shared<op::Relu>(), {x});
+    auto mul = graph->add_node_and_edge(make_shared<op::Multiply>(), {relu, x});
+    auto add = graph->add_node_and_edge(make_shared<op::Add>(), {mul, x});
+    graph->set_default_parameters();
+    graph->set_outputs({graph->add_node_and_edge(make_shared<op::Result>(), {add})});
+
+    bool sessions = FLAGS_fcpu_sessions;
+    FLAGS_fcpu_sessions = true;
+    nnfusion::test::CpuRuntime runtime(graph);
+    FLAGS_fcpu_sessions = sessions;
+    ASSERT_TRUE(runtime.compiled());
+    ASSERT_TRUE(runtime.build(session_driver));
+    EXPECT_EQ(runtime.run("./runtime_check"), 0);
+}
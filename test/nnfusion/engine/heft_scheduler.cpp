@@ -0,0 +1,42 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the HEFT list scheduler of CPU threads
+ */
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/engine/pass/graph/heft_scheduler.hpp"
+
+using nnfusion::pass::graph::heft_schedule;
+
+TEST(nnfusion_engine_heft_scheduler, parallel_branches)
+{
+    // 0 forks into the branches 1 -> 2 and 3 -> 4, which join in 5.
+    std::vector<double> cost = {1, 100, 100, 100, 100, 1};
+    std::vector<std::vector<int>> preds = {{}, {0}, {1}, {0}, {3}, {2, 4}};
+    auto schedule = heft_schedule(cost, preds, 4, 5);
+
+    EXPECT_EQ(schedule.num_threads, 2u);
+    EXPECT_EQ(schedule.thread[1], schedule.thread[2]);
+    EXPECT_EQ(schedule.thread[3], schedule.thread[4]);
+    EXPECT_NE(schedule.thread[1], schedule.thread[3]);
+    // One branch and the join wait on an event each, the join runs after the delayed branch
+    // and the event of the other one arrives before.
+    EXPECT_EQ(schedule.cross_thread_deps, 2u);
+    EXPECT_DOUBLE_EQ(schedule.serial, 402);
+    EXPECT_DOUBLE_EQ(schedule.makespan, 1 + 5 + 200 + 1);
+}
+
+TEST(nnfusion_engine_heft_scheduler, cheap_branches_stay_serial)
+{
+    // Branches cheaper than an event are not worth a thread.
+    std::vector<double> cost = {1, 2, 2, 1};
+    std::vector<std::vector<int>> preds = {{}, {0}, {0}, {1, 2}};
+    auto schedule = heft_schedule(cost, preds, 4, 5);
+
+    EXPECT_EQ(schedule.num_threads, 1u);
+    EXPECT_EQ(schedule.cross_thread_deps, 0u);
+    EXPECT_DOUBLE_EQ(schedule.makespan, schedule.serial);
+}
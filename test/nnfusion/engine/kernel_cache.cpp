@@ -0,0 +1,110 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the in-memory layer of the kernel cache DB
+ */
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "nnfusion/engine/cache/manager.hpp"
+
+using namespace nnfusion::cache;
+
+class nnfusion_engine_kernel_cache : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // Only takes effect if no other test opened the cache DB before.
+        path = "/tmp/nnfusion_test_kernel_cache_" + std::to_string(getpid()) + ".db";
+        FLAGS_fkernel_cache_path = path;
+    }
+
+    void TearDown() override
+    {
+        for (auto suffix : {"", "-wal", "-shm", "-journal"})
+            unlink((path + suffix).c_str());
+    }
+
+    std::string path;
+};
+
+TEST_F(nnfusion_engine_kernel_cache, prefetch_and_memory_hits)
+{
+    auto cache_manager = std::make_shared<KernelCacheManager>();
+    ASSERT_TRUE(cache_manager->is_valid());
+
+    std::string identifier = "test_kernel_cache_" + std::to_string(getpid());
+    auto entry = std::make_shared<KernelEntry>();
+    entry->key = identifier + "_key";
+    entry->identifier = identifier;
+    entry->op_type = "Dot";
+    entry->source = "External";
+    entry->device_type = "CUDA_GPU";
+    entry->function = nlohmann::json::parse(R"({"code": "kernel"})");
+    entry->tags.insert("CudaEmitter");
+    EXPECT_TRUE(cache_manager->insert_kernel_entry(entry, true));
+
+    auto before = KernelCacheManager::get_stats();
+    cache_manager->prefetch({identifier, identifier + "_missing"}, "CUDA_GPU");
+    auto fetched = cache_manager->fetch_all(identifier, "CUDA_GPU");
+    ASSERT_EQ(fetched.size(), 1);
+    EXPECT_EQ(fetched[0]->key, entry->key);
+    EXPECT_EQ(fetched[0]->tags.count("CudaEmitter"), 1);
+    EXPECT_TRUE(cache_manager->fetch_all(identifier + "_missing", "CUDA_GPU").empty());
+
+    // Entries are copies, changing them does not touch the cache.
+    fetched[0]->tags.clear();
+    EXPECT_EQ(cache_manager->fetch_all(identifier, "CUDA_GPU")[0]->tags.size(), 1);
+
+    auto after = KernelCacheManager::get_stats();
+    EXPECT_EQ(after.db_queries - before.db_queries, 1);
+    EXPECT_EQ(after.memory_hits - before.memory_hits, 3);
+    EXPECT_EQ(after.hits - before.hits, 2);
+    EXPECT_EQ(after.misses - before.misses, 1);
+
+    double cost = 0;
+    EXPECT_FALSE(cache_manager->fetch_profile(identifier, "CUDA_GPU", cost));
+    EXPECT_TRUE(cache_manager->insert_profile(identifier, "", "CUDA_GPU", 1.5));
+    EXPECT_TRUE(cache_manager->fetch_profile(identifier, "CUDA_GPU", cost));
+    EXPECT_EQ(cost, 1.5);
+
+    // Identifiers beyond the limit of bound parameters are queried in chunks.
+    std::vector<std::string> identifiers;
+    for (int i = 0; i < 1200; i++)
+        identifiers.push_back(identifier + "_chunk_" + std::to_string(i));
+    identifiers.push_back(identifier);
+    before = KernelCacheManager::get_stats();
+    cache_manager->prefetch(identifiers, "CUDA_GPU");
+    after = KernelCacheManager::get_stats();
+    EXPECT_EQ(after.db_queries - before.db_queries, 3);
+    EXPECT_EQ(cache_manager->fetch_all(identifier, "CUDA_GPU").size(), 1);
+}
+
+TEST_F(nnfusion_engine_kernel_cache, extra_ops_stay_with_their_manager)
+{
+    std::string identifier = "test_kernel_cache_extra_" + std::to_string(getpid());
+    auto entry = std::make_shared<KernelEntry>();
+    entry->key = identifier + "_key";
+    entry->identifier = identifier;
+    entry->op_type = "TestOnlyOp";
+    entry->source = "NNFusion";
+    entry->device_type = "GENERIC_CPU";
+    entry->function = nlohmann::json::parse(R"({"code": "kernel"})");
+
+    auto default_manager = std::make_shared<KernelCacheManager>();
+    ASSERT_TRUE(default_manager->is_valid());
+    EXPECT_FALSE(default_manager->insert_kernel_entry(entry, true));
+
+    auto extra_manager = std::make_shared<KernelCacheManager>(
+        std::unordered_set<std::string>{entry->op_type});
+    EXPECT_TRUE(extra_manager->insert_kernel_entry(entry, true));
+    EXPECT_EQ(extra_manager->fetch_all(identifier, "GENERIC_CPU").size(), 1);
+
+    // Neither the shared entries nor SupportOpList let other managers see the op.
+    EXPECT_EQ(KernelCacheManager::SupportOpList.count(entry->op_type), 0);
+    EXPECT_TRUE(default_manager->fetch_all(identifier, "GENERIC_CPU").empty());
+    EXPECT_FALSE(default_manager->insert_kernel_entry(entry, true));
+}
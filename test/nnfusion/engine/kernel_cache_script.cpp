@@ -0,0 +1,102 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for kernel_cache.sh, the compiler wrapper of -fkernel_cache_dir
+ */
+
+#include <fstream>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "nnfusion/common/util.hpp"
+#include "nnfusion/engine/pass/codegen/codegen_langunit.hpp"
+
+namespace
+{
+    void write_file(const std::string& path, const std::string& content)
+    {
+        std::ofstream file(path);
+        file << content;
+    }
+
+    std::string read_file(const std::string& path)
+    {
+        std::ifstream file(path);
+        return std::string((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    }
+
+    // Writes a project with kernel_cache.sh, a kernel and a header it includes.
+    void write_project(const std::string& project, const std::string& cache_dir, int value)
+    {
+        ASSERT_EQ(system(("mkdir -p " + project + "/kernels " + project + "/include").c_str()),
+                  0);
+        write_file(project + "/kernel_cache.sh",
+                   "#!/bin/bash\ncache_dir=\"" + cache_dir + "\"\n" +
+                       nnfusion::codegen::helper::kernel_cache->get_code());
+        write_file(project + "/include/value.hpp",
+                   "inline int value() { return " + std::to_string(value) + "; }\n");
+        write_file(project + "/kernels/kernel.cpp",
+                   "#include \"value.hpp\"\nint kernel() { return value() + __LINE__; }\n");
+    }
+
+    // Compiles the kernel of project through its kernel_cache.sh, with absolute paths as
+    // CMake passes them.
+    int compile(const std::string& project)
+    {
+        std::string command = "cd " + project + " && bash kernel_cache.sh c++ -I" + project +
+                              "/include -c " + project + "/kernels/kernel.cpp -o kernel.o";
+        return system(command.c_str());
+    }
+
+    size_t cached_objects(const std::string& cache_dir)
+    {
+        std::string listing;
+        FILE* pipe = popen(("ls " + cache_dir + " 2>/dev/null").c_str(), "r");
+        char buffer[256];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+            listing.append(buffer, count);
+        pclose(pipe);
+        size_t objects = 0;
+        for (size_t pos = listing.find(".o\n"); pos != std::string::npos;
+             pos = listing.find(".o\n", pos + 1))
+            objects++;
+        return objects;
+    }
+}
+
+TEST(nnfusion_engine_kernel_cache_script, projects_in_other_folders_share_objects)
+{
+    std::string dir = std::string(nnfusion::tmpnam(nullptr)) + "_kernel_cache";
+    std::string cache_dir = dir + "/cache";
+    write_project(dir + "/first", cache_dir, 3);
+    ASSERT_EQ(compile(dir + "/first"), 0);
+    ASSERT_EQ(cached_objects(cache_dir), 1u);
+
+    // Mark the cached object, a project which only differs by its folder copies it.
+    std::string marker = "cached\n";
+    ASSERT_EQ(system(("for object in " + cache_dir + "/*.o; do echo cached > $object; done")
+                         .c_str()),
+              0);
+    write_project(dir + "/second", cache_dir, 3);
+    ASSERT_EQ(compile(dir + "/second"), 0);
+    EXPECT_EQ(read_file(dir + "/second/kernel.o"), marker);
+    EXPECT_EQ(cached_objects(cache_dir), 1u);
+
+    // A change of an included header is a miss, which compiles and caches the object.
+    write_project(dir + "/third", cache_dir, 4);
+    ASSERT_EQ(compile(dir + "/third"), 0);
+    EXPECT_NE(read_file(dir + "/third/kernel.o"), marker);
+    EXPECT_EQ(cached_objects(cache_dir), 2u);
+
+    // Commands which do not compile run as they are and are not cached.
+    std::string archive = "cd " + dir + "/third && bash kernel_cache.sh ar rcs libkernel.a " +
+                          "kernel.o";
+    EXPECT_EQ(system(archive.c_str()), 0);
+    EXPECT_EQ(access((dir + "/third/libkernel.a").c_str(), F_OK), 0);
+    EXPECT_EQ(cached_objects(cache_dir), 2u);
+
+    system(("rm -rf " + dir).c_str());
+}
@@ -0,0 +1,61 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the kernel tracer of the generated CPU runtime
+ */
+
+#include <fstream>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/op_define/relu.hpp"
+#include "nnfusion/test_util/cpu_runtime.hpp"
+
+DECLARE_string(fkernel_trace);
+
+namespace
+{
+    const char* trace_driver = R"(
+#include "nnfusion_rt.h"
+
+int main()
+{
+    cpu_init();
+    float x[4] = {-1, 2, -3, 4}, y[4];
+    for (int i = 0; i < 3; i++)
+        kernel_entry(x, y);
+    cpu_free();
+    return y[0] == 0 && y[1] == 2 ? 0 : 1;
+}
+)";
+}
+
+TEST(nnfusion_engine_kernel_trace, names_and_path_are_escaped)
+{
+    auto graph = std::make_shared<graph::Graph>();
+    auto x = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{4}),
+                                      GNodeVector({}));
+    auto relu = graph->add_node_and_edge(make_shared<op::Relu>(), {x});
+    relu->set_name("relu \"1\" \\ x");
+    graph->set_default_parameters();
+    graph->set_outputs({graph->add_node_and_edge(make_shared<op::Result>(), {relu})});
+
+    std::string trace = FLAGS_fkernel_trace;
+    FLAGS_fkernel_trace = "trace \"a\".json";
+    nnfusion::test::CpuRuntime runtime(graph);
+    FLAGS_fkernel_trace = trace;
+    ASSERT_TRUE(runtime.compiled());
+    ASSERT_TRUE(runtime.build(trace_driver));
+    std::string output;
+    EXPECT_EQ(runtime.run("./runtime_check", &output), 0);
+    EXPECT_NE(output.find("kernel trace:"), std::string::npos);
+    EXPECT_NE(output.find("relu \"1\" \\ x"), std::string::npos);
+
+    std::ifstream file(runtime.folder() + "trace \"a\".json");
+    ASSERT_TRUE(file.good());
+    std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(json.find("{\"displayTimeUnit\""), 0u);
+    EXPECT_NE(json.find("\"name\": \"relu \\\"1\\\" \\\\ x\", \"cat\": \"Relu\""),
+              std::string::npos);
+}
@@ -0,0 +1,126 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for LoopFusionPass and the LoopFused CPU kernel
+ */
+
+#include <cmath>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/op_define/broadcast.hpp"
+#include "nnfusion/core/operators/op_define/divide.hpp"
+#include "nnfusion/core/operators/op_define/exp.hpp"
+#include "nnfusion/core/operators/op_define/max.hpp"
+#include "nnfusion/core/operators/op_define/parameter.hpp"
+#include "nnfusion/core/operators/op_define/relu.hpp"
+#include "nnfusion/core/operators/op_define/result.hpp"
+#include "nnfusion/core/operators/op_define/subtract.hpp"
+#include "nnfusion/core/operators/op_define/sum.hpp"
+#include "nnfusion/engine/pass/graph/loop_fusion_pass.hpp"
+
+DECLARE_bool(fcpu_loop_fusion);
+
+using namespace nnfusion;
+using nnfusion::pass::graph::LoopFusionPass;
+
+namespace
+{
+    bool run_pass(graph::Graph::Pointer& graph)
+    {
+        bool flag = FLAGS_fcpu_loop_fusion;
+        FLAGS_fcpu_loop_fusion = true;
+        bool result = LoopFusionPass().run_on_graph(graph);
+        FLAGS_fcpu_loop_fusion = flag;
+        return result;
+    }
+
+    std::map<std::string, size_t> count_ops(graph::Graph::Pointer& graph)
+    {
+        std::map<std::string, size_t> counts;
+        for (auto& node : graph->get_ordered_ops())
+            counts[node->get_op_type()]++;
+        return counts;
+    }
+
+    // softmax(x) over the last axis of x [rows, cols], as Max, Subtract, Exp, Sum and Divide.
+    graph::Graph::Pointer make_softmax(size_t rows, size_t cols)
+    {
+        auto graph = std::make_shared<graph::Graph>();
+        Shape shape{rows, cols};
+        auto x = graph->add_node_and_edge(std::make_shared<op::Parameter>(element::f32, shape),
+                                          graph::GNodeVector({}));
+        auto max = graph->add_node_and_edge(std::make_shared<op::Max>(AxisSet{1}), {x});
+        auto max_b =
+            graph->add_node_and_edge(std::make_shared<op::Broadcast>(shape, AxisSet{1}), {max});
+        auto shifted = graph->add_node_and_edge(std::make_shared<op::Subtract>(), {x, max_b});
+        auto exp = graph->add_node_and_edge(std::make_shared<op::Exp>(), {shifted});
+        auto sum = graph->add_node_and_edge(std::make_shared<op::Sum>(AxisSet{1}), {exp});
+        auto sum_b =
+            graph->add_node_and_edge(std::make_shared<op::Broadcast>(shape, AxisSet{1}), {sum});
+        auto y = graph->add_node_and_edge(std::make_shared<op::Divide>(), {exp, sum_b});
+        auto result = graph->add_node_and_edge(std::make_shared<op::Result>(), {y});
+        graph->set_default_parameters();
+        graph->set_outputs({result});
+        return graph;
+    }
+}
+
+TEST(nnfusion_pass_loop_fusion, softmax_becomes_one_loop)
+{
+    // 37 columns run full vectors and a scalar tail with both AVX2 and AVX-512.
+    const size_t rows = 4, cols = 37;
+    auto graph = make_softmax(rows, cols);
+
+    // Without the flag the graph is left as it is.
+    auto before = count_ops(graph);
+    EXPECT_TRUE(LoopFusionPass().run_on_graph(graph));
+    EXPECT_EQ(count_ops(graph), before);
+
+    ASSERT_TRUE(run_pass(graph));
+    auto counts = count_ops(graph);
+    EXPECT_EQ(counts["LoopFused"], 1);
+    for (auto type : {"Max", "Broadcast", "Subtract", "Exp", "Sum", "Divide"})
+        EXPECT_EQ(counts[type], 0) << type;
+
+    auto result = graph->get_outputs()[0];
+    auto fused = result->get_in_edge(0)->get_src();
+    ASSERT_EQ(fused->get_op_type(), "LoopFused");
+    // x is read by Max and Subtract, the fused node reads it once.
+    ASSERT_EQ(fused->get_input_size(), 1);
+    EXPECT_EQ(fused->get_output_shape(0), Shape({rows, cols}));
+
+    std::vector<float> x(rows * cols), y(rows * cols);
+    for (size_t i = 0; i < x.size(); i++)
+        x[i] = 3 * std::sin(0.61f * i);
+    for (size_t r = 0; r < rows; r++)
+    {
+        double max = x[r * cols], sum = 0;
+        for (size_t c = 0; c < cols; c++)
+            max = std::max<double>(max, x[r * cols + c]);
+        for (size_t c = 0; c < cols; c++)
+            sum += std::exp(x[r * cols + c] - max);
+        for (size_t c = 0; c < cols; c++)
+            y[r * cols + c] = std::exp(x[r * cols + c] - max) / sum;
+    }
+    EXPECT_TRUE(nnfusion::test::check_kernel<float>(fused, GENERIC_CPU, x, y));
+}
+
+TEST(nnfusion_pass_loop_fusion, leading_axis_reduction_is_not_fused)
+{
+    // A Sum over the rows does not reduce the trailing axes, the Relu after it stays apart.
+    auto graph = std::make_shared<graph::Graph>();
+    auto x = graph->add_node_and_edge(
+        std::make_shared<op::Parameter>(element::f32, Shape{4, 8}), graph::GNodeVector({}));
+    auto sum = graph->add_node_and_edge(std::make_shared<op::Sum>(AxisSet{0}), {x});
+    auto relu = graph->add_node_and_edge(std::make_shared<op::Relu>(), {sum});
+    auto result = graph->add_node_and_edge(std::make_shared<op::Result>(), {relu});
+    graph->set_default_parameters();
+    graph->set_outputs({result});
+
+    auto before = count_ops(graph);
+    ASSERT_TRUE(run_pass(graph));
+    EXPECT_EQ(count_ops(graph), before);
+    EXPECT_EQ(result->get_in_edge(0)->get_src(), relu);
+}
@@ -0,0 +1,48 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for the offline memory planner of MemoryAllocator
+ */
+
+#include "gtest/gtest.h"
+#include "nnfusion/engine/memory_allocator.hpp"
+
+using namespace nnfusion;
+
+namespace
+{
+    shared_ptr<descriptor::Tensor> create_tensor(const std::string& name, size_t bytes)
+    {
+        auto tensor = make_shared<descriptor::Tensor>(
+            element::u8, PartialShape(Shape{bytes}), name, GENERIC_CPU, false, false, false, false,
+            "default", 0);
+        return tensor;
+    }
+}
+
+TEST(nnfusion_engine_memory_allocator, offline_plan)
+{
+    MemoryAllocatorFactory maf(1, false);
+    auto a = create_tensor("a", 10);
+    auto b = create_tensor("b", 20);
+    auto c = create_tensor("c", 15);
+    auto allocator = maf.get_allocator(a);
+    allocator->set_alloc_scheme(MemoryAllocator::allocation_scheme::OFFLINE);
+
+    // First fit cannot reuse the hole of a for c, which ends up on top of b.
+    allocator->allocate(a);
+    allocator->allocate(b);
+    allocator->free(a);
+    allocator->allocate(c);
+    allocator->free(b);
+    allocator->free(c);
+    EXPECT_EQ(allocator->max_allocated(), 45);
+
+    allocator->plan();
+    EXPECT_EQ(allocator->max_allocated(), 35);
+    EXPECT_EQ(b->get_pool_offset(), 0);
+    EXPECT_EQ(c->get_pool_offset(), 20);
+    EXPECT_EQ(a->get_pool_offset(), 20);
+    EXPECT_NE(allocator->get_plan_report().find("lower bound 35"), std::string::npos);
+}
@@ -0,0 +1,153 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for NchwcLayoutPass
+ */
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+#include "nnfusion/core/operators/op_define/add.hpp"
+#include "nnfusion/core/operators/op_define/broadcast.hpp"
+#include "nnfusion/core/operators/op_define/constant.hpp"
+#include "nnfusion/core/operators/op_define/convolution.hpp"
+#include "nnfusion/core/operators/op_define/max_pool.hpp"
+#include "nnfusion/core/operators/op_define/parameter.hpp"
+#include "nnfusion/core/operators/op_define/relu.hpp"
+#include "nnfusion/core/operators/op_define/result.hpp"
+#include "nnfusion/engine/pass/graph/nchwc_layout_pass.hpp"
+
+DECLARE_bool(fnchwc_layout);
+
+using namespace nnfusion;
+using nnfusion::pass::graph::NchwcLayoutPass;
+
+namespace
+{
+    std::shared_ptr<graph::GNode> add_constant(graph::Graph::Pointer& graph, const Shape& shape)
+    {
+        std::vector<float> values(shape_size(shape), 0.5f);
+        return graph->add_node_and_edge(std::make_shared<op::Constant>(element::f32, shape, values),
+                                        graph::GNodeVector({}));
+    }
+
+    std::shared_ptr<graph::GNode> add_conv(graph::Graph::Pointer& graph,
+                                           std::shared_ptr<graph::GNode> input,
+                                           size_t out_channels,
+                                           size_t kernel)
+    {
+        std::ptrdiff_t pad = kernel / 2;
+        auto filter = add_constant(graph, {out_channels, input->get_shape()[1], kernel, kernel});
+        auto conv = std::make_shared<op::Convolution>(
+            Strides{1, 1}, Strides{1, 1}, CoordinateDiff{pad, pad}, CoordinateDiff{pad, pad});
+        return graph->add_node_and_edge(conv, {input, filter});
+    }
+
+    bool run_pass(graph::Graph::Pointer& graph)
+    {
+        bool flag = FLAGS_fnchwc_layout;
+        FLAGS_fnchwc_layout = true;
+        bool result = NchwcLayoutPass().run_on_graph(graph);
+        FLAGS_fnchwc_layout = flag;
+        return result;
+    }
+
+    std::map<std::string, size_t> count_ops(graph::Graph::Pointer& graph)
+    {
+        std::map<std::string, size_t> counts;
+        for (auto& node : graph->get_ordered_ops())
+            counts[node->get_op_type()]++;
+        return counts;
+    }
+
+    nnfusion::op::OpConfig::any& config_of(std::shared_ptr<graph::GNode> node)
+    {
+        return std::static_pointer_cast<op::GenericOp>(node->get_op_ptr())
+            ->localOpConfig.getRoot();
+    }
+}
+
+TEST(nnfusion_pass_nchwc_layout, blocks_conv_chain_and_pooling)
+{
+    // x -> conv 3x3 -> + bias -> Relu -> conv 1x1 -> MaxPool 2x2, all with 16 channels.
+    auto graph = std::make_shared<graph::Graph>();
+    auto x = graph->add_node_and_edge(
+        std::make_shared<op::Parameter>(element::f32, Shape{1, 16, 8, 8}), graph::GNodeVector({}));
+    auto conv1 = add_conv(graph, x, 16, 3);
+    auto bias = add_constant(graph, {16});
+    auto broadcast = graph->add_node_and_edge(
+        std::make_shared<op::Broadcast>(Shape{1, 16, 8, 8}, AxisSet{0, 2, 3}), {bias});
+    auto add = graph->add_node_and_edge(std::make_shared<op::Add>(), {conv1, broadcast});
+    auto relu = graph->add_node_and_edge(std::make_shared<op::Relu>(), {add});
+    auto conv2 = add_conv(graph, relu, 16, 1);
+    auto pool = graph->add_node_and_edge(
+        std::make_shared<op::MaxPool>(Shape{2, 2}, Strides{2, 2}), {conv2});
+    auto result = graph->add_node_and_edge(std::make_shared<op::Result>(), {pool});
+    graph->set_default_parameters();
+    graph->set_outputs({result});
+
+    // Without the flag the graph is left as it is.
+    auto before = count_ops(graph);
+    EXPECT_TRUE(NchwcLayoutPass().run_on_graph(graph));
+    EXPECT_EQ(count_ops(graph), before);
+
+    ASSERT_TRUE(run_pass(graph));
+    auto counts = count_ops(graph);
+    for (auto type : {"Convolution", "Add", "Broadcast", "Relu", "MaxPool"})
+        EXPECT_EQ(counts[type], 0) << type;
+    EXPECT_EQ(counts["NchwcConv"], 2);
+    EXPECT_EQ(counts["NchwcPool"], 1);
+    // Reorders are only left at the input and the output of the blocked chain.
+    EXPECT_EQ(counts["NchwcReorderInput"], 1);
+    EXPECT_EQ(counts["NchwcReorderOutput"], 1);
+
+    auto output = result->get_in_edge(0)->get_src();
+    ASSERT_EQ(output->get_op_type(), "NchwcReorderOutput");
+    EXPECT_EQ(output->get_output_shape(0), Shape({1, 16, 4, 4}));
+    auto nchwc_pool = output->get_in_edge(0)->get_src();
+    ASSERT_EQ(nchwc_pool->get_op_type(), "NchwcPool");
+    auto nchwc_conv2 = nchwc_pool->get_in_edge(0)->get_src();
+    ASSERT_EQ(nchwc_conv2->get_op_type(), "NchwcConv");
+    auto nchwc_conv1 = nchwc_conv2->get_in_edge(0)->get_src();
+    ASSERT_EQ(nchwc_conv1->get_op_type(), "NchwcConv");
+    // The bias and the Relu are fused into the first convolution.
+    EXPECT_EQ(nchwc_conv1->get_input_size(), 3);
+    EXPECT_EQ(config_of(nchwc_conv1)["activation"], "relu");
+    EXPECT_EQ(nchwc_conv1->get_in_edge(0)->get_src()->get_op_type(), "NchwcReorderInput");
+    EXPECT_EQ(nchwc_conv2->get_input_size(), 2);
+}
+
+TEST(nnfusion_pass_nchwc_layout, first_conv_reads_nchw)
+{
+    // A convolution of fewer input channels than any block reads its input as it is.
+    auto graph = std::make_shared<graph::Graph>();
+    auto x = graph->add_node_and_edge(
+        std::make_shared<op::Parameter>(element::f32, Shape{1, 3, 8, 8}), graph::GNodeVector({}));
+    auto conv = add_conv(graph, x, 16, 3);
+    auto result = graph->add_node_and_edge(std::make_shared<op::Result>(), {conv});
+    graph->set_default_parameters();
+    graph->set_outputs({result});
+
+    ASSERT_TRUE(run_pass(graph));
+    auto counts = count_ops(graph);
+    EXPECT_EQ(counts["Convolution"], 0);
+    EXPECT_EQ(counts["NchwcReorderInput"], 0);
+    EXPECT_EQ(counts["NchwcReorderOutput"], 1);
+    auto nchwc_conv = result->get_in_edge(0)->get_src()->get_in_edge(0)->get_src();
+    ASSERT_EQ(nchwc_conv->get_op_type(), "NchwcConv");
+    EXPECT_TRUE(config_of(nchwc_conv)["nchw_input"].get<bool>());
+    EXPECT_EQ(nchwc_conv->get_in_edge(0)->get_src(), x);
+
+    // Output channels which are not a multiple of the block are not blocked.
+    graph = std::make_shared<graph::Graph>();
+    x = graph->add_node_and_edge(
+        std::make_shared<op::Parameter>(element::f32, Shape{1, 16, 8, 8}), graph::GNodeVector({}));
+    conv = add_conv(graph, x, 12, 3);
+    result = graph->add_node_and_edge(std::make_shared<op::Result>(), {conv});
+    graph->set_default_parameters();
+    graph->set_outputs({result});
+    ASSERT_TRUE(run_pass(graph));
+    EXPECT_EQ(count_ops(graph)["NchwcConv"], 0);
+    EXPECT_EQ(result->get_in_edge(0)->get_src(), conv);
+}
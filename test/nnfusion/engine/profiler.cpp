@@ -63,4 +63,55 @@ TEST(nnfusion_engine_profiler, basic_utils)
         }
     }
     EXPECT_TRUE(has_valid_kernel);
-}
\ No newline at end of file
+}
+
+namespace
+{
+    ProfilingContext::Pointer create_cpu_context(const shared_ptr<GNode>& gnode)
+    {
+        auto kernel_regs = KernelRegistry::Global()->FindKernelRegistrations(
+            gnode->get_op_type(), GENERIC_CPU, element::f32);
+        shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+        for (auto kernel_reg : kernel_regs)
+        {
+            auto kernel = kernel_reg->m_factory(ctx);
+            if (kernel->get_or_emit_source())
+                return make_shared<ProfilingContext>(kernel);
+        }
+        return nullptr;
+    }
+}
+
+TEST(nnfusion_engine_profiler, compile_batches)
+{
+    vector<ProfilingContext::Pointer> pctxs{
+        create_cpu_context(inventory::create_object<op::Abs, float>(0)),
+        create_cpu_context(inventory::create_object<op::Relu, float>(0)),
+        create_cpu_context(inventory::create_object<op::Negative, float>(0)),
+        create_cpu_context(inventory::create_object<op::Pad, float>(0))};
+
+    // Two kernels per library, so the second batch must not bind to the first library.
+    auto runtime = CPUDefaultRuntime::Runtime();
+    CompileScheduler scheduler(runtime, 1, 2);
+    for (auto& pctx : pctxs)
+    {
+        ASSERT_TRUE(pctx != nullptr);
+        scheduler.add(pctx);
+    }
+    EXPECT_EQ(scheduler.run(), pctxs.size());
+
+    std::set<size_t> batches;
+    for (auto& record : scheduler.get_records())
+    {
+        EXPECT_TRUE(record.success);
+        batches.insert(record.batch_id);
+    }
+    EXPECT_GE(batches.size(), 2);
+
+    for (auto& pctx : pctxs)
+    {
+        EXPECT_TRUE(pctx->entry_point != nullptr);
+        Profiler prof(runtime, pctx);
+        EXPECT_TRUE(prof.execute());
+    }
+}
@@ -0,0 +1,200 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/**
+ * \brief Unittest for ShapeBucketCompiler
+ */
+
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/op_define/add.hpp"
+#include "nnfusion/core/operators/op_define/convolution.hpp"
+#include "nnfusion/core/operators/op_define/max_pool.hpp"
+#include "nnfusion/core/operators/op_define/parameter.hpp"
+#include "nnfusion/core/operators/op_define/relu.hpp"
+#include "nnfusion/core/operators/op_define/result.hpp"
+#include "nnfusion/core/operators/op_define/sum.hpp"
+#include "nnfusion/engine/shape_bucket.hpp"
+
+DECLARE_string(fdefault_device);
+
+using namespace nnfusion;
+using nnfusion::engine::ShapeBucketCompiler;
+
+namespace
+{
+    // y = Relu(x) + x with x of shape [batch, 4], and z = Relu(w) + w with w of shape [4] which
+    // is the same in all the buckets. With reduce_batch, y is summed over the batch.
+    graph::Graph::Pointer make_graph(const ShapeBucketCompiler::Bucket& bucket,
+                                     bool reduce_batch = false)
+    {
+        auto graph = std::make_shared<graph::Graph>();
+        graph::GNodeVector outputs;
+        for (auto shape : {Shape{bucket.at("batch"), 4}, Shape{4}})
+        {
+            auto x = graph->add_node_and_edge(std::make_shared<op::Parameter>(element::f32, shape),
+                                              graph::GNodeVector({}));
+            auto relu = graph->add_node_and_edge(std::make_shared<op::Relu>(), {x});
+            std::shared_ptr<graph::GNode> y =
+                graph->add_node_and_edge(std::make_shared<op::Add>(), {relu, x});
+            if (reduce_batch && shape.size() == 2)
+                y = graph->add_node_and_edge(std::make_shared<op::Sum>(AxisSet{0}), {y});
+            outputs.push_back(graph->add_node_and_edge(std::make_shared<op::Result>(), {y}));
+        }
+        graph->set_default_parameters();
+        graph->set_outputs(outputs);
+        return graph;
+    }
+
+    // A MaxPool of window [window, 1] or a Convolution with a [window, window] filter on x of
+    // shape [1, 1, height, 8].
+    graph::Graph::Pointer make_window_graph(const ShapeBucketCompiler::Bucket& bucket,
+                                            bool convolution,
+                                            size_t window)
+    {
+        auto graph = std::make_shared<graph::Graph>();
+        auto x = graph->add_node_and_edge(
+            std::make_shared<op::Parameter>(element::f32, Shape{1, 1, bucket.at("height"), 8}),
+            graph::GNodeVector({}));
+        std::shared_ptr<graph::GNode> y;
+        if (convolution)
+        {
+            auto w = graph->add_node_and_edge(
+                std::make_shared<op::Parameter>(element::f32, Shape{1, 1, window, window}),
+                graph::GNodeVector({}));
+            auto conv = std::make_shared<op::Convolution>(
+                Strides{1, 1}, Strides{1, 1}, CoordinateDiff{0, 0}, CoordinateDiff{0, 0});
+            y = graph->add_node_and_edge(conv, {x, w});
+        }
+        else
+        {
+            y = graph->add_node_and_edge(std::make_shared<op::MaxPool>(Shape{window, 1}), {x});
+        }
+        graph->set_default_parameters();
+        graph->set_outputs({graph->add_node_and_edge(std::make_shared<op::Result>(), {y})});
+        return graph;
+    }
+
+    // Runs the buckets batch:2 and batch:4 at every batch from 1 to 4, and compares each run
+    // with the unpadded run at batch 4 on the same leading rows. Exit codes: 1 for a wrong
+    // bucket, 2 for a different result.
+    const char* bucket_driver = R"(
+#include <cstring>
+#include "nnfusion_rt.h"
+
+int main()
+{
+    cpu_init();
+    float x[16], y[16], w[4], z[4], unpadded[16];
+    for (int i = 0; i < 16; i++)
+        x[i] = i % 7 - 3.0f;
+    for (int i = 0; i < 4; i++)
+        w[i] = i - 1.5f;
+    int64_t dims[] = {4};
+    if (kernel_entry(dims, x, w, unpadded, z) != 1)
+        return 1;
+    for (int batch = 1; batch < 4; batch++)
+    {
+        dims[0] = batch;
+        memset(y, 0, sizeof(y));
+        if (kernel_entry(dims, x, w, y, z) != (batch <= 2 ? 0 : 1))
+            return 1;
+        for (int i = 0; i < batch * 4; i++)
+            if (y[i] != unpadded[i] || y[i] != (x[i] > 0 ? 2 * x[i] : x[i]))
+                return 2;
+        for (int i = 0; i < 4; i++)
+            if (z[i] != (w[i] > 0 ? 2 * w[i] : w[i]))
+                return 2;
+    }
+    cpu_free();
+    return 0;
+}
+)";
+}
+
+TEST(nnfusion_engine_shape_bucket, dynamic_dims)
+{
+    std::vector<ShapeBucketCompiler::Bucket> buckets = {
+        {{"seq", 128}, {"batch", 1}, {"hidden", 768}},
+        {{"seq", 384}, {"batch", 8}, {"hidden", 768}}};
+    auto dims = ShapeBucketCompiler::get_dynamic_dims(buckets);
+    EXPECT_EQ(dims, (std::vector<std::string>{"batch", "seq"}));
+
+    std::vector<Shape> shapes = {Shape{1, 128, 768}, Shape{8, 384, 768}};
+    auto axis_dims = ShapeBucketCompiler::infer_axis_dims(shapes, buckets, dims);
+    EXPECT_EQ(axis_dims, (std::vector<int>{0, 1, -1}));
+}
+
+TEST(nnfusion_engine_shape_bucket, reject_reduction_over_padded_axis)
+{
+    std::vector<graph::Graph::Pointer> graphs = {make_graph({{"batch", 2}}, true),
+                                                 make_graph({{"batch", 4}}, true)};
+    EXPECT_THROW(ShapeBucketCompiler::check_padding(graphs), nnfusion::errors::CheckError);
+
+    graphs = {make_graph({{"batch", 2}}), make_graph({{"batch", 4}})};
+    EXPECT_NO_THROW(ShapeBucketCompiler::check_padding(graphs));
+}
+
+TEST(nnfusion_engine_shape_bucket, reject_window_over_padded_axis)
+{
+    for (bool convolution : {false, true})
+    {
+        // Windows along the padded axis would read the bucket padding at the edge.
+        std::vector<graph::Graph::Pointer> graphs = {
+            make_window_graph({{"height", 6}}, convolution, 3),
+            make_window_graph({{"height", 10}}, convolution, 3)};
+        EXPECT_THROW(ShapeBucketCompiler::check_padding(graphs), nnfusion::errors::CheckError);
+
+        graphs = {make_window_graph({{"height", 6}}, convolution, 1),
+                  make_window_graph({{"height", 10}}, convolution, 1)};
+        EXPECT_NO_THROW(ShapeBucketCompiler::check_padding(graphs));
+    }
+}
+
+TEST(nnfusion_engine_shape_bucket, padded_runs_match_unpadded_run)
+{
+    std::string default_device = FLAGS_fdefault_device;
+    FLAGS_fdefault_device = "CPU";
+    std::string dir = std::string(nnfusion::tmpnam(nullptr)) + "_shape_bucket";
+    ASSERT_EQ(system(("mkdir -p " + dir).c_str()), 0);
+    char cwd[PATH_MAX];
+    ASSERT_NE(getcwd(cwd, PATH_MAX), nullptr);
+    ASSERT_EQ(chdir(dir.c_str()), 0);
+
+    std::string folder = dir + "/cpu_codegen/";
+    ShapeBucketCompiler compiler({{{"batch", 2}}, {{"batch", 4}}}, folder);
+    bool compiled = compiler.run([](const ShapeBucketCompiler::Bucket& bucket) {
+        return make_graph(bucket);
+    });
+    EXPECT_TRUE(compiled);
+    if (compiled)
+    {
+        // The kernels of w are the same in both buckets, the second one calls those of the
+        // first one.
+        std::ifstream cmake_file(folder + "bucket_1/CMakeLists.txt");
+        std::string cmake((std::istreambuf_iterator<char>(cmake_file)),
+                          std::istreambuf_iterator<char>());
+        EXPECT_NE(cmake.find("nnfusion_bucket_0_cpu_rt"), std::string::npos);
+
+        std::ofstream driver(folder + "bucket_check.cpp");
+        driver << bucket_driver;
+        driver.close();
+        std::ofstream cmake_out(folder + "CMakeLists.txt", std::ios::app);
+        cmake_out << "\nadd_executable(bucket_check bucket_check.cpp)\n"
+                  << "target_link_libraries(bucket_check nnfusion_cpu_rt)\n";
+        cmake_out.close();
+        std::string build = "cd " + folder + " && cmake . > /dev/null && make -j > /dev/null";
+        ASSERT_EQ(system(build.c_str()), 0);
+        int status = system(("cd " + folder + " && ./bucket_check").c_str());
+        ASSERT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+
+    FLAGS_fdefault_device = default_device;
+    ASSERT_EQ(chdir(cwd), 0);
+    system(("rm -rf " + dir).c_str());
+}
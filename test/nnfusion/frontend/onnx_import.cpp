@@ -2,8 +2,10 @@
 //  Licensed under the MIT License.
 
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <vector>
 
@@ -11,8 +13,10 @@
 #include "gtest/gtest.h"
 #include "nnfusion/engine/util/file_util.hpp"
 #include "nnfusion/frontend/onnx_import/onnx.hpp"
+#include "nnfusion/frontend/onnx_import/util/graph_convert.hpp"
 
 DECLARE_bool(fantares_mode);
+DECLARE_bool(fonnx_mmap_external_data);
 
 using namespace nnfusion;
 using Inputs = vector<vector<float>>;
@@ -1652,4 +1656,91 @@ TEST(nnfusion_onnx_import, gru_op)
             outputs[i] = 0;
     }
     EXPECT_TRUE(test::all_close_f(expected_outputs, outputs));
-}
\ No newline at end of file
+}
+TEST(nnfusion_onnx_import, mmap_external_data)
+{
+    // weights.bin holds a float[2, 3] at the aligned offset 16, a float[3] at the misaligned
+    // offset 42 and a single float at 56 for a float[4], which is broadcast.
+    std::string dir = std::string(nnfusion::tmpnam(nullptr)) + "_external_data";
+    ASSERT_EQ(system(("mkdir -p " + dir).c_str()), 0);
+    std::string path = dir + "/weights.bin";
+    std::vector<float> aligned{1.5f, -2, 3, 0.25f, 5, -6}, misaligned{7, 8.5f, -9},
+        broadcast{10.75f};
+    std::vector<char> bytes(60, 0);
+    memcpy(bytes.data() + 16, aligned.data(), 24);
+    memcpy(bytes.data() + 42, misaligned.data(), 12);
+    memcpy(bytes.data() + 56, broadcast.data(), 4);
+    std::ofstream(path, std::ios::binary).write(bytes.data(), bytes.size());
+
+    onnx::ModelProto model;
+    model.set_ir_version(7);
+    model.add_opset_import()->set_version(11);
+    auto graph_proto = model.mutable_graph();
+    auto add_initializer = [&](
+        const std::string& name, const Shape& shape, size_t offset, size_t length) {
+        auto tensor = graph_proto->add_initializer();
+        tensor->set_name(name);
+        tensor->set_data_type(onnx::TensorProto_DataType_FLOAT);
+        for (auto dim : shape)
+            tensor->add_dims(dim);
+        tensor->set_data_location(onnx::TensorProto_DataLocation_EXTERNAL);
+        for (auto& entry : std::vector<std::pair<std::string, std::string>>{
+                 {"location", "weights.bin"},
+                 {"offset", std::to_string(offset)},
+                 {"length", std::to_string(length)}})
+        {
+            auto external_data = tensor->add_external_data();
+            external_data->set_key(entry.first);
+            external_data->set_value(entry.second);
+        }
+        auto node = graph_proto->add_node();
+        node->set_op_type("Identity");
+        node->add_input(name);
+        node->add_output(name + "_out");
+        graph_proto->add_output()->set_name(name + "_out");
+    };
+    add_initializer("aligned", Shape{2, 3}, 16, 24);
+    add_initializer("misaligned", Shape{3}, 42, 12);
+    add_initializer("broadcast", Shape{4}, 56, 4);
+
+    bool mmap_external_data = FLAGS_fonnx_mmap_external_data;
+    FLAGS_fonnx_mmap_external_data = true;
+    std::shared_ptr<graph::Graph> graph;
+    {
+        // The converter drops its own references to the mapping when it goes.
+        frontend::onnx_import::GraphConvert convert{model, {}, dir};
+        graph = convert.get_graph();
+    }
+    FLAGS_fonnx_mmap_external_data = mmap_external_data;
+
+    std::map<std::string, std::shared_ptr<op::Constant>> constants;
+    for (auto& gnode : graph->get_nodes())
+    {
+        if (auto constant = std::dynamic_pointer_cast<op::Constant>(gnode->get_op_ptr()))
+            constants[constant->get_name()] = constant;
+    }
+    ASSERT_EQ(constants.size(), 3u);
+
+    // Only the aligned one is built on the mapping of the file, the others are read.
+    EXPECT_FALSE(constants["aligned"]->get_storage()->owns_data());
+    EXPECT_TRUE(constants["misaligned"]->get_storage()->owns_data());
+    EXPECT_TRUE(constants["broadcast"]->get_storage()->owns_data());
+    auto address = reinterpret_cast<uintptr_t>(constants["aligned"]->get_data_ptr());
+    bool in_mapping = false;
+    std::ifstream maps("/proc/self/maps");
+    for (std::string line; std::getline(maps, line);)
+    {
+        unsigned long start = 0, end = 0;
+        if (line.find(path) != std::string::npos &&
+            sscanf(line.c_str(), "%lx-%lx", &start, &end) == 2 && start <= address &&
+            address + 24 <= end)
+            in_mapping = true;
+    }
+    EXPECT_TRUE(in_mapping);
+
+    // The mapping lives as long as the constant, even without the file.
+    ASSERT_EQ(system(("rm -rf " + dir).c_str()), 0);
+    EXPECT_EQ(constants["aligned"]->get_vector<float>(), aligned);
+    EXPECT_EQ(constants["misaligned"]->get_vector<float>(), misaligned);
+    EXPECT_EQ(constants["broadcast"]->get_vector<float>(), std::vector<float>(4, broadcast[0]));
+}
@@ -0,0 +1,174 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+///\brief Tests of the built-in lowering of Antares IR to CPU loops
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/kernels/cpu/antares/antares_lowering.hpp"
+#include "nnfusion/core/operators/op_define/dot.hpp"
+#include "nnfusion/core/operators/op_define/softmax.hpp"
+#include "nnfusion/engine/pass/graph/kernel_tuning.hpp"
+
+DECLARE_bool(fantares_cpu_builtin);
+
+using namespace nnfusion;
+using namespace nnfusion::kernels::cpu;
+
+namespace
+{
+    std::string einstein(const std::string& expr, const std::string& inputs)
+    {
+        return " - einstein_v2(\"" + expr + "\", input_dict={" + inputs + "}) ";
+    }
+
+    // Run the built-in antares kernel of gnode on the concatenated inputs, return its first
+    // output.
+    std::vector<float> run_antares(std::shared_ptr<GNode> gnode, const std::vector<float>& inputs)
+    {
+        FLAGS_fantares_cpu_builtin = true;
+        nnfusion::pass::graph::KernelTuning().register_builtin_cpu_kernel();
+        auto rt = get_default_runtime(GENERIC_CPU);
+        EXPECT_TRUE(rt != nullptr);
+        std::vector<float> output;
+        shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+        for (auto& kernel_reg : KernelRegistry::Global()->FindKernelRegistrations(
+                 gnode->get_op_type(), GENERIC_CPU, element::f32))
+        {
+            if (kernel_reg->m_tag != "antares")
+                continue;
+            auto kernel = kernel_reg->m_factory(ctx);
+            if (kernel->get_or_emit_source() == nullptr)
+                break;
+            auto pctx = make_shared<ProfilingContext>(kernel);
+            pctx->warmup_times = 0;
+            pctx->runtime_times = 1;
+            Profiler prof(rt, pctx);
+            auto res = prof.unsafe_execute<float>((void*)inputs.data());
+            if (!res.empty())
+                output = res[0];
+            break;
+        }
+        FLAGS_fantares_cpu_builtin = false;
+        EXPECT_FALSE(output.empty()) << "No built-in antares kernel of " << gnode->get_name();
+        return output;
+    }
+
+    const size_t N = 4, K = 8, M = 256;
+
+    // output0[N, M] +=! input0[N, K] * input1[K, M], whose rows are longer than a vector.
+    std::shared_ptr<GNode> make_dot()
+    {
+        auto graph = std::make_shared<graph::Graph>();
+        auto A = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{N, K}),
+                                          GNodeVector({}));
+        auto B = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{K, M}),
+                                          GNodeVector({}));
+        return graph->add_node_and_edge(make_shared<op::Dot>(), {A, B});
+    }
+
+    // Checks the kernel of the Dot of make_dot on inputs which are exact in float.
+    void check_dot(std::shared_ptr<GNode> dot)
+    {
+        std::vector<float> inputs(N * K + K * M), expected(N * M, 0);
+        for (size_t i = 0; i < inputs.size(); i++)
+            inputs[i] = static_cast<float>(i * 7 % 13) - 6;
+        for (size_t n = 0; n < N; n++)
+            for (size_t k = 0; k < K; k++)
+                for (size_t m = 0; m < M; m++)
+                    expected[n * M + m] += inputs[n * K + k] * inputs[N * K + k * M + m];
+        EXPECT_EQ(run_antares(dot, inputs), expected);
+    }
+}
+
+TEST(nnfusion_core_kernels, antares_lowering_dot)
+{
+    check_dot(make_dot());
+}
+
+// Softmax keeps its max and its sum of exponentials in mediates, the output reads both.
+TEST(nnfusion_core_kernels, antares_lowering_mediates)
+{
+    const size_t rows = 3, cols = 10;
+    auto graph = std::make_shared<graph::Graph>();
+    auto x = graph->add_node_and_edge(
+        make_shared<op::Parameter>(element::f32, Shape{rows, cols}), GNodeVector({}));
+    auto softmax = graph->add_node_and_edge(make_shared<op::Softmax>(AxisSet{1}), {x});
+
+    // The last row overflows exp without the max subtracted.
+    std::vector<float> inputs(rows * cols), expected(rows * cols);
+    for (size_t i = 0; i < inputs.size(); i++)
+        inputs[i] = std::sin(0.7f * i) * (i < 2 * cols ? 3.0f : 1000.0f);
+    for (size_t r = 0; r < rows; r++)
+    {
+        double max = inputs[r * cols], sum = 0;
+        for (size_t c = 0; c < cols; c++)
+            max = std::max<double>(max, inputs[r * cols + c]);
+        for (size_t c = 0; c < cols; c++)
+            sum += std::exp(inputs[r * cols + c] - max);
+        for (size_t c = 0; c < cols; c++)
+            expected[r * cols + c] = std::exp(inputs[r * cols + c] - max) / sum;
+    }
+    auto output = run_antares(softmax, inputs);
+    ASSERT_EQ(output.size(), expected.size());
+    for (size_t i = 0; i < output.size(); i++)
+        EXPECT_NEAR(output[i], expected[i], 1e-6) << "i = " << i;
+}
+
+TEST(nnfusion_core_kernels, antares_lowering_unsupported)
+{
+    auto inputs = R"( "input0" : { "dtype" : "float32", "shape" : [3]} )";
+    // scatters of =. are left to the codegen server
+    EXPECT_FALSE(AntaresLowering(einstein(" output0[N] =. input0[N]; ", inputs),
+                                 {{"float32", Shape{3}}})
+                     .is_valid());
+    // the output shape of the IR has to match the graph
+    EXPECT_FALSE(AntaresLowering(einstein(" output0[N] = input0[N]; ", inputs),
+                                 {{"float32", Shape{4}}})
+                     .is_valid());
+    EXPECT_FALSE(AntaresLowering(einstein(" output0[N] = input0[N].call(`lgamma`); ", inputs),
+                                 {{"float32", Shape{3}}})
+                     .is_valid());
+    EXPECT_FALSE(AntaresLowering("- input(\"input0\", [3]); ", {{"float32", Shape{3}}}).is_valid());
+    // an axis indexing dims of different sizes
+    EXPECT_FALSE(AntaresLowering(einstein(" output0[N] = input0[N] + input1[N]; ",
+                                          std::string(inputs) + R"(, "input1" : { "dtype" : )"
+                                                                R"("float32", "shape" : [4]} )"),
+                                 {{"float32", Shape{3}}})
+                     .is_valid());
+}
+
+TEST(nnfusion_core_kernels, antares_lowering_schedule)
+{
+    auto ir = einstein(" output0[N, M] +=! input0[N, K] * input1[K, M]; ",
+                       R"( "input0" : { "dtype" : "float32", "shape" : [4, 8]} , )"
+                       R"( "input1" : { "dtype" : "float32", "shape" : [8, 256]} )");
+    AntaresLowering lowering(ir, {{"float32", Shape{4, 256}}});
+    ASSERT_TRUE(lowering.is_valid()) << lowering.get_error();
+    EXPECT_TRUE(lowering.has_reduction_order());
+    EXPECT_EQ(lowering.get_max_row_length(), 256);
+
+    AntaresCpuSchedule schedule;
+    EXPECT_TRUE(schedule.is_default());
+    schedule.tile = 64;
+    schedule.vector_width = 8;
+    schedule.shards_per_thread = 2;
+    auto parsed = AntaresCpuSchedule::from_json(schedule.to_json());
+    EXPECT_EQ(parsed.to_string(), "t64_oa_v8_s2");
+
+    // tiles of 64 columns, vectors of 8 and two shards per thread
+    auto dot = make_dot();
+    (*dot)["AntaresCpuSchedule"] = parsed;
+    check_dot(dot);
+
+    // a scalar accumulator per element instead
+    dot = make_dot();
+    schedule = AntaresCpuSchedule();
+    schedule.reduce_outside = 0;
+    (*dot)["AntaresCpuSchedule"] = schedule;
+    check_dot(dot);
+}
@@ -5,6 +5,7 @@
 ///
 ///\author wenxh, ziming
 
+#include <cmath>
 #include <iostream>
 #include <set>
 #include <string>
@@ -53,18 +54,36 @@
 #include "nnfusion/core/operators/op_define/subtract.hpp"
 #include "nnfusion/core/operators/op_define/sum.hpp"
 #include "nnfusion/engine/pass/graph/kernel_selection.hpp"
+#include "nnfusion/engine/pass/graph/kernel_tuning.hpp"
 #include "nnfusion/engine/profiler/profiler.hpp"
 
 using namespace nnfusion::inventory;
 using namespace nnfusion::profiler;
 
 DECLARE_bool(fantares_mode);
+DECLARE_bool(fantares_cpu_builtin);
+DECLARE_string(fcpu_simd_isa);
 namespace nnfusion
 {
     namespace test
     {
         ///\todo Maybe a better/general way
 
+        // Whether the kernel with tag emits code for the first case of T.
+        template <typename T, typename val_t = float>
+        bool has_kernel(NNFusion_DeviceType dev_t, element::Type data_t, const std::string& tag)
+        {
+            auto gnode = create_object<T, val_t>(0);
+            shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+            for (auto& kernel_reg : KernelRegistry::Global()->FindKernelRegistrations(
+                     gnode->get_op_type(), dev_t, data_t))
+            {
+                if (kernel_reg->m_tag == tag && kernel_reg->m_factory(ctx)->get_or_emit_source())
+                    return true;
+            }
+            return false;
+        }
+
         template <typename T, typename val_t = float>
         bool check_kernels(NNFusion_DeviceType dev_t, element::Type data_t)
         {
@@ -343,4 +362,72 @@ TEST(nnfusion_core_kernels, batch_kernel_tests_sum)
 {
     EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Sum>(GENERIC_CPU, element::f32));
     EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Sum>(CUDA_GPU, element::f32));
-}
\ No newline at end of file
+}
+// The Antares IR lowered to CPU loops by nnfusion, checked with the other CPU kernels of the
+// elementwise, reduction and matmul ops.
+TEST(nnfusion_core_kernels, batch_kernel_tests_antares_cpu_builtin)
+{
+    FLAGS_fantares_cpu_builtin = true;
+    nnfusion::pass::graph::KernelTuning().register_builtin_cpu_kernel();
+    EXPECT_TRUE(
+        nnfusion::test::has_kernel<nnfusion::op::Add>(GENERIC_CPU, element::f32, "antares"));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Add>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(
+        nnfusion::test::has_kernel<nnfusion::op::Sum>(GENERIC_CPU, element::f32, "antares"));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Sum>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(
+        nnfusion::test::has_kernel<nnfusion::op::Dot>(GENERIC_CPU, element::f32, "antares"));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Dot>(GENERIC_CPU, element::f32));
+    FLAGS_fantares_cpu_builtin = false;
+}
+
+// The AVX-512 variants of the SIMD elementwise kernels, with the ceil/floor helpers and the masked
+// tail. The compares are left out like above, since their outputs are bool.
+TEST(nnfusion_core_kernels, batch_kernel_tests_simd_avx512)
+{
+    if (!__builtin_cpu_supports("avx512f"))
+    {
+        NNFUSION_LOG(INFO) << "The host does not support AVX-512, skip the test.";
+        return;
+    }
+    std::string isa = FLAGS_fcpu_simd_isa;
+    FLAGS_fcpu_simd_isa = "avx512";
+    EXPECT_TRUE(nnfusion::test::has_kernel<nnfusion::op::Add>(GENERIC_CPU, element::f32, "simd"));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Abs>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Add>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Ceiling>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Divide>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Floor>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Maximum>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Minimum>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(
+        nnfusion::test::check_kernels<nnfusion::op::Multiply>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(
+        nnfusion::test::check_kernels<nnfusion::op::Negative>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Relu>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(nnfusion::test::check_kernels<nnfusion::op::Sqrt>(GENERIC_CPU, element::f32));
+    EXPECT_TRUE(
+        nnfusion::test::check_kernels<nnfusion::op::Subtract>(GENERIC_CPU, element::f32));
+
+    // The cases above fit in the tail, 37 elements also run two full vectors.
+    auto graph = std::make_shared<graph::Graph>();
+    auto A = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{37}),
+                                      GNodeVector({}));
+    auto B = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{37}),
+                                      GNodeVector({}));
+    auto add = graph->add_node_and_edge(make_shared<op::Add>(), {A, B});
+    auto floor = graph->add_node_and_edge(make_shared<op::Floor>(), {A});
+    vector<float> a(37), b(37), sum(37), floored(37);
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        a[i] = 0.75f * i - 13;
+        b[i] = 2.0f * i;
+        sum[i] = a[i] + b[i];
+        floored[i] = std::floor(a[i]);
+    }
+    vector<float> add_input(a);
+    add_input.insert(add_input.end(), b.begin(), b.end());
+    EXPECT_TRUE(nnfusion::test::check_kernel<float>(add, GENERIC_CPU, add_input, sum));
+    EXPECT_TRUE(nnfusion::test::check_kernel<float>(floor, GENERIC_CPU, a, floored));
+    FLAGS_fcpu_simd_isa = isa;
+}
@@ -0,0 +1,270 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+///\brief Tests of the CPU kernels of If, Loop and Scan, run in a generated runtime
+
+#include <string>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/op_define/less.hpp"
+#include "nnfusion/test_util/cpu_runtime.hpp"
+
+namespace
+{
+    std::shared_ptr<GNode> add_parameter(const std::shared_ptr<graph::Graph>& graph,
+                                         const element::Type& type,
+                                         const Shape& shape)
+    {
+        return graph->add_node_and_edge(make_shared<op::Parameter>(type, shape),
+                                        GNodeVector({}));
+    }
+
+    std::shared_ptr<GNode> add_result(const std::shared_ptr<graph::Graph>& graph,
+                                      const std::shared_ptr<GNode>& value,
+                                      int output = 0,
+                                      bool to_host = true)
+    {
+        auto result_op = make_shared<op::Result>();
+        result_op->set_needs_copy_to_host(to_host);
+        return graph->add_node_and_edge(result_op, GNodeIndexVector{GNodeIndex(value, output)});
+    }
+
+    std::shared_ptr<GNode> add_body_input(op::ControlFlowBody& body,
+                                          const element::Type& type,
+                                          const Shape& shape)
+    {
+        auto param = add_parameter(body.graph, type, shape);
+        body.inputs.push_back(param);
+        return param;
+    }
+
+    void add_body_output(op::ControlFlowBody& body, const std::shared_ptr<GNode>& value)
+    {
+        body.outputs.push_back(add_result(body.graph, value, 0, false));
+    }
+
+    void finish(op::ControlFlowBody& body)
+    {
+        body.graph->set_default_parameters();
+        body.graph->set_outputs(body.outputs);
+    }
+
+    // Compiles graph with the CPU engine, builds its runtime together with driver and runs
+    // it. Returns the exit code of the driver, or -1 when the runtime fails to build.
+    int run_driver(const std::shared_ptr<graph::Graph>& graph, const char* driver)
+    {
+        nnfusion::test::CpuRuntime runtime(graph);
+        if (!runtime.build(driver))
+            return -1;
+        return runtime.run("./runtime_check");
+    }
+
+    // y = (x + x) * x if cond, else -x. Exit code 1 for a wrong value.
+    const char* if_driver = R"(
+#include "nnfusion_rt.h"
+
+int main()
+{
+    cpu_init();
+    float x[6] = {-3, -1.5, 0, 1, 2.5, 4}, y[6];
+    for (char cond = 0; cond < 2; cond++)
+    {
+        kernel_entry(&cond, x, y);
+        for (int i = 0; i < 6; i++)
+            if (y[i] != (cond ? (x[i] + x[i]) * x[i] : -x[i]))
+                return 1;
+    }
+    cpu_free();
+    return 0;
+}
+)";
+
+    // A Fibonacci-like sequence (a, b) -> (b, a + b) of vectors with a counter c, stopping
+    // once c + 1 reaches the limit but after 5 iterations at most. The sums a + b are
+    // stacked. Exit code 1 for a wrong final value, 2 for a wrong stacked sum.
+    const char* loop_driver = R"(
+#include "nnfusion_rt.h"
+
+int main()
+{
+    cpu_init();
+    float a0[4] = {1, 0, -1, 2}, b0[4] = {0, 1, 3, -2}, c0[1] = {0};
+    for (float limit = 1; limit <= 7; limit += 2)
+    {
+        float a[4], b[4], c[1], sums[5 * 4];
+        kernel_entry(a0, b0, c0, &limit, a, b, c, sums);
+
+        float ra[4], rb[4], rc = c0[0], rsums[5 * 4] = {0};
+        for (int j = 0; j < 4; j++)
+        {
+            ra[j] = a0[j];
+            rb[j] = b0[j];
+        }
+        for (int i = 0; i < 5; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                float s = ra[j] + rb[j];
+                rsums[i * 4 + j] = s;
+                ra[j] = rb[j];
+                rb[j] = s;
+            }
+            rc += 1;
+            if (!(rc < limit))
+                break;
+        }
+        if (c[0] != rc)
+            return 1;
+        for (int j = 0; j < 4; j++)
+            if (a[j] != ra[j] || b[j] != rb[j])
+                return 1;
+        for (int i = 0; i < 5 * 4; i++)
+            if (sums[i] != rsums[i])
+                return 2;
+    }
+    cpu_free();
+    return 0;
+}
+)";
+
+    // A running sum over the rows of a 3x4 input read from its last row on, stacked forward
+    // and backward. Exit code 1 for a wrong value.
+    const char* scan_driver = R"(
+#include "nnfusion_rt.h"
+
+int main()
+{
+    cpu_init();
+    float init[4] = {1, 2, 3, 4}, rows[3 * 4], sum[4], forward[3 * 4], backward[3 * 4];
+    for (int i = 0; i < 3 * 4; i++)
+        rows[i] = i * 0.5f - 2;
+    kernel_entry(init, rows, sum, forward, backward);
+
+    float s[4] = {1, 2, 3, 4};
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            s[j] += rows[(2 - i) * 4 + j];
+            if (forward[i * 4 + j] != s[j] || backward[(2 - i) * 4 + j] != s[j])
+                return 1;
+        }
+    }
+    for (int j = 0; j < 4; j++)
+        if (sum[j] != s[j])
+            return 1;
+    cpu_free();
+    return 0;
+}
+)";
+}
+
+TEST(nnfusion_core_kernels, control_flow_if)
+{
+    auto graph = std::make_shared<graph::Graph>();
+    auto cond = add_parameter(graph, element::boolean, Shape{});
+    auto x = add_parameter(graph, element::f32, Shape{2, 3});
+
+    // (x + x) * x keeps x + x in the workspace of the branch
+    op::ControlFlowBody then_branch;
+    then_branch.graph = std::make_shared<graph::Graph>();
+    auto then_x = add_parameter(then_branch.graph, element::f32, Shape{2, 3});
+    then_branch.captures.emplace_back(then_x, 1);
+    auto twice = then_branch.graph->add_node_and_edge(make_shared<op::Add>(),
+                                                      GNodeVector({then_x, then_x}));
+    add_body_output(then_branch,
+                    then_branch.graph->add_node_and_edge(make_shared<op::Multiply>(),
+                                                         GNodeVector({twice, then_x})));
+    finish(then_branch);
+
+    op::ControlFlowBody else_branch;
+    else_branch.graph = std::make_shared<graph::Graph>();
+    auto else_x = add_parameter(else_branch.graph, element::f32, Shape{2, 3});
+    else_branch.captures.emplace_back(else_x, 1);
+    add_body_output(else_branch,
+                    else_branch.graph->add_node_and_edge(make_shared<op::Negative>(),
+                                                         GNodeVector({else_x})));
+    finish(else_branch);
+
+    auto if_node = graph->add_node_and_edge(
+        make_shared<op::If>(then_branch, else_branch), GNodeVector({cond, x}), 1);
+    graph->set_default_parameters();
+    graph->set_outputs({add_result(graph, if_node)});
+    EXPECT_EQ(run_driver(graph, if_driver), 0);
+}
+
+TEST(nnfusion_core_kernels, control_flow_loop_early_exit)
+{
+    auto graph = std::make_shared<graph::Graph>();
+    auto trip_count = graph->add_node_and_edge(
+        make_shared<op::Constant>(element::i64, Shape{}, std::vector<int64_t>{5}),
+        GNodeVector({}));
+    auto cond = graph->add_node_and_edge(
+        make_shared<op::Constant>(element::boolean, Shape{}, std::vector<char>{1}),
+        GNodeVector({}));
+    auto a0 = add_parameter(graph, element::f32, Shape{4});
+    auto b0 = add_parameter(graph, element::f32, Shape{4});
+    auto c0 = add_parameter(graph, element::f32, Shape{1});
+    auto limit = add_parameter(graph, element::f32, Shape{1});
+
+    // (a, b, c) -> (b, a + b, c + 1), the next a is the previous b and has to be staged
+    op::ControlFlowBody body;
+    body.graph = std::make_shared<graph::Graph>();
+    add_body_input(body, element::i64, Shape{});
+    add_body_input(body, element::boolean, Shape{});
+    auto a = add_body_input(body, element::f32, Shape{4});
+    auto b = add_body_input(body, element::f32, Shape{4});
+    auto c = add_body_input(body, element::f32, Shape{1});
+    auto body_limit = add_parameter(body.graph, element::f32, Shape{1});
+    body.captures.emplace_back(body_limit, 5);
+    auto one = body.graph->add_node_and_edge(
+        make_shared<op::Constant>(element::f32, Shape{1}, std::vector<float>{1}),
+        GNodeVector({}));
+    auto sum = body.graph->add_node_and_edge(make_shared<op::Add>(), GNodeVector({a, b}));
+    auto next_c = body.graph->add_node_and_edge(make_shared<op::Add>(), GNodeVector({c, one}));
+    auto next_cond = body.graph->add_node_and_edge(make_shared<op::Less>(),
+                                                   GNodeVector({next_c, body_limit}));
+    add_body_output(body, next_cond);
+    add_body_output(body, b);
+    add_body_output(body, sum);
+    add_body_output(body, next_c);
+    add_body_output(body, sum);
+    finish(body);
+
+    auto loop = graph->add_node_and_edge(make_shared<op::Loop>(body, true, true, 5),
+                                         GNodeVector({trip_count, cond, a0, b0, c0, limit}),
+                                         4);
+    EXPECT_EQ(loop->get_output_shape(3), Shape({5, 4}));
+    graph->set_default_parameters();
+    graph->set_outputs({add_result(graph, loop, 0),
+                        add_result(graph, loop, 1),
+                        add_result(graph, loop, 2),
+                        add_result(graph, loop, 3)});
+    EXPECT_EQ(run_driver(graph, loop_driver), 0);
+}
+
+TEST(nnfusion_core_kernels, control_flow_scan_reverse)
+{
+    auto graph = std::make_shared<graph::Graph>();
+    auto init = add_parameter(graph, element::f32, Shape{4});
+    auto rows = add_parameter(graph, element::f32, Shape{3, 4});
+
+    op::ControlFlowBody body;
+    body.graph = std::make_shared<graph::Graph>();
+    auto sum = add_body_input(body, element::f32, Shape{4});
+    auto row = add_body_input(body, element::f32, Shape{4});
+    auto add = body.graph->add_node_and_edge(make_shared<op::Add>(), GNodeVector({sum, row}));
+    add_body_output(body, add);
+    add_body_output(body, add);
+    add_body_output(body, add);
+    finish(body);
+
+    auto scan_op =
+        make_shared<op::Scan>(body, 1, std::vector<bool>{true}, std::vector<bool>{false, true});
+    auto scan = graph->add_node_and_edge(scan_op, GNodeVector({init, rows}), 3);
+    graph->set_default_parameters();
+    graph->set_outputs(
+        {add_result(graph, scan, 0), add_result(graph, scan, 1), add_result(graph, scan, 2)});
+    EXPECT_EQ(run_driver(graph, scan_driver), 0);
+}
@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+///\brief Tests of the CPU kernels of FusedDot and FusedConv, i.e. the bias, residual and
+/// activation applied by GemmEpilogueFusionPass
+
+#include <string>
+#include <vector>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+namespace
+{
+    std::shared_ptr<GNode> make_fused(const std::string& op_type,
+                                      const std::vector<Shape>& input_shapes,
+                                      nnfusion::op::OpConfig::any config)
+    {
+        auto graph = std::make_shared<graph::Graph>();
+        GNodeVector inputs;
+        for (auto& shape : input_shapes)
+            inputs.push_back(graph->add_node_and_edge(
+                make_shared<op::Parameter>(element::f32, shape), GNodeVector({})));
+        auto op = std::make_shared<nnfusion::op::GenericOp>(op_type, op_type, config);
+        return graph->add_node_and_edge(op, inputs);
+    }
+
+    std::vector<float> concat(const std::vector<std::vector<float>>& inputs)
+    {
+        std::vector<float> all;
+        for (auto& input : inputs)
+            all.insert(all.end(), input.begin(), input.end());
+        return all;
+    }
+}
+
+TEST(nnfusion_core_kernels, fused_dot)
+{
+    // A * B is {{-5, 6}, {-8, 12}}
+    std::vector<float> A{1, 2, 3, 4, 5, 6}, B{1, -1, 0, 2, -2, 1};
+    std::vector<float> bias{1, -2}, residual{0.5, -10, 3, 1};
+
+    nnfusion::op::OpConfig::any config;
+    config["has_bias"] = true;
+    auto gnode = make_fused("FusedDot", {{2, 3}, {3, 2}, {2}}, config);
+    EXPECT_TRUE(nnfusion::test::check_kernel<float>(
+        gnode, GENERIC_CPU, concat({A, B, bias}), {-4, 4, -7, 10}));
+
+    config["has_residual"] = true;
+    config["activation"] = "relu";
+    gnode = make_fused("FusedDot", {{2, 3}, {3, 2}, {2}, {2, 2}}, config);
+    EXPECT_TRUE(nnfusion::test::check_kernel<float>(
+        gnode, GENERIC_CPU, concat({A, B, bias, residual}), {0, 0, 0, 11}));
+
+    // B transposed, with the residual alone
+    config = nnfusion::op::OpConfig::any();
+    config["trans_B"] = true;
+    config["has_residual"] = true;
+    std::vector<float> B_T{1, 0, -2, -1, 2, 1};
+    gnode = make_fused("FusedDot", {{2, 3}, {2, 3}, {2, 2}}, config);
+    EXPECT_TRUE(nnfusion::test::check_kernel<float>(
+        gnode, GENERIC_CPU, concat({A, B_T, residual}), {-4.5, -4, -5, 13}));
+}
+
+TEST(nnfusion_core_kernels, fused_conv)
+{
+    // The first filter adds the diagonal neighbour, the second one subtracts the lower
+    // neighbour from the right one: {{6, 8}, {12, 14}} and {{-2, -2}, {-2, -2}}.
+    std::vector<float> input{1, 2, 3, 4, 5, 6, 7, 8, 9}, filter{1, 0, 0, 1, 0, 1, -1, 0};
+    std::vector<float> bias{1, 0.5}, residual{0, 0, 0, 0, 1, 2, 3, 4};
+
+    nnfusion::op::OpConfig::any config;
+    config["strides"] = std::vector<int64_t>{1, 1};
+    config["dilations"] = std::vector<int64_t>{1, 1};
+    config["padding_below"] = std::vector<int64_t>{0, 0};
+    config["padding_above"] = std::vector<int64_t>{0, 0};
+    config["data_format"] = "NCHW";
+    config["activation"] = "relu";
+    config["has_bias"] = true;
+    auto gnode = make_fused("FusedConv", {{1, 1, 3, 3}, {2, 1, 2, 2}, {2}}, config);
+    EXPECT_TRUE(nnfusion::test::check_kernel<float>(
+        gnode, GENERIC_CPU, concat({input, filter, bias}), {7, 9, 13, 15, 0, 0, 0, 0}));
+
+    config["has_residual"] = true;
+    gnode = make_fused("FusedConv", {{1, 1, 3, 3}, {2, 1, 2, 2}, {2}, {1, 2, 2, 2}}, config);
+    EXPECT_TRUE(nnfusion::test::check_kernel<float>(gnode,
+                                                    GENERIC_CPU,
+                                                    concat({input, filter, bias, residual}),
+                                                    {7, 9, 13, 15, 0, 0.5, 1.5, 2.5}));
+}
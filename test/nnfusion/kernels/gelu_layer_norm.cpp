@@ -0,0 +1,292 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+///\brief Tests of the SIMD CPU kernels of Gelu and LayerNorm against references in double
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+namespace
+{
+    // Run the kernel of gnode with tag on the concatenated inputs, return its first output.
+    std::vector<float> run_kernel(std::shared_ptr<GNode> gnode,
+                                  const std::string& tag,
+                                  const std::vector<float>& inputs)
+    {
+        auto rt = get_default_runtime(GENERIC_CPU);
+        EXPECT_TRUE(rt != nullptr);
+        auto kernel_regs = KernelRegistry::Global()->FindKernelRegistrations(
+            gnode->get_op_type(), GENERIC_CPU, element::f32);
+        shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+        for (auto& kernel_reg : kernel_regs)
+        {
+            if (kernel_reg->m_tag != tag)
+                continue;
+            auto kernel = kernel_reg->m_factory(ctx);
+            EXPECT_TRUE(kernel->get_or_emit_source() != nullptr);
+            auto pctx = make_shared<ProfilingContext>(kernel);
+            pctx->warmup_times = 0;
+            pctx->runtime_times = 1;
+            Profiler prof(rt, pctx);
+            auto res = prof.unsafe_execute<float>((void*)inputs.data());
+            EXPECT_FALSE(res.empty());
+            return res.empty() ? std::vector<float>() : res[0];
+        }
+        ADD_FAILURE() << "There is no " << tag << " kernel of " << gnode->get_op_type();
+        return {};
+    }
+
+    // Run the simd kernel of gnode on inputs of mixed types, return the bytes of its outputs.
+    std::vector<std::vector<char>> run_simd_kernel(std::shared_ptr<GNode> gnode,
+                                                   const std::vector<std::vector<char>>& inputs)
+    {
+        auto rt = get_default_runtime(GENERIC_CPU);
+        EXPECT_TRUE(rt != nullptr);
+        shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+        for (auto& kernel_reg : KernelRegistry::Global()->FindKernelRegistrations(
+                 gnode->get_op_type(), GENERIC_CPU, element::f32))
+        {
+            if (kernel_reg->m_tag != "simd")
+                continue;
+            auto kernel = kernel_reg->m_factory(ctx);
+            EXPECT_TRUE(kernel->get_or_emit_source() != nullptr);
+            auto pctx = make_shared<ProfilingContext>(kernel);
+            pctx->warmup_times = 0;
+            pctx->runtime_times = 1;
+            Profiler prof(rt, pctx);
+            std::vector<std::vector<char>> outputs;
+            EXPECT_TRUE(prof.mixed_type_execute(inputs, outputs));
+            return outputs;
+        }
+        ADD_FAILURE() << "There is no simd kernel of " << gnode->get_op_type();
+        return {};
+    }
+
+    template <typename T>
+    std::vector<char> to_bytes(const std::vector<T>& values)
+    {
+        std::vector<char> bytes(values.size() * sizeof(T));
+        memcpy(bytes.data(), values.data(), bytes.size());
+        return bytes;
+    }
+
+    template <typename T>
+    std::vector<T> from_bytes(const std::vector<char>& bytes)
+    {
+        std::vector<T> values(bytes.size() / sizeof(T));
+        memcpy(values.data(), bytes.data(), values.size() * sizeof(T));
+        return values;
+    }
+
+    // Inputs beyond input_types are float.
+    std::shared_ptr<GNode> make_generic(const std::string& op_type,
+                                        const std::vector<Shape>& input_shapes,
+                                        nnfusion::op::OpConfig::any config,
+                                        const std::vector<element::Type>& input_types = {})
+    {
+        auto graph = std::make_shared<graph::Graph>();
+        GNodeVector inputs;
+        for (size_t i = 0; i < input_shapes.size(); i++)
+        {
+            auto type = i < input_types.size() ? input_types[i] : element::f32;
+            inputs.push_back(graph->add_node_and_edge(
+                make_shared<op::Parameter>(type, input_shapes[i]), GNodeVector({})));
+        }
+        auto op = std::make_shared<nnfusion::op::GenericOp>(op_type, op_type, config);
+        return graph->add_node_and_edge(op, inputs);
+    }
+
+    // Rows of x normalized over cols with gamma and beta, the statistics in double.
+    std::vector<float> layer_norm(const std::vector<float>& x,
+                                  const std::vector<float>& gamma,
+                                  const std::vector<float>& beta,
+                                  float epsilon)
+    {
+        size_t cols = gamma.size(), rows = x.size() / cols;
+        std::vector<float> y(x.size());
+        for (size_t r = 0; r < rows; r++)
+        {
+            double mean = 0, var = 0;
+            for (size_t c = 0; c < cols; c++)
+                mean += x[r * cols + c];
+            mean /= cols;
+            for (size_t c = 0; c < cols; c++)
+                var += (x[r * cols + c] - mean) * (x[r * cols + c] - mean);
+            var /= cols;
+            for (size_t c = 0; c < cols; c++)
+                y[r * cols + c] =
+                    (x[r * cols + c] - mean) / std::sqrt(var + epsilon) * gamma[c] + beta[c];
+        }
+        return y;
+    }
+}
+
+TEST(nnfusion_core_kernels, simd_gelu)
+{
+    // 41 elements run full vectors and a masked tail with both AVX2 and AVX-512, the largest
+    // ones are beyond the clamp of the erf approximation.
+    std::vector<float> x;
+    for (int i = 0; i < 41; i++)
+        x.push_back(-4.0f + 0.25f * i);
+    auto gnode = make_generic("Gelu", {{41}}, nnfusion::op::OpConfig::any());
+    auto y = run_kernel(gnode, "simd", x);
+    ASSERT_EQ(y.size(), x.size());
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        double reference = 0.5 * x[i] * (1 + std::erf(x[i] / std::sqrt(2.0)));
+        EXPECT_NEAR(y[i], reference, 1e-5 + 1e-5 * std::abs(reference)) << "x = " << x[i];
+    }
+}
+
+TEST(nnfusion_core_kernels, simd_layer_norm)
+{
+    const size_t rows = 3, cols = 37;
+    std::vector<float> gamma(cols), beta(cols);
+    for (size_t c = 0; c < cols; c++)
+    {
+        gamma[c] = 1.0f + 0.01f * c;
+        beta[c] = 0.1f * c - 1.0f;
+    }
+    nnfusion::op::OpConfig::any config;
+    config["axis"] = -1;
+    config["epsilon"] = 1e-5f;
+    auto gnode = make_generic("LayerNorm", {{rows, cols}, {cols}, {cols}}, config);
+
+    // The rows are centered at 0, then 100, then 10000. The variance of the last ones is lost
+    // to cancellation with E[x^2] - E[x]^2 in float, but not with Welford's updates.
+    for (float offset : {0.0f, 100.0f, 10000.0f})
+    {
+        std::vector<float> x(rows * cols);
+        for (size_t i = 0; i < x.size(); i++)
+            x[i] = offset + std::sin(0.37f * i) * (1 + i / cols);
+        auto expected = layer_norm(x, gamma, beta, 1e-5f);
+
+        std::vector<float> inputs(x);
+        inputs.insert(inputs.end(), gamma.begin(), gamma.end());
+        inputs.insert(inputs.end(), beta.begin(), beta.end());
+        auto y = run_kernel(gnode, "simd", inputs);
+        ASSERT_EQ(y.size(), x.size());
+        // The kernel keeps the mean in float, which is only exact to about ulp(offset).
+        float tolerance = offset < 1000 ? 1e-4f : 1e-2f;
+        for (size_t i = 0; i < x.size(); i++)
+            EXPECT_NEAR(y[i], expected[i], tolerance) << "offset = " << offset << ", i = " << i;
+    }
+}
+
+TEST(nnfusion_core_kernels, simd_skip_layer_norm)
+{
+    const size_t batch = 2, sequence = 3, hidden = 37, rows = batch * sequence;
+    std::vector<float> x(rows * hidden), skip(rows * hidden), gamma(hidden), beta(hidden),
+        bias(hidden);
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        x[i] = std::sin(0.37f * i) * 3;
+        skip[i] = std::cos(0.11f * i);
+    }
+    for (size_t c = 0; c < hidden; c++)
+    {
+        gamma[c] = 1.0f + 0.01f * c;
+        beta[c] = 0.1f * c - 1.0f;
+        bias[c] = 0.05f * c;
+    }
+    nnfusion::op::OpConfig::any config;
+    config["epsilon"] = 1e-5f;
+
+    // input + skip, then input + skip + bias, normalized with gamma and beta
+    for (bool with_bias : {false, true})
+    {
+        std::vector<Shape> shapes{{batch, sequence, hidden}, {batch, sequence, hidden}};
+        shapes.insert(shapes.end(), with_bias ? 3 : 2, Shape{hidden});
+        auto gnode = make_generic("SkipLayerNorm", shapes, config);
+        std::vector<std::vector<char>> inputs{
+            to_bytes(x), to_bytes(skip), to_bytes(gamma), to_bytes(beta)};
+        if (with_bias)
+            inputs.push_back(to_bytes(bias));
+        auto outputs = run_simd_kernel(gnode, inputs);
+        ASSERT_FALSE(outputs.empty());
+        auto y = from_bytes<float>(outputs[0]);
+
+        std::vector<float> sum(x.size());
+        for (size_t i = 0; i < x.size(); i++)
+            sum[i] = x[i] + skip[i] + (with_bias ? bias[i % hidden] : 0);
+        auto expected = layer_norm(sum, gamma, beta, 1e-5f);
+        ASSERT_EQ(y.size(), expected.size());
+        for (size_t i = 0; i < y.size(); i++)
+            EXPECT_NEAR(y[i], expected[i], 1e-4f) << "bias = " << with_bias << ", i = " << i;
+    }
+}
+
+TEST(nnfusion_core_kernels, simd_embed_layer_norm)
+{
+    const size_t batch = 2, sequence = 3, hidden = 37, words = 5, segments = 2;
+    std::vector<int32_t> input_ids{4, 0, 2, 1, 1, 3}, segment_ids{0, 0, 1, 1, 0, 1};
+    // The first sequence is masked from its third token on, the second one not at all.
+    std::vector<int32_t> mask{1, 1, 0, 1, 1, 1};
+    std::vector<float> word(words * hidden), position(sequence * hidden),
+        segment(segments * hidden), gamma(hidden), beta(hidden);
+    for (size_t i = 0; i < word.size(); i++)
+        word[i] = std::sin(0.37f * i) * 2;
+    for (size_t i = 0; i < position.size(); i++)
+        position[i] = std::cos(0.23f * i);
+    for (size_t i = 0; i < segment.size(); i++)
+        segment[i] = 0.01f * i - 0.3f;
+    for (size_t c = 0; c < hidden; c++)
+    {
+        gamma[c] = 1.0f + 0.01f * c;
+        beta[c] = 0.1f * c - 1.0f;
+    }
+    nnfusion::op::OpConfig::any config;
+    config["epsilon"] = 1e-5f;
+
+    // the sum of the word, position and segment embeddings of each token, normalized
+    std::vector<float> sum(batch * sequence * hidden);
+    for (size_t r = 0; r < batch * sequence; r++)
+        for (size_t c = 0; c < hidden; c++)
+            sum[r * hidden + c] = word[input_ids[r] * hidden + c] +
+                                  position[r % sequence * hidden + c] +
+                                  segment[segment_ids[r] * hidden + c];
+    auto expected = layer_norm(sum, gamma, beta, 1e-5f);
+
+    for (bool with_mask : {false, true})
+    {
+        std::vector<Shape> shapes{{batch, sequence},
+                                  {batch, sequence},
+                                  {words, hidden},
+                                  {sequence, hidden},
+                                  {segments, hidden},
+                                  {hidden},
+                                  {hidden}};
+        std::vector<element::Type> types{element::i32, element::i32};
+        std::vector<std::vector<char>> inputs{to_bytes(input_ids),
+                                              to_bytes(segment_ids),
+                                              to_bytes(word),
+                                              to_bytes(position),
+                                              to_bytes(segment),
+                                              to_bytes(gamma),
+                                              to_bytes(beta)};
+        if (with_mask)
+        {
+            shapes.push_back({batch, sequence});
+            types.resize(7, element::f32);
+            types.push_back(element::i32);
+            inputs.push_back(to_bytes(mask));
+        }
+        auto gnode = make_generic("EmbedLayerNorm", shapes, config, types);
+        auto outputs = run_simd_kernel(gnode, inputs);
+        ASSERT_EQ(outputs.size(), 2u);
+
+        auto y = from_bytes<float>(outputs[0]);
+        ASSERT_EQ(y.size(), expected.size());
+        for (size_t i = 0; i < y.size(); i++)
+            EXPECT_NEAR(y[i], expected[i], 1e-4f) << "mask = " << with_mask << ", i = " << i;
+        // mask_index is the first masked position, the sequence length without a mask
+        EXPECT_EQ(from_bytes<int32_t>(outputs[1]),
+                  with_mask ? std::vector<int32_t>({2, 3}) : std::vector<int32_t>({3, 3}));
+    }
+}
@@ -0,0 +1,104 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+///\brief Tests of the MLAS Dot on weights packed by cpu_init, run in a generated runtime
+
+#include <fstream>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/op_define/dot.hpp"
+#include "nnfusion/test_util/cpu_runtime.hpp"
+
+DECLARE_bool(fmlas_prepack);
+
+namespace
+{
+    // K and N are no multiples of the MLAS packing blocks of 16 columns and 256 rows.
+    const size_t M = 5, K = 300, N = 37;
+
+    float weight(size_t k, size_t n) { return ((k * 7 + n * 3) % 11 - 5.0f) * 0.125f; }
+    // y1 = x * W and y2 = x * W2^T with constant W and W2 = W^T, which cpu_init packs, and
+    // y3 = x * Wp with Wp = W passed as a parameter, which is not packed. Exit code 1 for a
+    // wrong value, 2 for a packed product which differs from the unpacked one.
+    const char* prepack_driver = R"(
+#include <cmath>
+#include "nnfusion_rt.h"
+
+const int M = 5, K = 300, N = 37;
+
+int main()
+{
+    cpu_init();
+    static float x[M * K], w[K * N], y1[M * N], y2[M * N], y3[M * N];
+    for (int m = 0; m < M; m++)
+        for (int k = 0; k < K; k++)
+            x[m * K + k] = ((m * 5 + k) % 9 - 4.0f) * 0.25f;
+    for (int k = 0; k < K; k++)
+        for (int n = 0; n < N; n++)
+            w[k * N + n] = ((k * 7 + n * 3) % 11 - 5.0f) * 0.125f;
+    for (int run = 0; run < 2; run++)
+    {
+        kernel_entry(x, w, y1, y2, y3);
+        for (int m = 0; m < M; m++)
+            for (int n = 0; n < N; n++)
+            {
+                double expected = 0;
+                for (int k = 0; k < K; k++)
+                    expected += x[m * K + k] * w[k * N + n];
+                int i = m * N + n;
+                if (std::fabs(y3[i] - expected) > 1e-3 * std::fmax(1.0, std::fabs(expected)))
+                    return 1;
+                if (std::fabs(y1[i] - y3[i]) > 1e-4f * std::fmax(1.0f, std::fabs(y3[i])) ||
+                    std::fabs(y2[i] - y3[i]) > 1e-4f * std::fmax(1.0f, std::fabs(y3[i])))
+                    return 2;
+            }
+    }
+    cpu_free();
+    return 0;
+}
+)";
+}
+
+TEST(nnfusion_core_kernels, mlas_dot_prepacked_weights)
+{
+    std::vector<float> w(K * N), w_t(N * K);
+    for (size_t k = 0; k < K; k++)
+        for (size_t n = 0; n < N; n++)
+            w[k * N + n] = w_t[n * K + k] = weight(k, n);
+
+    auto graph = std::make_shared<graph::Graph>();
+    auto x = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{M, K}),
+                                      GNodeVector({}));
+    auto w_param = graph->add_node_and_edge(make_shared<op::Parameter>(element::f32, Shape{K, N}),
+                                            GNodeVector({}));
+    auto w_const = graph->add_node_and_edge(make_shared<op::Constant>(element::f32, Shape{K, N}, w),
+                                            GNodeVector({}));
+    auto w_t_const = graph->add_node_and_edge(
+        make_shared<op::Constant>(element::f32, Shape{N, K}, w_t), GNodeVector({}));
+    auto y1 = graph->add_node_and_edge(make_shared<op::Dot>(1), {x, w_const});
+    auto y2 = graph->add_node_and_edge(make_shared<op::Dot>(1, true, false, true), {x, w_t_const});
+    auto y3 = graph->add_node_and_edge(make_shared<op::Dot>(1), {x, w_param});
+    GNodeVector outputs;
+    for (auto& y : {y1, y2, y3})
+        outputs.push_back(graph->add_node_and_edge(make_shared<op::Result>(), {y}));
+    graph->set_default_parameters();
+    graph->set_outputs(outputs);
+
+    bool prepack = FLAGS_fmlas_prepack;
+    FLAGS_fmlas_prepack = true;
+    nnfusion::test::CpuRuntime runtime(graph);
+    FLAGS_fmlas_prepack = prepack;
+    ASSERT_TRUE(runtime.compiled());
+    ASSERT_TRUE(runtime.build(prepack_driver));
+    EXPECT_EQ(runtime.run("./runtime_check"), 0);
+
+    // cpu_init packs the two constant weights.
+    std::ifstream source(runtime.folder() + "nnfusion_rt.cpp");
+    std::string code((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    size_t packs = 0;
+    for (size_t pos = code.find("MlasGemmPackB("); pos != std::string::npos;
+         pos = code.find("MlasGemmPackB(", pos + 1))
+        packs++;
+    EXPECT_EQ(packs, 2u);
+}
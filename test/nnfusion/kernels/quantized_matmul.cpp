@@ -0,0 +1,119 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+///\brief Tests of the Mlas kernel of QuantizedMatMul against the float Dot it replaces
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/operators/generic_op/generic_op.hpp"
+
+namespace
+{
+    template <typename T>
+    std::vector<char> to_raw(const std::vector<T>& values)
+    {
+        std::vector<char> raw(values.size() * sizeof(T));
+        memcpy(raw.data(), values.data(), raw.size());
+        return raw;
+    }
+
+    // Run the mlas kernel of gnode on the raw inputs, return its float output.
+    std::vector<float> run_mlas(std::shared_ptr<GNode> gnode,
+                                const std::vector<std::vector<char>>& inputs)
+    {
+        auto rt = get_default_runtime(GENERIC_CPU);
+        EXPECT_TRUE(rt != nullptr);
+        auto kernel_regs = KernelRegistry::Global()->FindKernelRegistrations(
+            gnode->get_op_type(), GENERIC_CPU, element::f32);
+        shared_ptr<KernelContext> ctx(new KernelContext(gnode));
+        for (auto& kernel_reg : kernel_regs)
+        {
+            if (kernel_reg->m_tag != "mlas")
+                continue;
+            auto kernel = kernel_reg->m_factory(ctx);
+            EXPECT_TRUE(kernel->get_or_emit_source() != nullptr);
+            auto pctx = make_shared<ProfilingContext>(kernel);
+            pctx->warmup_times = 0;
+            pctx->host_times = 1;
+            pctx->runtime_times = 1;
+            Profiler prof(rt, pctx);
+            std::vector<std::vector<char>> outputs;
+            EXPECT_TRUE(prof.mixed_type_execute(inputs, outputs));
+            EXPECT_EQ(outputs.size(), size_t(1));
+            std::vector<float> result(outputs[0].size() / sizeof(float));
+            memcpy(result.data(), outputs[0].data(), outputs[0].size());
+            return result;
+        }
+        ADD_FAILURE() << "There is no mlas kernel of " << gnode->get_op_type();
+        return {};
+    }
+}
+
+TEST(nnfusion_core_kernels, quantized_matmul)
+{
+    // A is [2, 4, 8] in [-1, 1], asymmetrically quantized to uint8; B is [8, 3] in [-1, 1],
+    // symmetrically quantized to int8.
+    const size_t batch = 2, m = 4, k = 8, n = 3;
+    const float a_scale = 2.0f / 255, b_scale = 1.0f / 127;
+    const int a_zero_point = 128, b_zero_point = 0;
+
+    std::vector<float> A(batch * m * k), B(k * n);
+    for (size_t i = 0; i < A.size(); i++)
+        A[i] = std::sin(0.7f * i);
+    for (size_t i = 0; i < B.size(); i++)
+        B[i] = std::cos(1.3f * i);
+
+    std::vector<uint8_t> A_q(A.size());
+    std::vector<int8_t> B_q(B.size());
+    for (size_t i = 0; i < A.size(); i++)
+        A_q[i] = static_cast<uint8_t>(
+            std::min(255.0f, std::max(0.0f, std::round(A[i] / a_scale) + a_zero_point)));
+    for (size_t i = 0; i < B.size(); i++)
+        B_q[i] = static_cast<int8_t>(std::round(B[i] / b_scale) + b_zero_point);
+
+    auto graph = std::make_shared<graph::Graph>();
+    auto a = graph->add_node_and_edge(
+        make_shared<op::Parameter>(element::u8, Shape{batch, m, k}), GNodeVector({}));
+    auto b = graph->add_node_and_edge(make_shared<op::Parameter>(element::i8, Shape{k, n}),
+                                      GNodeVector({}));
+    nnfusion::op::OpConfig::any config;
+    config["a_zero_point"] = a_zero_point;
+    config["b_zero_point"] = b_zero_point;
+    config["scale"] = a_scale * b_scale;
+    auto op =
+        std::make_shared<nnfusion::op::GenericOp>("QuantizedMatMul", "QuantizedMatMul", config);
+    auto gnode = graph->add_node_and_edge(op, {a, b});
+
+    auto result = run_mlas(gnode, {to_raw(A_q), to_raw(B_q)});
+    ASSERT_EQ(result.size(), batch * m * n);
+
+    for (size_t row = 0; row < batch * m; row++)
+    {
+        for (size_t col = 0; col < n; col++)
+        {
+            int32_t accumulated = 0;
+            float reference = 0, bound = 0;
+            for (size_t i = 0; i < k; i++)
+            {
+                float a_value = A[row * k + i], b_value = B[i * n + col];
+                accumulated +=
+                    (A_q[row * k + i] - a_zero_point) * (B_q[i * n + col] - b_zero_point);
+                reference += a_value * b_value;
+                // Each operand is off by at most half of its quantization step.
+                bound += std::abs(a_value) * b_scale / 2 + std::abs(b_value) * a_scale / 2 +
+                         a_scale * b_scale / 4;
+            }
+            float value = result[row * n + col];
+            // The kernel computes the integer product exactly, ...
+            EXPECT_NEAR(value, a_scale * b_scale * accumulated, 1e-5f);
+            // ... which approximates the float Dot within the quantization error.
+            EXPECT_NEAR(value, reference, bound);
+        }
+    }
+}
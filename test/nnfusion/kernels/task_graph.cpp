@@ -0,0 +1,90 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+///\brief Tests of the task graph executor emitted for -fcpu_task_graph
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/wait.h>
+
+#include "../test_util/common.hpp"
+#include "gtest/gtest.h"
+#include "nnfusion/core/kernels/cpu/task_graph.hpp"
+
+namespace
+{
+    // Runs a diamond 0 -> {1, 2} -> 3 many times on 4 threads, then a graph whose first task
+    // sleeps while the other workers have nothing to do. Exit codes: 1 for a task run out of
+    // order or not exactly once, 2 for idle workers burning the cores.
+    const char* diamond_driver = R"(
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include "task_graph.h"
+
+int main()
+{
+    const int dep_count[] = {0, 1, 1, 2};
+    const int succ_offset[] = {0, 2, 3, 4, 4};
+    const int succ[] = {1, 2, 3, 3};
+    nnfusion::cpu::TaskGraphExecutor executor(4, dep_count, succ_offset, succ, 4);
+    for (int run = 0; run < 200; run++)
+    {
+        std::atomic<int> clock(0);
+        std::atomic<int> stamp[4];
+        std::atomic<int> count[4];
+        for (int i = 0; i < 4; i++)
+        {
+            stamp[i] = -1;
+            count[i] = 0;
+        }
+        executor.Run([&](int task) {
+            if (task == 1)
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            count[task]++;
+            stamp[task] = clock++;
+        });
+        for (int i = 0; i < 4; i++)
+            if (count[i] != 1)
+                return 1;
+        if (!(stamp[0] < stamp[1] && stamp[0] < stamp[2] && stamp[1] < stamp[3] &&
+              stamp[2] < stamp[3]))
+            return 1;
+    }
+
+    const int chain_dep_count[] = {0, 1};
+    const int chain_succ_offset[] = {0, 1, 1};
+    const int chain_succ[] = {1};
+    nnfusion::cpu::TaskGraphExecutor chain(2, chain_dep_count, chain_succ_offset, chain_succ, 8);
+    std::clock_t start = std::clock();
+    chain.Run([](int task) {
+        if (task == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    });
+    double cpu_seconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+    return cpu_seconds < 0.1 ? 0 : 2;
+}
+)";
+}
+
+TEST(nnfusion_core_kernels, task_graph_diamond)
+{
+    std::string dir = std::string(nnfusion::tmpnam(nullptr)) + "_task_graph";
+    ASSERT_EQ(system(("mkdir -p " + dir).c_str()), 0);
+    std::ofstream header(dir + "/task_graph.h");
+    header << nnfusion::kernels::task_graph_header->get_code();
+    header.close();
+    std::ofstream driver(dir + "/main.cpp");
+    driver << diamond_driver;
+    driver.close();
+
+    std::string binary = dir + "/task_graph_test";
+    std::string cmd = "g++ -std=c++11 -O2 -pthread " + dir + "/main.cpp -o " + binary;
+    ASSERT_EQ(system(cmd.c_str()), 0);
+    int status = system(binary.c_str());
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    system(("rm -rf " + dir).c_str());
+}
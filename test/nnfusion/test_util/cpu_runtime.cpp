@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "cpu_runtime.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "nnfusion/common/util.hpp"
+#include "nnfusion/engine/device/cpu.hpp"
+
+DECLARE_string(fdefault_device);
+DECLARE_bool(fextern_result_memory);
+
+using namespace nnfusion::test;
+
+CpuRuntime::CpuRuntime(const std::shared_ptr<nnfusion::graph::Graph>& graph)
+{
+    m_dir = std::string(nnfusion::tmpnam(nullptr)) + "_cpu_runtime";
+    m_folder = m_dir + "/nnfusion_rt/cpu_codegen/";
+    if (system(("mkdir -p " + m_dir).c_str()) != 0)
+        return;
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (chdir(m_dir.c_str()) == 0)
+        {
+            FLAGS_fdefault_device = "CPU";
+            FLAGS_fextern_result_memory = true;
+            try
+            {
+                nnfusion::engine::CpuEngine engine;
+                engine.run_on_graph(const_cast<std::shared_ptr<nnfusion::graph::Graph>&>(graph));
+            }
+            catch (const std::exception& e)
+            {
+                NNFUSION_LOG(ERROR) << e.what();
+            }
+        }
+        _exit(1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    m_compiled = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+CpuRuntime::~CpuRuntime()
+{
+    system(("rm -rf " + m_dir).c_str());
+}
+
+bool CpuRuntime::build(const std::string& driver)
+{
+    if (!m_compiled)
+        return false;
+    if (!driver.empty())
+    {
+        std::ofstream source(m_folder + "runtime_check.cpp");
+        source << driver;
+        source.close();
+        std::ofstream cmake(m_folder + "CMakeLists.txt", std::ios::app);
+        cmake << "\nadd_executable(runtime_check runtime_check.cpp)\n"
+              << "target_link_libraries(runtime_check nnfusion_cpu_rt)\n";
+        cmake.close();
+    }
+    std::string command = "cd " + m_folder + " && cmake . > /dev/null && make -j > /dev/null";
+    return system(command.c_str()) == 0;
+}
+
+int CpuRuntime::run(const std::string& command, std::string* output) const
+{
+    FILE* pipe = popen(("cd " + m_folder + " && " + command).c_str(), "r");
+    if (pipe == nullptr)
+        return -1;
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+    {
+        if (output)
+            output->append(buffer, count);
+    }
+    int status = pclose(pipe);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
@@ -0,0 +1,45 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "nnfusion/core/graph/graph.hpp"
+
+namespace nnfusion
+{
+    namespace test
+    {
+        /// \brief Runs a model in the CPU runtime generated for it, for the tests of the code
+        ///        which only runs there, like cpu_init or the generated main_test.
+        class CpuRuntime
+        {
+        public:
+            /// \brief Compiles graph with the CPU engine in a temporary folder, with the
+            ///        current flags and -fextern_result_memory, so that kernel_entry writes the
+            ///        outputs to caller memory. The engine runs in a child process, since the
+            ///        codegen ends the process it runs in.
+            CpuRuntime(const std::shared_ptr<nnfusion::graph::Graph>& graph);
+            ~CpuRuntime();
+
+            bool compiled() const { return m_compiled; }
+            /// \brief The folder of the generated runtime, ending with '/'.
+            const std::string& folder() const { return m_folder; }
+
+            /// \brief Builds the runtime, with driver as the source of the executable
+            ///        runtime_check when it is not empty.
+            bool build(const std::string& driver = "");
+
+            /// \brief Runs command in the folder of the runtime. Returns its exit code, or -1
+            ///        when it does not exit. Its standard output goes to output if given.
+            int run(const std::string& command, std::string* output = nullptr) const;
+
+        private:
+            std::string m_dir;
+            std::string m_folder;
+            bool m_compiled = false;
+        };
+    }
+}
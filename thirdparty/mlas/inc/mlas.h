@@ -126,6 +126,45 @@ MlasGemm(
     MLAS_THREADPOOL* ThreadPool
     );
 
+//
+// Matrix/matrix multiply with a constant matrix B packed once.
+//
+
+size_t
+MLASCALL
+MlasGemmPackBSize(
+    size_t N,
+    size_t K
+    );
+
+void
+MLASCALL
+MlasGemmPackB(
+    CBLAS_TRANSPOSE TransB,
+    size_t N,
+    size_t K,
+    const float* B,
+    size_t ldb,
+    void* PackedB
+    );
+
+void
+MLASCALL
+MlasGemm(
+    CBLAS_TRANSPOSE TransA,
+    size_t M,
+    size_t N,
+    size_t K,
+    float alpha,
+    const float* A,
+    size_t lda,
+    const void* PackedB,
+    float beta,
+    float* C,
+    size_t ldc,
+    MLAS_THREADPOOL* ThreadPool
+    );
+
 void
 MLASCALL
 MlasGemm(
@@ -191,6 +230,7 @@ enum MLAS_CONV_ALGORITHM {
 
 struct MLAS_CONV_PARAMETERS {
     const MLAS_ACTIVATION* Activation;
+    float Beta;
     size_t Dimensions;
     size_t BatchCount;
     size_t GroupCount;
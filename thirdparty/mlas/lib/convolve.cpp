@@ -571,7 +571,7 @@ Return Value:
         //
 
         size_t CountK;
-        float beta = 0.0f;
+        float beta = Parameters->Beta;
         float* SegmentOutput = Output + SegmentStartN + n;
 
         for (size_t k = 0; k < K; k += CountK) {
@@ -718,8 +718,8 @@ Return Value:
         //
 
         MlasSgemmOperation(CblasNoTrans, Parameters->u.GemmDirect.TransB, FilterCount,
-            OutputSize, K, 1.0f, filter, K, input, Parameters->u.GemmDirect.ldb, 0.0f,
-            output, OutputSize);
+            OutputSize, K, 1.0f, filter, K, input, Parameters->u.GemmDirect.ldb,
+            Parameters->Beta, output, OutputSize);
 
         //
         // Apply the activation with optional bias.
@@ -857,7 +857,9 @@ Arguments:
     WorkingBuffer - Supplies a working buffer sized to the number of elements
         returned by MlasConvPrepare.
 
-    Output - Supplies the output tensor.
+    Output - Supplies the output tensor. The convolution is added to the
+        existing contents scaled by Parameters->Beta, which MlasConvPrepare
+        sets to zero.
 
     ThreadPool - Supplies the thread pool object to use, else nullptr if the
         base library threading support should be used.
@@ -934,8 +936,8 @@ Return Value:
                     //
 
                     MlasGemm(CblasNoTrans, Parameters->u.GemmDirect.TransB, FilterCount,
-                        OutputSize, K, 1.0f, filter, K, Input, Parameters->u.GemmDirect.ldb, 0.0f,
-                        Output, OutputSize, ThreadPool);
+                        OutputSize, K, 1.0f, filter, K, Input, Parameters->u.GemmDirect.ldb,
+                        Parameters->Beta, Output, OutputSize, ThreadPool);
 
                     //
                     // Apply the activation with optional bias.
@@ -961,7 +963,8 @@ Return Value:
                     }
 
                     MlasGemm(CblasNoTrans, CblasNoTrans, FilterCount, OutputSize, K, 1.0f, filter,
-                        K, WorkingBuffer, OutputSize, 0.0f, Output, OutputSize, ThreadPool);
+                        K, WorkingBuffer, OutputSize, Parameters->Beta, Output, OutputSize,
+                        ThreadPool);
 
                     //
                     // Apply the activation with optional bias.
@@ -1080,6 +1083,7 @@ Return Value:
     //
 
     Parameters->Activation = Activation;
+    Parameters->Beta = 0.0f;
     Parameters->Dimensions = Dimensions;
     Parameters->BatchCount = BatchCount;
     Parameters->GroupCount = GroupCount;